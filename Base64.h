@@ -0,0 +1,104 @@
+#ifndef Base64_h
+#define Base64_h
+
+// Library includes.
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// @brief Standard base64 (RFC 4648, with padding), to embed binary data like compressed batches into a JSON string value, which needs no escaping afterwards
+class Base64 {
+  public:
+    /// @brief Length of the encoded text, excluding the null terminator
+    /// @param size Size of the binary data in bytes
+    /// @return Amount of characters
+    static constexpr size_t Get_Encoded_Length(size_t const & size) {
+        return (size + 2U) / 3U * 4U;
+    }
+
+    /// @brief Encodes binary data into null-terminated text
+    /// @param input Binary data
+    /// @param size Size of the binary data in bytes
+    /// @param output Buffer the text is written into
+    /// @param capacity Size of the output buffer in bytes, including the space for the null terminator
+    /// @return Length of the text or 0 if it does not fit into the output
+    static size_t Encode(uint8_t const * input, size_t const & size, char * output, size_t const & capacity) {
+        size_t const length = Get_Encoded_Length(size);
+        if (length >= capacity) {
+            return 0U;
+        }
+        size_t written = 0U;
+        for (size_t i = 0U; i < size; i += 3U) {
+            uint32_t const remaining = static_cast<uint32_t>(size - i);
+            uint32_t const group = (static_cast<uint32_t>(input[i]) << 16U)
+              | (remaining > 1U ? static_cast<uint32_t>(input[i + 1U]) << 8U : 0U)
+              | (remaining > 2U ? static_cast<uint32_t>(input[i + 2U]) : 0U);
+            output[written++] = Character(group >> 18U);
+            output[written++] = Character(group >> 12U);
+            output[written++] = remaining > 1U ? Character(group >> 6U) : '=';
+            output[written++] = remaining > 2U ? Character(group) : '=';
+        }
+        output[written] = '\0';
+        return written;
+    }
+
+    /// @brief Decodes text into binary data, whitespace is not allowed
+    /// @param input Encoded text
+    /// @param length Length of the text, has to be a multiple of 4
+    /// @param output Buffer the binary data is written into
+    /// @param capacity Size of the output buffer in bytes
+    /// @return Size of the binary data or 0 if the text is invalid or does not fit into the output
+    static size_t Decode(char const * input, size_t const & length, uint8_t * output, size_t const & capacity) {
+        if (length % 4U != 0U) {
+            return 0U;
+        }
+        size_t written = 0U;
+        for (size_t i = 0U; i < length; i += 4U) {
+            bool const last = i + 4U == length;
+            uint8_t const padding = last ? static_cast<uint8_t>((input[i + 3U] == '=') + (input[i + 2U] == '=')) : 0U;
+            uint32_t group = 0U;
+            for (size_t j = 0U; j < 4U - padding; j++) {
+                int8_t const value = Value(input[i + j]);
+                if (value < 0) {
+                    return 0U;
+                }
+                group |= static_cast<uint32_t>(value) << (18U - 6U * j);
+            }
+            size_t const bytes = 3U - padding;
+            if (written + bytes > capacity) {
+                return 0U;
+            }
+            for (size_t j = 0U; j < bytes; j++) {
+                output[written++] = static_cast<uint8_t>(group >> (16U - 8U * j));
+            }
+        }
+        return written;
+    }
+
+  private:
+    static int8_t Value(char const & character) {
+        if (character >= 'A' && character <= 'Z') {
+            return static_cast<int8_t>(character - 'A');
+        }
+        if (character >= 'a' && character <= 'z') {
+            return static_cast<int8_t>(character - 'a' + 26);
+        }
+        if (character >= '0' && character <= '9') {
+            return static_cast<int8_t>(character - '0' + 52);
+        }
+        if (character == '+') {
+            return 62;
+        }
+        if (character == '/') {
+            return 63;
+        }
+        return -1;
+    }
+
+    /// @brief Character of the given 6 bit value, a string literal instead of a static member array, which would need a definition outside of the class before C++17
+    static char Character(uint32_t const & value) {
+        return "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[value & 0x3FU];
+    }
+};
+
+#endif // Base64_h
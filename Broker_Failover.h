@@ -0,0 +1,238 @@
+#ifndef Broker_Failover_h
+#define Broker_Failover_h
+
+// Library includes.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/// @brief Address of one broker
+struct Broker_Endpoint {
+    char const * host; // Host name or IP address, has to stay valid as long as the failover uses it
+    uint16_t     port; // Port of the MQTT listener
+};
+
+
+/// @brief Timing of the broker failover
+struct Broker_Failover_Settings {
+    uint8_t  failures_before_switch = 1U;  // Failed connects or lost connections in a row after which the next broker is used
+    uint32_t down_ms = 30000U;             // Time a failed broker is skipped when choosing the standby, unless every other broker failed as well
+    uint32_t fallback_holdoff_ms = 60000U; // Time a preferred broker has to stay reachable, and the current connection has to be up, before falling back to it
+};
+
+
+/// @brief Chooses the broker to connect to from a list in the order of preference. The active broker is replaced by the standby broker,
+/// the most preferred broker that did not fail recently, as soon as it failed failures_before_switch times in a row, e.g. because it is restarted for maintenance.
+/// The standby broker is checked regularly by the caller (see Warm_Standby), once a more preferred broker than the active one stayed reachable long enough the caller falls back to it.
+/// Only decides, connecting is left to the caller, so it can be used with any client and on the host (see tools/broker_failover_test.cpp)
+/// @tparam MaxBrokers Maximum amount of brokers in the list, default = 4
+template<size_t MaxBrokers = 4U>
+class Broker_Failover {
+  public:
+    /// @brief Constructor
+    /// @param brokers Brokers in the order of preference, the first one is used initially, has to stay valid as long as the failover is used
+    /// @param count Amount of brokers, at most MaxBrokers are used
+    /// @param settings Timing of the failover, default = Broker_Failover_Settings()
+    Broker_Failover(Broker_Endpoint const * brokers, size_t const & count, Broker_Failover_Settings const & settings = Broker_Failover_Settings())
+      : m_brokers(brokers)
+      , m_count(count < MaxBrokers ? count : MaxBrokers)
+      , m_settings(settings)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Broker that should be connected to
+    /// @return Active broker
+    Broker_Endpoint const & Get_Active() const {
+        return m_brokers[m_active];
+    }
+
+    /// @brief Position of the active broker in the list
+    /// @return Index of the active broker
+    size_t const & Get_Active_Index() const {
+        return m_active;
+    }
+
+    /// @brief Broker the active one is replaced with if it fails, and that the standby connection should be kept to.
+    /// The most preferred broker except the active one, brokers that failed recently are skipped as long as there are others
+    /// @param now_ms Current time in milliseconds
+    /// @return Index of the standby broker, equal to the amount of brokers if there is only one
+    size_t Get_Standby_Index(uint32_t const & now_ms) const {
+        size_t fallback = m_count;
+        for (size_t index = 0U; index < m_count; index++) {
+            if (index == m_active) {
+                continue;
+            }
+            if (!Is_Down(index, now_ms)) {
+                return index;
+            }
+            fallback = fallback < m_count ? fallback : index;
+        }
+        return fallback;
+    }
+
+    /// @brief Has to be called once the connection to the active broker was established
+    /// @param now_ms Current time in milliseconds
+    void Connected(uint32_t const & now_ms) {
+        m_failures = 0U;
+        m_down_until_ms[m_active] = 0U;
+        m_connected_ms = now_ms | 1U;
+    }
+
+    /// @brief Has to be called if connecting to the active broker failed or the established connection was lost, switches to the standby broker once it failed often enough
+    /// @param now_ms Current time in milliseconds
+    /// @return Whether the active broker changed, connecting to the new one should then be tried immediately instead of backing off
+    bool Failed(uint32_t const & now_ms) {
+        m_connected_ms = 0U;
+        m_down_until_ms[m_active] = (now_ms + m_settings.down_ms) | 1U;
+        m_reachable_since_ms[m_active] = 0U;
+        m_failures++;
+        if (m_failures < m_settings.failures_before_switch) {
+            return false;
+        }
+        size_t const standby = Get_Standby_Index(now_ms);
+        if (standby >= m_count) {
+            m_failures = 0U;
+            return false;
+        }
+        Switch_To(standby);
+        return true;
+    }
+
+    /// @brief Has to be called with the result of every check of a broker, that is not the active one, e.g. connecting the standby connection
+    /// @param index Index of the checked broker
+    /// @param reachable Whether the broker could be reached
+    /// @param now_ms Current time in milliseconds
+    void Checked(size_t const & index, bool const & reachable, uint32_t const & now_ms) {
+        if (index >= m_count) {
+            return;
+        }
+        if (reachable) {
+            m_down_until_ms[index] = 0U;
+            m_reachable_since_ms[index] = m_reachable_since_ms[index] != 0U ? m_reachable_since_ms[index] : (now_ms | 1U);
+        }
+        else {
+            m_down_until_ms[index] = (now_ms + m_settings.down_ms) | 1U;
+            m_reachable_since_ms[index] = 0U;
+        }
+    }
+
+    /// @brief Whether the standby broker is preferred over the active one and stayed reachable for the holdoff, while the active connection was up for the holdoff as well,
+    /// so a broker that just came back or a connection that was just established are not switched away from immediately
+    /// @param now_ms Current time in milliseconds
+    /// @return Whether the caller should switch to the standby broker with Switch_To()
+    bool Is_Fallback_Due(uint32_t const & now_ms) const {
+        size_t const standby = Get_Standby_Index(now_ms);
+        if (standby >= m_active || m_connected_ms == 0U || m_reachable_since_ms[standby] == 0U) {
+            return false;
+        }
+        return now_ms - m_reachable_since_ms[standby] >= m_settings.fallback_holdoff_ms && now_ms - m_connected_ms >= m_settings.fallback_holdoff_ms;
+    }
+
+    /// @brief Makes the given broker the active one, the caller has to close the current connection and connect again
+    /// @param index Index of the broker
+    void Switch_To(size_t const & index) {
+        if (index >= m_count || index == m_active) {
+            return;
+        }
+        m_active = index;
+        m_failures = 0U;
+        m_connected_ms = 0U;
+        m_reachable_since_ms[index] = 0U;
+        m_switches++;
+    }
+
+    /// @brief Amount of times the active broker changed
+    /// @return Amount of switches
+    uint32_t const & Get_Switches() const {
+        return m_switches;
+    }
+
+  private:
+    bool Is_Down(size_t const & index, uint32_t const & now_ms) const {
+        return m_down_until_ms[index] != 0U && static_cast<int32_t>(now_ms - m_down_until_ms[index]) < 0;
+    }
+
+    Broker_Endpoint const *  m_brokers = nullptr;                  // Brokers in the order of preference
+    size_t                   m_count = 0U;                         // Amount of brokers
+    Broker_Failover_Settings m_settings = {};                      // Timing of the failover
+    size_t                   m_active = 0U;                        // Index of the active broker
+    uint8_t                  m_failures = 0U;                      // Failures of the active broker in a row
+    uint32_t                 m_connected_ms = 0U;                  // Time the active connection was established, 0 while it is not
+    uint32_t                 m_down_until_ms[MaxBrokers] = {};     // Time until which a failed broker is skipped, 0 if it did not fail
+    uint32_t                 m_reachable_since_ms[MaxBrokers] = {}; // Time since which a broker was reachable without interruption, 0 if it was not
+    uint32_t                 m_switches = 0U;                      // Changes of the active broker
+};
+
+
+/// @brief Pair of sockets, one used by the MQTT connection and a warm standby one kept connected to the standby broker.
+/// Switching to the standby broker then only needs the MQTT handshake over the already established socket, instead of a DNS lookup and a TCP handshake first,
+/// which are the slow part of connecting over a bad or congested link. Connecting the standby socket doubles as the reachability check of the standby broker.
+/// Brokers close sockets that do not start the MQTT handshake after a while, the standby socket therefore has to be refreshed regularly with Warm()
+/// @tparam Socket Client type with connect(const char *, uint16_t, int32_t) that gives up after the timeout in milliseconds, connected() and stop(), e.g. the WiFiClient of the ESP32
+template<typename Socket>
+class Warm_Standby {
+  public:
+    /// @brief Constructor
+    /// @param first Socket used by the MQTT connection initially
+    /// @param second Socket used as the standby initially
+    Warm_Standby(Socket & first, Socket & second)
+      : m_sockets{ &first, &second }
+    {
+        // Nothing to do
+    }
+
+    /// @brief Socket currently used by the MQTT connection
+    /// @return Active socket
+    Socket & Get_Active() {
+        return *m_sockets[m_active];
+    }
+
+    /// @brief Keeps the standby socket connected to the given broker, connects it again if it was closed or belongs to another broker.
+    /// Connecting blocks until the socket is connected or the given timeout expired, the default connect timeout of the socket is meant for the connection
+    /// that is actually needed and would stall the caller for seconds every time the standby broker is down
+    /// @param broker Standby broker
+    /// @param timeout_ms Time connecting may block, a broker that did not accept the connection within it counts as unreachable
+    /// @return Whether the standby socket is connected to the broker
+    bool Warm(Broker_Endpoint const & broker, int32_t const & timeout_ms) {
+        Socket & standby = *m_sockets[m_active ^ 1U];
+        if (Is_Warm(broker.host, broker.port) && standby.connected()) {
+            return true;
+        }
+        standby.stop();
+        m_host = nullptr;
+        if (!standby.connect(broker.host, broker.port, timeout_ms)) {
+            return false;
+        }
+        m_host = broker.host;
+        m_port = broker.port;
+        return true;
+    }
+
+    /// @brief Makes the standby socket the active one, if it is connected to the given broker, the previously active socket is closed
+    /// @param host Host that should be connected to
+    /// @param port Port that should be connected to
+    /// @return Whether the standby socket was taken over, otherwise the active socket has to be connected as usual
+    bool Adopt(char const * host, uint16_t const & port) {
+        if (!Is_Warm(host, port) || !m_sockets[m_active ^ 1U]->connected()) {
+            return false;
+        }
+        m_sockets[m_active]->stop();
+        m_active ^= 1U;
+        m_host = nullptr;
+        return true;
+    }
+
+  private:
+    bool Is_Warm(char const * host, uint16_t const & port) const {
+        return m_host != nullptr && host != nullptr && m_port == port && strcmp(m_host, host) == 0;
+    }
+
+    Socket *     m_sockets[2U] = {}; // Both sockets, the one at m_active is used by the MQTT connection
+    uint8_t      m_active = 0U;      // Index of the active socket
+    char const * m_host = nullptr;   // Broker the standby socket is connected to, nullptr if it is not
+    uint16_t     m_port = 0U;        // Port the standby socket is connected to
+};
+
+#endif // Broker_Failover_h
@@ -0,0 +1,239 @@
+#ifndef Calibration_h
+#define Calibration_h
+
+// Library includes.
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// @brief Precomputed lookup table, that linearizes raw ADC readings with one table lookup and one linear interpolation,
+/// instead of evaluating the nonlinear calibration function (log, pow, division) for every sample.
+/// The table has an entry every 2^(Input_Bits - Index_Bits) raw counts, the index and the interpolation fraction are therefore a shift and a mask
+/// @tparam Input_Bits Resolution of the raw readings, for example 12 for the ESP32 ADC or 10 for the ESP8266 ADC
+/// @tparam Index_Bits Amount of table segments as a power of two, the table contains 2^Index_Bits + 1 entries
+template<uint8_t Input_Bits, uint8_t Index_Bits>
+class Linearization_Table {
+    static_assert(Index_Bits <= Input_Bits, "Table can not contain more segments than there are raw values");
+
+  public:
+    /// @brief Amount of entries in the table
+    static size_t constexpr ENTRIES = (1U << Index_Bits) + 1U;
+    /// @brief Largest raw value that can be linearized
+    static uint32_t constexpr MAX_RAW = (1UL << Input_Bits) - 1U;
+
+    /// @brief Evaluates the calibration function once for every table entry, expensive, but only has to be done when the calibration changes
+    /// @tparam Function Callable taking the raw reading as an uint32_t and returning the linearized value as a float
+    /// @param function Calibration function that should be approximated by the table
+    template<typename Function>
+    void Build(Function const & function) {
+        for (size_t index = 0U; index < ENTRIES; index++) {
+            uint32_t const raw = static_cast<uint32_t>(index) << SHIFT;
+            m_table[index] = function(raw > MAX_RAW ? MAX_RAW : raw);
+        }
+    }
+
+    /// @brief Linearizes the given raw reading
+    /// @param raw Raw reading, values above MAX_RAW are clamped
+    /// @return Linearized value, interpolated between the two neighbouring table entries
+    float Lookup(uint32_t raw) const {
+        if (raw > MAX_RAW) {
+            raw = MAX_RAW;
+        }
+        size_t const index = raw >> SHIFT;
+        float const fraction = static_cast<float>(raw & MASK) * INVERSE_STEP;
+        return m_table[index] + (m_table[index + 1U] - m_table[index]) * fraction;
+    }
+
+  private:
+    static uint8_t constexpr SHIFT = Input_Bits - Index_Bits;
+    static uint32_t constexpr MASK = (1UL << SHIFT) - 1U;
+    static constexpr float INVERSE_STEP = 1.0f / static_cast<float>(1UL << SHIFT);
+
+    float m_table[ENTRIES] = {};
+};
+
+
+/// @brief Point measured while calibrating a thermistor
+struct Thermistor_Point {
+    float resistance_ohm;   // Measured resistance of the thermistor
+    float temperature_c;    // Reference temperature in degrees celsius
+};
+
+/// @brief Steinhart-Hart model of a NTC thermistor, 1 / T = A + B * ln(R) + C * ln(R)^3
+struct Steinhart_Hart {
+    double a = 0.0;
+    double b = 0.0;
+    double c = 0.0;
+
+    /// @brief Solves the three coefficients from three calibration points, which should span the measured range
+    /// @param points Calibration points, have to be ordered by resistance and must not contain duplicate resistances
+    /// @return Whether the points resulted in a physically meaningful model, that is monotonic over the calibrated range
+    bool Fit(Thermistor_Point const (&points)[3U]) {
+        double l[3U] = {};
+        double y[3U] = {};
+        for (size_t i = 0U; i < 3U; i++) {
+            if (points[i].resistance_ohm <= 0.0f) {
+                return false;
+            }
+            l[i] = log(static_cast<double>(points[i].resistance_ohm));
+            y[i] = 1.0 / (static_cast<double>(points[i].temperature_c) + KELVIN_OFFSET);
+        }
+        if (l[0U] == l[1U] || l[0U] == l[2U] || l[1U] == l[2U]) {
+            return false;
+        }
+        double const gamma2 = (y[1U] - y[0U]) / (l[1U] - l[0U]);
+        double const gamma3 = (y[2U] - y[0U]) / (l[2U] - l[0U]);
+        c = (gamma3 - gamma2) / (l[2U] - l[1U]) / (l[0U] + l[1U] + l[2U]);
+        b = gamma2 - c * (l[0U] * l[0U] + l[0U] * l[1U] + l[1U] * l[1U]);
+        a = y[0U] - (b + l[0U] * l[0U] * c) * l[0U];
+        // A NTC gets colder with rising resistance, the derivative of 1 / T has to be positive everywhere in the calibrated range
+        for (size_t i = 0U; i < 3U; i++) {
+            if (b + 3.0 * c * l[i] * l[i] <= 0.0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Evaluates the model, expensive because of the logarithm, therefore only used to build the lookup table
+    /// @param resistance_ohm Resistance of the thermistor
+    /// @return Temperature in degrees celsius
+    float Temperature(double const & resistance_ohm) const {
+        double const l = log(resistance_ohm);
+        return static_cast<float>(1.0 / (a + b * l + c * l * l * l) - KELVIN_OFFSET);
+    }
+
+    static constexpr double KELVIN_OFFSET = 273.15;
+};
+
+
+/// @brief Thermistor on the low side of a voltage divider with a fixed series resistor on the high side, linearized through a lookup table
+/// @tparam Input_Bits Resolution of the raw ADC readings
+/// @tparam Index_Bits Amount of table segments as a power of two
+template<uint8_t Input_Bits, uint8_t Index_Bits>
+class Thermistor_Calibration {
+  public:
+    /// @brief Constructor
+    /// @param series_resistance_ohm Resistance of the fixed resistor in the voltage divider
+    explicit Thermistor_Calibration(float const & series_resistance_ohm)
+      : m_series_resistance_ohm(series_resistance_ohm)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Fits the Steinhart-Hart model to the given points and rebuilds the lookup table,
+    /// the previous calibration is kept if the points are invalid
+    /// @param points Calibration points, have to be ordered by resistance
+    /// @return Whether the calibration was applied
+    bool Calibrate(Thermistor_Point const (&points)[3U]) {
+        Steinhart_Hart model;
+        if (!model.Fit(points)) {
+            return false;
+        }
+        float const series = m_series_resistance_ohm;
+        m_table.Build([&model, &series](uint32_t raw) {
+            // Both ends of the range mean a shorted or disconnected thermistor, clamp to the closest measurable resistance
+            if (raw == 0U) {
+                raw = 1U;
+            }
+            else if (raw >= Table::MAX_RAW) {
+                raw = Table::MAX_RAW - 1U;
+            }
+            double const resistance = series * static_cast<double>(raw) / static_cast<double>(Table::MAX_RAW - raw);
+            return model.Temperature(resistance);
+        });
+        m_calibrated = true;
+        return true;
+    }
+
+    /// @brief Whether a calibration has been applied, readings are meaningless before that
+    /// @return Whether the thermistor is calibrated
+    bool const & Is_Calibrated() const {
+        return m_calibrated;
+    }
+
+    /// @brief Converts a raw ADC reading into a temperature
+    /// @param raw Raw ADC reading of the voltage over the thermistor
+    /// @return Temperature in degrees celsius
+    float Temperature(uint32_t const & raw) const {
+        return m_table.Lookup(raw);
+    }
+
+  private:
+    using Table = Linearization_Table<Input_Bits, Index_Bits>;
+
+    float m_series_resistance_ohm = 0.0f; // Fixed resistor in the voltage divider
+    Table m_table = {};                   // Precomputed raw reading to temperature table
+    bool  m_calibrated = false;           // Whether the table has been built
+};
+
+
+/// @brief Point measured while calibrating a pH probe with a buffer solution
+struct PH_Point {
+    float raw;  // Raw ADC reading in the buffer solution
+    float ph;   // pH of the buffer solution
+};
+
+/// @brief pH probe calibrated with two or three buffer solutions, piecewise linear between the points and extrapolated outside of them.
+/// The electrode slope is proportional to the absolute temperature (Nernst equation), therefore readings are compensated to the current temperature
+/// around the isopotential point at pH 7, which is a single multiplication per sample
+/// @tparam Input_Bits Resolution of the raw ADC readings
+/// @tparam Index_Bits Amount of table segments as a power of two
+template<uint8_t Input_Bits, uint8_t Index_Bits>
+class PH_Calibration {
+  public:
+    /// @brief Rebuilds the lookup table from the given buffer points, the previous calibration is kept if the points are invalid
+    /// @param points Calibration points, have to be ordered by raw reading
+    /// @param count Amount of points, 2 or 3
+    /// @param calibration_temperature_c Temperature of the buffer solutions while calibrating
+    /// @return Whether the calibration was applied
+    bool Calibrate(PH_Point const * points, size_t const & count, float const & calibration_temperature_c) {
+        if (count < 2U || count > 3U) {
+            return false;
+        }
+        for (size_t i = 1U; i < count; i++) {
+            if (points[i].raw <= points[i - 1U].raw) {
+                return false;
+            }
+        }
+        m_table.Build([points, count](uint32_t const & raw) {
+            // Use the segment containing the reading, or the closest one to extrapolate
+            size_t segment = 0U;
+            while (segment + 2U < count && static_cast<float>(raw) > points[segment + 1U].raw) {
+                segment++;
+            }
+            PH_Point const & low = points[segment];
+            PH_Point const & high = points[segment + 1U];
+            return low.ph + (static_cast<float>(raw) - low.raw) * (high.ph - low.ph) / (high.raw - low.raw);
+        });
+        m_calibration_temperature_k = calibration_temperature_c + static_cast<float>(Steinhart_Hart::KELVIN_OFFSET);
+        m_calibrated = true;
+        return true;
+    }
+
+    /// @brief Whether a calibration has been applied, readings are meaningless before that
+    /// @return Whether the probe is calibrated
+    bool const & Is_Calibrated() const {
+        return m_calibrated;
+    }
+
+    /// @brief Converts a raw ADC reading into a pH value, compensated to the given temperature
+    /// @param raw Raw ADC reading of the probe
+    /// @param temperature_c Current temperature of the medium
+    /// @return pH value
+    float PH(uint32_t const & raw, float const & temperature_c) const {
+        float const uncompensated = m_table.Lookup(raw);
+        float const factor = m_calibration_temperature_k / (temperature_c + static_cast<float>(Steinhart_Hart::KELVIN_OFFSET));
+        return ISOPOTENTIAL_PH + (uncompensated - ISOPOTENTIAL_PH) * factor;
+    }
+
+  private:
+    static constexpr float ISOPOTENTIAL_PH = 7.0f;
+
+    Linearization_Table<Input_Bits, Index_Bits> m_table = {};                   // Precomputed raw reading to pH at calibration temperature table
+    float                                       m_calibration_temperature_k = 298.15f; // Temperature the table is valid for
+    bool                                        m_calibrated = false;           // Whether the table has been built
+};
+
+#endif // Calibration_h
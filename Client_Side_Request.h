@@ -0,0 +1,356 @@
+#ifndef Client_Side_Request_h
+#define Client_Side_Request_h
+
+// Local includes.
+#include "Callback.h"
+#include "IAPI_Implementation.h"
+#include "Json_Writer.h"
+#include "Log_Level.h"
+#include "Timer_Wheel.h"
+
+
+// Client side request topics.
+char constexpr CLIENT_REQUEST_ATTRIBUTE_TOPIC[] = "v1/devices/me/attributes/request/%u";
+char constexpr CLIENT_REQUEST_ATTRIBUTE_RESPONSE_SUBSCRIBE_TOPIC[] = "v1/devices/me/attributes/response/+";
+char constexpr CLIENT_REQUEST_ATTRIBUTE_RESPONSE_TOPIC[] = "v1/devices/me/attributes/response/";
+char constexpr CLIENT_REQUEST_RPC_TOPIC[] = "v1/devices/me/rpc/request/%u";
+char constexpr CLIENT_REQUEST_RPC_RESPONSE_SUBSCRIBE_TOPIC[] = "v1/devices/me/rpc/response/+";
+char constexpr CLIENT_REQUEST_RPC_RESPONSE_TOPIC[] = "v1/devices/me/rpc/response/";
+// Client side request data keys.
+char constexpr CLIENT_REQUEST_SHARED_KEYS[] = "sharedKeys";
+char constexpr CLIENT_REQUEST_CLIENT_KEYS[] = "clientKeys";
+char constexpr CLIENT_REQUEST_SHARED_RESPONSE_KEY[] = "shared";
+char constexpr CLIENT_REQUEST_CLIENT_RESPONSE_KEY[] = "client";
+char constexpr CLIENT_REQUEST_METHOD_KEY[] = "method";
+char constexpr CLIENT_REQUEST_PARAMS_KEY[] = "params";
+// Log messages.
+char constexpr CLIENT_REQUEST_TABLE_FULL[] = "Too many outstanding client side requests, increase MaxOutstanding (%u)";
+char constexpr CLIENT_REQUEST_PAYLOAD_OVERFLOWED[] = "Client side request payload overflowed, increase MaxPayloadSize (%u)";
+char constexpr CLIENT_REQUEST_UNKNOWN_ID[] = "Received response for unknown or timed out client side request with id (%u)";
+
+
+/// @brief Handles the internal implementation of device to server requests, meaning attribute requests
+/// (see https://thingsboard.io/docs/reference/mqtt-api/#request-attribute-values-from-the-server)
+/// and client side RPC (see https://thingsboard.io/docs/reference/mqtt-api/#client-side-rpc).
+/// In comparison to Attribute_Request, which waits for every request on its own watchdog, any amount of requests up to MaxOutstanding can be pipelined.
+/// Outstanding requests are kept in a fixed-size table, that is addressed by the request id, so matching a received response is O(1).
+/// Their deadlines are registered with the shared Timer_Wheel, so timeouts cost nothing until they expire instead of being polled every loop iteration
+/// @tparam MaxOutstanding Maximum amount of requests that can wait for their response at the same time, default = 16
+/// @tparam Logger Implementation that should be used to print error messages generated by internal processes and additional debugging messages if THINGSBOARD_ENABLE_DEBUG is set,
+/// wrap it in a Log_Policy to choose the level of the Log_Category::REQUEST messages at compile time instead, default = DefaultLogger
+/// @tparam MaxPayloadSize Maximum size of the serialized request payload including the null terminator, default = 128
+template<size_t MaxOutstanding = 16U, typename Logger = DefaultLogger, size_t MaxPayloadSize = 128U>
+class Client_Side_Request : public IAPI_Implementation {
+  public:
+    /// @brief Callback called with the received response. Attribute requests receive the object containing the requested attributes,
+    /// client side RPC requests the complete response sent by the server
+    using Response_Callback = Callback<void, JsonVariantConst const &>;
+    /// @brief Callback called if no response was received before the deadline, or the request was given up because the API was unsubscribed
+    using Timeout_Callback = Callback<void>;
+
+    /// @brief Constructor
+    /// @param timers Timer wheel the deadlines of the outstanding requests are registered with, has to be advanced regularly by its owner
+    explicit Client_Side_Request(Timer_Wheel & timers)
+      : m_timers(timers)
+    {
+        for (auto & request : m_requests) {
+            request.owner = this;
+            request.timer = Timer_Wheel::Timer(&Timeout_Expired, &request);
+        }
+    }
+
+    /// @brief Requests the current values of the given shared attributes, the response is passed to the given callback.
+    /// Does not wait for the response, multiple requests can be outstanding at the same time
+    /// @tparam InputIterator Class that points to the begin and end iterator of the given attribute key container
+    /// @param first Iterator pointing to the first attribute key
+    /// @param last Iterator pointing to the end of the attribute keys (last element + 1)
+    /// @param response_callback Called with the object containing the received attributes
+    /// @param timeout_microseconds Time after which the request is given up and the timeout callback is called instead
+    /// @param timeout_callback Called if no response was received in time or the request was given up by Unsubscribe(), can be nullptr
+    /// @return Whether sending the request was successful or not
+    template<typename InputIterator>
+    bool Shared_Attributes_Request(InputIterator const & first, InputIterator const & last, typename Response_Callback::function response_callback, uint64_t const & timeout_microseconds, typename Timeout_Callback::function timeout_callback) {
+        return Attributes_Request(Request_Type::SHARED_ATTRIBUTES, CLIENT_REQUEST_SHARED_KEYS, first, last, response_callback, timeout_microseconds, timeout_callback);
+    }
+
+    /// @brief Requests the current values of the given client attributes, the response is passed to the given callback.
+    /// Does not wait for the response, multiple requests can be outstanding at the same time
+    /// @tparam InputIterator Class that points to the begin and end iterator of the given attribute key container
+    /// @param first Iterator pointing to the first attribute key
+    /// @param last Iterator pointing to the end of the attribute keys (last element + 1)
+    /// @param response_callback Called with the object containing the received attributes
+    /// @param timeout_microseconds Time after which the request is given up and the timeout callback is called instead
+    /// @param timeout_callback Called if no response was received in time or the request was given up by Unsubscribe(), can be nullptr
+    /// @return Whether sending the request was successful or not
+    template<typename InputIterator>
+    bool Client_Attributes_Request(InputIterator const & first, InputIterator const & last, typename Response_Callback::function response_callback, uint64_t const & timeout_microseconds, typename Timeout_Callback::function timeout_callback) {
+        return Attributes_Request(Request_Type::CLIENT_ATTRIBUTES, CLIENT_REQUEST_CLIENT_KEYS, first, last, response_callback, timeout_microseconds, timeout_callback);
+    }
+
+    /// @brief Calls the given method on the server, the response is passed to the given callback.
+    /// Does not wait for the response, multiple requests can be outstanding at the same time
+    /// @param method_name Name of the server side method that should be called
+    /// @param params Already serialized JSON params of the call, nullptr if the method does not expect any
+    /// @param response_callback Called with the response of the server
+    /// @param timeout_microseconds Time after which the request is given up and the timeout callback is called instead
+    /// @param timeout_callback Called if no response was received in time or the request was given up by Unsubscribe(), can be nullptr
+    /// @return Whether sending the request was successful or not
+    bool RPC_Request(char const * method_name, char const * params, typename Response_Callback::function response_callback, uint64_t const & timeout_microseconds, typename Timeout_Callback::function timeout_callback) {
+        char payload[MaxPayloadSize] = {};
+        Json_Writer writer(payload, sizeof(payload));
+        writer.Begin_Object();
+        writer.Add(CLIENT_REQUEST_METHOD_KEY, method_name);
+        writer.Key(CLIENT_REQUEST_PARAMS_KEY);
+        if (params == nullptr) {
+            writer.Raw_Value("{}", 2U);
+        }
+        else {
+            writer.Raw_Value(params, strlen(params));
+        }
+        writer.End_Object();
+        return Send_Request(Request_Type::RPC, CLIENT_REQUEST_RPC_TOPIC, writer, response_callback, timeout_microseconds, timeout_callback);
+    }
+
+    /// @brief Amount of requests that are still waiting for their response
+    /// @return Amount of outstanding requests
+    size_t const & Get_Outstanding() const {
+        return m_outstanding;
+    }
+
+    API_Process_Type Get_Process_Type() const override {
+        return API_Process_Type::JSON;
+    }
+
+    void Process_Response(char const * topic, uint8_t * payload, unsigned int length) override {
+        // Nothing to do
+    }
+
+    void Process_Json_Response(char const * topic, JsonDocument const & data) override {
+        bool const is_rpc = strncmp(CLIENT_REQUEST_RPC_RESPONSE_TOPIC, topic, strlen(CLIENT_REQUEST_RPC_RESPONSE_TOPIC)) == 0;
+        size_t const request_id = Helper::parseRequestId(is_rpc ? CLIENT_REQUEST_RPC_RESPONSE_TOPIC : CLIENT_REQUEST_ATTRIBUTE_RESPONSE_TOPIC, topic);
+        size_t const index = Find(request_id);
+        if (index == NO_ENTRY || (m_requests[index].type == Request_Type::RPC) != is_rpc) {
+            Log<Log_Level::WARNING>::printfln(CLIENT_REQUEST_UNKNOWN_ID, request_id);
+            return;
+        }
+
+        Request_Type const type = m_requests[index].type;
+        Response_Callback const response_callback = m_requests[index].response_callback;
+        Release(index);
+        JsonVariantConst const response = data.as<JsonVariantConst>();
+        switch (type) {
+            case Request_Type::SHARED_ATTRIBUTES:
+                response_callback.Call_Callback(response[CLIENT_REQUEST_SHARED_RESPONSE_KEY]);
+                break;
+            case Request_Type::CLIENT_ATTRIBUTES:
+                response_callback.Call_Callback(response[CLIENT_REQUEST_CLIENT_RESPONSE_KEY]);
+                break;
+            default:
+                response_callback.Call_Callback(response);
+                break;
+        }
+    }
+
+    bool Compare_Response_Topic(char const * topic) const override {
+        return strncmp(CLIENT_REQUEST_ATTRIBUTE_RESPONSE_TOPIC, topic, strlen(CLIENT_REQUEST_ATTRIBUTE_RESPONSE_TOPIC)) == 0 ||
+               strncmp(CLIENT_REQUEST_RPC_RESPONSE_TOPIC, topic, strlen(CLIENT_REQUEST_RPC_RESPONSE_TOPIC)) == 0;
+    }
+
+    bool Unsubscribe() override {
+        // Outstanding requests will never receive their response, they are given up like a timeout, so whoever waits for them is notified.
+        // The callbacks are only called once the table is consistent again, because they are allowed to send new requests
+        Timeout_Callback given_up[MaxOutstanding] = {};
+        size_t count = 0U;
+        for (size_t index = 0U; index < MaxOutstanding; index++) {
+            if (m_requests[index].used) {
+                given_up[count++] = m_requests[index].timeout_callback;
+                Release(index);
+            }
+        }
+        for (size_t index = 0U; index < count; index++) {
+            given_up[index].Call_Callback();
+        }
+        bool const attributes_unsubscribed = !m_attribute_subscribed || m_unsubscribe_topic_callback.Call_Callback(CLIENT_REQUEST_ATTRIBUTE_RESPONSE_SUBSCRIBE_TOPIC);
+        bool const rpc_unsubscribed = !m_rpc_subscribed || m_unsubscribe_topic_callback.Call_Callback(CLIENT_REQUEST_RPC_RESPONSE_SUBSCRIBE_TOPIC);
+        m_attribute_subscribed = false;
+        m_rpc_subscribed = false;
+        return attributes_unsubscribed && rpc_unsubscribed;
+    }
+
+    bool Resubscribe_Topic() override {
+        if (m_attribute_subscribed && !m_subscribe_topic_callback.Call_Callback(CLIENT_REQUEST_ATTRIBUTE_RESPONSE_SUBSCRIBE_TOPIC)) {
+            Log<Log_Level::ERROR>::printfln(SUBSCRIBE_TOPIC_FAILED, CLIENT_REQUEST_ATTRIBUTE_RESPONSE_SUBSCRIBE_TOPIC);
+            return false;
+        }
+        if (m_rpc_subscribed && !m_subscribe_topic_callback.Call_Callback(CLIENT_REQUEST_RPC_RESPONSE_SUBSCRIBE_TOPIC)) {
+            Log<Log_Level::ERROR>::printfln(SUBSCRIBE_TOPIC_FAILED, CLIENT_REQUEST_RPC_RESPONSE_SUBSCRIBE_TOPIC);
+            return false;
+        }
+        return true;
+    }
+
+#if !THINGSBOARD_USE_ESP_TIMER
+    void loop() override {
+        // Nothing to do, timeouts are driven by the shared timer wheel
+    }
+#endif // !THINGSBOARD_USE_ESP_TIMER
+
+    void Initialize() override {
+        // Nothing to do
+    }
+
+    void Set_Client_Callbacks(Callback<void, IAPI_Implementation &>::function subscribe_api_callback, Callback<bool, char const * const, JsonDocument const &, size_t const &>::function send_json_callback, Callback<bool, char const * const, char const * const>::function send_json_string_callback, Callback<bool, char const * const>::function subscribe_topic_callback, Callback<bool, char const * const>::function unsubscribe_topic_callback, Callback<uint16_t>::function get_size_callback, Callback<bool, uint16_t>::function set_buffer_size_callback, Callback<size_t *>::function get_request_id_callback) override {
+        m_send_json_string_callback.Set_Callback(send_json_string_callback);
+        m_subscribe_topic_callback.Set_Callback(subscribe_topic_callback);
+        m_unsubscribe_topic_callback.Set_Callback(unsubscribe_topic_callback);
+        m_get_request_id_callback.Set_Callback(get_request_id_callback);
+    }
+
+  private:
+    // Returned if no table slot contains the searched request
+    static size_t constexpr NO_ENTRY = MaxOutstanding;
+
+    // Messages of the given level, removed at compile time if the level is disabled for the Logger
+    template<Log_Level Level>
+    using Log = Log_Site<Log_Category::REQUEST, Level, Logger>;
+
+    enum class Request_Type : uint8_t {
+        SHARED_ATTRIBUTES,
+        CLIENT_ATTRIBUTES,
+        RPC
+    };
+
+    struct Request {
+        bool                  used = false;             // Whether the slot contains an outstanding request
+        Request_Type          type = {};               // Kind of the request, decides how the response is passed to the callback
+        size_t                request_id = 0U;         // Id the request was sent with, the response is received with the same id
+        Response_Callback     response_callback = {};  // Called with the received response
+        Timeout_Callback      timeout_callback = {};   // Called once the deadline passed without response
+        Timer_Wheel::Timer    timer = {};              // Deadline of the request, registered with the shared timer wheel
+        Client_Side_Request * owner = nullptr;         // Instance the request belongs to, used by the timer callback
+    };
+
+    /// @brief Timer wheel callback of an outstanding request, whose deadline passed without receiving a response
+    /// @param context Request that timed out
+    static void Timeout_Expired(void * context) {
+        Request & request = *static_cast<Request *>(context);
+        Timeout_Callback const timeout_callback = request.timeout_callback;
+        request.owner->Release(static_cast<size_t>(&request - request.owner->m_requests));
+        timeout_callback.Call_Callback();
+    }
+
+    template<typename InputIterator>
+    bool Attributes_Request(Request_Type const & type, char const * keys_name, InputIterator const & first, InputIterator const & last, typename Response_Callback::function response_callback, uint64_t const & timeout_microseconds, typename Timeout_Callback::function timeout_callback) {
+        // Attribute keys are sent as one comma separated string
+        char keys[MaxPayloadSize] = {};
+        size_t length = 0U;
+        for (auto it = first; it != last; ++it) {
+            size_t const key_length = strlen(*it);
+            if (length + key_length + 1U >= sizeof(keys)) {
+                Log<Log_Level::ERROR>::printfln(CLIENT_REQUEST_PAYLOAD_OVERFLOWED, MaxPayloadSize);
+                return false;
+            }
+            if (length != 0U) {
+                keys[length++] = ',';
+            }
+            memcpy(keys + length, *it, key_length);
+            length += key_length;
+        }
+
+        char payload[MaxPayloadSize] = {};
+        Json_Writer writer(payload, sizeof(payload));
+        writer.Begin_Object();
+        writer.Add(keys_name, static_cast<char const *>(keys));
+        writer.End_Object();
+        return Send_Request(type, CLIENT_REQUEST_ATTRIBUTE_TOPIC, writer, response_callback, timeout_microseconds, timeout_callback);
+    }
+
+    bool Send_Request(Request_Type const & type, char const * topic_format, Json_Writer const & writer, typename Response_Callback::function response_callback, uint64_t const & timeout_microseconds, typename Timeout_Callback::function timeout_callback) {
+        if (writer.Overflowed()) {
+            Log<Log_Level::ERROR>::printfln(CLIENT_REQUEST_PAYLOAD_OVERFLOWED, MaxPayloadSize);
+            return false;
+        }
+        else if (m_outstanding >= MaxOutstanding) {
+            Log<Log_Level::ERROR>::printfln(CLIENT_REQUEST_TABLE_FULL, MaxOutstanding);
+            return false;
+        }
+
+        bool & subscribed = (type == Request_Type::RPC) ? m_rpc_subscribed : m_attribute_subscribed;
+        char const * const subscribe_topic = (type == Request_Type::RPC) ? CLIENT_REQUEST_RPC_RESPONSE_SUBSCRIBE_TOPIC : CLIENT_REQUEST_ATTRIBUTE_RESPONSE_SUBSCRIBE_TOPIC;
+        if (!subscribed) {
+            if (!m_subscribe_topic_callback.Call_Callback(subscribe_topic)) {
+                Log<Log_Level::ERROR>::printfln(SUBSCRIBE_TOPIC_FAILED, subscribe_topic);
+                return false;
+            }
+            subscribed = true;
+        }
+
+        size_t * p_request_id = m_get_request_id_callback.Call_Callback();
+        if (p_request_id == nullptr) {
+            return false;
+        }
+        size_t & request_id = *p_request_id;
+        request_id++;
+
+        char topic[Helper::detectSize(topic_format, request_id)] = {};
+        (void)snprintf(topic, sizeof(topic), topic_format, request_id);
+        if (!m_send_json_string_callback.Call_Callback(topic, writer.Get_String())) {
+            return false;
+        }
+
+        // Table is addressed by the request id, collisions are resolved by probing the following slots
+        size_t index = request_id % MaxOutstanding;
+        while (m_requests[index].used) {
+            index = (index + 1U) % MaxOutstanding;
+        }
+        Request & request = m_requests[index];
+        request.used = true;
+        request.type = type;
+        request.request_id = request_id;
+        request.response_callback.Set_Callback(response_callback);
+        request.timeout_callback.Set_Callback(timeout_callback);
+        m_outstanding++;
+
+        // Round up, a request must never time out before its deadline
+        uint64_t const timeout_milliseconds = (timeout_microseconds + 999U) / 1000U;
+        m_timers.Start(request.timer, timeout_milliseconds > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(timeout_milliseconds));
+        return true;
+    }
+
+    /// @brief Searches the outstanding request with the given id, starting at the slot the id maps to
+    /// @return Index of the request in the table or NO_ENTRY if it is not outstanding (anymore)
+    size_t Find(size_t const & request_id) const {
+        size_t index = request_id % MaxOutstanding;
+        for (size_t probed = 0U; probed < MaxOutstanding; probed++) {
+            Request const & request = m_requests[index];
+            if (request.used && request.request_id == request_id) {
+                return index;
+            }
+            index = (index + 1U) % MaxOutstanding;
+        }
+        return NO_ENTRY;
+    }
+
+    /// @brief Stops the deadline of the request and frees its table slot
+    void Release(size_t const & index) {
+        Request & request = m_requests[index];
+        m_timers.Stop(request.timer);
+        request.used = false;
+        request.response_callback = Response_Callback();
+        request.timeout_callback = Timeout_Callback();
+        m_outstanding--;
+    }
+
+    Callback<bool, char const * const, char const * const> m_send_json_string_callback = {};  // Send json string callback
+    Callback<bool, char const * const>                     m_subscribe_topic_callback = {};   // Subscribe mqtt topic client callback
+    Callback<bool, char const * const>                     m_unsubscribe_topic_callback = {}; // Unubscribe mqtt topic client callback
+    Callback<size_t *>                                     m_get_request_id_callback = {};    // Get internal request id client callback
+
+    Timer_Wheel &  m_timers;                           // Shared timer wheel the request deadlines are registered with
+    Request        m_requests[MaxOutstanding] = {};    // Outstanding requests, addressed by request id
+    size_t         m_outstanding = 0U;                 // Amount of used table slots
+    bool           m_attribute_subscribed = false;     // Whether the attribute response topic has been subscribed
+    bool           m_rpc_subscribed = false;           // Whether the rpc response topic has been subscribed
+};
+
+#endif // Client_Side_Request_h
@@ -0,0 +1,220 @@
+#ifndef Deferred_Logger_h
+#define Deferred_Logger_h
+
+// Library includes.
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+
+
+/// @brief Logger implementation with the same interface as DefaultLogger, that can be passed as the Logger template argument of the API implementations,
+/// but which does not format the message while it is logged. Only the pointer to the format string and the raw arguments are copied into a ring,
+/// the message is formatted and printed later by calling Flush() from the idle part of loop(), so logging inside time critical paths, like processing a received rpc,
+/// costs a few copies instead of formatting and writing to a slow serial port (see tools/logger_benchmark.cpp).
+/// Format strings have to stay valid until they are flushed, which is the case for the string constants used by the library. String arguments are copied,
+/// because they often point into the buffer of the received message. Messages that do not fit into the ring are counted and dropped.
+/// One context may log while another one flushes, the ring is shared between every API implementation using the same template arguments
+/// @tparam Capacity Amount of messages the ring can hold, has to be a power of two, default = 16
+/// @tparam ArgumentSize Maximum size of the arguments of one message, longer string arguments are truncated, default = 48
+template<size_t Capacity = 16U, size_t ArgumentSize = 48U>
+class Deferred_Logger {
+    static_assert(Capacity > 0U && (Capacity & (Capacity - 1U)) == 0U, "Capacity has to be a power of two");
+
+  public:
+    /// @brief Maximum length of one formatted message, longer ones are truncated
+    static size_t constexpr MAX_MESSAGE_LENGTH = 160U;
+
+    /// @brief Queues a message with arguments
+    /// @tparam Args Types of the arguments, arithmetic types and strings are supported
+    /// @param format Format string, has to stay valid until the message is flushed
+    /// @param args Arguments of the format string
+    /// @return 0 if the message was queued, -1 if the ring was full or the arguments did not fit
+    template<typename ...Args>
+    static int printfln(char const * const format, Args const &... args) {
+        return Queue(format, &Unpack<typename Stored<Args>::Type...>::template Format<>, args...);
+    }
+
+    /// @brief Queues a message without arguments
+    /// @param message Message, has to stay valid until it is flushed
+    /// @return 0 if the message was queued, -1 if the ring was full
+    static int println(char const * const message) {
+        return Queue(message, &Copy);
+    }
+
+    /// @brief Formats and prints the queued messages, each on its own line, may only be called from one context at a time.
+    /// Stops before a message that would exceed the given amount of bytes, which allows to only print what fits into the transmit buffer of the output without blocking.
+    /// Messages longer than the output can ever take at once are truncated to max_line, otherwise they would never fit and block every message queued after them
+    /// @tparam Output Anything with println(const char *), e.g. the Arduino Print class
+    /// @param output Output the messages are printed to
+    /// @param max_bytes Maximum amount of bytes to print, including the line ending of every message
+    /// @param max_line Maximum size of a single line including its line ending, e.g. the size of the transmit buffer, default = SIZE_MAX (only truncated to MAX_MESSAGE_LENGTH)
+    /// @return Amount of printed messages
+    template<typename Output>
+    static size_t Flush(Output & output, size_t max_bytes, size_t const & max_line = SIZE_MAX) {
+        size_t printed = 0U;
+        char message[MAX_MESSAGE_LENGTH] = {};
+        // Buffer size the messages are formatted with, including the null terminator that takes the place of the line ending
+        size_t const message_size = max_line > LINE_ENDING_SIZE && max_line - LINE_ENDING_SIZE < sizeof(message) ? max_line - LINE_ENDING_SIZE + 1U : sizeof(message);
+        while (true) {
+            uint32_t const tail = s_tail.load(std::memory_order_relaxed);
+            if (tail == s_head.load(std::memory_order_acquire)) {
+                break;
+            }
+            Entry const & entry = s_entries[tail & (Capacity - 1U)];
+            int const length = entry.formatter(message, message_size, entry.format, entry.arguments);
+            size_t const size = (length < 0 ? 0U : (static_cast<size_t>(length) < message_size ? static_cast<size_t>(length) : message_size - 1U)) + LINE_ENDING_SIZE;
+            if (size > max_bytes) {
+                break;
+            }
+            output.println(message);
+            max_bytes -= size;
+            s_tail.store(tail + 1U, std::memory_order_release);
+            printed++;
+        }
+        return printed;
+    }
+
+    /// @brief Whether messages are waiting to be flushed
+    /// @return Whether the ring is not empty
+    static bool Has_Pending() {
+        return s_tail.load(std::memory_order_relaxed) != s_head.load(std::memory_order_acquire);
+    }
+
+    /// @brief Amount of messages that were dropped, because the ring was full
+    /// @return Amount of dropped messages
+    static uint32_t Get_Dropped() {
+        return s_dropped.load(std::memory_order_relaxed);
+    }
+
+  private:
+    // Carriage return and new line written by println
+    static size_t constexpr LINE_ENDING_SIZE = 2U;
+
+    using Formatter = int (*)(char *, size_t, char const *, uint8_t const *);
+
+    /// @brief Queued message
+    struct Entry {
+        char const * format = nullptr;            // Format string of the message
+        Formatter    formatter = nullptr;         // Formats the message with the arguments, instantiated for their types
+        uint8_t      arguments[ArgumentSize] = {}; // Copied arguments, strings including their null terminator
+    };
+
+    // Type an argument is stored as, strings are copied into the entry and read back as a pointer into it
+    template<typename T, bool String = std::is_convertible<T, char const *>::value>
+    struct Stored {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "Only arithmetic types and strings can be logged");
+        using Type = T;
+
+        static bool Write(uint8_t * data, size_t & used, T const & value) {
+            if (used + sizeof(T) > ArgumentSize) {
+                return false;
+            }
+            memcpy(data + used, &value, sizeof(T));
+            used += sizeof(T);
+            return true;
+        }
+
+        static uint8_t const * Read(uint8_t const * data, T & value) {
+            memcpy(&value, data, sizeof(T));
+            return data + sizeof(T);
+        }
+    };
+
+    template<typename T>
+    struct Stored<T, true> {
+        using Type = char const *;
+
+        static bool Write(uint8_t * data, size_t & used, char const * value) {
+            if (used >= ArgumentSize) {
+                return false;
+            }
+            if (value == nullptr) {
+                value = "(null)";
+            }
+            size_t const length = strnlen(value, ArgumentSize - used - 1U);
+            memcpy(data + used, value, length);
+            data[used + length] = '\0';
+            used += length + 1U;
+            return true;
+        }
+
+        static uint8_t const * Read(uint8_t const * data, char const * & value) {
+            value = reinterpret_cast<char const *>(data);
+            return data + strlen(value) + 1U;
+        }
+    };
+
+    template<typename ...Args>
+    static int Queue(char const * const format, Formatter const & formatter, Args const &... args) {
+        uint32_t const head = s_head.load(std::memory_order_relaxed);
+        if (head - s_tail.load(std::memory_order_acquire) >= Capacity) {
+            s_dropped.fetch_add(1U, std::memory_order_relaxed);
+            return -1;
+        }
+        Entry & entry = s_entries[head & (Capacity - 1U)];
+        size_t used = 0U;
+        if (!Store(entry.arguments, used, args...)) {
+            s_dropped.fetch_add(1U, std::memory_order_relaxed);
+            return -1;
+        }
+        entry.format = format;
+        entry.formatter = formatter;
+        s_head.store(head + 1U, std::memory_order_release);
+        return 0;
+    }
+
+    static bool Store(uint8_t *, size_t &) {
+        return true;
+    }
+
+    template<typename First, typename ...Rest>
+    static bool Store(uint8_t * data, size_t & used, First const & first, Rest const &... rest) {
+        return Stored<First>::Write(data, used, first) && Store(data, used, rest...);
+    }
+
+    // Reads the stored arguments back one after another, once all of them were read the message is formatted with them
+    template<typename ...Pending>
+    struct Unpack {
+        template<typename ...Done>
+        static int Format(char * message, size_t size, char const * format, uint8_t const *, Done... done) {
+            return snprintf(message, size, format, done...);
+        }
+    };
+
+    template<typename First, typename ...Rest>
+    struct Unpack<First, Rest...> {
+        template<typename ...Done>
+        static int Format(char * message, size_t size, char const * format, uint8_t const * data, Done... done) {
+            typename Stored<First>::Type value;
+            data = Stored<First>::Read(data, value);
+            return Unpack<Rest...>::template Format<Done..., typename Stored<First>::Type>(message, size, format, data, done..., value);
+        }
+    };
+
+    // Messages without arguments are printed as they are, like DefaultLogger::println
+    static int Copy(char * message, size_t size, char const * text, uint8_t const *) {
+        return snprintf(message, size, "%s", text);
+    }
+
+    static Entry                 s_entries[Capacity]; // Ring of the queued messages
+    static std::atomic<uint32_t> s_head;              // Amount of messages ever queued
+    static std::atomic<uint32_t> s_tail;              // Amount of messages ever flushed
+    static std::atomic<uint32_t> s_dropped;           // Messages dropped because the ring was full
+};
+
+template<size_t Capacity, size_t ArgumentSize>
+typename Deferred_Logger<Capacity, ArgumentSize>::Entry Deferred_Logger<Capacity, ArgumentSize>::s_entries[Capacity] = {};
+
+template<size_t Capacity, size_t ArgumentSize>
+std::atomic<uint32_t> Deferred_Logger<Capacity, ArgumentSize>::s_head = {0U};
+
+template<size_t Capacity, size_t ArgumentSize>
+std::atomic<uint32_t> Deferred_Logger<Capacity, ArgumentSize>::s_tail = {0U};
+
+template<size_t Capacity, size_t ArgumentSize>
+std::atomic<uint32_t> Deferred_Logger<Capacity, ArgumentSize>::s_dropped = {0U};
+
+#endif // Deferred_Logger_h
@@ -0,0 +1,472 @@
+#ifndef Delta_OTA_h
+#define Delta_OTA_h
+
+// Library includes.
+#include <stddef.h>
+#include <stdint.h>
+#if defined(ESP32)
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#endif // defined(ESP32)
+
+
+/// @brief CRC-32 (IEEE 802.3, the checksum of zlib and Ethernet) with a 16 entry table, which processes a nibble per lookup and needs only 64 bytes of constant data
+class Crc32 {
+  public:
+    /// @brief Initial value of a running checksum
+    static uint32_t constexpr INITIAL = 0xFFFFFFFFU;
+
+    /// @brief Continues a running checksum with the given data, the final checksum is Finalize() of the running value
+    /// @param crc Running checksum, INITIAL for the first block
+    /// @param data Data that should be added
+    /// @param size Size of the data in bytes
+    /// @return Updated running checksum
+    static uint32_t Update(uint32_t crc, uint8_t const * data, size_t const & size) {
+        for (size_t i = 0U; i < size; i++) {
+            crc ^= data[i];
+            crc = (crc >> 4U) ^ Table(crc & 0x0FU);
+            crc = (crc >> 4U) ^ Table(crc & 0x0FU);
+        }
+        return crc;
+    }
+
+    /// @brief Converts a running checksum into the final checksum
+    /// @param crc Running checksum
+    /// @return Checksum
+    static uint32_t Finalize(uint32_t const & crc) {
+        return crc ^ 0xFFFFFFFFU;
+    }
+
+    /// @brief Checksum of a complete buffer
+    /// @param data Data the checksum should be calculated for
+    /// @param size Size of the data in bytes
+    /// @return Checksum
+    static uint32_t Calculate(uint8_t const * data, size_t const & size) {
+        return Finalize(Update(INITIAL, data, size));
+    }
+
+  private:
+    static uint32_t Table(uint32_t const & index) {
+        static uint32_t const table[16U] = {
+            0x00000000U, 0x1DB71064U, 0x3B6E20C8U, 0x26D930ACU, 0x76DC4190U, 0x6B6B51F4U, 0x4DB26158U, 0x5005713CU,
+            0xEDB88320U, 0xF00F9344U, 0xD6D6A3E8U, 0xCB61B38CU, 0x9B64C2B0U, 0x86D3D2D4U, 0xA00AE278U, 0xBDBDF21CU
+        };
+        return table[index];
+    }
+};
+
+
+/// @brief Instructions of a delta patch, every instruction is followed by its arguments as unsigned LEB128 varints
+enum class Delta_Opcode : uint8_t {
+    COPY = 0x01U, // Offset and length, copies bytes of the running (source) image, unchanged code and data
+    ADD = 0x02U   // Length followed by that many bytes, inserts new bytes
+};
+
+/// @brief Result of applying a patch, every error is final, the patch has to be restarted afterwards
+enum class Delta_Status : uint8_t {
+    OK,                 // Everything consumed so far is valid
+    INVALID_HEADER,     // Magic or sizes of the header are invalid
+    SOURCE_MISMATCH,    // Patch was created against a different image than the one running
+    INVALID_PATCH,      // Unknown instruction, copy outside of the source or output longer than the target
+    SOURCE_READ_FAILED, // Source image could not be read
+    SINK_WRITE_FAILED,  // Output could not be written
+    INCOMPLETE,         // Patch ended before the complete target was written
+    TARGET_MISMATCH     // Written image does not have the checksum of the target
+};
+
+/// @brief Readable description of a status, sent back as the error of a failed update
+/// @param status Status of the patch
+/// @return Description of the status
+inline char const * Get_Delta_Status_Text(Delta_Status const & status) {
+    switch (status) {
+        case Delta_Status::OK:
+            return "ok";
+        case Delta_Status::INVALID_HEADER:
+            return "invalid header";
+        case Delta_Status::SOURCE_MISMATCH:
+            return "source mismatch";
+        case Delta_Status::INVALID_PATCH:
+            return "invalid patch";
+        case Delta_Status::SOURCE_READ_FAILED:
+            return "source read failed";
+        case Delta_Status::SINK_WRITE_FAILED:
+            return "sink write failed";
+        case Delta_Status::INCOMPLETE:
+            return "incomplete";
+        case Delta_Status::TARGET_MISMATCH:
+            return "target mismatch";
+    }
+    return "unknown";
+}
+
+/// @brief Sizes and checksums of the images a patch converts between, the first bytes of every patch
+struct Delta_Header {
+    uint32_t source_size = 0U; // Size of the image the patch was created against
+    uint32_t source_crc = 0U;  // Checksum of that image
+    uint32_t target_size = 0U; // Size of the resulting image
+    uint32_t target_crc = 0U;  // Checksum of the resulting image
+};
+
+
+/// @brief Applies a binary delta patch against the running image while the patch is streamed in chunks of any size, without buffering the patch or the image.
+/// The patch starts with the magic "BDP1" and the Delta_Header (all 32 bit little endian), followed by COPY and ADD instructions (see Delta_Opcode).
+/// Before the first instruction the source image is verified against the checksum in the header, while applying every instruction is range checked
+/// and the checksum of the written image is accumulated, which Finish() compares against the target, so a corrupted or mismatched patch is never activated.
+/// The source is verified in slices of SourceCheckSize bytes, one per Push(), so no single call reads the whole image. Until the source is verified
+/// Push() does not consume the instructions, the caller pushes them again from Get_Consumed(), like a chunk whose acknowledgement got lost.
+/// A full image is the special case of a patch with a single ADD instruction, see tools/delta_patch.cpp for creating patches
+/// @tparam Source Class providing bool Read(uint32_t offset, uint8_t * buffer, size_t size) for the running image
+/// @tparam Sink Class providing bool Write(uint8_t const * data, size_t size) for the new image
+/// @tparam CopyBufferSize Size of the buffer bytes are copied from the source through, default = 256
+/// @tparam SourceCheckSize Bytes of the source verified per Push(), bounds the time of a single call, default = 32768
+template<typename Source, typename Sink, size_t CopyBufferSize = 256U, size_t SourceCheckSize = 32768U>
+class Delta_Patch_Applier {
+    static_assert(SourceCheckSize > 0U, "The source has to be verified in slices of at least one byte");
+
+  public:
+    /// @brief Size of the magic and the header in front of the instructions
+    static size_t constexpr HEADER_SIZE = 20U;
+
+    /// @brief Constructor
+    /// @param source Running image the patch is applied against
+    /// @param sink Receives the new image
+    Delta_Patch_Applier(Source & source, Sink & sink)
+      : m_source(source)
+      , m_sink(sink)
+    {
+        Reset();
+    }
+
+    /// @brief Discards the progress, to start a new patch
+    void Reset() {
+        m_state = State::HEADER;
+        m_status = Delta_Status::OK;
+        m_header = Delta_Header();
+        m_header_length = 0U;
+        m_consumed = 0U;
+        m_written = 0U;
+        m_crc = Crc32::INITIAL;
+        m_source_checked = 0U;
+        m_source_crc = Crc32::INITIAL;
+        m_varint = 0U;
+        m_varint_shift = 0U;
+        m_offset = 0U;
+        m_remaining = 0U;
+    }
+
+    /// @brief Applies the next chunk of the patch, while the source is verified only the header is consumed, see Get_Consumed()
+    /// @param data Chunk of the patch, directly following the bytes consumed so far
+    /// @param size Size of the chunk in bytes
+    /// @return Status after the chunk, once it is an error every further chunk is ignored
+    Delta_Status Push(uint8_t const * data, size_t const & size) {
+        size_t position = 0U;
+        bool source_checked = false;
+        while (m_status == Delta_Status::OK && position < size) {
+            switch (m_state) {
+                case State::HEADER:
+                    m_header_bytes[m_header_length++] = data[position++];
+                    if (m_header_length == HEADER_SIZE) {
+                        Parse_Header();
+                    }
+                    break;
+                case State::SOURCE_CHECK:
+                    if (source_checked) {
+                        // One slice per call, the rest of the chunk is pushed again
+                        m_consumed += position;
+                        return m_status;
+                    }
+                    Check_Source();
+                    source_checked = true;
+                    break;
+                case State::OPCODE: {
+                    uint8_t const opcode = data[position++];
+                    if (opcode == static_cast<uint8_t>(Delta_Opcode::COPY)) {
+                        m_state = State::COPY_OFFSET;
+                    }
+                    else if (opcode == static_cast<uint8_t>(Delta_Opcode::ADD)) {
+                        m_state = State::ADD_LENGTH;
+                    }
+                    else {
+                        m_status = Delta_Status::INVALID_PATCH;
+                    }
+                    break;
+                }
+                case State::COPY_OFFSET:
+                    if (Read_Varint(data[position++])) {
+                        m_offset = m_varint;
+                        m_state = State::COPY_LENGTH;
+                    }
+                    break;
+                case State::COPY_LENGTH:
+                    if (Read_Varint(data[position++])) {
+                        Copy(m_offset, m_varint);
+                        m_state = State::OPCODE;
+                    }
+                    break;
+                case State::ADD_LENGTH:
+                    if (Read_Varint(data[position++])) {
+                        m_remaining = m_varint;
+                        m_state = m_remaining > 0U ? State::ADD_DATA : State::OPCODE;
+                        if (m_remaining > m_header.target_size - m_written) {
+                            m_status = Delta_Status::INVALID_PATCH;
+                        }
+                    }
+                    break;
+                case State::ADD_DATA: {
+                    size_t const available = size - position;
+                    size_t const count = available < m_remaining ? available : m_remaining;
+                    Write(data + position, count);
+                    position += count;
+                    m_remaining -= count;
+                    if (m_remaining == 0U) {
+                        m_state = State::OPCODE;
+                    }
+                    break;
+                }
+            }
+        }
+        m_consumed += position;
+        return m_status;
+    }
+
+    /// @brief Checks that the complete target was written and has the expected checksum, has to be called after the last chunk before the image is activated
+    /// @return OK if the new image is valid
+    Delta_Status Finish() {
+        if (m_status != Delta_Status::OK) {
+            return m_status;
+        }
+        if (m_state != State::OPCODE || m_written != m_header.target_size) {
+            m_status = Delta_Status::INCOMPLETE;
+        }
+        else if (Crc32::Finalize(m_crc) != m_header.target_crc) {
+            m_status = Delta_Status::TARGET_MISMATCH;
+        }
+        return m_status;
+    }
+
+    /// @brief Status of the patch, the first error stays until Reset()
+    /// @return Current status
+    Delta_Status const & Get_Status() const {
+        return m_status;
+    }
+
+    /// @brief Header of the patch, valid once the first HEADER_SIZE bytes were pushed
+    /// @return Sizes and checksums of the images
+    Delta_Header const & Get_Header() const {
+        return m_header;
+    }
+
+    /// @brief Bytes of the patch pushed so far
+    /// @return Offset the next chunk starts at
+    size_t const & Get_Consumed() const {
+        return m_consumed;
+    }
+
+    /// @brief Bytes of the new image written so far
+    /// @return Size of the written image
+    size_t const & Get_Written() const {
+        return m_written;
+    }
+
+  private:
+    enum class State : uint8_t {
+        HEADER,
+        SOURCE_CHECK,
+        OPCODE,
+        COPY_OFFSET,
+        COPY_LENGTH,
+        ADD_LENGTH,
+        ADD_DATA
+    };
+
+    static uint32_t Read_Uint32(uint8_t const * data) {
+        return static_cast<uint32_t>(data[0U]) | (static_cast<uint32_t>(data[1U]) << 8U) | (static_cast<uint32_t>(data[2U]) << 16U) | (static_cast<uint32_t>(data[3U]) << 24U);
+    }
+
+    void Parse_Header() {
+        if (m_header_bytes[0U] != 'B' || m_header_bytes[1U] != 'D' || m_header_bytes[2U] != 'P' || m_header_bytes[3U] != '1') {
+            m_status = Delta_Status::INVALID_HEADER;
+            return;
+        }
+        m_header.source_size = Read_Uint32(m_header_bytes + 4U);
+        m_header.source_crc = Read_Uint32(m_header_bytes + 8U);
+        m_header.target_size = Read_Uint32(m_header_bytes + 12U);
+        m_header.target_crc = Read_Uint32(m_header_bytes + 16U);
+        if (m_header.target_size == 0U) {
+            m_status = Delta_Status::INVALID_HEADER;
+            return;
+        }
+        // Verifying the whole source before the first instruction ensures no copy reads from an image the patch was not made for
+        m_state = State::SOURCE_CHECK;
+    }
+
+    /// @brief Accumulates the checksum of the next slice of the source, compares it against the header once the whole source was read
+    void Check_Source() {
+        uint32_t const end = (m_header.source_size - m_source_checked) < SourceCheckSize ? m_header.source_size : m_source_checked + SourceCheckSize;
+        while (m_source_checked < end) {
+            size_t const count = (end - m_source_checked) < CopyBufferSize ? (end - m_source_checked) : CopyBufferSize;
+            if (!m_source.Read(m_source_checked, m_copy_buffer, count)) {
+                m_status = Delta_Status::SOURCE_READ_FAILED;
+                return;
+            }
+            m_source_crc = Crc32::Update(m_source_crc, m_copy_buffer, count);
+            m_source_checked += count;
+        }
+        if (m_source_checked < m_header.source_size) {
+            return;
+        }
+        if (Crc32::Finalize(m_source_crc) != m_header.source_crc) {
+            m_status = Delta_Status::SOURCE_MISMATCH;
+            return;
+        }
+        m_state = State::OPCODE;
+    }
+
+    /// @brief Accumulates one byte of a varint, returns true once the value is complete
+    bool Read_Varint(uint8_t const & byte) {
+        if (m_varint_shift == 0U) {
+            m_varint = 0U;
+        }
+        if (m_varint_shift > 28U) {
+            m_status = Delta_Status::INVALID_PATCH;
+            return false;
+        }
+        m_varint |= static_cast<uint32_t>(byte & 0x7FU) << m_varint_shift;
+        if ((byte & 0x80U) != 0U) {
+            m_varint_shift += 7U;
+            return false;
+        }
+        m_varint_shift = 0U;
+        return true;
+    }
+
+    void Copy(uint32_t offset, uint32_t length) {
+        if (offset > m_header.source_size || length > m_header.source_size - offset || length > m_header.target_size - m_written) {
+            m_status = Delta_Status::INVALID_PATCH;
+            return;
+        }
+        while (length > 0U && m_status == Delta_Status::OK) {
+            size_t const count = length < CopyBufferSize ? length : CopyBufferSize;
+            if (!m_source.Read(offset, m_copy_buffer, count)) {
+                m_status = Delta_Status::SOURCE_READ_FAILED;
+                return;
+            }
+            Write(m_copy_buffer, count);
+            offset += count;
+            length -= count;
+        }
+    }
+
+    void Write(uint8_t const * data, size_t const & size) {
+        if (size > m_header.target_size - m_written) {
+            m_status = Delta_Status::INVALID_PATCH;
+            return;
+        }
+        if (!m_sink.Write(data, size)) {
+            m_status = Delta_Status::SINK_WRITE_FAILED;
+            return;
+        }
+        m_crc = Crc32::Update(m_crc, data, size);
+        m_written += size;
+    }
+
+    Source &     m_source;                           // Running image
+    Sink &       m_sink;                             // New image
+    State        m_state = State::HEADER;            // Part of the patch the next byte belongs to
+    Delta_Status m_status = Delta_Status::OK;        // First error or OK
+    Delta_Header m_header = {};                      // Sizes and checksums of the images
+    uint8_t      m_header_bytes[HEADER_SIZE] = {};   // Magic and header while they are received
+    size_t       m_header_length = 0U;               // Bytes of the header received so far
+    size_t       m_consumed = 0U;                    // Bytes of the patch pushed so far
+    size_t       m_written = 0U;                     // Bytes of the new image written so far
+    uint32_t     m_crc = Crc32::INITIAL;             // Running checksum of the new image
+    uint32_t     m_source_checked = 0U;              // Bytes of the source verified so far
+    uint32_t     m_source_crc = Crc32::INITIAL;      // Running checksum of the source
+    uint32_t     m_varint = 0U;                      // Value of the varint that is read
+    uint8_t      m_varint_shift = 0U;                // Bits of the varint read so far
+    uint32_t     m_offset = 0U;                      // Source offset of the current copy
+    uint32_t     m_remaining = 0U;                   // Bytes of the current add that were not received yet
+    uint8_t      m_copy_buffer[CopyBufferSize] = {}; // Bytes on their way from the source to the sink
+};
+
+
+#if defined(ESP32)
+
+/// @brief Running application partition as the source of a patch
+class Esp_Partition_Source {
+  public:
+    Esp_Partition_Source()
+      : m_partition(esp_ota_get_running_partition())
+    {
+        // Nothing to do
+    }
+
+    bool Read(uint32_t const & offset, uint8_t * buffer, size_t const & size) {
+        return m_partition != nullptr && esp_partition_read(m_partition, offset, buffer, size) == ESP_OK;
+    }
+
+  private:
+    esp_partition_t const * m_partition = nullptr; // Partition of the running image
+};
+
+/// @brief Next OTA partition as the sink of a patch, is only booted after End() verified the image and Activate() was called
+class Esp_Ota_Sink {
+  public:
+    /// @brief Starts writing to the next OTA partition, which is erased sector by sector while it is written,
+    /// erasing the whole partition up front would block the caller for seconds
+    /// @return Whether there is an OTA partition that could be prepared
+    bool Begin() {
+        Abort();
+        m_partition = esp_ota_get_next_update_partition(nullptr);
+        m_active = m_partition != nullptr && esp_ota_begin(m_partition, OTA_WITH_SEQUENTIAL_WRITES, &m_handle) == ESP_OK;
+        return m_active;
+    }
+
+    bool Write(uint8_t const * data, size_t const & size) {
+        return m_active && esp_ota_write(m_handle, data, size) == ESP_OK;
+    }
+
+    /// @brief Finishes writing, the image format and its hash are validated
+    /// @return Whether the written image is a valid application
+    bool End() {
+        if (!m_active) {
+            return false;
+        }
+        m_active = false;
+        return esp_ota_end(m_handle) == ESP_OK;
+    }
+
+    /// @brief Boots the written image with the next restart
+    /// @return Whether the boot partition was changed
+    bool Activate() {
+        return m_partition != nullptr && esp_ota_set_boot_partition(m_partition) == ESP_OK;
+    }
+
+    /// @brief Discards a partially written image
+    void Abort() {
+        if (m_active) {
+            esp_ota_abort(m_handle);
+            m_active = false;
+        }
+    }
+
+    /// @brief Confirms that the running image works, has to be called once it proved so (e.g. connected to the server) after booting into an update.
+    /// With rollback enabled in the bootloader an update that is not confirmed is rolled back with the next restart, without it this does nothing
+    /// @return Whether the running image was waiting to be confirmed and is confirmed now
+    static bool Confirm_Running() {
+        esp_ota_img_states_t state = ESP_OTA_IMG_UNDEFINED;
+        if (esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) != ESP_OK || state != ESP_OTA_IMG_PENDING_VERIFY) {
+            return false;
+        }
+        return esp_ota_mark_app_valid_cancel_rollback() == ESP_OK;
+    }
+
+  private:
+    esp_partition_t const * m_partition = nullptr; // Partition the new image is written to
+    esp_ota_handle_t        m_handle = 0U;         // Handle of the running update
+    bool                    m_active = false;      // Whether an update is being written
+};
+
+#endif // defined(ESP32)
+
+#endif // Delta_OTA_h
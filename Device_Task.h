@@ -0,0 +1,267 @@
+#ifndef Device_Task_h
+#define Device_Task_h
+
+// Coroutines require C++20 and a toolchain that implements them (host builds and recent ESP32 toolchains).
+#if defined(__cpp_impl_coroutine)
+
+// Library includes.
+#include <coroutine>
+#include <exception>
+
+// Local includes.
+#include "Client_Side_Request.h"
+#include "Timer_Wheel.h"
+
+// Request_Awaitable registers capturing lambdas as response and timeout callbacks, which plain function pointers can not hold
+#if !THINGSBOARD_ENABLE_STL
+#error "Device_Task requires THINGSBOARD_ENABLE_STL, without it awaited requests can never resume their task"
+#endif // !THINGSBOARD_ENABLE_STL
+
+
+/// @brief Coroutine type for device logic, that consists of multiple steps which have to wait for the server or for time to pass,
+/// for example the connect, subscribe and request sequence or multi-step control procedures.
+/// Instead of blocking loop() or restarting a long sequence of early returns from scratch, the sequence is written top to bottom with co_await
+/// and suspends while waiting, so loop() and other tasks keep running. The task starts running immediately when it is called,
+/// and is resumed by the timer wheel or the response callbacks, it does not need to be polled.
+/// A task must only be destroyed once it is Done(), because pending timers or requests would otherwise resume a destroyed coroutine
+class Device_Task {
+  public:
+    struct promise_type {
+        Device_Task get_return_object() {
+            return Device_Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        // Keeps the frame alive after finishing, so the owner can still query the result
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+
+        void return_value(bool const & value) {
+            result = value;
+        }
+
+        void unhandled_exception() {
+            std::terminate();
+        }
+
+        bool result = false; // Value given to co_return
+    };
+
+    /// @brief Constructor, creates an empty task that is already done
+    Device_Task() = default;
+
+    Device_Task(Device_Task && other) noexcept
+      : m_handle(other.m_handle)
+    {
+        other.m_handle = nullptr;
+    }
+
+    Device_Task & operator=(Device_Task && other) noexcept {
+        if (this != &other) {
+            Destroy();
+            m_handle = other.m_handle;
+            other.m_handle = nullptr;
+        }
+        return *this;
+    }
+
+    Device_Task(Device_Task const &) = delete;
+    Device_Task & operator=(Device_Task const &) = delete;
+
+    ~Device_Task() {
+        Destroy();
+    }
+
+    /// @brief Whether the task ran until its co_return, empty tasks are always done
+    /// @return Whether the task is done
+    bool Done() const {
+        return !m_handle || m_handle.done();
+    }
+
+    /// @brief Value the task returned with co_return, only valid once the task is done
+    /// @return Result of the task or false if it is empty or not done yet
+    bool Result() const {
+        return Done() && m_handle ? m_handle.promise().result : false;
+    }
+
+  private:
+    explicit Device_Task(std::coroutine_handle<promise_type> handle)
+      : m_handle(handle)
+    {
+        // Nothing to do
+    }
+
+    void Destroy() {
+        if (m_handle) {
+            m_handle.destroy();
+            m_handle = nullptr;
+        }
+    }
+
+    std::coroutine_handle<promise_type> m_handle = nullptr; // Coroutine frame owned by this task
+};
+
+
+/// @brief Awaitable that suspends the task for the given time, using a timer registered with the shared timer wheel
+class Delay_Awaitable {
+  public:
+    /// @brief Constructor
+    /// @param timers Timer wheel the wakeup is registered with
+    /// @param delay_milliseconds Time the task should be suspended for
+    Delay_Awaitable(Timer_Wheel & timers, uint32_t const & delay_milliseconds)
+      : m_timers(timers)
+      , m_delay_milliseconds(delay_milliseconds)
+      , m_timer(&Resume, nullptr)
+    {
+        // Nothing to do
+    }
+
+    Delay_Awaitable(Delay_Awaitable const &) = delete;
+    Delay_Awaitable & operator=(Delay_Awaitable const &) = delete;
+
+    ~Delay_Awaitable() {
+        m_timers.Stop(m_timer);
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        m_timer.context = handle.address();
+        m_timers.Start(m_timer, m_delay_milliseconds);
+    }
+
+    void await_resume() const noexcept {
+        // Nothing to do
+    }
+
+  private:
+    static void Resume(void * context) {
+        std::coroutine_handle<>::from_address(context).resume();
+    }
+
+    Timer_Wheel &      m_timers;             // Timer wheel the wakeup is registered with
+    uint32_t           m_delay_milliseconds; // Time the task is suspended for
+    Timer_Wheel::Timer m_timer;              // Resumes the task once expired
+};
+
+
+/// @brief Result of an awaited client side request
+enum class Request_Result : uint8_t {
+    SEND_FAILED, // Request could not be sent, the response callback is never called
+    RESPONSE,    // Response was received and passed to the response callback
+    TIMEOUT      // No response was received before the deadline, or the request was given up because the connection was closed
+};
+
+
+/// @brief Awaitable client side request. The request is sent as soon as the awaitable is created, not when it is awaited,
+/// which allows to start multiple requests, that are then pipelined, and await them afterwards one by one.
+/// The received response is only valid while it is being received, therefore it is passed to the given response callback instead of being returned by co_await.
+/// Has to stay at the same address until it completed, which is guaranteed if it is created as a local variable of the task
+/// @tparam Request_API Client_Side_Request instantiation used to send the request
+template<typename Request_API>
+class Request_Awaitable {
+  public:
+    /// @brief Sends the request, the response or timeout resumes the task awaiting this instance
+    /// @param send Method sending the request, receives the response and timeout callbacks that have to be passed to the request API
+    /// @param response_callback Called with the received response, before the awaiting task is resumed
+    template<typename Send_Function>
+    Request_Awaitable(Send_Function send, typename Request_API::Response_Callback::function response_callback)
+      : m_response_callback(response_callback)
+    {
+        bool const sent = send(
+            [this](JsonVariantConst const & data) {
+                m_response_callback.Call_Callback(data);
+                Complete(Request_Result::RESPONSE);
+            },
+            [this]() {
+                Complete(Request_Result::TIMEOUT);
+            });
+        if (!sent) {
+            m_done = true;
+        }
+    }
+
+    Request_Awaitable(Request_Awaitable const &) = delete;
+    Request_Awaitable & operator=(Request_Awaitable const &) = delete;
+
+    bool await_ready() const noexcept {
+        return m_done;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+        m_waiting = handle;
+    }
+
+    Request_Result await_resume() const noexcept {
+        return m_result;
+    }
+
+  private:
+    void Complete(Request_Result const & result) {
+        m_result = result;
+        m_done = true;
+        if (m_waiting) {
+            std::coroutine_handle<> const waiting = m_waiting;
+            m_waiting = nullptr;
+            waiting.resume();
+        }
+    }
+
+    typename Request_API::Response_Callback m_response_callback = {};                      // Called with the received response
+    std::coroutine_handle<>                 m_waiting = nullptr;                           // Task suspended on this request
+    Request_Result                          m_result = Request_Result::SEND_FAILED;        // Outcome of the request
+    bool                                    m_done = false;                                // Whether the request completed
+};
+
+
+/// @brief Sends a shared attribute request, that can be awaited inside of a Device_Task
+/// @param requests Client side request API used to send the request
+/// @param first Iterator pointing to the first attribute key
+/// @param last Iterator pointing to the end of the attribute keys (last element + 1)
+/// @param timeout_microseconds Time after which the request is given up
+/// @param response_callback Called with the object containing the received attributes
+/// @return Awaitable resolving to the Request_Result
+template<typename Request_API, typename InputIterator>
+Request_Awaitable<Request_API> Await_Shared_Attributes(Request_API & requests, InputIterator const & first, InputIterator const & last, uint64_t const & timeout_microseconds, typename Request_API::Response_Callback::function response_callback) {
+    return Request_Awaitable<Request_API>([&](auto on_response, auto on_timeout) {
+        return requests.Shared_Attributes_Request(first, last, on_response, timeout_microseconds, on_timeout);
+    }, response_callback);
+}
+
+/// @brief Sends a client attribute request, that can be awaited inside of a Device_Task
+/// @param requests Client side request API used to send the request
+/// @param first Iterator pointing to the first attribute key
+/// @param last Iterator pointing to the end of the attribute keys (last element + 1)
+/// @param timeout_microseconds Time after which the request is given up
+/// @param response_callback Called with the object containing the received attributes
+/// @return Awaitable resolving to the Request_Result
+template<typename Request_API, typename InputIterator>
+Request_Awaitable<Request_API> Await_Client_Attributes(Request_API & requests, InputIterator const & first, InputIterator const & last, uint64_t const & timeout_microseconds, typename Request_API::Response_Callback::function response_callback) {
+    return Request_Awaitable<Request_API>([&](auto on_response, auto on_timeout) {
+        return requests.Client_Attributes_Request(first, last, on_response, timeout_microseconds, on_timeout);
+    }, response_callback);
+}
+
+/// @brief Calls a method on the server, that can be awaited inside of a Device_Task
+/// @param requests Client side request API used to send the request
+/// @param method_name Name of the server side method that should be called
+/// @param params Already serialized JSON params of the call, nullptr if the method does not expect any
+/// @param timeout_microseconds Time after which the request is given up
+/// @param response_callback Called with the response of the server
+/// @return Awaitable resolving to the Request_Result
+template<typename Request_API>
+Request_Awaitable<Request_API> Await_RPC(Request_API & requests, char const * method_name, char const * params, uint64_t const & timeout_microseconds, typename Request_API::Response_Callback::function response_callback) {
+    return Request_Awaitable<Request_API>([&](auto on_response, auto on_timeout) {
+        return requests.RPC_Request(method_name, params, on_response, timeout_microseconds, on_timeout);
+    }, response_callback);
+}
+
+#endif // defined(__cpp_impl_coroutine)
+
+#endif // Device_Task_h
@@ -0,0 +1,507 @@
+#ifndef Impaired_Client_h
+#define Impaired_Client_h
+
+// Local includes.
+#include "Noise_Model.h"
+
+// Library includes.
+#include <Arduino.h>
+#include <Client.h>
+
+
+/// @brief Network conditions emulated by Impaired_Client, the default emulates an unimpaired link
+struct Impairment_Profile {
+    uint32_t            latency_ms = 0U;                  // One way delay added to every written and every received chunk
+    uint32_t            jitter_ms = 0U;                   // Additional uniformly distributed delay up to this value, TCP keeps the order, so it never reorders
+    uint32_t            bandwidth_bytes_per_s = 0U;       // Serialization rate of the link in both directions, 0 for unlimited
+    Packet_Loss_Profile loss = {};                        // Burst loss of written chunks, TCP retransmits them, so a loss costs a retransmission timeout instead of data
+    uint32_t            retransmission_timeout_ms = 200U; // Delay of the first retransmission, doubled for every further loss in a row
+    uint32_t            mean_disconnect_interval_ms = 0U; // Mean time between forced disconnects of the link, 0 to never disconnect
+    uint32_t            outage_ms = 0U;                   // Time connecting fails after a forced disconnect, like a lost access point
+    uint32_t            mean_stall_interval_ms = 0U;      // Mean time between silent stalls of the connection, 0 to never stall
+    uint32_t            stall_ms = 0U;                    // Time a stalled connection stays half-open, every byte in both directions is lost but it still reports connected,
+                                                          // afterwards it is closed like an expired keepalive would. A new connection is not affected
+};
+
+/// @brief Predefined network conditions, from a slightly imperfect home network to a flaky link at the edge of the access point range
+enum class Impairment_Preset : uint8_t {
+    NONE,
+    GOOD_WIFI,
+    CONGESTED,
+    LOSSY,
+    FLAKY,
+    HALF_OPEN
+};
+
+/// @brief Network conditions of the given preset
+/// @param preset Predefined network conditions
+/// @return Profile of the preset
+inline Impairment_Profile Get_Impairment_Profile(Impairment_Preset const & preset) {
+    Impairment_Profile profile;
+    switch (preset) {
+        case Impairment_Preset::GOOD_WIFI:
+            profile.latency_ms = 5U;
+            profile.jitter_ms = 5U;
+            profile.loss.good_loss = 0.001f;
+            break;
+        case Impairment_Preset::CONGESTED:
+            profile.latency_ms = 80U;
+            profile.jitter_ms = 120U;
+            profile.bandwidth_bytes_per_s = 4000U;
+            profile.loss.good_loss = 0.01f;
+            profile.loss.bad_loss = 0.2f;
+            profile.loss.good_to_bad = 0.01f;
+            profile.loss.bad_to_good = 0.2f;
+            profile.retransmission_timeout_ms = 300U;
+            break;
+        case Impairment_Preset::LOSSY:
+            profile.latency_ms = 30U;
+            profile.jitter_ms = 40U;
+            profile.bandwidth_bytes_per_s = 20000U;
+            profile.loss.good_loss = 0.02f;
+            profile.loss.bad_loss = 0.5f;
+            profile.loss.good_to_bad = 0.02f;
+            profile.loss.bad_to_good = 0.1f;
+            profile.retransmission_timeout_ms = 300U;
+            break;
+        case Impairment_Preset::FLAKY:
+            profile.latency_ms = 50U;
+            profile.jitter_ms = 200U;
+            profile.bandwidth_bytes_per_s = 8000U;
+            profile.loss.good_loss = 0.02f;
+            profile.loss.bad_loss = 0.6f;
+            profile.loss.good_to_bad = 0.05f;
+            profile.loss.bad_to_good = 0.1f;
+            profile.retransmission_timeout_ms = 400U;
+            profile.mean_disconnect_interval_ms = 120000U;
+            profile.outage_ms = 10000U;
+            break;
+        case Impairment_Preset::HALF_OPEN:
+            // Good link whose connection silently dies every few minutes, e.g. a NAT or load balancer dropping its state, until the keepalive notices
+            profile.latency_ms = 10U;
+            profile.jitter_ms = 20U;
+            profile.loss.good_loss = 0.001f;
+            profile.mean_stall_interval_ms = 300000U;
+            profile.stall_ms = 45000U;
+            break;
+        default:
+            break;
+    }
+    return profile;
+}
+
+
+/// @brief Counters of the emulated impairments, to relate the measured delivery and latency of the device logic to the conditions
+struct Impairment_Statistics {
+    uint32_t segments_written = 0U;   // Writes passed into the delay line
+    uint32_t retransmissions = 0U;    // Writes delayed by an emulated loss
+    uint32_t disconnects = 0U;        // Forced disconnects
+    uint32_t refused_connects = 0U;   // Connect attempts refused during an outage
+    uint32_t bytes_sent = 0U;         // Bytes released to the underlying client
+    uint32_t bytes_received = 0U;     // Bytes released to the reader
+    uint32_t stalls = 0U;             // Connections that went half-open
+    uint32_t stalled_ms = 0U;         // Time connections were half-open, the windows in which published data was lost
+    uint32_t bytes_lost = 0U;         // Bytes lost in either direction while half-open
+};
+
+
+/// @brief Arduino Client decorator that emulates bad Wi-Fi on the device itself, between the MQTT client and the real WiFiClient,
+/// to reproduce buffering, reconnection and timeout behaviour of the sketch logic under defined conditions without a special access point.
+/// Written and received bytes are held in fixed size delay lines until their release time, which includes latency, jitter,
+/// serialization at the bandwidth cap and retransmission timeouts of lost segments. Forced disconnects stop the underlying client
+/// and refuse connections for the outage duration. All randomness is drawn from a counter based stream, so a profile, seed and device reproduce the same impairments.
+/// Only meant for testing, the delay lines are filled and emptied from the calls the MQTT client makes anyway (connected(), available(), read(), write())
+/// @tparam BufferSize Capacity of each delay line in bytes, writes that do not fit are refused like a full socket buffer, default = 2048
+/// @tparam MaxSegments Maximum amount of separately timed chunks in each delay line, default = 32
+template<size_t BufferSize = 2048U, size_t MaxSegments = 32U>
+class Impaired_Client : public Client {
+  public:
+    /// @brief Constructor
+    /// @param client Underlying client the impaired traffic is passed to
+    /// @param profile Network conditions that should be emulated
+    /// @param seed Seed of the impairments, default = 1
+    /// @param device Identifier of the device, default = 0
+    Impaired_Client(Client & client, Impairment_Profile const & profile, uint64_t const & seed = 1U, uint32_t const & device = 0U)
+      : m_client(client)
+      , m_profile(profile)
+      , m_seed(seed)
+      , m_device(device)
+      , m_random(seed, device, static_cast<uint32_t>(Noise_Stream::NETWORK) + 1U)
+      , m_loss(seed, device, profile.loss)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Changes the emulated conditions, takes effect for all following traffic
+    /// @param profile Network conditions that should be emulated
+    void Set_Profile(Impairment_Profile const & profile) {
+        m_profile = profile;
+        m_loss = Packet_Loss(m_seed, m_device, profile.loss);
+    }
+
+    /// @brief Counters of the emulated impairments
+    /// @return Statistics
+    Impairment_Statistics const & Get_Statistics() const {
+        return m_statistics;
+    }
+
+    /// @brief Time until the next delayed chunk is released, the socket of the underlying client can not signal these, so waiting on it has to be capped by this
+    /// @return Milliseconds until the next release or UINT32_MAX if nothing is delayed
+    uint32_t Milliseconds_Until_Next_Release() const {
+        uint32_t const now = millis();
+        uint32_t const outbound = m_outbound.Milliseconds_Until_Next(now);
+        uint32_t const inbound = m_inbound.Milliseconds_Until_Next(now);
+        return outbound < inbound ? outbound : inbound;
+    }
+
+    int connect(IPAddress ip, uint16_t port) override {
+        if (!Connect_Allowed()) {
+            return 0;
+        }
+        return m_client.connect(ip, port);
+    }
+
+    int connect(char const * host, uint16_t port) override {
+        if (!Connect_Allowed()) {
+            return 0;
+        }
+        return m_client.connect(host, port);
+    }
+
+#if defined(ESP32)
+    int connect(IPAddress ip, uint16_t port, int32_t timeout) override {
+        if (!Connect_Allowed()) {
+            return 0;
+        }
+        return m_client.connect(ip, port, timeout);
+    }
+
+    int connect(char const * host, uint16_t port, int32_t timeout) override {
+        if (!Connect_Allowed()) {
+            return 0;
+        }
+        return m_client.connect(host, port, timeout);
+    }
+#endif // defined(ESP32)
+
+    size_t write(uint8_t byte) override {
+        return write(&byte, 1U);
+    }
+
+    size_t write(uint8_t const * buffer, size_t size) override {
+        Pump();
+        if (!m_client.connected()) {
+            return 0U;
+        }
+        uint32_t const now = millis();
+        uint32_t release = now + Delay(m_write_index);
+        if (m_loss.Drop(m_write_index)) {
+            // Retransmission timeout doubles with every loss in a row, capped to avoid stalling forever
+            release += m_profile.retransmission_timeout_ms << (m_consecutive_losses < MAX_BACKOFF_SHIFT ? m_consecutive_losses : MAX_BACKOFF_SHIFT);
+            m_consecutive_losses++;
+            m_statistics.retransmissions++;
+        }
+        else {
+            m_consecutive_losses = 0U;
+        }
+        m_write_index++;
+        release = Serialize(m_uplink_free_ms, now, release, size);
+        size_t const accepted = m_outbound.Push(buffer, size, release);
+        if (accepted > 0U) {
+            m_statistics.segments_written++;
+        }
+        Pump();
+        return accepted;
+    }
+
+    int available() override {
+        Pump();
+        return static_cast<int>(m_inbound.Released(millis()));
+    }
+
+    int read() override {
+        uint8_t byte = 0U;
+        return read(&byte, 1U) == 1 ? byte : -1;
+    }
+
+    int read(uint8_t * buffer, size_t size) override {
+        Pump();
+        size_t const count = m_inbound.Pop(buffer, size, millis());
+        m_statistics.bytes_received += count;
+        return count > 0U ? static_cast<int>(count) : -1;
+    }
+
+    int peek() override {
+        Pump();
+        return m_inbound.Peek(millis());
+    }
+
+    void flush() override {
+        Pump();
+        m_client.flush();
+    }
+
+    void stop() override {
+        End_Stall(millis());
+        m_outbound.Clear();
+        m_inbound.Clear();
+        m_client.stop();
+    }
+
+    uint8_t connected() override {
+        Pump();
+        // Data that was already received stays readable after the connection closed, like a socket
+        return m_client.connected() || m_inbound.Released(millis()) > 0U;
+    }
+
+    operator bool() override {
+        return connected() != 0U;
+    }
+
+  private:
+    static uint8_t constexpr MAX_BACKOFF_SHIFT = 4U;
+
+    /// @brief Fixed size FIFO of bytes, grouped into chunks that become readable at their release time
+    class Delay_Line {
+      public:
+        size_t Push(uint8_t const * data, size_t size, uint32_t release_ms) {
+            if (m_segment_count == MaxSegments) {
+                return 0U;
+            }
+            size_t const free = BufferSize - m_size;
+            size = size < free ? size : free;
+            if (size == 0U) {
+                return 0U;
+            }
+            // TCP delivers in order, a chunk is never released before the one in front of it
+            if (m_segment_count > 0U) {
+                Segment const & last = m_segments[(m_first_segment + m_segment_count - 1U) % MaxSegments];
+                if (static_cast<int32_t>(release_ms - last.release_ms) < 0) {
+                    release_ms = last.release_ms;
+                }
+            }
+            for (size_t i = 0U; i < size; i++) {
+                m_data[(m_head + m_size + i) % BufferSize] = data[i];
+            }
+            m_size += size;
+            Segment & segment = m_segments[(m_first_segment + m_segment_count) % MaxSegments];
+            segment.release_ms = release_ms;
+            segment.length = size;
+            m_segment_count++;
+            return size;
+        }
+
+        size_t Released(uint32_t const & now_ms) const {
+            size_t released = 0U;
+            for (size_t i = 0U; i < m_segment_count; i++) {
+                Segment const & segment = m_segments[(m_first_segment + i) % MaxSegments];
+                if (static_cast<int32_t>(now_ms - segment.release_ms) < 0) {
+                    break;
+                }
+                released += segment.length;
+            }
+            return released;
+        }
+
+        size_t Pop(uint8_t * buffer, size_t size, uint32_t const & now_ms) {
+            size_t count = 0U;
+            while (count < size && m_segment_count > 0U) {
+                Segment & segment = m_segments[m_first_segment];
+                if (static_cast<int32_t>(now_ms - segment.release_ms) < 0) {
+                    break;
+                }
+                size_t const chunk = (size - count) < segment.length ? (size - count) : segment.length;
+                for (size_t i = 0U; i < chunk; i++) {
+                    buffer[count + i] = m_data[(m_head + i) % BufferSize];
+                }
+                Consume(chunk);
+                count += chunk;
+            }
+            return count;
+        }
+
+        int Peek(uint32_t const & now_ms) const {
+            if (m_segment_count == 0U || static_cast<int32_t>(now_ms - m_segments[m_first_segment].release_ms) < 0) {
+                return -1;
+            }
+            return m_data[m_head];
+        }
+
+        /// @brief Released bytes at the front, without removing them, only contiguous up to the end of the ring
+        size_t Front(uint8_t const * & data, uint32_t const & now_ms) const {
+            if (m_segment_count == 0U || static_cast<int32_t>(now_ms - m_segments[m_first_segment].release_ms) < 0) {
+                return 0U;
+            }
+            data = &m_data[m_head];
+            size_t const contiguous = BufferSize - m_head;
+            size_t const length = m_segments[m_first_segment].length;
+            return length < contiguous ? length : contiguous;
+        }
+
+        void Consume(size_t size) {
+            m_head = (m_head + size) % BufferSize;
+            m_size -= size;
+            while (size > 0U) {
+                Segment & segment = m_segments[m_first_segment];
+                size_t const used = size < segment.length ? size : segment.length;
+                segment.length -= used;
+                size -= used;
+                if (segment.length == 0U) {
+                    m_first_segment = (m_first_segment + 1U) % MaxSegments;
+                    m_segment_count--;
+                }
+            }
+        }
+
+        uint32_t Milliseconds_Until_Next(uint32_t const & now_ms) const {
+            if (m_segment_count == 0U) {
+                return UINT32_MAX;
+            }
+            int32_t const remaining = static_cast<int32_t>(m_segments[m_first_segment].release_ms - now_ms);
+            return remaining > 0 ? static_cast<uint32_t>(remaining) : 0U;
+        }
+
+        void Clear() {
+            m_head = 0U;
+            m_size = 0U;
+            m_first_segment = 0U;
+            m_segment_count = 0U;
+        }
+
+      private:
+        struct Segment {
+            uint32_t release_ms; // Time the chunk becomes readable
+            size_t   length;     // Bytes of the chunk that were not consumed yet
+        };
+
+        uint8_t m_data[BufferSize] = {};      // Ring of the delayed bytes
+        size_t  m_head = 0U;                  // First byte in the ring
+        size_t  m_size = 0U;                  // Bytes in the ring
+        Segment m_segments[MaxSegments] = {}; // Ring of the chunks
+        size_t  m_first_segment = 0U;         // First chunk in the ring
+        size_t  m_segment_count = 0U;         // Chunks in the ring
+    };
+
+    /// @brief Latency plus jitter of the given chunk
+    uint32_t Delay(uint32_t const & index) const {
+        uint32_t const jitter = m_profile.jitter_ms > 0U ? static_cast<uint32_t>(m_random.Uniform(index, 1U) * m_profile.jitter_ms) : 0U;
+        return m_profile.latency_ms + jitter;
+    }
+
+    /// @brief Delays the release until the link finished transmitting everything before it at the bandwidth cap
+    uint32_t Serialize(uint32_t & link_free_ms, uint32_t const & now, uint32_t const & release, size_t const & size) const {
+        if (m_profile.bandwidth_bytes_per_s == 0U) {
+            return release;
+        }
+        if (static_cast<int32_t>(link_free_ms - now) < 0) {
+            link_free_ms = now;
+        }
+        link_free_ms += static_cast<uint32_t>((static_cast<uint64_t>(size) * 1000U + m_profile.bandwidth_bytes_per_s - 1U) / m_profile.bandwidth_bytes_per_s);
+        uint32_t const serialized = link_free_ms + m_profile.latency_ms;
+        return static_cast<int32_t>(serialized - release) > 0 ? serialized : release;
+    }
+
+    bool Connect_Allowed() {
+        if (m_outage_until_ms != 0U && static_cast<int32_t>(millis() - m_outage_until_ms) < 0) {
+            m_statistics.refused_connects++;
+            return false;
+        }
+        m_outage_until_ms = 0U;
+        End_Stall(millis());
+        m_outbound.Clear();
+        m_inbound.Clear();
+        m_last_pump_ms = millis();
+        return true;
+    }
+
+    /// @brief Ends the stall of the current connection, if there is one, and adds its duration to the statistics
+    void End_Stall(uint32_t const & now) {
+        if (m_stall_start_ms == 0U) {
+            return;
+        }
+        m_statistics.stalled_ms += now - m_stall_start_ms;
+        m_stall_start_ms = 0U;
+    }
+
+    /// @brief Moves released outbound bytes to the underlying client, delays newly received bytes and emulates forced disconnects and stalls
+    void Pump() {
+        uint32_t const now = millis();
+        uint32_t const elapsed = now - m_last_pump_ms;
+        if (m_stall_start_ms != 0U && now - m_stall_start_ms >= m_profile.stall_ms) {
+            // Keepalive of the client expired, the half-open connection is closed
+            m_statistics.disconnects++;
+            stop();
+            m_last_pump_ms = now;
+            return;
+        }
+        if (m_profile.mean_stall_interval_ms > 0U && m_stall_start_ms == 0U && m_client.connected()) {
+            float const probability = static_cast<float>(elapsed) / static_cast<float>(m_profile.mean_stall_interval_ms);
+            if (elapsed > 0U && m_random.Uniform(m_event_index++, 3U) < probability) {
+                m_statistics.stalls++;
+                m_stall_start_ms = now | 1U;
+            }
+        }
+        if (m_profile.mean_disconnect_interval_ms > 0U && m_client.connected()) {
+            // Probability of a disconnect within the elapsed time of a memoryless (exponential) process, approximated for short intervals
+            float const probability = static_cast<float>(elapsed) / static_cast<float>(m_profile.mean_disconnect_interval_ms);
+            if (elapsed > 0U && m_random.Uniform(m_event_index++, 2U) < probability) {
+                m_statistics.disconnects++;
+                m_outage_until_ms = (now + m_profile.outage_ms) | 1U;
+                stop();
+                m_last_pump_ms = now;
+                return;
+            }
+        }
+        m_last_pump_ms = now;
+
+        uint8_t const * data = nullptr;
+        size_t length = 0U;
+        while ((length = m_outbound.Front(data, now)) > 0U) {
+            // Nothing reaches the peer of a half-open connection, but the local socket still accepts the bytes
+            size_t const written = m_stall_start_ms != 0U ? length : m_client.write(data, length);
+            if (written == 0U) {
+                break;
+            }
+            m_outbound.Consume(written);
+            (m_stall_start_ms != 0U ? m_statistics.bytes_lost : m_statistics.bytes_sent) += written;
+        }
+
+        uint8_t chunk[64U];
+        while (m_client.available() > 0) {
+            int const count = m_client.read(chunk, sizeof(chunk));
+            if (count <= 0) {
+                break;
+            }
+            if (m_stall_start_ms != 0U) {
+                m_statistics.bytes_lost += static_cast<uint32_t>(count);
+                continue;
+            }
+            uint32_t const release = Serialize(m_downlink_free_ms, now, now + Delay(m_read_index++), static_cast<size_t>(count));
+            if (m_inbound.Push(chunk, static_cast<size_t>(count), release) < static_cast<size_t>(count)) {
+                // Receive window full, the real socket keeps the rest until the next call
+                break;
+            }
+        }
+    }
+
+    Client &              m_client;                 // Underlying client
+    Impairment_Profile    m_profile = {};           // Emulated conditions
+    uint64_t              m_seed = 1U;              // Seed of the impairments
+    uint32_t              m_device = 0U;            // Identifier of the device
+    Random_Stream         m_random;                 // Jitter and disconnects
+    Packet_Loss           m_loss;                   // Loss of written chunks
+    Delay_Line            m_outbound;               // Written, not yet released bytes
+    Delay_Line            m_inbound;                // Received, not yet released bytes
+    Impairment_Statistics m_statistics = {};        // Counters of the emulated impairments
+    uint32_t              m_write_index = 0U;       // Index of the next written chunk
+    uint32_t              m_read_index = 0U;        // Index of the next received chunk
+    uint32_t              m_event_index = 0U;       // Index of the next disconnect draw
+    uint32_t              m_consecutive_losses = 0U; // Losses in a row, for the retransmission backoff
+    uint32_t              m_uplink_free_ms = 0U;    // Time the uplink finished transmitting the last written chunk
+    uint32_t              m_downlink_free_ms = 0U;  // Time the downlink finished transmitting the last received chunk
+    uint32_t              m_last_pump_ms = 0U;      // Time of the last disconnect draw
+    uint32_t              m_outage_until_ms = 0U;   // End of the current outage, 0 if there is none
+    uint32_t              m_stall_start_ms = 0U;    // Start of the stall of the current connection, 0 if it is not stalled
+};
+
+#endif // Impaired_Client_h
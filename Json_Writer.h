@@ -0,0 +1,340 @@
+#ifndef Json_Writer_h
+#define Json_Writer_h
+
+// Library includes.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/// @brief Append-only JSON writer, that streams keys and values directly into a caller provided buffer in a single pass.
+/// Compared to filling a JsonDocument and then serializing it, no node tree has to be allocated and the length of the payload is known at any point,
+/// without having to walk the document a second time to measure it (see Helper::Measure_Json).
+/// Separators between members are inserted automatically, the caller only has to ensure the calls form valid JSON (every key is followed by exactly one value).
+/// If the buffer is too small the writer stops appending and Overflowed() returns true, the content is always null-terminated
+class Json_Writer {
+  public:
+    /// @brief Constructor
+    /// @param buffer Buffer the JSON is written into, has to stay valid as long as the writer is used
+    /// @param capacity Size of the given buffer in bytes, including the space for the null terminator
+    Json_Writer(char * buffer, size_t const & capacity)
+      : m_buffer(buffer)
+      , m_capacity(capacity)
+    {
+        Clear();
+    }
+
+    /// @brief Resets the writer to an empty buffer, allows to reuse the same writer for multiple messages
+    void Clear() {
+        m_length = 0U;
+        m_depth = 0U;
+        m_first_member = 1U;
+        m_after_key = false;
+        m_overflowed = m_capacity == 0U;
+        if (!m_overflowed) {
+            m_buffer[0] = '\0';
+        }
+    }
+
+    /// @brief Opens an object, either as the top level value, as an array element or as the value of the previous key
+    void Begin_Object() {
+        Begin_Container('{');
+    }
+
+    /// @brief Closes the previously opened object
+    void End_Object() {
+        End_Container('}');
+    }
+
+    /// @brief Opens an array, either as the top level value, as an array element or as the value of the previous key
+    void Begin_Array() {
+        Begin_Container('[');
+    }
+
+    /// @brief Closes the previously opened array
+    void End_Array() {
+        End_Container(']');
+    }
+
+    /// @brief Writes the key of the next object member, has to be followed by exactly one value
+    /// @param key Key of the member, is escaped if needed
+    void Key(char const * key) {
+        Separate();
+        Append_String(key);
+        Append_Char(':');
+        m_after_key = true;
+    }
+
+    /// @brief Writes a string value, which is escaped if needed, nullptr is written as JSON null
+    void Value(char const * value) {
+        Separate();
+        if (value == nullptr) {
+            Append_Raw("null", 4U);
+            return;
+        }
+        Append_String(value);
+    }
+
+    void Value(bool const & value) {
+        Separate();
+        if (value) {
+            Append_Raw("true", 4U);
+        }
+        else {
+            Append_Raw("false", 5U);
+        }
+    }
+
+    void Value(int const & value) {
+        Value(static_cast<long long>(value));
+    }
+
+    void Value(unsigned int const & value) {
+        Value(static_cast<unsigned long long>(value));
+    }
+
+    void Value(long const & value) {
+        Value(static_cast<long long>(value));
+    }
+
+    void Value(unsigned long const & value) {
+        Value(static_cast<unsigned long long>(value));
+    }
+
+    void Value(long long const & value) {
+        Separate();
+        if (value < 0) {
+            Append_Char('-');
+            // Negate as unsigned, to ensure the minimum value does not overflow
+            Append_Unsigned(0U - static_cast<uint64_t>(value));
+            return;
+        }
+        Append_Unsigned(static_cast<uint64_t>(value));
+    }
+
+    void Value(unsigned long long const & value) {
+        Separate();
+        Append_Unsigned(value);
+    }
+
+    /// @brief Writes a floating point value, non finite values are written as JSON null, because JSON has no representation for them.
+    /// Values with more than 31 digits do not fit into the formatting buffer and mark the writer as overflowed
+    /// @param value Value that should be written
+    /// @param decimals Amount of digits after the decimal point, default = 3
+    void Value(double const & value, uint8_t const & decimals = 3U) {
+        Separate();
+        if (value != value || value > 1.7976931348623157e308 || value < -1.7976931348623157e308) {
+            Append_Raw("null", 4U);
+            return;
+        }
+        char number[32] = {};
+        int const written = snprintf(number, sizeof(number), "%.*f", decimals, value);
+        // snprintf returns the length the number would have had, large values (about 1e28 and above) do not fit and would be read past the end of the buffer
+        if (written <= 0 || static_cast<size_t>(written) >= sizeof(number)) {
+            m_overflowed = true;
+            return;
+        }
+        Append_Raw(number, static_cast<size_t>(written));
+    }
+
+    void Value(float const & value, uint8_t const & decimals = 3U) {
+        Value(static_cast<double>(value), decimals);
+    }
+
+    /// @brief Writes already serialized JSON (object, array, number, ...) as the next value, is copied without any validation or escaping
+    /// @param json Serialized JSON value
+    /// @param length Length of the serialized value in bytes
+    void Raw_Value(char const * json, size_t const & length) {
+        Separate();
+        Append_Raw(json, length);
+    }
+
+    /// @brief Writes a complete key-value pair into the currently open object
+    /// @tparam T Type of the value, has to be supported by one of the Value() overloads
+    /// @param key Key of the member
+    /// @param value Value of the member
+    template<typename T>
+    void Add(char const * key, T const & value) {
+        Key(key);
+        Value(value);
+    }
+
+    /// @brief Amount of bytes written so far, excluding the null terminator
+    /// @return Current length of the serialized JSON
+    size_t const & Length() const {
+        return m_length;
+    }
+
+    /// @brief Amount of bytes that can still be written before the writer overflows, excluding the null terminator
+    /// @return Free space in the buffer
+    size_t Remaining() const {
+        return m_overflowed ? 0U : m_capacity - m_length - 1U;
+    }
+
+    /// @brief Whether the buffer was too small, in that case the content is truncated and should not be sent
+    /// @return Whether the writer overflowed
+    bool const & Overflowed() const {
+        return m_overflowed;
+    }
+
+    /// @brief Null-terminated serialized JSON
+    /// @return Pointer to the start of the buffer given in the constructor
+    char const * Get_String() const {
+        return m_buffer;
+    }
+
+  private:
+    // Maximum nesting depth of objects and arrays, limited by the amount of bits in m_first_member
+    static size_t constexpr MAX_DEPTH = 31U;
+
+    void Begin_Container(char const & open) {
+        Separate();
+        if (m_depth >= MAX_DEPTH) {
+            m_overflowed = true;
+            return;
+        }
+        Append_Char(open);
+        m_depth++;
+        m_first_member |= (1U << m_depth);
+    }
+
+    void End_Container(char const & close) {
+        if (m_depth == 0U) {
+            return;
+        }
+        m_first_member &= ~(1U << m_depth);
+        m_depth--;
+        Append_Char(close);
+    }
+
+    /// @brief Inserts a comma before every member or element except the first one in the current container,
+    /// the value directly following a key never needs a separator
+    void Separate() {
+        if (m_after_key) {
+            m_after_key = false;
+            return;
+        }
+        uint32_t const bit = (1U << m_depth);
+        if (m_first_member & bit) {
+            m_first_member &= ~bit;
+            return;
+        }
+        Append_Char(',');
+    }
+
+    void Append_Unsigned(uint64_t value) {
+        // 20 digits are enough for the maximum 64-bit value
+        char digits[20] = {};
+        size_t count = 0U;
+        do {
+            digits[sizeof(digits) - 1U - count] = static_cast<char>('0' + (value % 10U));
+            value /= 10U;
+            count++;
+        } while (value != 0U);
+        Append_Raw(digits + sizeof(digits) - count, count);
+    }
+
+    void Append_String(char const * value) {
+        Append_Char('"');
+        for (; *value != '\0'; value++) {
+            char const c = *value;
+            switch (c) {
+                case '"':
+                    Append_Raw("\\\"", 2U);
+                    break;
+                case '\\':
+                    Append_Raw("\\\\", 2U);
+                    break;
+                case '\n':
+                    Append_Raw("\\n", 2U);
+                    break;
+                case '\r':
+                    Append_Raw("\\r", 2U);
+                    break;
+                case '\t':
+                    Append_Raw("\\t", 2U);
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20U) {
+                        char escaped[7] = {};
+                        (void)snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+                        Append_Raw(escaped, 6U);
+                    }
+                    else {
+                        Append_Char(c);
+                    }
+                    break;
+            }
+        }
+        Append_Char('"');
+    }
+
+    void Append_Char(char const & c) {
+        Append_Raw(&c, 1U);
+    }
+
+    void Append_Raw(char const * data, size_t const & length) {
+        // Keep one byte for the null terminator
+        if (m_overflowed || m_length + length >= m_capacity) {
+            m_overflowed = true;
+            return;
+        }
+        memcpy(m_buffer + m_length, data, length);
+        m_length += length;
+        m_buffer[m_length] = '\0';
+    }
+
+    char *   m_buffer = nullptr;    // Buffer the JSON is written into
+    size_t   m_capacity = 0U;       // Size of the buffer including the null terminator
+    size_t   m_length = 0U;         // Amount of bytes written, excluding the null terminator
+    size_t   m_depth = 0U;          // Current nesting depth of objects and arrays, 0 is the top level
+    uint32_t m_first_member = 1U;   // Bit per nesting depth, set while the container on that depth has no member yet
+    bool     m_after_key = false;   // Whether the last write was a key, so the next value needs no separator
+    bool     m_overflowed = false;  // Whether the buffer was too small for the written content
+};
+
+
+/// @brief Sends the given elements as JSON arrays, split into as few messages as the payload buffer allows. Every element is serialized into the scratch buffer first
+/// and only appended to the message if it fits completely, so a message is never cut off in the middle of an element.
+/// Stops at the first message that could not be sent, or at an element that does not even fit into an empty message
+/// @tparam Element Type of the elements
+/// @tparam Write Callable with the signature void(Json_Writer &, Element const &), serializes one element as a single JSON value
+/// @tparam Send Callable with the signature bool(char const *, size_t), sends one message and returns whether it was sent
+/// @param elements Elements that should be sent, in order
+/// @param count Amount of elements
+/// @param payload Buffer the messages are serialized into
+/// @param scratch Buffer a single element is serialized into, has to be as big as the payload buffer
+/// @param capacity Size of both buffers in bytes, including the null terminator
+/// @param write Serializes one element
+/// @param send Sends one message
+/// @return Amount of elements from the start that were sent, the remaining ones have to be sent again later
+template<typename Element, typename Write, typename Send>
+size_t Send_Json_Batches(Element const * elements, size_t const & count, char * payload, char * scratch, size_t const & capacity, Write write, Send send) {
+    Json_Writer writer(payload, capacity);
+    Json_Writer element(scratch, capacity);
+    size_t sent = 0U;
+    while (sent < count) {
+        writer.Clear();
+        writer.Begin_Array();
+        size_t batched = 0U;
+        while (sent + batched < count) {
+            element.Clear();
+            write(element, elements[sent + batched]);
+            // Space for the separator and the closing bracket
+            size_t const needed = element.Length() + (batched > 0U ? 1U : 0U) + 1U;
+            if (element.Overflowed() || needed > writer.Remaining()) {
+                break;
+            }
+            writer.Raw_Value(element.Get_String(), element.Length());
+            batched++;
+        }
+        writer.End_Array();
+        if (batched == 0U || writer.Overflowed() || !send(writer.Get_String(), writer.Length())) {
+            break;
+        }
+        sent += batched;
+    }
+    return sent;
+}
+
+#endif // Json_Writer_h
@@ -0,0 +1,92 @@
+#ifndef Key_Dictionary_h
+#define Key_Dictionary_h
+
+// Local includes.
+#include "Json_Writer.h"
+
+// Library includes.
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/// @brief Interns the keys of high rate telemetry into short numeric ids, "temperature" is sent as "2" in every message instead of the full name.
+/// The device publishes the dictionary once after connecting, as an array whose index is the id of the key, the receiver replaces the ids with the names again (see tools/telemetry_decode.cpp).
+/// A receiver that does not know about the dictionary would store the ids as keys of their own, ids are therefore only sent once the receiver acknowledged the dictionary (see Acknowledge()),
+/// until then every key is sent with its name.
+/// Ids are the positions in the given key list, the list therefore may only ever be appended to, so that telemetry recorded with an older firmware still decodes correctly.
+/// Keys that are not part of the dictionary are sent unchanged, so interning a subset of the keys is always possible
+/// @tparam KeyCount Amount of keys in the dictionary, at most 1000
+template<size_t KeyCount>
+class Key_Dictionary {
+    static_assert(KeyCount > 0U && KeyCount <= 1000U, "Ids are written with up to three digits");
+
+  public:
+    /// @brief Constructor
+    /// @param keys Names of the interned keys, have to stay valid as long as the dictionary is used, id of a key is its index
+    /// @param enabled Whether keys are interned, if disabled Key() always returns the name, default = true
+    Key_Dictionary(char const * const (&keys)[KeyCount], bool const & enabled = true)
+      : m_keys(keys)
+      , m_enabled(enabled)
+    {
+        for (size_t i = 0U; i < KeyCount; i++) {
+            snprintf(m_ids[i], sizeof(m_ids[i]), "%u", static_cast<unsigned int>(i));
+        }
+    }
+
+    /// @brief Enables or disables interning, for example if the receiver can not decode ids
+    /// @param enabled Whether keys are interned
+    void Set_Enabled(bool const & enabled) {
+        m_enabled = enabled;
+    }
+
+    /// @brief Enables interning once the receiver acknowledged the dictionary, with the amount of keys it knows.
+    /// Keys are only ever appended, a receiver that knows all of them can decode every id, a receiver that knows fewer (an older dictionary) or none gets the names
+    /// @param known_keys Amount of keys the receiver acknowledged, 0 if it did not acknowledge the dictionary
+    void Acknowledge(size_t const & known_keys) {
+        m_enabled = known_keys >= KeyCount;
+    }
+
+    /// @brief Whether keys are interned
+    /// @return Whether Key() returns ids
+    bool const & Is_Enabled() const {
+        return m_enabled;
+    }
+
+    /// @brief Key that should be sent for the given name
+    /// @param name Name of the key, the same pointer as in the dictionary is found without comparing the string
+    /// @return Id of the key if it is interned, otherwise the name itself
+    char const * Key(char const * name) const {
+        if (!m_enabled) {
+            return name;
+        }
+        for (size_t i = 0U; i < KeyCount; i++) {
+            if (m_keys[i] == name) {
+                return m_ids[i];
+            }
+        }
+        for (size_t i = 0U; i < KeyCount; i++) {
+            if (strcmp(m_keys[i], name) == 0) {
+                return m_ids[i];
+            }
+        }
+        return name;
+    }
+
+    /// @brief Writes the dictionary as an array of the names ordered by id, as the value of the previous key
+    /// @param writer Writer the dictionary is written into
+    void Write(Json_Writer & writer) const {
+        writer.Begin_Array();
+        for (size_t i = 0U; i < KeyCount; i++) {
+            writer.Value(m_keys[i]);
+        }
+        writer.End_Array();
+    }
+
+  private:
+    char const * const (&m_keys)[KeyCount];      // Names of the interned keys, index is the id
+    char               m_ids[KeyCount][4U] = {}; // Serialized id of every key
+    bool               m_enabled = true;         // Whether keys are interned
+};
+
+#endif // Key_Dictionary_h
@@ -0,0 +1,218 @@
+#ifndef Link_Health_h
+#define Link_Health_h
+
+// Library includes.
+#include <stdint.h>
+
+
+/// @brief Thresholds of the link quality monitoring, the defaults suit a probe every few seconds and telemetry every 2 seconds
+struct Link_Health_Settings {
+    uint32_t probe_interval_ms = 5000U;          // Interval of the probes while the link is healthy
+    uint32_t degraded_probe_interval_ms = 1000U; // Interval of the probes while the link is degraded or the signal is failing, confirms the recovery or the failure quickly
+    uint32_t probe_timeout_ms = 3000U;           // A probe without answer after this time counts as lost
+    uint32_t degraded_rtt_ms = 800U;             // Smoothed round trip time, or age of the outstanding probe, above which the link is degraded
+    uint8_t  lost_probes_to_reconnect = 2U;      // Probes lost in a row, after which the connection is considered dead
+    float    weak_rssi_dbm = -85.0f;             // Smoothed signal strength below which the probes are sent more often
+    float    fading_rssi_dbm = -75.0f;           // Smoothed signal strength below which a falling signal already shortens the probe interval
+    float    fading_rssi_db_per_s = -0.5f;       // Trend of the signal strength below which the signal counts as falling
+};
+
+
+/// @brief Quality of the link as judged by Link_Health
+enum class Link_State : uint8_t {
+    HEALTHY,  // Telemetry can be published directly
+    DEGRADED, // Probes are slow or were lost, data would likely be lost, telemetry should be buffered until the link recovered
+    DEAD      // Probes are not answered anymore, the connection is likely half-open and should be reconnected
+};
+
+
+/// @brief Judges the quality of the connection to the server from the round trip time of probes sent over the same connection,
+/// e.g. attribute requests. A half-open connection, whose peer is gone without closing it,
+/// keeps reporting connected until the keepalive of the client expires, everything published in the meantime is silently lost.
+/// Unanswered probes detect it within a few probe intervals instead, and a rising round trip time often announces a lost link before it happens,
+/// which allows to buffer telemetry before data is lost. The state is only judged from the probes, a weak or falling signal strength alone does not degrade the link,
+/// many devices work fine at the edge of the access point range, it only shortens the probe interval, so that a failing link is confirmed by the probes early.
+/// Only keeps a few values and does not send anything itself, so it can be used with any client and on the host (see tools/link_health_simulation.cpp)
+class Link_Health {
+  public:
+    /// @brief Constructor
+    /// @param settings Thresholds of the monitoring, default = Link_Health_Settings()
+    explicit Link_Health(Link_Health_Settings const & settings = Link_Health_Settings())
+      : m_settings(settings)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Replaces the thresholds of the monitoring
+    /// @param settings Thresholds of the monitoring
+    void Configure(Link_Health_Settings const & settings) {
+        m_settings = settings;
+    }
+
+    /// @brief Forgets the state of the previous connection, has to be called after every connect. The signal strength is kept, it does not depend on the connection
+    /// @param now_ms Current time in milliseconds
+    void Reset(uint32_t const & now_ms) {
+        m_probe_pending = false;
+        m_probed = false;
+        m_last_probe_ms = now_ms;
+        m_lost_in_row = 0U;
+        m_probe_overdue = false;
+        m_rtt_ms = 0.0f;
+        m_state = Link_State::HEALTHY;
+    }
+
+    /// @brief Adds a measured signal strength, smoothes the level and the trend between samples
+    /// @param now_ms Time of the sample in milliseconds
+    /// @param rssi_dbm Measured signal strength, e.g. WiFi.RSSI()
+    void Add_Rssi(uint32_t const & now_ms, float const & rssi_dbm) {
+        if (m_rssi_samples == 0U) {
+            m_rssi_dbm = rssi_dbm;
+        }
+        else {
+            float const previous = m_rssi_dbm;
+            m_rssi_dbm += (rssi_dbm - m_rssi_dbm) * SMOOTHING;
+            uint32_t const elapsed_ms = now_ms - m_last_rssi_ms;
+            if (elapsed_ms > 0U) {
+                float const slope = (m_rssi_dbm - previous) * 1000.0f / static_cast<float>(elapsed_ms);
+                m_rssi_trend = m_rssi_samples == 1U ? slope : m_rssi_trend + (slope - m_rssi_trend) * SMOOTHING;
+            }
+        }
+        m_last_rssi_ms = now_ms;
+        m_rssi_samples = m_rssi_samples < UINT8_MAX ? m_rssi_samples + 1U : m_rssi_samples;
+    }
+
+    /// @brief Whether the next probe should be sent, the interval is shorter while the link is not healthy or the signal is failing and only one probe is outstanding at a time
+    /// @param now_ms Current time in milliseconds
+    /// @return Whether a probe should be sent now
+    bool Is_Probe_Due(uint32_t const & now_ms) const {
+        if (m_probe_pending) {
+            return false;
+        }
+        if (!m_probed) {
+            return true;
+        }
+        uint32_t const interval = m_state == Link_State::HEALTHY && !Is_Signal_Failing() ? m_settings.probe_interval_ms : m_settings.degraded_probe_interval_ms;
+        return now_ms - m_last_probe_ms >= interval;
+    }
+
+    /// @brief Has to be called once a probe was sent
+    /// @param now_ms Time the probe was sent in milliseconds
+    void Probe_Sent(uint32_t const & now_ms) {
+        m_probe_pending = true;
+        m_probed = true;
+        m_last_probe_ms = now_ms;
+    }
+
+    /// @brief Has to be called once the answer of the outstanding probe was received, answers of probes that were already counted as lost are ignored
+    /// @param now_ms Time the answer was received in milliseconds
+    void Probe_Answered(uint32_t const & now_ms) {
+        if (!m_probe_pending) {
+            return;
+        }
+        m_probe_pending = false;
+        m_lost_in_row = 0U;
+        float const rtt = static_cast<float>(now_ms - m_last_probe_ms);
+        m_rtt_ms = m_rtt_ms == 0.0f ? rtt : m_rtt_ms + (rtt - m_rtt_ms) * SMOOTHING;
+    }
+
+    /// @brief Counts the outstanding probe as lost once its timeout passed and judges the link from the probes
+    /// @param now_ms Current time in milliseconds
+    /// @return Quality of the link
+    Link_State Update(uint32_t const & now_ms) {
+        uint32_t const probe_age = m_probe_pending ? now_ms - m_last_probe_ms : 0U;
+        if (m_probe_pending && probe_age >= m_settings.probe_timeout_ms) {
+            m_probe_pending = false;
+            m_lost_in_row = m_lost_in_row < UINT8_MAX ? m_lost_in_row + 1U : m_lost_in_row;
+        }
+        m_probe_overdue = probe_age > m_settings.degraded_rtt_ms;
+        if (m_lost_in_row >= m_settings.lost_probes_to_reconnect) {
+            m_state = Link_State::DEAD;
+        }
+        else if (m_lost_in_row > 0U || m_probe_overdue || m_rtt_ms > m_settings.degraded_rtt_ms) {
+            m_state = Link_State::DEGRADED;
+        }
+        else {
+            m_state = Link_State::HEALTHY;
+        }
+        return m_state;
+    }
+
+    /// @brief Quality of the link at the last call to Update()
+    /// @return Quality of the link
+    Link_State const & Get_State() const {
+        return m_state;
+    }
+
+    /// @brief Whether the probes are currently answered, no probe was lost since the last answer and the outstanding one is not overdue.
+    /// Also true on a slow link, whose smoothed round trip time degrades it, data sent over it still arrives, only later
+    /// @return Whether the connection is working at the last call to Update()
+    bool Is_Answering() const {
+        return m_lost_in_row == 0U && !m_probe_overdue;
+    }
+
+    /// @brief Combined quality of the round trip time, the signal strength and the lost probes, meant for dashboards, the decisions are made by Update() from the probes alone
+    /// @return Score from 0 (unusable) to 100 (perfect)
+    uint8_t Get_Score() const {
+        float score = 100.0f;
+        score -= Clamp(m_rtt_ms / static_cast<float>(m_settings.degraded_rtt_ms) * 20.0f, 0.0f, 40.0f);
+        if (m_rssi_samples > 0U) {
+            score -= Clamp((-60.0f - m_rssi_dbm) * 40.0f / 30.0f, 0.0f, 40.0f);
+        }
+        score -= 30.0f * m_lost_in_row;
+        return static_cast<uint8_t>(Clamp(score, 0.0f, 100.0f) + 0.5f);
+    }
+
+    /// @brief Smoothed round trip time of the answered probes
+    /// @return Round trip time in milliseconds, 0 if no probe was answered since the last reset
+    float const & Get_Rtt() const {
+        return m_rtt_ms;
+    }
+
+    /// @brief Smoothed signal strength
+    /// @return Signal strength in dBm
+    float const & Get_Rssi() const {
+        return m_rssi_dbm;
+    }
+
+    /// @brief Smoothed change of the signal strength
+    /// @return Trend in dB per second, negative while the signal is falling
+    float const & Get_Rssi_Trend() const {
+        return m_rssi_trend;
+    }
+
+    /// @brief Probes lost in a row
+    /// @return Amount of lost probes since the last answered one
+    uint8_t const & Get_Lost_Probes() const {
+        return m_lost_in_row;
+    }
+
+  private:
+    // Weight of a new sample in the exponentially smoothed values
+    static constexpr float SMOOTHING = 0.3f;
+
+    bool Is_Signal_Failing() const {
+        if (m_rssi_samples < 2U) {
+            return false;
+        }
+        return m_rssi_dbm < m_settings.weak_rssi_dbm || (m_rssi_dbm < m_settings.fading_rssi_dbm && m_rssi_trend < m_settings.fading_rssi_db_per_s);
+    }
+
+    static float Clamp(float const & value, float const & minimum, float const & maximum) {
+        return value < minimum ? minimum : (value > maximum ? maximum : value);
+    }
+
+    Link_Health_Settings m_settings = {};                 // Thresholds of the monitoring
+    Link_State           m_state = Link_State::HEALTHY;   // Quality at the last update
+    bool                 m_probe_pending = false;         // Whether a probe is waiting for its answer
+    bool                 m_probed = false;                // Whether a probe was sent since the last reset
+    uint32_t             m_last_probe_ms = 0U;            // Time the last probe was sent
+    uint8_t              m_lost_in_row = 0U;              // Probes lost since the last answered one
+    bool                 m_probe_overdue = false;         // Whether the outstanding probe was older than the degraded round trip time at the last update
+    float                m_rtt_ms = 0.0f;                 // Smoothed round trip time, 0 until the first answer
+    float                m_rssi_dbm = 0.0f;               // Smoothed signal strength
+    float                m_rssi_trend = 0.0f;             // Smoothed change of the signal strength in dB per second
+    uint32_t             m_last_rssi_ms = 0U;             // Time of the last signal strength sample
+    uint8_t              m_rssi_samples = 0U;             // Signal strength samples, saturates
+};
+
+#endif // Link_Health_h
@@ -0,0 +1,115 @@
+#ifndef Log_Level_h
+#define Log_Level_h
+
+// Local includes.
+#include "Configuration.h"
+
+// Library includes.
+#include <stdint.h>
+#include <type_traits>
+
+
+/// @brief Severity of a log message, a level includes every level above it
+enum class Log_Level : uint8_t {
+    NONE,
+    ERROR,
+    WARNING,
+    INFO,
+    DEBUG
+};
+
+
+/// @brief Part of the library a log message is generated by, the level of every category can be chosen separately
+enum class Log_Category : uint8_t {
+    RPC,
+    REQUEST
+};
+
+
+/// @brief Level used for loggers without a Log_Policy, keeps the previous behaviour, errors are always logged and everything else only if THINGSBOARD_ENABLE_DEBUG is set
+#if THINGSBOARD_ENABLE_DEBUG
+Log_Level constexpr DEFAULT_LOG_LEVEL = Log_Level::DEBUG;
+#else
+Log_Level constexpr DEFAULT_LOG_LEVEL = Log_Level::ERROR;
+#endif // THINGSBOARD_ENABLE_DEBUG
+
+
+/// @brief Adds compile time log levels to a logger, passed as the Logger template argument of the API implementations instead of the logger itself.
+/// Messages below the level of their category are removed at compile time, including their format strings,
+/// so errors can stay enabled in production images while the debug messages cost neither flash nor time
+/// @tparam Logger Logger the enabled messages are passed to, e.g. DefaultLogger or Deferred_Logger
+/// @tparam Level Level of every category that is not given explicitly
+/// @tparam RpcLevel Level of the server side rpc messages, default = Level
+/// @tparam RequestLevel Level of the client side request messages, default = Level
+template<typename Logger, Log_Level Level, Log_Level RpcLevel = Level, Log_Level RequestLevel = Level>
+class Log_Policy : public Logger {
+  public:
+    /// @brief Level messages of the given category have to be at or above to be logged
+    /// @param category Category of the message
+    /// @return Level of the category
+    static constexpr Log_Level Get_Level(Log_Category const category) {
+        return category == Log_Category::RPC ? RpcLevel : (category == Log_Category::REQUEST ? RequestLevel : Level);
+    }
+};
+
+
+/// @brief Level of the given category of a logger, loggers without a Get_Level() method, e.g. DefaultLogger, use DEFAULT_LOG_LEVEL for every category
+/// @tparam Logger Logger to get the level of
+/// @tparam Category Category to get the level of
+template<typename Logger, Log_Category Category, typename = void>
+struct Log_Level_Of {
+    static Log_Level constexpr value = DEFAULT_LOG_LEVEL;
+};
+
+template<typename Logger, Log_Category Category>
+struct Log_Level_Of<Logger, Category, typename std::conditional<true, void, decltype(Logger::Get_Level(Category))>::type> {
+    static Log_Level constexpr value = Logger::Get_Level(Category);
+};
+
+
+/// @brief Logs the messages of one level and category with the given logger, or compiles to nothing if that level is disabled for the logger
+/// @tparam Category Category of the messages
+/// @tparam Level Level of the messages
+/// @tparam Logger Logger the messages are passed to if they are enabled
+template<Log_Category Category, Log_Level Level, typename Logger>
+class Log_Site {
+  public:
+    /// @brief Whether messages of this level and category are logged
+    static bool constexpr ENABLED = Level != Log_Level::NONE && static_cast<uint8_t>(Level) <= static_cast<uint8_t>(Log_Level_Of<Logger, Category>::value);
+
+    /// @brief Logs a message with arguments, if enabled
+    /// @tparam Args Types of the arguments
+    /// @param format Format string
+    /// @param args Arguments of the format string
+    template<typename ...Args>
+    static void printfln(char const * const format, Args const &... args) {
+        Print(std::integral_constant<bool, ENABLED>(), format, args...);
+    }
+
+    /// @brief Logs a message without arguments, if enabled
+    /// @param message Message
+    static void println(char const * const message) {
+        Print_Line(std::integral_constant<bool, ENABLED>(), message);
+    }
+
+  private:
+    template<typename ...Args>
+    static void Print(std::true_type, char const * const format, Args const &... args) {
+        (void)Logger::printfln(format, args...);
+    }
+
+    template<typename ...Args>
+    static void Print(std::false_type, char const * const, Args const &...) {
+        // Disabled, nothing to do
+    }
+
+    static void Print_Line(std::true_type, char const * const message) {
+        (void)Logger::println(message);
+    }
+
+    static void Print_Line(std::false_type, char const * const) {
+        // Disabled, nothing to do
+    }
+};
+
+#endif // Log_Level_h
@@ -0,0 +1,246 @@
+#ifndef Lzss_h
+#define Lzss_h
+
+// Library includes.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/// @brief Small footprint LZSS codec with a fixed window (the scheme of heatshrink), meant for batched uploads of repetitive JSON telemetry.
+/// The compressed stream consists of a 5 byte header, the window and length bits in the first byte followed by the uncompressed size (32 bit little endian),
+/// and a most significant bit first bit stream of tokens, either a literal (1, 8 bits) or a back reference (0, WindowBits bits distance - 1, LengthBits bits length - MIN_MATCH).
+/// A back reference of the minimum length costs less than two literals, repeated keys of 10 and more bytes cost 2 bytes instead
+class Lzss {
+  public:
+    /// @brief Size of the header in front of the bit stream
+    static size_t constexpr HEADER_SIZE = 5U;
+    /// @brief Shortest back reference that is encoded, shorter repetitions are cheaper as literals
+    static size_t constexpr MIN_MATCH = 3U;
+
+    /// @brief Uncompressed size stored in the header of a compressed stream
+    /// @param input Compressed stream
+    /// @param size Size of the compressed stream in bytes
+    /// @return Uncompressed size or 0 if the header is incomplete
+    static size_t Get_Decompressed_Size(uint8_t const * input, size_t const & size) {
+        if (size < HEADER_SIZE) {
+            return 0U;
+        }
+        return static_cast<size_t>(input[1U]) | (static_cast<size_t>(input[2U]) << 8U) | (static_cast<size_t>(input[3U]) << 16U) | (static_cast<size_t>(input[4U]) << 24U);
+    }
+
+    /// @brief Decompresses a complete stream, the window and length bits are read from the header, so a single decoder handles every encoder configuration.
+    /// Needs no memory besides the output, the window is the already decompressed output itself
+    /// @param input Compressed stream
+    /// @param size Size of the compressed stream in bytes
+    /// @param output Buffer the uncompressed data is written into
+    /// @param capacity Size of the output buffer in bytes
+    /// @return Size of the uncompressed data or 0 if the stream is invalid or does not fit into the output
+    static size_t Decompress(uint8_t const * input, size_t const & size, uint8_t * output, size_t const & capacity) {
+        size_t const expected = Get_Decompressed_Size(input, size);
+        if (expected == 0U || expected > capacity) {
+            return 0U;
+        }
+        uint8_t const window_bits = input[0U] >> 4U;
+        uint8_t const length_bits = input[0U] & 0x0FU;
+        if (window_bits == 0U || length_bits == 0U) {
+            return 0U;
+        }
+
+        size_t const bit_count = (size - HEADER_SIZE) * 8U;
+        size_t bit = 0U;
+        uint8_t const * stream = input + HEADER_SIZE;
+        auto read_bits = [&](uint8_t const & count, uint32_t & value) -> bool {
+            if (bit + count > bit_count) {
+                return false;
+            }
+            value = 0U;
+            for (uint8_t i = 0U; i < count; i++, bit++) {
+                value = (value << 1U) | ((stream[bit >> 3U] >> (7U - (bit & 7U))) & 1U);
+            }
+            return true;
+        };
+
+        size_t length = 0U;
+        while (length < expected) {
+            uint32_t flag = 0U;
+            if (!read_bits(1U, flag)) {
+                return 0U;
+            }
+            if (flag != 0U) {
+                uint32_t literal = 0U;
+                if (!read_bits(8U, literal)) {
+                    return 0U;
+                }
+                output[length++] = static_cast<uint8_t>(literal);
+                continue;
+            }
+            uint32_t distance = 0U;
+            uint32_t count = 0U;
+            if (!read_bits(window_bits, distance) || !read_bits(length_bits, count)) {
+                return 0U;
+            }
+            distance += 1U;
+            count += MIN_MATCH;
+            if (distance > length || length + count > expected) {
+                return 0U;
+            }
+            // Byte by byte, the reference may overlap the bytes it produces (runs)
+            for (uint32_t i = 0U; i < count; i++, length++) {
+                output[length] = output[length - distance];
+            }
+        }
+        return length;
+    }
+};
+
+
+/// @brief LZSS compressor with hash chains over a fixed window, all workspaces are members sized at compile time, compressing never allocates memory.
+/// Every position is inserted into a chain of earlier positions with the same three byte prefix, only the newest MaxChain candidates are compared,
+/// which bounds the worst case time per byte independent of the input
+/// @tparam WindowBits Size of the window as a power of two, determines how far back repetitions are found and the bits of a distance, 8 - 15, default = 10 (1 KiB)
+/// @tparam LengthBits Bits of the length of a back reference, the longest one is MIN_MATCH + 2^LengthBits - 1, 2 - 8, default = 5
+/// @tparam HashBits Size of the hash table as a power of two, default = 9
+/// @tparam MaxChain Maximum amount of candidates compared per position, default = 16
+template<uint8_t WindowBits = 10U, uint8_t LengthBits = 5U, uint8_t HashBits = 9U, uint8_t MaxChain = 16U>
+class Lzss_Encoder {
+    static_assert(WindowBits >= 8U && WindowBits <= 15U, "Window has to be between 256 bytes and 32 KiB");
+    static_assert(LengthBits >= 2U && LengthBits <= 8U, "Length has to be between 2 and 8 bits");
+
+  public:
+    static size_t constexpr WINDOW_SIZE = 1U << WindowBits;
+    static size_t constexpr MAX_MATCH = Lzss::MIN_MATCH + (1U << LengthBits) - 1U;
+
+    /// @brief Worst case size of the compressed stream, every byte a literal
+    /// @param size Size of the uncompressed data in bytes
+    /// @return Size of the compressed stream in bytes
+    static constexpr size_t Get_Max_Compressed_Size(size_t const & size) {
+        return Lzss::HEADER_SIZE + (size * 9U + 7U) / 8U;
+    }
+
+    /// @brief Compresses a complete buffer into a single stream
+    /// @param input Uncompressed data
+    /// @param size Size of the uncompressed data in bytes
+    /// @param output Buffer the compressed stream is written into
+    /// @param capacity Size of the output buffer in bytes
+    /// @return Size of the compressed stream or 0 if it does not fit into the output or the input is empty
+    size_t Compress(uint8_t const * input, size_t const & size, uint8_t * output, size_t const & capacity) {
+        if (size == 0U || size > UINT32_MAX || capacity < Lzss::HEADER_SIZE) {
+            return 0U;
+        }
+        output[0U] = static_cast<uint8_t>((WindowBits << 4U) | LengthBits);
+        output[1U] = static_cast<uint8_t>(size);
+        output[2U] = static_cast<uint8_t>(size >> 8U);
+        output[3U] = static_cast<uint8_t>(size >> 16U);
+        output[4U] = static_cast<uint8_t>(size >> 24U);
+        m_output = output + Lzss::HEADER_SIZE;
+        m_capacity = capacity - Lzss::HEADER_SIZE;
+        m_length = 0U;
+        m_bits = 0U;
+        m_bit_count = 0U;
+        m_overflowed = false;
+        // Positions are stored as 16 bit, the chains are followed by distance, so older positions that wrapped around are never mistaken for recent ones
+        memset(m_head, 0xFF, sizeof(m_head));
+
+        size_t position = 0U;
+        while (position < size) {
+            size_t best_length = 0U;
+            size_t best_distance = 0U;
+            Find_Match(input, size, position, best_length, best_distance);
+            if (best_length >= Lzss::MIN_MATCH) {
+                Write_Bits(0U, 1U);
+                Write_Bits(static_cast<uint32_t>(best_distance - 1U), WindowBits);
+                Write_Bits(static_cast<uint32_t>(best_length - Lzss::MIN_MATCH), LengthBits);
+            }
+            else {
+                best_length = 1U;
+                Write_Bits(0x100U | input[position], 9U);
+            }
+            for (size_t i = 0U; i < best_length; i++, position++) {
+                Insert(input, size, position);
+            }
+            if (m_overflowed) {
+                return 0U;
+            }
+        }
+        // Pad the last byte with zeros, the decoder stops at the uncompressed size
+        if (m_bit_count > 0U) {
+            Write_Bits(0U, 8U - m_bit_count);
+        }
+        return m_overflowed ? 0U : Lzss::HEADER_SIZE + m_length;
+    }
+
+  private:
+    static size_t constexpr HASH_SIZE = 1U << HashBits;
+    static uint16_t constexpr NO_POSITION = 0xFFFFU;
+
+    static size_t Hash(uint8_t const * data) {
+        uint32_t const prefix = static_cast<uint32_t>(data[0U]) | (static_cast<uint32_t>(data[1U]) << 8U) | (static_cast<uint32_t>(data[2U]) << 16U);
+        return (prefix * 2654435761U) >> (32U - HashBits);
+    }
+
+    void Insert(uint8_t const * input, size_t const & size, size_t const & position) {
+        if (position + Lzss::MIN_MATCH > size) {
+            return;
+        }
+        size_t const hash = Hash(input + position);
+        m_previous[position & (WINDOW_SIZE - 1U)] = m_head[hash];
+        m_head[hash] = static_cast<uint16_t>(position);
+    }
+
+    void Find_Match(uint8_t const * input, size_t const & size, size_t const & position, size_t & best_length, size_t & best_distance) const {
+        if (position + Lzss::MIN_MATCH > size) {
+            return;
+        }
+        size_t const limit = (size - position) < MAX_MATCH ? (size - position) : MAX_MATCH;
+        uint16_t candidate = m_head[Hash(input + position)];
+        size_t last_distance = 0U;
+        for (uint8_t chain = 0U; chain < MaxChain && candidate != NO_POSITION; chain++) {
+            size_t const distance = static_cast<uint16_t>(static_cast<uint16_t>(position) - candidate);
+            // Chains only go back in time, a distance that does not grow means the chain reached positions overwritten in the window
+            if (distance == 0U || distance > WINDOW_SIZE || distance <= last_distance) {
+                break;
+            }
+            last_distance = distance;
+            uint8_t const * const match = input + position - distance;
+            size_t length = 0U;
+            while (length < limit && match[length] == input[position + length]) {
+                length++;
+            }
+            if (length > best_length) {
+                best_length = length;
+                best_distance = distance;
+                if (length == limit) {
+                    break;
+                }
+            }
+            candidate = m_previous[(position - distance) & (WINDOW_SIZE - 1U)];
+        }
+    }
+
+    void Write_Bits(uint32_t const & value, uint8_t const & count) {
+        for (uint8_t i = count; i-- > 0U;) {
+            m_bits = static_cast<uint8_t>((m_bits << 1U) | ((value >> i) & 1U));
+            if (++m_bit_count == 8U) {
+                if (m_length == m_capacity) {
+                    m_overflowed = true;
+                    return;
+                }
+                m_output[m_length++] = m_bits;
+                m_bits = 0U;
+                m_bit_count = 0U;
+            }
+        }
+    }
+
+    uint16_t  m_head[HASH_SIZE] = {};       // Newest position of every hash
+    uint16_t  m_previous[WINDOW_SIZE] = {}; // Next older position with the same hash, indexed by the position within the window
+    uint8_t * m_output = nullptr;           // Bit stream of the current compression
+    size_t    m_capacity = 0U;              // Size of the bit stream buffer
+    size_t    m_length = 0U;                // Complete bytes written into the bit stream
+    uint8_t   m_bits = 0U;                  // Bits of the incomplete byte
+    uint8_t   m_bit_count = 0U;             // Amount of bits in the incomplete byte
+    bool      m_overflowed = false;         // Whether the bit stream did not fit into the output
+};
+
+#endif // Lzss_h
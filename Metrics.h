@@ -0,0 +1,356 @@
+#ifndef Metrics_h
+#define Metrics_h
+
+// Local includes.
+#include "Json_Writer.h"
+
+// Library includes.
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/// @brief Monotonically increasing count of events, e.g. sent messages. Increments are a single relaxed atomic addition,
+/// the counter can therefore be incremented from any context, including interrupts and other threads, without a lock
+class Metric_Counter {
+  public:
+    /// @brief Adds the given amount to the counter
+    /// @param amount Amount to add, default = 1
+    void Increment(uint32_t const & amount = 1U) {
+        m_value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    /// @brief Current value of the counter, wraps around after 2^32 events
+    /// @return Current value
+    uint32_t Get() const {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<uint32_t> m_value = {0U}; // Amount of counted events
+};
+
+
+/// @brief Value that can go up and down, e.g. the heater output, only the last set value is kept
+class Metric_Gauge {
+  public:
+    /// @brief Replaces the value of the gauge
+    /// @param value New value
+    void Set(float const & value) {
+        m_value.store(value, std::memory_order_relaxed);
+    }
+
+    /// @brief Last set value of the gauge
+    /// @return Current value
+    float Get() const {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<float> m_value = {0.0f}; // Last set value
+};
+
+
+/// @brief Distribution of recorded values, e.g. durations in microseconds, counted in buckets of powers of two.
+/// Bucket 0 counts the value 0, bucket i counts the values in [2^(i-1), 2^i), the last bucket every larger value as well.
+/// Recording is three relaxed atomic additions, quantiles are approximated with the upper bound of the bucket they fall into, which is at most a factor 2 off
+class Metric_Histogram {
+  public:
+    /// @brief Amount of buckets, the last regular bucket ends at 2^(BUCKET_COUNT - 2) - 1, ~4 seconds when recording microseconds
+    static size_t constexpr BUCKET_COUNT = 24U;
+
+    /// @brief Adds the given value to the distribution
+    /// @param value Value to record
+    void Record(uint32_t const & value) {
+        m_buckets[Get_Bucket_Index(value)].fetch_add(1U, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+        m_count.fetch_add(1U, std::memory_order_relaxed);
+    }
+
+    /// @brief Amount of recorded values
+    /// @return Amount of values
+    uint32_t Get_Count() const {
+        return m_count.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Sum of the recorded values, wraps around after 2^32
+    /// @return Sum of the values
+    uint32_t Get_Sum() const {
+        return m_sum.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Amount of values recorded into the given bucket
+    /// @param index Index of the bucket, has to be smaller than BUCKET_COUNT
+    /// @return Amount of values in the bucket
+    uint32_t Get_Bucket(size_t const & index) const {
+        return m_buckets[index].load(std::memory_order_relaxed);
+    }
+
+    /// @brief Largest value counted in the given bucket, the last bucket is unbounded and returns UINT32_MAX
+    /// @param index Index of the bucket, has to be smaller than BUCKET_COUNT
+    /// @return Inclusive upper bound of the bucket
+    static uint32_t Get_Upper_Bound(size_t const & index) {
+        return index + 1U >= BUCKET_COUNT ? UINT32_MAX : (UINT32_C(1) << index) - 1U;
+    }
+
+    /// @brief Approximates the value below which the given fraction of the recorded values lies
+    /// @param quantile Fraction in [0, 1], e.g. 0.99 for the 99th percentile
+    /// @return Upper bound of the bucket containing the quantile, 0 if nothing was recorded
+    uint32_t Get_Quantile(float const & quantile) const {
+        uint32_t counts[BUCKET_COUNT] = {};
+        uint32_t total = 0U;
+        // Buckets are read once, the result stays consistent while values are recorded concurrently
+        for (size_t index = 0U; index < BUCKET_COUNT; index++) {
+            counts[index] = Get_Bucket(index);
+            total += counts[index];
+        }
+        if (total == 0U) {
+            return 0U;
+        }
+        uint32_t rank = static_cast<uint32_t>(quantile * total + 0.5f);
+        rank = rank == 0U ? 1U : (rank > total ? total : rank);
+        uint32_t seen = 0U;
+        for (size_t index = 0U; index < BUCKET_COUNT; index++) {
+            seen += counts[index];
+            if (seen >= rank) {
+                return Get_Upper_Bound(index);
+            }
+        }
+        return UINT32_MAX;
+    }
+
+  private:
+    static size_t Get_Bucket_Index(uint32_t value) {
+        size_t index = 0U;
+        while (value != 0U && index + 1U < BUCKET_COUNT) {
+            value >>= 1U;
+            index++;
+        }
+        return index;
+    }
+
+    std::atomic<uint32_t> m_buckets[BUCKET_COUNT] = {}; // Amount of values per bucket
+    std::atomic<uint32_t> m_sum = {0U};                 // Sum of the recorded values
+    std::atomic<uint32_t> m_count = {0U};               // Amount of recorded values
+};
+
+
+/// @brief Kind of a registered metric
+enum class Metric_Type : uint8_t {
+    COUNTER,
+    GAUGE,
+    HISTOGRAM
+};
+
+
+/// @brief Fixed-capacity registry of named metrics, which are snapshotted together into one telemetry message, instead of publishing every value on its own.
+/// The metrics themselves are owned by the caller and only referenced, values that are already tracked elsewhere, e.g. the cache statistics of Server_Side_RPC,
+/// can be registered as a function reading them instead of being counted twice. Registering is not thread safe and should be done once at startup,
+/// snapshots may be taken while the metrics are updated concurrently. Every value is read atomically, but the snapshot as a whole is not
+/// @tparam MaxMetrics Maximum amount of metrics that can be registered, default = 24
+template<size_t MaxMetrics = 24U>
+class Metrics_Registry {
+  public:
+    /// @brief Reads the current value of a counter kept somewhere else
+    using Counter_Function = uint32_t (*)();
+    /// @brief Reads the current value of a gauge kept somewhere else
+    using Gauge_Function = float (*)();
+
+    /// @brief Registers a counter
+    /// @param name Name of the metric, has to stay valid as long as the registry is used, should only contain [a-zA-Z0-9_] to be a valid Prometheus name
+    /// @param counter Counter the value is read from
+    /// @return Whether the metric was registered, false if the registry is full
+    bool Add(char const * name, Metric_Counter const & counter) {
+        Entry * const entry = Add_Entry(name, Metric_Type::COUNTER);
+        if (entry != nullptr) {
+            entry->counter = &counter;
+        }
+        return entry != nullptr;
+    }
+
+    /// @brief Registers a counter read with the given function
+    /// @param name Name of the metric, has to stay valid as long as the registry is used
+    /// @param function Function returning the current value of the counter
+    /// @return Whether the metric was registered, false if the registry is full
+    bool Add(char const * name, Counter_Function function) {
+        Entry * const entry = Add_Entry(name, Metric_Type::COUNTER);
+        if (entry != nullptr) {
+            entry->counter_function = function;
+        }
+        return entry != nullptr;
+    }
+
+    /// @brief Registers a gauge
+    /// @param name Name of the metric, has to stay valid as long as the registry is used
+    /// @param gauge Gauge the value is read from
+    /// @return Whether the metric was registered, false if the registry is full
+    bool Add(char const * name, Metric_Gauge const & gauge) {
+        Entry * const entry = Add_Entry(name, Metric_Type::GAUGE);
+        if (entry != nullptr) {
+            entry->gauge = &gauge;
+        }
+        return entry != nullptr;
+    }
+
+    /// @brief Registers a gauge read with the given function
+    /// @param name Name of the metric, has to stay valid as long as the registry is used
+    /// @param function Function returning the current value of the gauge
+    /// @return Whether the metric was registered, false if the registry is full
+    bool Add(char const * name, Gauge_Function function) {
+        Entry * const entry = Add_Entry(name, Metric_Type::GAUGE);
+        if (entry != nullptr) {
+            entry->gauge_function = function;
+        }
+        return entry != nullptr;
+    }
+
+    /// @brief Registers a histogram
+    /// @param name Name of the metric, has to stay valid as long as the registry is used
+    /// @param histogram Histogram the distribution is read from
+    /// @return Whether the metric was registered, false if the registry is full
+    bool Add(char const * name, Metric_Histogram const & histogram) {
+        Entry * const entry = Add_Entry(name, Metric_Type::HISTOGRAM);
+        if (entry != nullptr) {
+            entry->histogram = &histogram;
+        }
+        return entry != nullptr;
+    }
+
+    /// @brief Amount of registered metrics
+    /// @return Amount of metrics
+    size_t const & Size() const {
+        return m_size;
+    }
+
+    /// @brief Writes a snapshot of every metric as members into the currently open object of the given writer, so all of them are sent as a single telemetry message.
+    /// Counters and gauges are written as "name":value, histograms as "nameCount", "nameMean", "nameP50" and "nameP99"
+    /// @param writer Writer with an open object
+    void Write(Json_Writer & writer) const {
+        char key[MAX_KEY_LENGTH] = {};
+        for (size_t index = 0U; index < m_size; index++) {
+            Entry const & entry = m_entries[index];
+            switch (entry.type) {
+                case Metric_Type::COUNTER:
+                    writer.Add(entry.name, Get_Counter(entry));
+                    break;
+                case Metric_Type::GAUGE:
+                    writer.Add(entry.name, Get_Gauge(entry));
+                    break;
+                case Metric_Type::HISTOGRAM: {
+                    Metric_Histogram const & histogram = *entry.histogram;
+                    uint32_t const count = histogram.Get_Count();
+                    snprintf(key, sizeof(key), "%sCount", entry.name);
+                    writer.Add(key, count);
+                    snprintf(key, sizeof(key), "%sMean", entry.name);
+                    writer.Add(key, count == 0U ? 0.0f : static_cast<float>(histogram.Get_Sum()) / count);
+                    snprintf(key, sizeof(key), "%sP50", entry.name);
+                    writer.Add(key, histogram.Get_Quantile(0.5f));
+                    snprintf(key, sizeof(key), "%sP99", entry.name);
+                    writer.Add(key, histogram.Get_Quantile(0.99f));
+                    break;
+                }
+            }
+        }
+    }
+
+    /// @brief Writes a snapshot of every metric in the Prometheus text exposition format, meant for host builds, e.g. to scrape a simulation.
+    /// Histograms are written with cumulative buckets, empty buckets above the largest recorded value are skipped
+    /// @tparam Output Anything with write(const uint8_t *, size_t), e.g. the Arduino Print class
+    /// @param output Output the text is written to
+    /// @param prefix Prepended to the name of every metric, e.g. "bioreactor_", default = ""
+    template<typename Output>
+    void Write_Prometheus(Output & output, char const * prefix = "") const {
+        static char const * const TYPE_NAMES[] = { "counter", "gauge", "histogram" };
+        char line[MAX_LINE_LENGTH] = {};
+        for (size_t index = 0U; index < m_size; index++) {
+            Entry const & entry = m_entries[index];
+            Print_Line(output, line, snprintf(line, sizeof(line), "# TYPE %s%s %s\n", prefix, entry.name, TYPE_NAMES[static_cast<uint8_t>(entry.type)]));
+            switch (entry.type) {
+                case Metric_Type::COUNTER:
+                    Print_Line(output, line, snprintf(line, sizeof(line), "%s%s %lu\n", prefix, entry.name, static_cast<unsigned long>(Get_Counter(entry))));
+                    break;
+                case Metric_Type::GAUGE:
+                    Print_Line(output, line, snprintf(line, sizeof(line), "%s%s %g\n", prefix, entry.name, static_cast<double>(Get_Gauge(entry))));
+                    break;
+                case Metric_Type::HISTOGRAM: {
+                    Metric_Histogram const & histogram = *entry.histogram;
+                    uint32_t counts[Metric_Histogram::BUCKET_COUNT] = {};
+                    size_t used = 0U;
+                    for (size_t bucket = 0U; bucket < Metric_Histogram::BUCKET_COUNT; bucket++) {
+                        counts[bucket] = histogram.Get_Bucket(bucket);
+                        used = counts[bucket] != 0U ? bucket + 1U : used;
+                    }
+                    // The total is taken from the buckets instead of the count, so the +Inf bucket always matches _count
+                    unsigned long cumulative = 0U;
+                    for (size_t bucket = 0U; bucket < used && bucket + 1U < Metric_Histogram::BUCKET_COUNT; bucket++) {
+                        cumulative += counts[bucket];
+                        Print_Line(output, line, snprintf(line, sizeof(line), "%s%s_bucket{le=\"%lu\"} %lu\n", prefix, entry.name,
+                            static_cast<unsigned long>(Metric_Histogram::Get_Upper_Bound(bucket)), cumulative));
+                    }
+                    if (used == Metric_Histogram::BUCKET_COUNT) {
+                        cumulative += counts[Metric_Histogram::BUCKET_COUNT - 1U];
+                    }
+                    Print_Line(output, line, snprintf(line, sizeof(line), "%s%s_bucket{le=\"+Inf\"} %lu\n", prefix, entry.name, cumulative));
+                    Print_Line(output, line, snprintf(line, sizeof(line), "%s%s_sum %lu\n", prefix, entry.name, static_cast<unsigned long>(histogram.Get_Sum())));
+                    Print_Line(output, line, snprintf(line, sizeof(line), "%s%s_count %lu\n", prefix, entry.name, cumulative));
+                    break;
+                }
+            }
+        }
+    }
+
+  private:
+    // Longest key written for a histogram, the name followed by the longest suffix
+    static size_t constexpr MAX_KEY_LENGTH = 48U;
+    static size_t constexpr MAX_LINE_LENGTH = 128U;
+
+    /// @brief Registered metric, only the member matching the type and source is set
+    struct Entry {
+        char const *             name = nullptr;
+        Metric_Type              type = Metric_Type::COUNTER;
+        Metric_Counter const *   counter = nullptr;
+        Counter_Function         counter_function = nullptr;
+        Metric_Gauge const *     gauge = nullptr;
+        Gauge_Function           gauge_function = nullptr;
+        Metric_Histogram const * histogram = nullptr;
+    };
+
+    Entry * Add_Entry(char const * name, Metric_Type const & type) {
+        if (m_size >= MaxMetrics || name == nullptr) {
+            return nullptr;
+        }
+        Entry & entry = m_entries[m_size++];
+        entry.name = name;
+        entry.type = type;
+        return &entry;
+    }
+
+    static uint32_t Get_Counter(Entry const & entry) {
+        return entry.counter != nullptr ? entry.counter->Get() : entry.counter_function();
+    }
+
+    static float Get_Gauge(Entry const & entry) {
+        return entry.gauge != nullptr ? entry.gauge->Get() : entry.gauge_function();
+    }
+
+    template<typename Output>
+    static void Print_Line(Output & output, char const * line, int const & length) {
+        if (length <= 0) {
+            return;
+        }
+        if (static_cast<size_t>(length) < MAX_LINE_LENGTH) {
+            output.write(reinterpret_cast<uint8_t const *>(line), static_cast<size_t>(length));
+            return;
+        }
+        // Truncated, the newline was cut off with the rest of the line, without it the next line would be glued onto this one
+        output.write(reinterpret_cast<uint8_t const *>(line), MAX_LINE_LENGTH - 1U);
+        output.write(reinterpret_cast<uint8_t const *>("\n"), 1U);
+    }
+
+    Entry  m_entries[MaxMetrics] = {}; // Registered metrics
+    size_t m_size = 0U;                // Amount of registered metrics
+};
+
+#endif // Metrics_h
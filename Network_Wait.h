@@ -0,0 +1,52 @@
+#ifndef Network_Wait_h
+#define Network_Wait_h
+
+// Library includes.
+#include <Arduino.h>
+#if defined(ESP32)
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#elif defined(ESP8266)
+#include <ESP8266WiFi.h>
+#endif
+
+
+/// @brief Allows the network task to block until the underlying socket becomes readable or the given timeout expires,
+/// instead of sleeping a fixed delay and then polling the client every iteration, even if nothing arrived.
+/// While blocked the task does not use any CPU time, and received messages are processed as soon as they arrive
+class Network_Wait {
+  public:
+    /// @brief Blocks until the client has data available or the timeout expired.
+    /// On ESP32 this uses lwIP select() on the socket of the client, on other boards there is no socket to wait on,
+    /// therefore it falls back to sleeping for at most fallback_milliseconds and returns early once data is available
+    /// @param client Client whose socket should be waited on
+    /// @param timeout_milliseconds Maximum time to block, normally the time until the next timer deadline
+    /// @param fallback_milliseconds Maximum time to sleep if the socket can not be waited on, default = 10
+    /// @return Whether data is available to be read
+    static bool Wait_For_Readable(WiFiClient & client, uint32_t const & timeout_milliseconds, uint32_t const & fallback_milliseconds = 10U) {
+        // Data can already be buffered inside the client, which select() on the socket does not know about
+        if (client.available() > 0) {
+            return true;
+        }
+#if defined(ESP32)
+        int const fd = client.fd();
+        if (fd >= 0) {
+            fd_set read_fds;
+            FD_ZERO(&read_fds);
+            FD_SET(fd, &read_fds);
+            // Also wake up on errors, so a closed connection is noticed immediately
+            fd_set error_fds;
+            FD_ZERO(&error_fds);
+            FD_SET(fd, &error_fds);
+            struct timeval timeout;
+            timeout.tv_sec = timeout_milliseconds / 1000U;
+            timeout.tv_usec = (timeout_milliseconds % 1000U) * 1000U;
+            return select(fd + 1, &read_fds, nullptr, &error_fds, &timeout) > 0;
+        }
+#endif // defined(ESP32)
+        delay(timeout_milliseconds < fallback_milliseconds ? timeout_milliseconds : fallback_milliseconds);
+        return client.available() > 0;
+    }
+};
+
+#endif // Network_Wait_h
@@ -0,0 +1,173 @@
+#ifndef Noise_Model_h
+#define Noise_Model_h
+
+// Local includes.
+#include "Philox.h"
+
+// Library includes.
+#include <math.h>
+#include <stdint.h>
+
+
+/// @brief Noise sources on the different streams of one device, every source draws from its own stream, so adding or removing one does not change the others
+enum class Noise_Stream : uint32_t {
+    SENSOR_BASE = 0U, // First sensor, sensor n uses SENSOR_BASE + n
+    FEED = 0x100U,    // Feed disturbances
+    NETWORK = 0x200U  // Packet loss
+};
+
+
+/// @brief Imperfections of a simulated sensor
+struct Sensor_Noise_Profile {
+    float noise_sigma = 0.0f;         // Standard deviation of the white measurement noise
+    float drift_sigma = 0.0f;         // Standard deviation of the drift increment per sample, the drift is a random walk
+    float dropout_probability = 0.0f; // Probability that a sample is lost (disconnected probe, ADC timeout)
+    float quantization = 0.0f;        // Resolution of the sensor, 0 for a continuous value
+};
+
+/// @brief Sensor of one device, adds noise, drift, quantization and dropouts to the true value.
+/// The drift is the only state, it is a random walk and therefore depends on all previous samples, which have to be taken with consecutive indices
+class Noisy_Sensor {
+  public:
+    /// @brief Constructor
+    /// @param seed Seed of the run
+    /// @param device Identifier of the device
+    /// @param sensor Index of the sensor on the device
+    /// @param profile Imperfections of the sensor
+    Noisy_Sensor(uint64_t const & seed, uint32_t const & device, uint32_t const & sensor, Sensor_Noise_Profile const & profile)
+      : m_random(seed, device, static_cast<uint32_t>(Noise_Stream::SENSOR_BASE) + sensor)
+      , m_profile(profile)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Measures the given true value
+    /// @param index Index of the sample, has to increase by one with every call
+    /// @param true_value Actual value of the measured quantity
+    /// @param measured Receives the measured value, unchanged if the sample was lost
+    /// @return Whether a value was measured, false if the sample dropped out
+    bool Sample(uint64_t const & index, float const & true_value, float & measured) {
+        if (m_profile.noise_sigma <= 0.0f && m_profile.drift_sigma <= 0.0f && m_profile.dropout_probability <= 0.0f) {
+            // Ideal sensor, skip generating the block
+            measured = Quantize(true_value);
+            return true;
+        }
+        // Words 0 and 1 give the noise and the drift increment, word 2 the dropout
+        Philox4x32::Block const block = m_random.Block(index);
+        float noise = 0.0f;
+        float drift_increment = 0.0f;
+        Philox4x32::To_Normal_Pair(block.word[0U], block.word[1U], noise, drift_increment);
+        m_drift += m_profile.drift_sigma * drift_increment;
+        if (Philox4x32::To_Unit(block.word[2U]) < m_profile.dropout_probability) {
+            return false;
+        }
+        measured = Quantize(true_value + m_drift + m_profile.noise_sigma * noise);
+        return true;
+    }
+
+    /// @brief Current offset caused by the drift
+    /// @return Drift in the unit of the sensor
+    float const & Get_Drift() const {
+        return m_drift;
+    }
+
+  private:
+    float Quantize(float const & value) const {
+        return m_profile.quantization > 0.0f ? roundf(value / m_profile.quantization) * m_profile.quantization : value;
+    }
+
+    Random_Stream        m_random;       // Noise of this sensor
+    Sensor_Noise_Profile m_profile = {}; // Imperfections of the sensor
+    float                m_drift = 0.0f; // Accumulated drift
+};
+
+
+/// @brief Randomly occurring rectangular disturbance pulses, for example feed additions or a heat load of the culture
+struct Pulse_Disturbance_Profile {
+    float    probability = 0.0f;   // Probability per sample that a pulse starts, if none is active
+    float    amplitude_min = 0.0f; // Smallest amplitude of a pulse
+    float    amplitude_max = 0.0f; // Largest amplitude of a pulse
+    uint32_t duration = 1U;        // Length of a pulse in samples
+};
+
+/// @brief Disturbance pulses of one device, the only state is the pulse that is currently active
+class Pulse_Disturbance {
+  public:
+    /// @brief Constructor
+    /// @param seed Seed of the run
+    /// @param device Identifier of the device
+    /// @param profile Rate and size of the pulses
+    Pulse_Disturbance(uint64_t const & seed, uint32_t const & device, Pulse_Disturbance_Profile const & profile)
+      : m_random(seed, device, static_cast<uint32_t>(Noise_Stream::FEED))
+      , m_profile(profile)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Value of the disturbance at the given sample
+    /// @param index Index of the sample, has to increase by one with every call
+    /// @return Amplitude of the active pulse or 0
+    float Value(uint64_t const & index) {
+        if (m_remaining == 0U && m_profile.probability > 0.0f) {
+            Philox4x32::Block const block = m_random.Block(index);
+            if (Philox4x32::To_Unit(block.word[0U]) < m_profile.probability) {
+                float const fraction = Philox4x32::To_Unit(block.word[1U]);
+                m_amplitude = m_profile.amplitude_min + fraction * (m_profile.amplitude_max - m_profile.amplitude_min);
+                m_remaining = m_profile.duration;
+            }
+        }
+        if (m_remaining == 0U) {
+            return 0.0f;
+        }
+        m_remaining--;
+        return m_amplitude;
+    }
+
+  private:
+    Random_Stream             m_random;           // Noise of the disturbance
+    Pulse_Disturbance_Profile m_profile = {};     // Rate and size of the pulses
+    float                     m_amplitude = 0.0f; // Amplitude of the active pulse
+    uint32_t                  m_remaining = 0U;   // Samples the active pulse still lasts
+};
+
+
+/// @brief Burst loss of a wireless link, as a two state Gilbert-Elliott model
+struct Packet_Loss_Profile {
+    float good_loss = 0.0f;     // Loss probability while the link is good
+    float bad_loss = 0.0f;      // Loss probability while the link is bad
+    float good_to_bad = 0.0f;   // Probability per packet that the link turns bad
+    float bad_to_good = 1.0f;   // Probability per packet that the link recovers
+};
+
+/// @brief Decides which packets of one device are lost, the only state is whether the link is currently good or bad
+class Packet_Loss {
+  public:
+    /// @brief Constructor
+    /// @param seed Seed of the run
+    /// @param device Identifier of the device
+    /// @param profile Loss probabilities and transitions of the link
+    Packet_Loss(uint64_t const & seed, uint32_t const & device, Packet_Loss_Profile const & profile)
+      : m_random(seed, device, static_cast<uint32_t>(Noise_Stream::NETWORK))
+      , m_profile(profile)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Whether the given packet is lost
+    /// @param index Index of the packet, has to increase by one with every call
+    /// @return Whether the packet should be dropped
+    bool Drop(uint64_t const & index) {
+        Philox4x32::Block const block = m_random.Block(index);
+        float const transition = Philox4x32::To_Unit(block.word[0U]);
+        m_bad = m_bad ? !(transition < m_profile.bad_to_good) : (transition < m_profile.good_to_bad);
+        float const loss = Philox4x32::To_Unit(block.word[1U]);
+        return loss < (m_bad ? m_profile.bad_loss : m_profile.good_loss);
+    }
+
+  private:
+    Random_Stream       m_random;       // Noise of the link
+    Packet_Loss_Profile m_profile = {}; // Loss probabilities and transitions
+    bool                m_bad = false;  // Whether the link is currently in the bad state
+};
+
+#endif // Noise_Model_h
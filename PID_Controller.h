@@ -0,0 +1,68 @@
+#ifndef PID_Controller_h
+#define PID_Controller_h
+
+
+/// @brief Gains and output limits of a PID controller
+struct PID_Gains {
+    float kp = 0.0f;          // Proportional gain
+    float ki = 0.0f;          // Integral gain per second
+    float kd = 0.0f;          // Derivative gain in seconds
+    float output_min = 0.0f;  // Smallest output, for example 0 % heater duty cycle
+    float output_max = 1.0f;  // Largest output, for example 100 % heater duty cycle
+};
+
+
+/// @brief Discrete PID controller, the baseline the model predictive controller is compared against.
+/// The derivative acts on the measurement instead of the error, so setpoint steps do not kick the output,
+/// and the integral is only accumulated while the output is not saturated in the same direction (conditional integration anti windup)
+class PID_Controller {
+  public:
+    /// @brief Constructor
+    /// @param gains Gains and output limits
+    explicit PID_Controller(PID_Gains const & gains = PID_Gains())
+      : m_gains(gains)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Replaces the gains, the integral is kept to avoid a bump in the output
+    /// @param gains New gains and output limits
+    void Set_Gains(PID_Gains const & gains) {
+        m_gains = gains;
+    }
+
+    /// @brief Clears the integral and the derivative history, for example when the controller is enabled again
+    void Reset() {
+        m_integral = 0.0f;
+        m_initialized = false;
+    }
+
+    /// @brief Computes the next output
+    /// @param measurement Current value of the controlled variable
+    /// @param setpoint Desired value of the controlled variable
+    /// @param dt_seconds Time since the previous update
+    /// @return Output, clamped to the limits of the gains
+    float Update(float const & measurement, float const & setpoint, float const & dt_seconds) {
+        float const error = setpoint - measurement;
+        float const derivative = (m_initialized && dt_seconds > 0.0f) ? -(measurement - m_previous_measurement) / dt_seconds : 0.0f;
+        m_previous_measurement = measurement;
+        m_initialized = true;
+
+        float const unclamped = m_gains.kp * error + m_integral + m_gains.kd * derivative;
+        float const integral_step = m_gains.ki * error * dt_seconds;
+        if (!(unclamped >= m_gains.output_max && integral_step > 0.0f) && !(unclamped <= m_gains.output_min && integral_step < 0.0f)) {
+            m_integral += integral_step;
+        }
+
+        float const output = m_gains.kp * error + m_integral + m_gains.kd * derivative;
+        return output < m_gains.output_min ? m_gains.output_min : (output > m_gains.output_max ? m_gains.output_max : output);
+    }
+
+  private:
+    PID_Gains m_gains = {};                  // Gains and output limits
+    float     m_integral = 0.0f;             // Accumulated integral term, already multiplied by ki
+    float     m_previous_measurement = 0.0f; // Measurement of the previous update, for the derivative
+    bool      m_initialized = false;         // Whether a previous measurement exists
+};
+
+#endif // PID_Controller_h
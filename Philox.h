@@ -0,0 +1,126 @@
+#ifndef Philox_h
+#define Philox_h
+
+// Library includes.
+#include <math.h>
+#include <stdint.h>
+
+
+/// @brief Philox4x32-10 counter based random number generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC 2011).
+/// Instead of advancing a hidden state, every output block is a pure function of a 128 bit counter and a 64 bit key.
+/// Any sample can therefore be generated directly from its coordinates (seed, device, stream, sample index), in any order and on any thread,
+/// without sharing or storing generator state, which keeps parallel simulations deterministic independent of the scheduling
+class Philox4x32 {
+  public:
+    /// @brief Four 32 bit words, used for both the counter and the generated output
+    struct Block {
+        uint32_t word[4U];
+    };
+
+    /// @brief Generates the random block of the given counter
+    /// @param counter Coordinates of the block, every distinct counter gives an independent block
+    /// @param key_low Lower half of the key, normally the seed
+    /// @param key_high Upper half of the key
+    /// @return Four uniformly distributed random words
+    static Block Generate(Block counter, uint32_t key_low, uint32_t key_high) {
+        for (uint8_t round = 0U; round < ROUNDS; round++) {
+            uint64_t const product0 = static_cast<uint64_t>(MULTIPLIER0) * counter.word[0U];
+            uint64_t const product1 = static_cast<uint64_t>(MULTIPLIER1) * counter.word[2U];
+            Block next;
+            next.word[0U] = static_cast<uint32_t>(product1 >> 32U) ^ counter.word[1U] ^ key_low;
+            next.word[1U] = static_cast<uint32_t>(product1);
+            next.word[2U] = static_cast<uint32_t>(product0 >> 32U) ^ counter.word[3U] ^ key_high;
+            next.word[3U] = static_cast<uint32_t>(product0);
+            counter = next;
+            key_low += WEYL0;
+            key_high += WEYL1;
+        }
+        return counter;
+    }
+
+    /// @brief Converts a random word into a uniformly distributed float
+    /// @param word Random word
+    /// @return Value in [0, 1), with 24 bits, which fit into the mantissa of a float exactly
+    static float To_Unit(uint32_t const & word) {
+        return static_cast<float>(word >> 8U) * (1.0f / 16777216.0f);
+    }
+
+    /// @brief Converts two random words into a standard normal distributed float with the Box-Muller transform
+    /// @param first First random word
+    /// @param second Second random word
+    /// @return Value with mean 0 and standard deviation 1
+    static float To_Normal(uint32_t const & first, uint32_t const & second) {
+        // Shifted by half an interval, the logarithm must never see 0
+        float const radius = sqrtf(-2.0f * logf(To_Unit(first) + (0.5f / 16777216.0f)));
+        return radius * cosf(6.283185307f * To_Unit(second));
+    }
+
+    /// @brief Converts two random words into two independent standard normal distributed floats, both outputs of the Box-Muller transform
+    /// @param first First random word
+    /// @param second Second random word
+    /// @param normal_a Receives the first value
+    /// @param normal_b Receives the second value
+    static void To_Normal_Pair(uint32_t const & first, uint32_t const & second, float & normal_a, float & normal_b) {
+        float const radius = sqrtf(-2.0f * logf(To_Unit(first) + (0.5f / 16777216.0f)));
+        float const angle = 6.283185307f * To_Unit(second);
+        normal_a = radius * cosf(angle);
+        normal_b = radius * sinf(angle);
+    }
+
+  private:
+    static uint8_t constexpr ROUNDS = 10U;
+    static uint32_t constexpr MULTIPLIER0 = 0xD2511F53U;
+    static uint32_t constexpr MULTIPLIER1 = 0xCD9E8D57U;
+    static uint32_t constexpr WEYL0 = 0x9E3779B9U;
+    static uint32_t constexpr WEYL1 = 0xBB67AE85U;
+};
+
+
+/// @brief Independent stream of random numbers of one device, addressed by the sample index instead of being drawn in sequence.
+/// The counter is (sample index low, sample index high, stream, device) and the key is the seed of the run,
+/// so every device and every noise source (stream) of it gets its own non overlapping sequence from a single seed
+class Random_Stream {
+  public:
+    /// @brief Constructor
+    /// @param seed Seed of the complete run, the same seed reproduces the same run
+    /// @param device Identifier of the simulated or real device
+    /// @param stream Identifier of the noise source on that device
+    Random_Stream(uint64_t const & seed, uint32_t const & device, uint32_t const & stream)
+      : m_seed(seed)
+      , m_device(device)
+      , m_stream(stream)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Four random words of the given sample
+    /// @param index Index of the sample
+    /// @return Random block, identical for identical arguments
+    Philox4x32::Block Block(uint64_t const & index) const {
+        Philox4x32::Block const counter = { { static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32U), m_stream, m_device } };
+        return Philox4x32::Generate(counter, static_cast<uint32_t>(m_seed), static_cast<uint32_t>(m_seed >> 32U));
+    }
+
+    /// @brief Uniformly distributed float in [0, 1)
+    /// @param index Index of the sample
+    /// @param lane Which of the four words of the block should be used, allows drawing up to four independent values per sample
+    /// @return Random value
+    float Uniform(uint64_t const & index, uint8_t const & lane = 0U) const {
+        return Philox4x32::To_Unit(Block(index).word[lane & 3U]);
+    }
+
+    /// @brief Standard normal distributed float, Box-Muller transform of the first two words of the block
+    /// @param index Index of the sample
+    /// @return Random value with mean 0 and standard deviation 1
+    float Normal(uint64_t const & index) const {
+        Philox4x32::Block const block = Block(index);
+        return Philox4x32::To_Normal(block.word[0U], block.word[1U]);
+    }
+
+  private:
+    uint64_t m_seed = 0U;   // Key of the generator
+    uint32_t m_device = 0U; // Highest counter word
+    uint32_t m_stream = 0U; // Third counter word
+};
+
+#endif // Philox_h
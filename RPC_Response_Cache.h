@@ -0,0 +1,145 @@
+#ifndef RPC_Response_Cache_h
+#define RPC_Response_Cache_h
+
+// Library includes.
+#include <stdint.h>
+#include <string.h>
+
+
+/// @brief Default amount of responses the server side RPC cache remembers, 0 disables the cache
+size_t constexpr Default_Cached_Responses_Amount = 0U;
+/// @brief Default maximum size of one cached serialized response in bytes, including the null terminator
+size_t constexpr Default_Cached_Response_Size = 64U;
+
+
+/// @brief Fixed-size least recently used cache of server side RPC responses, keyed by the request id and method name of the request.
+/// Allows to answer requests that are redelivered by the broker or retried by the server with the previously serialized response,
+/// instead of executing the handler again, which for actuator commands would apply the same change multiple times.
+/// Lookups scan all entries, which is the fastest option for the small amount of entries the cache is meant for
+/// @tparam MaxEntries Maximum amount of remembered responses, once full the least recently used entry is replaced
+/// @tparam MaxResponseSize Maximum size of one serialized response including the null terminator, requests with bigger responses are only remembered as handled
+template<size_t MaxEntries, size_t MaxResponseSize>
+class RPC_Response_Cache {
+  public:
+    /// @brief Constructor
+    RPC_Response_Cache() = default;
+
+    /// @brief Looks up the response to a previously handled request and counts the lookup as a hit or a miss
+    /// @param request_id Id of the received request, parsed from the request topic
+    /// @param method_name Name of the called method, guards against ids that are reused for different requests
+    /// @param response Set to the cached null-terminated response on a hit, empty string if the handler did not respond, nullptr if the response was too big to be cached
+    /// @return Whether the request was already handled
+    bool Find(size_t const & request_id, char const * method_name, char const * & response) {
+        uint32_t const key = Hash(method_name);
+        for (auto & entry : m_entries) {
+            if (entry.used && entry.request_id == request_id && entry.method_hash == key) {
+                entry.last_used = ++m_use_counter;
+                response = entry.handled_only ? nullptr : entry.response;
+                m_hits++;
+                return true;
+            }
+        }
+        m_misses++;
+        return false;
+    }
+
+    /// @brief Remembers the response of a handled request, replacing the least recently used entry if the cache is full
+    /// @param request_id Id of the handled request
+    /// @param method_name Name of the called method
+    /// @param response Serialized response, empty string if the handler did not respond
+    /// @param length Length of the serialized response, excluding the null terminator
+    /// @return Whether the response was small enough to be cached, otherwise the request is only remembered as handled
+    bool Store(size_t const & request_id, char const * method_name, char const * response, size_t const & length) {
+        if (MaxEntries == 0U) {
+            return false;
+        }
+        if (length >= MaxResponseSize) {
+            Store_Handled(request_id, method_name);
+            return false;
+        }
+        Entry & entry = Replace(request_id, method_name);
+        memcpy(entry.response, response, length);
+        entry.response[length] = '\0';
+        return true;
+    }
+
+    /// @brief Remembers a handled request without its response, because it was too big to be cached or could not be serialized.
+    /// Finding the request again then returns no response, so the caller neither executes it again nor answers it
+    /// @param request_id Id of the handled request
+    /// @param method_name Name of the called method
+    void Store_Handled(size_t const & request_id, char const * method_name) {
+        if (MaxEntries == 0U) {
+            return;
+        }
+        Entry & entry = Replace(request_id, method_name);
+        entry.handled_only = true;
+        entry.response[0] = '\0';
+    }
+
+    /// @brief Forgets all cached responses, has to be called once request ids can start again from the beginning (new session)
+    void Clear() {
+        for (auto & entry : m_entries) {
+            entry.used = false;
+        }
+    }
+
+    /// @brief Amount of requests that were answered from the cache
+    /// @return Amount of cache hits
+    uint32_t const & Get_Hits() const {
+        return m_hits;
+    }
+
+    /// @brief Amount of requests that were not found in the cache and therefore executed the handler
+    /// @return Amount of cache misses
+    uint32_t const & Get_Misses() const {
+        return m_misses;
+    }
+
+  private:
+    struct Entry {
+        bool     used = false;                 // Whether the entry contains a response
+        bool     handled_only = false;         // Whether only the request was remembered, because its response did not fit
+        size_t   request_id = 0U;              // Id of the request the response belongs to
+        uint32_t method_hash = 0U;             // Hash of the called method name
+        uint32_t last_used = 0U;               // Value of m_use_counter the last time the entry was stored or found
+        char     response[MaxResponseSize] = {}; // Serialized null-terminated response
+    };
+
+    /// @brief Entry for the given request, replaces the least recently used entry if the cache is full
+    Entry & Replace(size_t const & request_id, char const * method_name) {
+        Entry * oldest = &m_entries[0];
+        for (auto & entry : m_entries) {
+            if (!entry.used) {
+                oldest = &entry;
+                break;
+            }
+            else if (entry.last_used < oldest->last_used) {
+                oldest = &entry;
+            }
+        }
+        oldest->used = true;
+        oldest->handled_only = false;
+        oldest->request_id = request_id;
+        oldest->method_hash = Hash(method_name);
+        oldest->last_used = ++m_use_counter;
+        return *oldest;
+    }
+
+    /// @brief 32-bit FNV-1a hash of the given string, null is treated as an empty string
+    static uint32_t Hash(char const * value) {
+        uint32_t hash = 2166136261U;
+        for (; value != nullptr && *value != '\0'; value++) {
+            hash ^= static_cast<uint8_t>(*value);
+            hash *= 16777619U;
+        }
+        return hash;
+    }
+
+    // Entries are never empty arrays, even if the cache is disabled, to keep the code free of special cases
+    Entry    m_entries[MaxEntries > 0U ? MaxEntries : 1U] = {};
+    uint32_t m_use_counter = 0U; // Monotonic counter, used to find the least recently used entry
+    uint32_t m_hits = 0U;        // Amount of requests answered from the cache
+    uint32_t m_misses = 0U;      // Amount of requests that had to be handled
+};
+
+#endif // RPC_Response_Cache_h
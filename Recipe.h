@@ -0,0 +1,185 @@
+#ifndef Recipe_h
+#define Recipe_h
+
+// Library includes.
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// @brief Setpoint channels every recipe segment controls
+enum class Recipe_Channel : uint8_t {
+    TEMPERATURE, // Medium temperature in degrees celsius
+    STIRRER,     // Stirrer speed in rotations per minute
+    PH,          // pH target
+    COUNT        // Amount of channels, not a valid channel
+};
+
+/// @brief Amount of setpoint channels
+size_t constexpr RECIPE_CHANNELS = static_cast<size_t>(Recipe_Channel::COUNT);
+
+
+/// @brief One phase of a recipe, as received from the server before it is compiled
+struct Recipe_Segment {
+    uint32_t duration_milliseconds;  // Length of the phase, the last phase keeps its final setpoints after it ended
+    float    target[RECIPE_CHANNELS]; // Setpoints reached at the end of the phase
+    bool     ramp;                    // Whether the setpoints ramp linearly from the end of the previous phase, otherwise they step to the target and hold
+};
+
+
+/// @brief Executes a batch recipe on the device, a piecewise linear setpoint trajectory for every channel.
+/// The segments are compiled once when they are loaded, into their absolute start time, start values and slopes,
+/// which makes interpolating the setpoints a single multiply-add per channel in every control tick.
+/// The current segment index only ever moves forward while running, therefore finding it is amortized O(1) as well,
+/// instead of searching all segments for the current time in every tick.
+/// The recipe uses relative time from Start(), wrap around of the millisecond counter is therefore handled as long as a recipe runs less than ~49 days
+/// @tparam MaxSegments Maximum amount of segments a recipe can consist of
+template<size_t MaxSegments>
+class Recipe {
+  public:
+    /// @brief Setpoints of every channel, indexed by Recipe_Channel
+    struct Setpoints {
+        float value[RECIPE_CHANNELS];
+    };
+
+    /// @brief Compiles the given segments into the recipe, replaces and stops the previously loaded recipe
+    /// @param segments Segments in execution order
+    /// @param count Amount of segments, has to be between 1 and MaxSegments
+    /// @param initial Setpoints before the first segment, used as the start of a ramp in the first segment
+    /// @return Whether the recipe was valid and has been loaded, the previous recipe is kept otherwise
+    bool Load(Recipe_Segment const * segments, size_t const & count, Setpoints const & initial) {
+        if (segments == nullptr || count == 0U || count > MaxSegments) {
+            return false;
+        }
+        uint64_t start = 0U;
+        for (size_t i = 0U; i < count; i++) {
+            start += segments[i].duration_milliseconds;
+        }
+        if (start > UINT32_MAX) {
+            return false;
+        }
+
+        Stop();
+        start = 0U;
+        Setpoints previous = initial;
+        for (size_t i = 0U; i < count; i++) {
+            Recipe_Segment const & segment = segments[i];
+            Compiled_Segment & compiled = m_segments[i];
+            compiled.start_milliseconds = static_cast<uint32_t>(start);
+            compiled.end_milliseconds = static_cast<uint32_t>(start + segment.duration_milliseconds);
+            float const inverse_duration = segment.duration_milliseconds > 0U ? 1.0f / static_cast<float>(segment.duration_milliseconds) : 0.0f;
+            for (size_t channel = 0U; channel < RECIPE_CHANNELS; channel++) {
+                float const from = segment.ramp ? previous.value[channel] : segment.target[channel];
+                compiled.start[channel] = from;
+                compiled.slope[channel] = (segment.target[channel] - from) * inverse_duration;
+                previous.value[channel] = segment.target[channel];
+            }
+            compiled.inverse_duration = inverse_duration;
+            start = compiled.end_milliseconds;
+        }
+        m_count = count;
+        m_final = previous;
+        return true;
+    }
+
+    /// @brief Starts executing the loaded recipe from its first segment
+    /// @param now_milliseconds Current time in milliseconds
+    /// @return Whether a recipe is loaded and has been started
+    bool Start(uint32_t const & now_milliseconds) {
+        if (m_count == 0U) {
+            return false;
+        }
+        m_start_milliseconds = now_milliseconds;
+        m_elapsed_milliseconds = 0U;
+        m_index = 0U;
+        m_running = true;
+        return true;
+    }
+
+    /// @brief Stops executing the recipe, the setpoints are no longer updated by Update()
+    void Stop() {
+        m_running = false;
+    }
+
+    /// @brief Interpolates the setpoints for the given time, meant to be called every control tick
+    /// @param now_milliseconds Current time in milliseconds
+    /// @param setpoints Receives the interpolated setpoints, left untouched if the recipe is not running
+    /// @return Whether the recipe is running, false once it finished or if it has been stopped
+    bool Update(uint32_t const & now_milliseconds, Setpoints & setpoints) {
+        if (!m_running) {
+            return false;
+        }
+        m_elapsed_milliseconds = now_milliseconds - m_start_milliseconds;
+        while (m_index < m_count && m_elapsed_milliseconds >= m_segments[m_index].end_milliseconds) {
+            m_index++;
+        }
+        if (m_index >= m_count) {
+            setpoints = m_final;
+            m_running = false;
+            return false;
+        }
+        Compiled_Segment const & segment = m_segments[m_index];
+        float const offset = static_cast<float>(m_elapsed_milliseconds - segment.start_milliseconds);
+        for (size_t channel = 0U; channel < RECIPE_CHANNELS; channel++) {
+            setpoints.value[channel] = segment.start[channel] + segment.slope[channel] * offset;
+        }
+        return true;
+    }
+
+    /// @brief Whether the recipe is currently being executed
+    /// @return Whether the recipe is running
+    bool const & Is_Running() const {
+        return m_running;
+    }
+
+    /// @brief Amount of segments of the loaded recipe
+    /// @return Amount of segments or 0 if no recipe is loaded
+    size_t const & Get_Segment_Count() const {
+        return m_count;
+    }
+
+    /// @brief Index of the segment that was active during the last Update(), equal to the segment count once the recipe finished
+    /// @return Index of the current segment
+    size_t const & Get_Segment_Index() const {
+        return m_index;
+    }
+
+    /// @brief Progress through the current segment, as of the last Update()
+    /// @return Value between 0 and 1
+    float Get_Segment_Progress() const {
+        if (m_index >= m_count) {
+            return 1.0f;
+        }
+        Compiled_Segment const & segment = m_segments[m_index];
+        return static_cast<float>(m_elapsed_milliseconds - segment.start_milliseconds) * segment.inverse_duration;
+    }
+
+    /// @brief Progress through the complete recipe, as of the last Update()
+    /// @return Value between 0 and 1
+    float Get_Progress() const {
+        if (m_count == 0U || m_index >= m_count) {
+            return m_count == 0U ? 0.0f : 1.0f;
+        }
+        uint32_t const total = m_segments[m_count - 1U].end_milliseconds;
+        return total > 0U ? static_cast<float>(m_elapsed_milliseconds) / static_cast<float>(total) : 1.0f;
+    }
+
+  private:
+    /// @brief Segment converted into absolute times and per millisecond slopes
+    struct Compiled_Segment {
+        uint32_t start_milliseconds;       // Start relative to the start of the recipe
+        uint32_t end_milliseconds;         // End relative to the start of the recipe
+        float    inverse_duration;         // 1 / duration, to compute the progress without a division
+        float    start[RECIPE_CHANNELS];   // Setpoints at the start of the segment
+        float    slope[RECIPE_CHANNELS];   // Change of the setpoints per millisecond
+    };
+
+    Compiled_Segment m_segments[MaxSegments] = {}; // Compiled segments of the loaded recipe
+    Setpoints        m_final = {};                  // Setpoints after the last segment ended
+    size_t           m_count = 0U;                  // Amount of loaded segments
+    size_t           m_index = 0U;                  // Current segment, only ever increases while running
+    uint32_t         m_start_milliseconds = 0U;     // Time the recipe was started at
+    uint32_t         m_elapsed_milliseconds = 0U;   // Time since the start as of the last Update()
+    bool             m_running = false;             // Whether the recipe is executing
+};
+
+#endif // Recipe_h
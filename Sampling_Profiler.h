@@ -0,0 +1,285 @@
+#ifndef Sampling_Profiler_h
+#define Sampling_Profiler_h
+
+// Library includes.
+#include <stddef.h>
+#include <stdint.h>
+#if defined(ESP32)
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#if defined(__XTENSA__)
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+#include <xtensa_context.h>
+#else
+#include <freertos/xtensa_context.h>
+#endif // ESP_ARDUINO_VERSION_MAJOR >= 3
+// Interrupt nesting per core, maintained by the interrupt dispatcher of the FreeRTOS port (port.c), it is not declared in any of its headers
+extern "C" volatile unsigned port_interruptNesting[portNUM_PROCESSORS];
+#endif // defined(__XTENSA__)
+#elif defined(__linux__)
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#endif
+
+
+/// @brief Fixed size histogram of sampled program counters, filled from an interrupt or signal handler, so recording never allocates, locks or calls any other function.
+/// Program counters are grouped into granules of 2^GranularityBits bytes and counted in an open addressing hash table,
+/// a device can not resolve them to functions itself, the dump is resolved against the firmware ELF on the host (see tools/sampling_profile.cpp)
+/// @tparam Capacity Maximum amount of distinct granules, samples of further granules are only counted as dropped, has to be a power of two, default = 256
+/// @tparam GranularityBits Size of a granule as a power of two, larger granules need fewer entries but blur neighbouring small functions, default = 4
+template<size_t Capacity = 256U, uint8_t GranularityBits = 4U>
+class Pc_Histogram {
+    static_assert((Capacity & (Capacity - 1U)) == 0U, "Capacity has to be a power of two");
+
+  public:
+    /// @brief Sampled granule and how often it was hit
+    struct Entry {
+        uintptr_t pc = 0U;    // Start address of the granule, 0 for an unused entry
+        uint32_t  count = 0U; // Samples that hit the granule
+    };
+
+    /// @brief Counts a sample, safe to call from an interrupt or signal handler as long as the histogram is not read at the same time
+    /// @param pc Program counter that was interrupted
+    void Record(uintptr_t const & pc) {
+        m_samples++;
+        uintptr_t const granule = (pc >> GranularityBits) << GranularityBits;
+        if (granule == 0U) {
+            m_dropped++;
+            return;
+        }
+        size_t index = (static_cast<uint32_t>(granule >> GranularityBits) * 2654435761U) & (Capacity - 1U);
+        for (size_t probe = 0U; probe < MAX_PROBES; probe++) {
+            Entry & entry = m_entries[index];
+            if (entry.pc == granule) {
+                entry.count++;
+                return;
+            }
+            if (entry.pc == 0U) {
+                entry.pc = granule;
+                entry.count = 1U;
+                m_used++;
+                return;
+            }
+            index = (index + 1U) & (Capacity - 1U);
+        }
+        m_dropped++;
+    }
+
+    /// @brief Removes all samples
+    void Clear() {
+        for (Entry & entry : m_entries) {
+            entry = Entry();
+        }
+        m_samples = 0U;
+        m_dropped = 0U;
+        m_used = 0U;
+    }
+
+    /// @brief Moves the used entries to the front, ordered by descending count, breaks the hash table, so it may only be called once sampling stopped,
+    /// recording afterwards requires Clear()
+    /// @return Amount of used entries
+    size_t Sort() {
+        size_t used = 0U;
+        for (size_t i = 0U; i < Capacity; i++) {
+            if (m_entries[i].pc != 0U) {
+                Entry const entry = m_entries[i];
+                m_entries[i] = Entry();
+                // Insertion sort, the table is small and it only runs when dumping
+                size_t position = used;
+                while (position > 0U && m_entries[position - 1U].count < entry.count) {
+                    m_entries[position] = m_entries[position - 1U];
+                    position--;
+                }
+                m_entries[position] = entry;
+                used++;
+            }
+        }
+        return used;
+    }
+
+    /// @brief Entry at the given index, after Sort() the index is the rank
+    /// @param index Index of the entry, has to be smaller than Capacity
+    /// @return Granule and its count
+    Entry const & Get_Entry(size_t const & index) const {
+        return m_entries[index];
+    }
+
+    /// @brief Amount of distinct granules
+    /// @return Used entries
+    size_t Get_Used() const {
+        return m_used;
+    }
+
+    /// @brief All samples taken, including the dropped ones
+    /// @return Amount of samples
+    uint32_t Get_Samples() const {
+        return m_samples;
+    }
+
+    /// @brief Samples that could not be counted, because the table was full around their granule
+    /// @return Amount of dropped samples
+    uint32_t Get_Dropped() const {
+        return m_dropped;
+    }
+
+  private:
+    // Probes until a sample is dropped, bounds the time spent in the interrupt
+    static size_t constexpr MAX_PROBES = 8U;
+
+    Entry             m_entries[Capacity] = {}; // Hash table of the granules
+    volatile uint32_t m_samples = 0U;           // All samples
+    volatile uint32_t m_dropped = 0U;           // Samples that were not counted
+    volatile size_t   m_used = 0U;              // Used entries
+};
+
+
+/// @brief Periodically interrupts the program and records where it was into a Pc_Histogram, to find what takes the time on a device that can not be debugged.
+/// Supported targets:
+/// - Xtensa ESP32, ESP32-S2 and ESP32-S3: a hardware timer interrupt on the core that started the profiler, normally the core running loop(), samples the task it interrupted.
+///   The exception registers (EPC1) can not be used, by the time the timer callback runs the interrupt dispatcher may have taken nested exceptions that overwrote them.
+///   Instead the program counter is read from the exception frame the dispatcher saved on the stack of the interrupted task, whose address FreeRTOS stores
+///   as the top of stack of that task. A timer interrupt that interrupted another interrupt handler, seen as an interrupt nesting above 1, has no such frame and is counted as dropped sample.
+/// - Linux hosts: SIGPROF of the process CPU time, which samples all threads like perf record would, without needing perf.
+/// Start() fails on every other target, including the RISC-V ESP32 variants. Only one profiler can run at a time
+/// @tparam Histogram Histogram the samples are recorded into, default = Pc_Histogram<>
+template<typename Histogram = Pc_Histogram<>>
+class Sampling_Profiler {
+  public:
+    static uint32_t constexpr MIN_RATE_HZ = 100U;
+    static uint32_t constexpr MAX_RATE_HZ = 10000U;
+
+    /// @brief Starts sampling, samples are added to the ones recorded before, call Get_Histogram().Clear() to start over
+    /// @param rate_hz Samples per second, MIN_RATE_HZ - MAX_RATE_HZ, higher rates disturb the measured program more
+    /// @return Whether sampling started, false if it is already running, the rate is invalid or the platform is not supported
+    bool Start(uint32_t const & rate_hz) {
+        if (s_running != nullptr || rate_hz < MIN_RATE_HZ || rate_hz > MAX_RATE_HZ) {
+            return false;
+        }
+        s_running = this;
+#if defined(ESP32) && defined(__XTENSA__)
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+        m_timer = timerBegin(TIMER_FREQUENCY_HZ);
+        if (m_timer == nullptr) {
+            s_running = nullptr;
+            return false;
+        }
+        timerAttachInterrupt(m_timer, &On_Timer);
+        timerAlarm(m_timer, TIMER_FREQUENCY_HZ / rate_hz, true, 0U);
+#else
+        // APB clock of 80 MHz divided to 1 MHz
+        m_timer = timerBegin(TIMER_NUMBER, 80U, true);
+        if (m_timer == nullptr) {
+            s_running = nullptr;
+            return false;
+        }
+        timerAttachInterrupt(m_timer, &On_Timer, true);
+        timerAlarmWrite(m_timer, TIMER_FREQUENCY_HZ / rate_hz, true);
+        timerAlarmEnable(m_timer);
+#endif // ESP_ARDUINO_VERSION_MAJOR >= 3
+        return true;
+#elif defined(__linux__)
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = &On_Signal;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(SIGPROF, &action, nullptr) != 0) {
+            s_running = nullptr;
+            return false;
+        }
+        struct itimerval interval;
+        interval.it_interval.tv_sec = 0;
+        interval.it_interval.tv_usec = static_cast<suseconds_t>(1000000U / rate_hz);
+        interval.it_value = interval.it_interval;
+        if (setitimer(ITIMER_PROF, &interval, nullptr) != 0) {
+            s_running = nullptr;
+            return false;
+        }
+        return true;
+#else
+        s_running = nullptr;
+        return false;
+#endif // defined(ESP32) && defined(__XTENSA__)
+    }
+
+    /// @brief Stops sampling, afterwards the histogram can be read
+    void Stop() {
+        if (s_running != this) {
+            return;
+        }
+#if defined(ESP32) && defined(__XTENSA__)
+        timerEnd(m_timer);
+        m_timer = nullptr;
+#elif defined(__linux__)
+        struct itimerval interval;
+        memset(&interval, 0, sizeof(interval));
+        setitimer(ITIMER_PROF, &interval, nullptr);
+        signal(SIGPROF, SIG_IGN);
+#endif // defined(ESP32) && defined(__XTENSA__)
+        s_running = nullptr;
+    }
+
+    /// @brief Whether this profiler is currently sampling
+    /// @return Whether it is running
+    bool Is_Running() const {
+        return s_running == this;
+    }
+
+    /// @brief Recorded samples, may only be read or changed while the profiler is stopped
+    /// @return Histogram
+    Histogram & Get_Histogram() {
+        return m_histogram;
+    }
+
+  private:
+#if defined(ESP32) && defined(__XTENSA__)
+    static uint32_t constexpr TIMER_FREQUENCY_HZ = 1000000U;
+    static uint8_t constexpr TIMER_NUMBER = 1U;
+
+    static void ARDUINO_ISR_ATTR On_Timer() {
+        Sampling_Profiler * const profiler = s_running;
+        if (profiler == nullptr) {
+            return;
+        }
+        // The dispatcher already counted this interrupt, so the nesting is 1 if it interrupted a task. Only then it saved the interrupted context into the task,
+        // xPortInterruptedFromISRContext() would be true for every sample. A sample interrupting another interrupt handler is recorded as 0, which counts as dropped
+        if (port_interruptNesting[xPortGetCoreID()] > 1U) {
+            profiler->m_histogram.Record(0U);
+            return;
+        }
+        // The top of stack is the first member of the task control block, the handle points to it
+        XtExcFrame const * const frame = *reinterpret_cast<XtExcFrame const * const *>(xTaskGetCurrentTaskHandle());
+        profiler->m_histogram.Record(static_cast<uintptr_t>(frame->pc));
+    }
+
+    hw_timer_t * m_timer = nullptr; // Timer generating the sampling interrupt
+#elif defined(__linux__)
+    static void On_Signal(int, siginfo_t *, void * context) {
+        ucontext_t const * const user_context = static_cast<ucontext_t const *>(context);
+#if defined(__x86_64__)
+        uintptr_t const pc = static_cast<uintptr_t>(user_context->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__aarch64__)
+        uintptr_t const pc = static_cast<uintptr_t>(user_context->uc_mcontext.pc);
+#else
+        uintptr_t const pc = 0U;
+        (void)user_context;
+#endif // defined(__x86_64__)
+        Sampling_Profiler * const profiler = s_running;
+        if (profiler != nullptr) {
+            profiler->m_histogram.Record(pc);
+        }
+    }
+#endif // defined(ESP32) && defined(__XTENSA__)
+
+    static Sampling_Profiler * volatile s_running; // Profiler the interrupt records into, only one timer or signal is used
+
+    Histogram m_histogram = {}; // Recorded samples
+};
+
+template<typename Histogram>
+Sampling_Profiler<Histogram> * volatile Sampling_Profiler<Histogram>::s_running = nullptr;
+
+#endif // Sampling_Profiler_h
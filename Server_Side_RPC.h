@@ -4,6 +4,8 @@
 // Local includes.
 #include "RPC_Callback.h"
 #include "IAPI_Implementation.h"
+#include "RPC_Response_Cache.h"
+#include "Log_Level.h"
 
 
 // Server side RPC topics.
@@ -15,26 +17,31 @@ char constexpr RPC_RESPONSE_OVERFLOWED[] = "Server-side RPC response overflowed,
 #if !THINGSBOARD_ENABLE_DYNAMIC
 char constexpr SERVER_SIDE_RPC_SUBSCRIPTIONS[] = "server-side RPC";
 #endif // !THINGSBOARD_ENABLE_DYNAMIC
-#if THINGSBOARD_ENABLE_DEBUG
+char constexpr RPC_RESPONSE_CACHED[] = "Server-side RPC request with id (%u) was already handled, sending cached response";
+char constexpr RPC_RESPONSE_NOT_CACHED[] = "Server-side RPC request with id (%u) was already handled, but its response did not fit into the cache, increase MaxCachedResponseSize (%u)";
 char constexpr SERVER_RPC_METHOD_NULL[] = "Server-side RPC method name is NULL";
 char constexpr RPC_RESPONSE_NULL[] = "Response JsonDocument is NULL, skipping sending";
 char constexpr NO_RPC_PARAMS_PASSED[] = "No parameters passed with RPC, passing null JSON";
 char constexpr CALLING_RPC_CB[] = "Calling subscribed callback for rpc with methodname (%s)";
-#endif // THINGSBOARD_ENABLE_DEBUG
 
 
 /// @brief Handles the internal implementation of the ThingsBoard server side RPC API.
 /// See https://thingsboard.io/docs/user-guide/rpc/#server-side-rpc for more information
-/// @tparam Logger Implementation that should be used to print error messages generated by internal processes and additional debugging messages if THINGSBOARD_ENABLE_DEBUG is set, default = DefaultLogger
+/// @tparam Logger Implementation that should be used to print error messages generated by internal processes and additional debugging messages if THINGSBOARD_ENABLE_DEBUG is set,
+/// wrap it in a Log_Policy to choose the level of the Log_Category::RPC messages at compile time instead, default = DefaultLogger
+/// @tparam MaxCachedResponses Maximum amount of serialized responses remembered by request id, requests that are received again (redelivered by the broker or retried by the server)
+/// are answered from the cache instead of calling the subscribed callback again, default = Default_Cached_Responses_Amount (0, cache disabled)
+/// @tparam MaxCachedResponseSize Maximum size of one cached serialized response including the null terminator. Requests with bigger responses are only remembered as handled,
+/// a duplicate is then neither executed again nor answered, default = Default_Cached_Response_Size (64)
 #if THINGSBOARD_ENABLE_DYNAMIC
-template <typename Logger = DefaultLogger>
+template <typename Logger = DefaultLogger, size_t MaxCachedResponses = Default_Cached_Responses_Amount, size_t MaxCachedResponseSize = Default_Cached_Response_Size>
 #else
 /// @tparam MaxSubscriptions Maximum amount of simultaneous server side rpc subscriptions.
 /// Once the maximum amount has been reached it is not possible to increase the size, this is done because it allows to allcoate the memory on the stack instead of the heap, default = Default_Subscriptions_Amount (1)
 /// @tparam MaxRPC Maximum amount of key-value pairs that will ever be sent in the subscribed callback method of an RPC_Callback, allows to use a StaticJsonDocument on the stack in the background.
 /// If we simply use .to<JsonVariant>(); on the received document and use .set() to change the internal value then the size requirements are 0.
 /// However if we attempt to send multiple key-value pairs, we have to adjust the size accordingly. See https://arduinojson.org/v6/assistant/ for more information on how to estimate the required size and divide the result by 16 to receive the required MaxRPC value, default = Default_RPC_Amount (0)
-template<size_t MaxSubscriptions = Default_Subscriptions_Amount, size_t MaxRPC = Default_RPC_Amount, typename Logger = DefaultLogger>
+template<size_t MaxSubscriptions = Default_Subscriptions_Amount, size_t MaxRPC = Default_RPC_Amount, typename Logger = DefaultLogger, size_t MaxCachedResponses = Default_Cached_Responses_Amount, size_t MaxCachedResponseSize = Default_Cached_Response_Size>
 #endif // THINGSBOARD_ENABLE_DYNAMIC
 class Server_Side_RPC : public IAPI_Implementation {
   public:
@@ -60,7 +67,7 @@ class Server_Side_RPC : public IAPI_Implementation {
 #if !THINGSBOARD_ENABLE_DYNAMIC
         size_t const size = Helper::distance(first, last);
         if (m_rpc_callbacks.size() + size > m_rpc_callbacks.capacity()) {
-            Logger::printfln(MAX_SUBSCRIPTIONS_EXCEEDED, MAX_SUBSCRIPTIONS_TEMPLATE_NAME, SERVER_SIDE_RPC_SUBSCRIPTIONS);
+            Log<Log_Level::ERROR>::printfln(MAX_SUBSCRIPTIONS_EXCEEDED, MAX_SUBSCRIPTIONS_TEMPLATE_NAME, SERVER_SIDE_RPC_SUBSCRIPTIONS);
             return false;
         }
 #endif // !THINGSBOARD_ENABLE_DYNAMIC
@@ -83,7 +90,7 @@ class Server_Side_RPC : public IAPI_Implementation {
     bool RPC_Subscribe(RPC_Callback const & callback) {
 #if !THINGSBOARD_ENABLE_DYNAMIC
         if (m_rpc_callbacks.size() + 1 > m_rpc_callbacks.capacity()) {
-            Logger::printfln(MAX_SUBSCRIPTIONS_EXCEEDED, MAX_SUBSCRIPTIONS_TEMPLATE_NAME, SERVER_SIDE_RPC_SUBSCRIPTIONS);
+            Log<Log_Level::ERROR>::printfln(MAX_SUBSCRIPTIONS_EXCEEDED, MAX_SUBSCRIPTIONS_TEMPLATE_NAME, SERVER_SIDE_RPC_SUBSCRIPTIONS);
             return false;
         }
 #endif // !THINGSBOARD_ENABLE_DYNAMIC
@@ -101,6 +108,26 @@ class Server_Side_RPC : public IAPI_Implementation {
         return m_unsubscribe_topic_callback.Call_Callback(RPC_SUBSCRIBE_TOPIC);
     }
 
+    /// @brief Amount of received requests that were already handled before and therefore answered from the response cache,
+    /// without calling the subscribed callback again
+    /// @return Amount of response cache hits
+    uint32_t const & Get_Cache_Hits() const {
+        return m_response_cache.Get_Hits();
+    }
+
+    /// @brief Amount of received requests that were not found in the response cache and therefore called the subscribed callback
+    /// @return Amount of response cache misses
+    uint32_t const & Get_Cache_Misses() const {
+        return m_response_cache.Get_Misses();
+    }
+
+    /// @brief Amount of received requests that were handled, by calling the subscribed callback or answering from the response cache,
+    /// counted whether the response cache is enabled or not
+    /// @return Amount of handled requests
+    uint32_t const & Get_Handled() const {
+        return m_handled;
+    }
+
     API_Process_Type Get_Process_Type() const override {
         return API_Process_Type::JSON;
     }
@@ -111,12 +138,29 @@ class Server_Side_RPC : public IAPI_Implementation {
 
     void Process_Json_Response(char const * topic, JsonDocument const & data) override {
         if (!data.containsKey(RPC_METHOD_KEY)) {
-#if THINGSBOARD_ENABLE_DEBUG
-            Logger::println(SERVER_RPC_METHOD_NULL);
-#endif // THINGSBOARD_ENABLE_DEBUG
+            Log<Log_Level::WARNING>::println(SERVER_RPC_METHOD_NULL);
             return;
         }
         char const * method_name = data[RPC_METHOD_KEY];
+        size_t const request_id = Helper::parseRequestId(RPC_REQUEST_TOPIC, topic);
+        char responseTopic[Helper::detectSize(RPC_SEND_RESPONSE_TOPIC, request_id)] = {};
+        (void)snprintf(responseTopic, sizeof(responseTopic), RPC_SEND_RESPONSE_TOPIC, request_id);
+
+        char const * cached_response = nullptr;
+        if (MaxCachedResponses > 0U && m_response_cache.Find(request_id, method_name, cached_response)) {
+            // The callback is not executed again either way, for actuator commands a missing answer is better than applying the change twice
+            if (cached_response == nullptr) {
+                Log<Log_Level::WARNING>::printfln(RPC_RESPONSE_NOT_CACHED, request_id, MaxCachedResponseSize);
+                return;
+            }
+            Log<Log_Level::INFO>::printfln(RPC_RESPONSE_CACHED, request_id);
+            m_handled++;
+            // Empty response means the callback did not respond the first time either
+            if (!Helper::stringIsNullorEmpty(cached_response)) {
+                (void)m_send_json_string_callback.Call_Callback(responseTopic, cached_response);
+            }
+            return;
+        }
 
 #if THINGSBOARD_ENABLE_STL
         auto it = std::find_if(m_rpc_callbacks.begin(), m_rpc_callbacks.end(), [&method_name](RPC_Callback const & rpc) {
@@ -132,15 +176,10 @@ class Server_Side_RPC : public IAPI_Implementation {
               continue;
             }
 #endif // THINGSBOARD_ENABLE_STL
-#if THINGSBOARD_ENABLE_DEBUG
-            if (!data.containsKey(RPC_PARAMS_KEY)) {
-                Logger::println(NO_RPC_PARAMS_PASSED);
+            if (Log<Log_Level::DEBUG>::ENABLED && !data.containsKey(RPC_PARAMS_KEY)) {
+                Log<Log_Level::DEBUG>::println(NO_RPC_PARAMS_PASSED);
             }
-#endif // THINGSBOARD_ENABLE_DEBUG
-
-#if THINGSBOARD_ENABLE_DEBUG
-            Logger::printfln(CALLING_RPC_CB, method_name);
-#endif // THINGSBOARD_ENABLE_DEBUG
+            Log<Log_Level::DEBUG>::printfln(CALLING_RPC_CB, method_name);
 
             JsonVariantConst const param = data[RPC_PARAMS_KEY];
 #if THINGSBOARD_ENABLE_DYNAMIC
@@ -150,23 +189,38 @@ class Server_Side_RPC : public IAPI_Implementation {
             size_t constexpr rpc_response_size = MaxRPC;
             StaticJsonDocument<JSON_OBJECT_SIZE(MaxRPC)> json_buffer;
 #endif // THINGSBOARD_ENABLE_DYNAMIC
+            m_handled++;
             rpc.Call_Callback(param, json_buffer);
 
             if (json_buffer.isNull()) {
-#if THINGSBOARD_ENABLE_DEBUG
-                Logger::println(RPC_RESPONSE_NULL);
-#endif // THINGSBOARD_ENABLE_DEBUG
+                Log<Log_Level::DEBUG>::println(RPC_RESPONSE_NULL);
+                if (MaxCachedResponses > 0U) {
+                    (void)m_response_cache.Store(request_id, method_name, "", 0U);
+                }
                 return;
             }
             else if (json_buffer.overflowed()) {
-                Logger::printfln(RPC_RESPONSE_OVERFLOWED, rpc_response_size);
+                Log<Log_Level::ERROR>::printfln(RPC_RESPONSE_OVERFLOWED, rpc_response_size);
+                if (MaxCachedResponses > 0U) {
+                    m_response_cache.Store_Handled(request_id, method_name);
+                }
                 return;
             }
 
-            size_t const request_id = Helper::parseRequestId(RPC_REQUEST_TOPIC, topic);
-            char responseTopic[Helper::detectSize(RPC_SEND_RESPONSE_TOPIC, request_id)] = {};
-            (void)snprintf(responseTopic, sizeof(responseTopic), RPC_SEND_RESPONSE_TOPIC, request_id);
-            (void)m_send_json_callback.Call_Callback(responseTopic, json_buffer, Helper::Measure_Json(json_buffer));
+            size_t const json_size = Helper::Measure_Json(json_buffer);
+            // Responses that fit into the cache are serialized only once, directly into the cache, and then sent as a string,
+            // bigger responses are sent directly and the request is only remembered as handled
+            if (MaxCachedResponses > 0U && json_size < MaxCachedResponseSize) {
+                char response[MaxCachedResponseSize] = {};
+                size_t const length = serializeJson(json_buffer, response, sizeof(response));
+                (void)m_response_cache.Store(request_id, method_name, response, length);
+                (void)m_send_json_string_callback.Call_Callback(responseTopic, response);
+                return;
+            }
+            else if (MaxCachedResponses > 0U) {
+                m_response_cache.Store_Handled(request_id, method_name);
+            }
+            (void)m_send_json_callback.Call_Callback(responseTopic, json_buffer, json_size);
             return;
         }
     }
@@ -180,8 +234,10 @@ class Server_Side_RPC : public IAPI_Implementation {
     }
 
     bool Resubscribe_Topic() override {
+        // Request ids restart with a new session, cached responses of the previous one could otherwise answer unrelated requests
+        m_response_cache.Clear();
         if (!m_rpc_callbacks.empty() && !m_subscribe_topic_callback.Call_Callback(RPC_SUBSCRIBE_TOPIC)) {
-            Logger::printfln(SUBSCRIBE_TOPIC_FAILED, RPC_SUBSCRIBE_TOPIC);
+            Log<Log_Level::ERROR>::printfln(SUBSCRIBE_TOPIC_FAILED, RPC_SUBSCRIBE_TOPIC);
             return false;
         }
         return true;
@@ -199,12 +255,18 @@ class Server_Side_RPC : public IAPI_Implementation {
 
     void Set_Client_Callbacks(Callback<void, IAPI_Implementation &>::function subscribe_api_callback, Callback<bool, char const * const, JsonDocument const &, size_t const &>::function send_json_callback, Callback<bool, char const * const, char const * const>::function send_json_string_callback, Callback<bool, char const * const>::function subscribe_topic_callback, Callback<bool, char const * const>::function unsubscribe_topic_callback, Callback<uint16_t>::function get_size_callback, Callback<bool, uint16_t>::function set_buffer_size_callback, Callback<size_t *>::function get_request_id_callback) override {
         m_send_json_callback.Set_Callback(send_json_callback);
+        m_send_json_string_callback.Set_Callback(send_json_string_callback);
         m_subscribe_topic_callback.Set_Callback(subscribe_topic_callback);
         m_unsubscribe_topic_callback.Set_Callback(unsubscribe_topic_callback);
     }
 
   private:
+    // Messages of the given level, removed at compile time if the level is disabled for the Logger
+    template<Log_Level Level>
+    using Log = Log_Site<Log_Category::RPC, Level, Logger>;
+
     Callback<bool, char const * const, JsonDocument const &, size_t const &> m_send_json_callback = {};         // Send json document callback
+    Callback<bool, char const * const, char const * const>                   m_send_json_string_callback = {};  // Send json string callback
     Callback<bool, char const * const>                                       m_subscribe_topic_callback = {};   // Subscribe mqtt topic client callback
     Callback<bool, char const * const>                                       m_unsubscribe_topic_callback = {}; // Unubscribe mqtt topic client callback
 
@@ -221,6 +283,8 @@ class Server_Side_RPC : public IAPI_Implementation {
 #else
     Array<RPC_Callback, MaxSubscriptions>                                    m_rpc_callbacks = {};              // Server side RPC callbacks array
 #endif // THINGSBOARD_ENABLE_DYNAMIC
+    RPC_Response_Cache<MaxCachedResponses, MaxCachedResponseSize>            m_response_cache = {};             // Recently sent responses by request id, to answer duplicated requests
+    uint32_t                                                                 m_handled = 0U;                    // Requests answered by a callback or from the response cache
 };
 
 #endif // Server_Side_RPC_h
\ No newline at end of file
@@ -0,0 +1,110 @@
+#ifndef Standby_Client_h
+#define Standby_Client_h
+
+// Local includes.
+#include "Broker_Failover.h"
+
+// Library includes.
+#include <Arduino.h>
+#include <Client.h>
+
+
+/// @brief Arduino Client decorator between the MQTT client and two sockets, that keeps the second socket connected to the standby broker (see Warm_Standby).
+/// Connecting to the host and port the standby socket is already connected to takes that socket over without connecting again, which makes the MQTT client,
+/// that always opens a new connection in connect(), use the warm standby connection. Every other call is passed to the active socket
+/// @tparam Socket Type of the underlying sockets, e.g. WiFiClient
+template<typename Socket>
+class Standby_Client : public Client {
+  public:
+    /// @brief Constructor
+    /// @param first Socket used by the MQTT connection initially
+    /// @param second Socket used as the standby initially
+    Standby_Client(Socket & first, Socket & second)
+      : m_standby(first, second)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Keeps the standby socket connected to the given broker, blocks for at most the given timeout while it has to be connected again
+    /// @param broker Standby broker
+    /// @param timeout_ms Time connecting may block, a broker that did not accept the connection within it counts as unreachable
+    /// @return Whether the standby socket is connected to the broker
+    bool Warm(Broker_Endpoint const & broker, int32_t const & timeout_ms) {
+        return m_standby.Warm(broker, timeout_ms);
+    }
+
+    /// @brief Socket currently used by the MQTT connection, e.g. to wait for received data on it
+    /// @return Active socket
+    Socket & Get_Active() {
+        return m_standby.Get_Active();
+    }
+
+    int connect(IPAddress ip, uint16_t port) override {
+        return Get_Active().connect(ip, port);
+    }
+
+    int connect(char const * host, uint16_t port) override {
+        if (m_standby.Adopt(host, port)) {
+            return 1;
+        }
+        return Get_Active().connect(host, port);
+    }
+
+#if defined(ESP32)
+    int connect(IPAddress ip, uint16_t port, int32_t timeout) override {
+        return Get_Active().connect(ip, port, timeout);
+    }
+
+    int connect(char const * host, uint16_t port, int32_t timeout) override {
+        if (m_standby.Adopt(host, port)) {
+            return 1;
+        }
+        return Get_Active().connect(host, port, timeout);
+    }
+#endif // defined(ESP32)
+
+    size_t write(uint8_t byte) override {
+        return Get_Active().write(byte);
+    }
+
+    size_t write(uint8_t const * buffer, size_t size) override {
+        return Get_Active().write(buffer, size);
+    }
+
+    int available() override {
+        return Get_Active().available();
+    }
+
+    int read() override {
+        return Get_Active().read();
+    }
+
+    int read(uint8_t * buffer, size_t size) override {
+        return Get_Active().read(buffer, size);
+    }
+
+    int peek() override {
+        return Get_Active().peek();
+    }
+
+    void flush() override {
+        Get_Active().flush();
+    }
+
+    void stop() override {
+        Get_Active().stop();
+    }
+
+    uint8_t connected() override {
+        return Get_Active().connected();
+    }
+
+    operator bool() override {
+        return connected() != 0U;
+    }
+
+  private:
+    Warm_Standby<Socket> m_standby; // Active and standby socket
+};
+
+#endif // Standby_Client_h
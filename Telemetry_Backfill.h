@@ -0,0 +1,204 @@
+#ifndef Telemetry_Backfill_h
+#define Telemetry_Backfill_h
+
+// Local includes.
+#include "Json_Writer.h"
+#include "Lzss.h"
+
+// Library includes.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/// @brief Counters of the telemetry recorded while the connection was down
+struct Backfill_Statistics {
+    uint32_t records = 0U;          // Records that were recorded
+    uint32_t dropped_records = 0U;  // Records that were discarded, because the memory was full or a single record did not fit into a block
+    uint32_t raw_bytes = 0U;        // Size of the sealed records before compression
+    uint32_t compressed_bytes = 0U; // Size of the sealed records after compression
+};
+
+
+/// @brief Keeps telemetry that could not be sent while the connection was down, to upload it after reconnecting (backfill).
+/// Records are appended to a staging block as newline separated JSON objects {"t":<millis>,"values":{...}}, because the same keys repeat in every record
+/// full blocks are compressed (see Lzss.h), which keeps several times more history in the same memory and reduces the upload by the same factor.
+/// Compressed blocks are kept in a fixed size arena from oldest to newest, once it is full the oldest blocks are discarded.
+/// Every block is sized to be uploaded as a single message, the receiver decompresses it and converts t into a timestamp with the device time at the upload (see tools/telemetry_decode.cpp)
+/// @tparam ArenaSize Memory for the compressed blocks in bytes, default = 16384
+/// @tparam BlockSize Size of the staging block before compression in bytes, larger blocks compress better, default = 2048
+/// @tparam MaxCompressedBlock Largest compressed block in bytes, blocks that compress worse are split, default = 512
+/// @tparam Encoder Compressor of the blocks, default = Lzss_Encoder<>
+template<size_t ArenaSize = 16384U, size_t BlockSize = 2048U, size_t MaxCompressedBlock = 512U, typename Encoder = Lzss_Encoder<>>
+class Telemetry_Backfill {
+    // Every block in the arena is prefixed with its compressed length and its amount of records, 16 bit each
+    static size_t constexpr BLOCK_HEADER_SIZE = 4U;
+
+    static_assert(MaxCompressedBlock + BLOCK_HEADER_SIZE <= ArenaSize, "Arena has to fit at least one block");
+    static_assert(MaxCompressedBlock <= UINT16_MAX, "Block length is stored as 16 bit");
+
+  public:
+    /// @brief Appends one telemetry record to the staging block, seals the block first if the record does not fit anymore
+    /// @param time_ms Device time the values were measured at
+    /// @param values Serialized JSON object with the telemetry values
+    /// @param length Length of the serialized values in bytes
+    /// @return Whether the record was kept, false if a single record is larger than a block
+    bool Record(uint32_t const & time_ms, char const * values, size_t const & length) {
+        m_statistics.records++;
+        if (!Append(time_ms, values, length)) {
+            Seal();
+            if (!Append(time_ms, values, length)) {
+                m_statistics.dropped_records++;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Compresses the records of the staging block into the arena, has to be called before uploading, so that the newest records are included
+    void Seal() {
+        while (m_staging_length > 0U) {
+            size_t end = m_staging_length;
+            size_t compressed = 0U;
+            while (end > 0U) {
+                compressed = m_encoder.Compress(m_staging, end, m_scratch, MaxCompressedBlock);
+                if (compressed > 0U) {
+                    break;
+                }
+                // Did not compress enough to fit into one block, retry with the records in the first half, at least the first record on its own
+                size_t const half = Record_Boundary_Before(end / 2U);
+                size_t const first = Record_End(0U);
+                end = half > 0U ? half : (first < end ? first : 0U);
+            }
+            if (end == 0U) {
+                // A single record that can not be compressed into one block, discard it
+                end = Record_End(0U);
+                m_statistics.dropped_records++;
+            }
+            else {
+                Store(m_scratch, compressed, Count_Records(end));
+                m_statistics.raw_bytes += end;
+                m_statistics.compressed_bytes += compressed;
+            }
+            memmove(m_staging, m_staging + end, m_staging_length - end);
+            m_staging_length -= end;
+        }
+    }
+
+    /// @brief Whether there are sealed blocks waiting to be uploaded
+    /// @return Whether the arena contains a block
+    bool Has_Block() const {
+        return m_arena_length > 0U;
+    }
+
+    /// @brief Whether there are records that were not uploaded yet, sealed or still staged
+    /// @return Whether anything is pending
+    bool Has_Pending() const {
+        return m_arena_length > 0U || m_staging_length > 0U;
+    }
+
+    /// @brief Oldest sealed block, stays in the arena until Pop() is called, which allows retrying a failed upload
+    /// @param data Receives the start of the compressed block
+    /// @return Size of the compressed block or 0 if there is none
+    size_t Front(uint8_t const * & data) const {
+        if (m_arena_length == 0U) {
+            return 0U;
+        }
+        data = m_arena + BLOCK_HEADER_SIZE;
+        return Block_Length(0U);
+    }
+
+    /// @brief Removes the oldest sealed block, after it was uploaded successfully
+    void Pop() {
+        if (m_arena_length > 0U) {
+            Discard_Oldest();
+        }
+    }
+
+    /// @brief Counters of the recorded telemetry
+    /// @return Statistics
+    Backfill_Statistics const & Get_Statistics() const {
+        return m_statistics;
+    }
+
+  private:
+    bool Append(uint32_t const & time_ms, char const * values, size_t const & length) {
+        // Json_Writer always terminates, the terminator is overwritten by the record separator
+        size_t const free = BlockSize - m_staging_length;
+        Json_Writer writer(reinterpret_cast<char *>(m_staging + m_staging_length), free);
+        writer.Begin_Object();
+        writer.Add("t", time_ms);
+        writer.Key("values");
+        writer.Raw_Value(values, length);
+        writer.End_Object();
+        if (writer.Overflowed() || writer.Length() + 1U >= free) {
+            return false;
+        }
+        m_staging[m_staging_length + writer.Length()] = '\n';
+        m_staging_length += writer.Length() + 1U;
+        return true;
+    }
+
+    /// @brief End of the last complete record that ends at or before the given offset, 0 if there is none
+    size_t Record_Boundary_Before(size_t const & offset) const {
+        for (size_t i = offset; i > 0U; i--) {
+            if (m_staging[i - 1U] == '\n') {
+                return i;
+            }
+        }
+        return 0U;
+    }
+
+    /// @brief End of the record starting at the given offset
+    size_t Record_End(size_t const & offset) const {
+        for (size_t i = offset; i < m_staging_length; i++) {
+            if (m_staging[i] == '\n') {
+                return i + 1U;
+            }
+        }
+        return m_staging_length;
+    }
+
+    uint16_t Count_Records(size_t const & end) const {
+        uint16_t count = 0U;
+        for (size_t i = 0U; i < end; i++) {
+            count += m_staging[i] == '\n';
+        }
+        return count;
+    }
+
+    size_t Block_Length(size_t const & offset) const {
+        return static_cast<size_t>(m_arena[offset]) | (static_cast<size_t>(m_arena[offset + 1U]) << 8U);
+    }
+
+    void Discard_Oldest() {
+        size_t const block = BLOCK_HEADER_SIZE + Block_Length(0U);
+        memmove(m_arena, m_arena + block, m_arena_length - block);
+        m_arena_length -= block;
+    }
+
+    void Store(uint8_t const * data, size_t const & length, uint16_t const & records) {
+        while (m_arena_length + BLOCK_HEADER_SIZE + length > ArenaSize) {
+            // Keep the newest history, the oldest block is the least valuable one
+            m_statistics.dropped_records += static_cast<uint32_t>(m_arena[2U]) | (static_cast<uint32_t>(m_arena[3U]) << 8U);
+            Discard_Oldest();
+        }
+        uint8_t * block = m_arena + m_arena_length;
+        block[0U] = static_cast<uint8_t>(length);
+        block[1U] = static_cast<uint8_t>(length >> 8U);
+        block[2U] = static_cast<uint8_t>(records);
+        block[3U] = static_cast<uint8_t>(records >> 8U);
+        memcpy(block + BLOCK_HEADER_SIZE, data, length);
+        m_arena_length += BLOCK_HEADER_SIZE + length;
+    }
+
+    Encoder             m_encoder;                         // Compressor of the staging block
+    uint8_t             m_staging[BlockSize] = {};         // Records that were not compressed yet
+    size_t              m_staging_length = 0U;             // Bytes used in the staging block
+    uint8_t             m_scratch[MaxCompressedBlock] = {}; // Output of the compressor
+    uint8_t             m_arena[ArenaSize] = {};           // Compressed blocks, oldest first
+    size_t              m_arena_length = 0U;               // Bytes used in the arena
+    Backfill_Statistics m_statistics = {};                 // Counters of the recorded telemetry
+};
+
+#endif // Telemetry_Backfill_h
@@ -0,0 +1,264 @@
+#ifndef Temperature_MPC_h
+#define Temperature_MPC_h
+
+// Local includes.
+#include "Thermal_Model.h"
+
+// Library includes.
+#include <math.h>
+#include <stddef.h>
+
+
+/// @brief Tuning of the model predictive temperature controller
+struct MPC_Settings {
+    float tick_seconds = 1.0f;              // Interval Update() is called at
+    float prediction_step_seconds = 30.0f;  // Length of one step of the prediction horizon, longer than the tick to cover the thermal lag with a short horizon
+    float tracking_weight = 1.0f;           // Penalty on the squared deviation of the predicted medium temperature from the setpoint
+    float move_weight = 0.05f;              // Penalty on the squared change of the heater duty cycle between steps
+    float state_gain = 0.5f;                // Observer gain correcting the estimated medium temperature with the measurement
+    float disturbance_gain = 0.0001f;       // Observer gain of the integrating disturbance, removes steady state errors caused by model mismatch
+};
+
+
+/// @brief Model predictive controller for the medium temperature of the jacketed vessel, computes the heater duty cycle (0 to 1).
+/// Every tick it solves the box constrained quadratic program
+///     min 1/2 * U' * H * U + f' * U    subject to 0 <= U <= 1
+/// over Horizon future heater moves. The problem is condensed, the predicted temperatures are eliminated through the model,
+/// so H only depends on the model and the weights and is computed once in Configure(), every tick only the linear term f is rebuilt from the current state.
+/// It is solved with an accelerated projected gradient method with a fixed iteration limit, the momentum coefficients and the step size are precomputed as well,
+/// which bounds the solve time by Iterations * (Horizon^2 + 4 * Horizon) multiply-adds, without any heap allocation, matrix factorization or square root at runtime.
+/// The jacket temperature is not measured, it is estimated with an observer, which also estimates a constant disturbance (offset free tracking)
+/// @tparam Horizon Amount of prediction steps and heater moves optimized every tick
+/// @tparam Iterations Maximum amount of projected gradient iterations per tick
+template<size_t Horizon, size_t Iterations = 60U>
+class Temperature_MPC {
+  public:
+    /// @brief Upper bound of the floating point multiply-adds of one Update(), used to check the solve time budget of the target
+    static size_t constexpr OPERATIONS_PER_SOLVE = Iterations * (Horizon * Horizon + 4U * Horizon) + 4U * Horizon;
+
+    /// @brief Constructor
+    /// @param model Model of the vessel, only its parameters are used
+    /// @param settings Tuning of the controller
+    explicit Temperature_MPC(Thermal_Model const & model = Thermal_Model(), MPC_Settings const & settings = MPC_Settings()) {
+        Configure(model, settings);
+    }
+
+    /// @brief Precomputes the prediction, the Hessian, the step size and the momentum coefficients, expensive compared to Update()
+    /// and therefore only called when the model or the tuning changes. Resets the estimated state
+    /// @param model Model of the vessel, only its parameters are used
+    /// @param settings Tuning of the controller
+    void Configure(Thermal_Model const & model, MPC_Settings const & settings) {
+        m_settings = settings;
+        m_tick = model.Discretize(settings.tick_seconds);
+        m_step = model.Discretize(settings.prediction_step_seconds);
+
+        // Markov parameters, effect of a heater move on the predicted medium temperature 1 to Horizon steps later
+        float markov[Horizon] = {};
+        float a_power_b[2U] = { m_step.b[0U], m_step.b[1U] };
+        for (size_t k = 0U; k < Horizon; k++) {
+            markov[k] = a_power_b[1U];
+            float const next[2U] = {
+                m_step.a[0U][0U] * a_power_b[0U] + m_step.a[0U][1U] * a_power_b[1U],
+                m_step.a[1U][0U] * a_power_b[0U] + m_step.a[1U][1U] * a_power_b[1U]
+            };
+            a_power_b[0U] = next[0U];
+            a_power_b[1U] = next[1U];
+        }
+        // Prediction matrix G is lower triangular Toeplitz, G[k][j] = markov[k - j]
+        for (size_t k = 0U; k < Horizon; k++) {
+            for (size_t j = 0U; j < Horizon; j++) {
+                m_prediction[k][j] = (j <= k) ? markov[k - j] : 0.0f;
+            }
+        }
+
+        // H = q * G' * G + r * D' * D, with D the difference operator of the moves, the first move is relative to the previously applied one
+        for (size_t row = 0U; row < Horizon; row++) {
+            for (size_t column = 0U; column < Horizon; column++) {
+                float sum = 0.0f;
+                for (size_t k = 0U; k < Horizon; k++) {
+                    sum += m_prediction[k][row] * m_prediction[k][column];
+                }
+                float difference = 0.0f;
+                if (row == column) {
+                    difference = (row + 1U < Horizon) ? 2.0f : 1.0f;
+                }
+                else if (row == column + 1U || column == row + 1U) {
+                    difference = -1.0f;
+                }
+                m_hessian[row][column] = settings.tracking_weight * sum + settings.move_weight * difference;
+            }
+        }
+
+        // Gershgorin bound of the largest eigenvalue, the gradient step 1 / L is guaranteed to converge
+        float lipschitz = 0.0f;
+        for (size_t row = 0U; row < Horizon; row++) {
+            float sum = 0.0f;
+            for (size_t column = 0U; column < Horizon; column++) {
+                sum += fabsf(m_hessian[row][column]);
+            }
+            lipschitz = sum > lipschitz ? sum : lipschitz;
+        }
+        m_inverse_lipschitz = lipschitz > 0.0f ? 1.0f / lipschitz : 0.0f;
+
+        // Nesterov momentum coefficients (t_k - 1) / t_k+1 only depend on the iteration
+        float t = 1.0f;
+        for (size_t i = 0U; i < Iterations; i++) {
+            float const t_next = 0.5f * (1.0f + sqrtf(1.0f + 4.0f * t * t));
+            m_momentum[i] = (t - 1.0f) / t_next;
+            t = t_next;
+        }
+
+        Reset();
+    }
+
+    /// @brief Forgets the estimated state, the next Update() initializes it from the measurement
+    void Reset() {
+        m_initialized = false;
+        m_disturbance = 0.0f;
+        m_applied = 0.0f;
+        m_step_elapsed_seconds = 0.0f;
+        m_iterations = 0U;
+        for (size_t i = 0U; i < Horizon; i++) {
+            m_moves[i] = 0.0f;
+        }
+    }
+
+    /// @brief Corrects the estimated state with the measurement, solves the quadratic program and returns the first move.
+    /// Has to be called every tick_seconds
+    /// @param measured_c Measured medium temperature
+    /// @param setpoint_c Desired medium temperature over the complete horizon
+    /// @return Heater duty cycle between 0 and 1
+    float Update(float const & measured_c, float const & setpoint_c) {
+        if (!m_initialized) {
+            // Jacket starts at the medium temperature, the observer corrects it within a few jacket time constants
+            m_state[0U] = measured_c;
+            m_state[1U] = measured_c;
+            m_initialized = true;
+        }
+        else {
+            float const error = measured_c - m_state[1U];
+            m_state[1U] += m_settings.state_gain * error;
+            m_state[0U] += m_settings.state_gain * error;
+            m_disturbance += m_settings.disturbance_gain * error / m_settings.tick_seconds;
+        }
+
+        // Free response of the model without any heater moves, the disturbance is a constant rate of change of the medium temperature
+        float free[Horizon] = {};
+        float x[2U] = { m_state[0U], m_state[1U] };
+        float const disturbance_step = m_disturbance * m_settings.prediction_step_seconds;
+        for (size_t k = 0U; k < Horizon; k++) {
+            float const jacket = m_step.a[0U][0U] * x[0U] + m_step.a[0U][1U] * x[1U] + m_step.d[0U];
+            float const vessel = m_step.a[1U][0U] * x[0U] + m_step.a[1U][1U] * x[1U] + m_step.d[1U] + disturbance_step;
+            x[0U] = jacket;
+            x[1U] = vessel;
+            free[k] = vessel - setpoint_c;
+        }
+        // f = q * G' * (free response - setpoint) - r * e0 * previously applied move
+        float linear[Horizon] = {};
+        for (size_t j = 0U; j < Horizon; j++) {
+            float sum = 0.0f;
+            for (size_t k = j; k < Horizon; k++) {
+                sum += m_prediction[k][j] * free[k];
+            }
+            linear[j] = m_settings.tracking_weight * sum;
+        }
+        linear[0U] -= m_settings.move_weight * m_applied;
+
+        // The horizon moves by one prediction step only once that much time passed, until then the previous solution is still aligned with it
+        m_step_elapsed_seconds += m_settings.tick_seconds;
+        bool const shift = m_step_elapsed_seconds >= m_settings.prediction_step_seconds;
+        if (shift) {
+            m_step_elapsed_seconds -= m_settings.prediction_step_seconds;
+        }
+        Solve(linear, shift);
+
+        m_applied = m_moves[0U];
+        // Predict the state at the next tick with the applied move
+        float const jacket = m_tick.a[0U][0U] * m_state[0U] + m_tick.a[0U][1U] * m_state[1U] + m_tick.b[0U] * m_applied + m_tick.d[0U];
+        float const vessel = m_tick.a[1U][0U] * m_state[0U] + m_tick.a[1U][1U] * m_state[1U] + m_tick.b[1U] * m_applied + m_tick.d[1U] + m_disturbance * m_settings.tick_seconds;
+        m_state[0U] = jacket;
+        m_state[1U] = vessel;
+        return m_applied;
+    }
+
+    /// @brief Projected gradient iterations used by the last Update(), less than Iterations if the solution converged early
+    /// @return Amount of iterations
+    size_t const & Get_Iterations() const {
+        return m_iterations;
+    }
+
+    /// @brief Estimated jacket temperature, which is not measured
+    /// @return Jacket temperature in degrees celsius
+    float const & Get_Estimated_Jacket_Temperature() const {
+        return m_state[0U];
+    }
+
+    /// @brief Estimated disturbance, heat the model does not explain, as a rate of change of the medium temperature
+    /// @return Disturbance in degrees celsius per second
+    float const & Get_Estimated_Disturbance() const {
+        return m_disturbance;
+    }
+
+  private:
+    // Largest change of any move, below which the solution is considered converged
+    static constexpr float CONVERGENCE_TOLERANCE = 1e-4f;
+
+    /// @brief Accelerated projected gradient (FISTA) on the box 0 <= U <= 1, warm started from the previous solution
+    /// @param linear Linear term of the quadratic program
+    /// @param shift Whether a full prediction step passed since the previous solution, which is then shifted by one step to stay aligned with the horizon
+    void Solve(float const (&linear)[Horizon], bool const & shift) {
+        if (shift) {
+            // The last move is repeated
+            for (size_t i = 0U; i + 1U < Horizon; i++) {
+                m_moves[i] = m_moves[i + 1U];
+            }
+        }
+        float extrapolated[Horizon] = {};
+        for (size_t i = 0U; i < Horizon; i++) {
+            extrapolated[i] = m_moves[i];
+        }
+
+        m_iterations = 0U;
+        for (size_t iteration = 0U; iteration < Iterations; iteration++) {
+            m_iterations++;
+            float largest_change = 0.0f;
+            float next[Horizon] = {};
+            for (size_t row = 0U; row < Horizon; row++) {
+                float gradient = linear[row];
+                for (size_t column = 0U; column < Horizon; column++) {
+                    gradient += m_hessian[row][column] * extrapolated[column];
+                }
+                float value = extrapolated[row] - m_inverse_lipschitz * gradient;
+                value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+                next[row] = value;
+            }
+            float const momentum = m_momentum[iteration];
+            for (size_t i = 0U; i < Horizon; i++) {
+                float const change = next[i] - m_moves[i];
+                largest_change = fabsf(change) > largest_change ? fabsf(change) : largest_change;
+                extrapolated[i] = next[i] + momentum * change;
+                m_moves[i] = next[i];
+            }
+            if (largest_change < CONVERGENCE_TOLERANCE) {
+                break;
+            }
+        }
+    }
+
+    MPC_Settings              m_settings = {};                      // Tuning of the controller
+    Thermal_Model::Discrete   m_tick = {};                          // Model discretized for one tick, used by the observer
+    Thermal_Model::Discrete   m_step = {};                          // Model discretized for one prediction step
+    float                     m_prediction[Horizon][Horizon] = {};  // Effect of the moves on the predicted medium temperatures
+    float                     m_hessian[Horizon][Horizon] = {};     // Constant Hessian of the condensed quadratic program
+    float                     m_momentum[Iterations] = {};          // Precomputed Nesterov momentum coefficients
+    float                     m_inverse_lipschitz = 0.0f;           // Gradient step size
+    float                     m_moves[Horizon] = {};                // Solution of the last tick, warm start of the next one
+    float                     m_state[2U] = {};                     // Estimated jacket and medium temperature
+    float                     m_disturbance = 0.0f;                 // Estimated unmodelled rate of change of the medium temperature
+    float                     m_applied = 0.0f;                     // Move applied in the last tick
+    float                     m_step_elapsed_seconds = 0.0f;        // Time passed since the warm start was last shifted by a prediction step
+    size_t                    m_iterations = 0U;                    // Iterations used by the last solve
+    bool                      m_initialized = false;                // Whether the state has been initialized from a measurement
+};
+
+#endif // Temperature_MPC_h
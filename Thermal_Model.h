@@ -0,0 +1,134 @@
+#ifndef Thermal_Model_h
+#define Thermal_Model_h
+
+// Library includes.
+#include <stddef.h>
+
+
+/// @brief Physical parameters of a jacketed vessel, the heater warms the jacket, which warms the medium with a long lag.
+/// Defaults describe a 5 l glass vessel with a 500 W heating jacket
+struct Thermal_Parameters {
+    float heater_power_w = 500.0f;                   // Heating power at full duty cycle
+    float jacket_capacity_j_per_k = 4000.0f;         // Heat capacity of the jacket and its fluid
+    float vessel_capacity_j_per_k = 21000.0f;        // Heat capacity of the medium and the vessel wall
+    float jacket_vessel_conductance_w_per_k = 30.0f; // Heat transfer from the jacket into the medium
+    float jacket_ambient_conductance_w_per_k = 2.0f; // Losses of the jacket to the surroundings
+    float vessel_ambient_conductance_w_per_k = 3.0f; // Losses of the medium to the surroundings (lid, headspace, gassing)
+    float ambient_c = 22.0f;                         // Temperature of the surroundings
+};
+
+
+/// @brief Two state linear thermal model of the jacketed vessel, x = [jacket temperature, medium temperature], input u = heater duty cycle (0 to 1).
+///     C_j * dT_j/dt = P * u - k_jv * (T_j - T_v) - k_ja * (T_j - T_a)
+///     C_v * dT_v/dt = k_jv * (T_j - T_v) - k_va * (T_v - T_a)
+/// Used to simulate the plant on the host and as the prediction model of the model predictive controller on the device
+class Thermal_Model {
+  public:
+    /// @brief Discrete time form x[k+1] = A * x[k] + B * u[k] + D of the model for a fixed step
+    struct Discrete {
+        float a[2U][2U]; // State transition
+        float b[2U];     // Input gain
+        float d[2U];     // Constant ambient contribution
+    };
+
+    /// @brief Constructor, both temperatures start at the ambient temperature
+    /// @param parameters Physical parameters of the vessel
+    explicit Thermal_Model(Thermal_Parameters const & parameters = Thermal_Parameters())
+      : m_parameters(parameters)
+      , m_jacket_c(parameters.ambient_c)
+      , m_vessel_c(parameters.ambient_c)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Overwrites the current state
+    /// @param jacket_c Temperature of the jacket
+    /// @param vessel_c Temperature of the medium
+    void Set_State(float const & jacket_c, float const & vessel_c) {
+        m_jacket_c = jacket_c;
+        m_vessel_c = vessel_c;
+    }
+
+    /// @brief Advances the simulation, integrated with sub steps well below the fastest time constant of the jacket,
+    /// so large steps stay stable and accurate
+    /// @param heater Heater duty cycle, clamped to 0 to 1
+    /// @param dt_seconds Simulated time to advance
+    /// @param disturbance_w Additional heat flow into the medium the controller does not know about, for example the heat of an exothermic culture, default = 0
+    void Step(float heater, float const & dt_seconds, float const & disturbance_w = 0.0f) {
+        heater = heater < 0.0f ? 0.0f : (heater > 1.0f ? 1.0f : heater);
+        size_t const sub_steps = static_cast<size_t>(dt_seconds / MAX_SUB_STEP_SECONDS) + 1U;
+        float const h = dt_seconds / static_cast<float>(sub_steps);
+        for (size_t i = 0U; i < sub_steps; i++) {
+            float jacket_rate = 0.0f;
+            float vessel_rate = 0.0f;
+            Derivative(m_jacket_c, m_vessel_c, heater, jacket_rate, vessel_rate);
+            m_jacket_c += h * jacket_rate;
+            m_vessel_c += h * (vessel_rate + disturbance_w / m_parameters.vessel_capacity_j_per_k);
+        }
+    }
+
+    /// @brief Discretizes the model for the given step, with the same sub stepping as Step(), so the prediction matches the simulation
+    /// @param dt_seconds Length of one discrete step
+    /// @return Discrete time matrices
+    Discrete Discretize(float const & dt_seconds) const {
+        size_t const sub_steps = static_cast<size_t>(dt_seconds / MAX_SUB_STEP_SECONDS) + 1U;
+        float const h = dt_seconds / static_cast<float>(sub_steps);
+        Thermal_Parameters const & p = m_parameters;
+        // Euler sub step x = S * x + s_u * u + s_d, composed sub_steps times
+        float const s[2U][2U] = {
+            { 1.0f - h * (p.jacket_vessel_conductance_w_per_k + p.jacket_ambient_conductance_w_per_k) / p.jacket_capacity_j_per_k, h * p.jacket_vessel_conductance_w_per_k / p.jacket_capacity_j_per_k },
+            { h * p.jacket_vessel_conductance_w_per_k / p.vessel_capacity_j_per_k, 1.0f - h * (p.jacket_vessel_conductance_w_per_k + p.vessel_ambient_conductance_w_per_k) / p.vessel_capacity_j_per_k }
+        };
+        float const s_u[2U] = { h * p.heater_power_w / p.jacket_capacity_j_per_k, 0.0f };
+        float const s_d[2U] = { h * p.jacket_ambient_conductance_w_per_k * p.ambient_c / p.jacket_capacity_j_per_k, h * p.vessel_ambient_conductance_w_per_k * p.ambient_c / p.vessel_capacity_j_per_k };
+
+        Discrete result = { { { 1.0f, 0.0f }, { 0.0f, 1.0f } }, { 0.0f, 0.0f }, { 0.0f, 0.0f } };
+        for (size_t i = 0U; i < sub_steps; i++) {
+            Discrete next = {};
+            for (size_t row = 0U; row < 2U; row++) {
+                for (size_t column = 0U; column < 2U; column++) {
+                    next.a[row][column] = s[row][0U] * result.a[0U][column] + s[row][1U] * result.a[1U][column];
+                }
+                next.b[row] = s[row][0U] * result.b[0U] + s[row][1U] * result.b[1U] + s_u[row];
+                next.d[row] = s[row][0U] * result.d[0U] + s[row][1U] * result.d[1U] + s_d[row];
+            }
+            result = next;
+        }
+        return result;
+    }
+
+    /// @brief Temperature of the jacket
+    /// @return Jacket temperature in degrees celsius
+    float const & Get_Jacket_Temperature() const {
+        return m_jacket_c;
+    }
+
+    /// @brief Temperature of the medium, the measured and controlled variable
+    /// @return Medium temperature in degrees celsius
+    float const & Get_Vessel_Temperature() const {
+        return m_vessel_c;
+    }
+
+    /// @brief Physical parameters of the model
+    /// @return Parameters
+    Thermal_Parameters const & Get_Parameters() const {
+        return m_parameters;
+    }
+
+  private:
+    // Well below the jacket time constant C_j / (k_jv + k_ja) of the default parameters
+    static constexpr float MAX_SUB_STEP_SECONDS = 5.0f;
+
+    void Derivative(float const & jacket_c, float const & vessel_c, float const & heater, float & jacket_rate, float & vessel_rate) const {
+        Thermal_Parameters const & p = m_parameters;
+        float const transfer = p.jacket_vessel_conductance_w_per_k * (jacket_c - vessel_c);
+        jacket_rate = (p.heater_power_w * heater - transfer - p.jacket_ambient_conductance_w_per_k * (jacket_c - p.ambient_c)) / p.jacket_capacity_j_per_k;
+        vessel_rate = (transfer - p.vessel_ambient_conductance_w_per_k * (vessel_c - p.ambient_c)) / p.vessel_capacity_j_per_k;
+    }
+
+    Thermal_Parameters m_parameters = {}; // Physical parameters
+    float              m_jacket_c = 0.0f; // Current jacket temperature
+    float              m_vessel_c = 0.0f; // Current medium temperature
+};
+
+#endif // Thermal_Model_h
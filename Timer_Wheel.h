@@ -0,0 +1,228 @@
+#ifndef Timer_Wheel_h
+#define Timer_Wheel_h
+
+// Library includes.
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// @brief Hierarchical timer wheel, shared service all APIs and the device logic register their deadlines with,
+/// instead of every API polling all of its outstanding requests in every loop iteration.
+/// Consists of TIMER_WHEEL_LEVELS wheels with TIMER_WHEEL_SLOTS slots each, every level covers TIMER_WHEEL_SLOTS times the range of the level below it.
+/// Starting and stopping a timer is O(1), advancing the time only visits the slot of every passed tick, timers on the higher levels
+/// are cascaded down once, when their range is reached. Advancing is therefore O(expired timers) instead of O(armed timers).
+/// Timers are intrusive and owned by whoever registers them, the wheel itself never allocates memory.
+/// Deadlines are rounded up to the next tick, a timer never fires early, but up to one tick late
+class Timer_Wheel {
+  public:
+    /// @brief Timer that can be registered with the wheel. Has to stay valid and must not be moved while it is armed
+    struct Timer {
+        using function = void (*)(void * context);
+
+        /// @brief Constructor
+        /// @param callback Method called once the timer expired, is allowed to restart the timer
+        /// @param context Passed to the callback, allows to use the same callback for multiple timers
+        Timer(function callback = nullptr, void * context = nullptr)
+          : callback(callback)
+          , context(context)
+        {
+            // Nothing to do
+        }
+
+        /// @brief Whether the timer is currently registered and waiting to expire
+        /// @return Whether the timer is armed
+        bool Is_Armed() const {
+            return armed;
+        }
+
+        function callback = nullptr; // Called once the timer expired
+        void *   context = nullptr;  // Passed to the callback
+        uint32_t expiry_tick = 0U;   // Tick the timer expires at
+        Timer *  previous = nullptr; // Previous timer in the same slot
+        Timer *  next = nullptr;     // Next timer in the same slot
+        uint8_t  level = 0U;         // Wheel level the timer is linked into
+        uint8_t  slot = 0U;          // Slot on that level the timer is linked into
+        bool     armed = false;      // Whether the timer is linked into a slot
+    };
+
+    /// @brief Constructor
+    /// @param tick_milliseconds Resolution of the wheel in milliseconds, default = 10
+    explicit Timer_Wheel(uint32_t const & tick_milliseconds = 10U)
+      : m_tick_milliseconds(tick_milliseconds > 0U ? tick_milliseconds : 1U)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Arms the timer to expire after the given delay, if it is already armed it is restarted with the new delay.
+    /// Timers started before the first call to Advance() count their delay from that first call, so a long setup does not expire them immediately
+    /// @param timer Timer that should be armed
+    /// @param delay_milliseconds Time from now after which the timer expires
+    void Start(Timer & timer, uint32_t const & delay_milliseconds) {
+        Stop(timer);
+        // Round up, a timer must never expire before its deadline
+        uint32_t ticks = (delay_milliseconds + m_tick_milliseconds - 1U) / m_tick_milliseconds;
+        if (ticks == 0U) {
+            ticks = 1U;
+        }
+        timer.expiry_tick = m_current_tick + ticks;
+        Insert(timer);
+        m_armed++;
+    }
+
+    /// @brief Disarms the timer, does nothing if it is not armed
+    /// @param timer Timer that should be disarmed
+    void Stop(Timer & timer) {
+        if (!timer.armed) {
+            return;
+        }
+        Unlink(timer);
+        m_armed--;
+    }
+
+    /// @brief Advances the wheel to the given time and calls the callback of every timer that expired in the meantime.
+    /// Has to be called regularly, at least once per tick to keep the timers accurate, calling it less often only delays the callbacks
+    /// @param now_milliseconds Current time in milliseconds, is allowed to wrap around
+    void Advance(uint32_t const & now_milliseconds) {
+        if (!m_synchronized) {
+            // The wheel starts at the first advance, the time before it (e.g. the boot) did not pass for the armed timers
+            m_last_tick_milliseconds = now_milliseconds;
+            m_synchronized = true;
+            return;
+        }
+        uint32_t const elapsed_ticks = (now_milliseconds - m_last_tick_milliseconds) / m_tick_milliseconds;
+        m_last_tick_milliseconds += elapsed_ticks * m_tick_milliseconds;
+        if (m_armed == 0U) {
+            // Nothing can expire, skip the passed ticks instead of visiting every empty slot
+            m_current_tick += elapsed_ticks;
+            return;
+        }
+        for (uint32_t tick = 0U; tick < elapsed_ticks; tick++) {
+            Process_Tick();
+        }
+    }
+
+    /// @brief Time until the next timer expires, used to decide for how long the device can block without missing a deadline.
+    /// Exact if the next timer is on the lowest level, otherwise the time until the lowest level wraps around,
+    /// which is guaranteed to be before the next timer expires
+    /// @param now_milliseconds Current time in milliseconds
+    /// @return Milliseconds until the next timer expires or UINT32_MAX if no timer is armed
+    uint32_t Milliseconds_Until_Next(uint32_t const & now_milliseconds) const {
+        if (m_armed == 0U) {
+            return UINT32_MAX;
+        }
+        uint32_t ticks = 1U;
+        for (; ticks <= TIMER_WHEEL_SLOTS; ticks++) {
+            if (m_wheels[0U][(m_current_tick + ticks) & TIMER_WHEEL_SLOT_MASK] != nullptr) {
+                break;
+            }
+        }
+        if (ticks > TIMER_WHEEL_SLOTS) {
+            ticks = TIMER_WHEEL_SLOTS - (m_current_tick & TIMER_WHEEL_SLOT_MASK);
+        }
+        uint32_t const deadline = (m_synchronized ? m_last_tick_milliseconds : now_milliseconds) + ticks * m_tick_milliseconds;
+        uint32_t const remaining = deadline - now_milliseconds;
+        // Deadline already passed, but the wheel has not been advanced yet
+        return (remaining > ticks * m_tick_milliseconds) ? 0U : remaining;
+    }
+
+    /// @brief Amount of currently armed timers
+    /// @return Amount of armed timers
+    size_t const & Get_Armed() const {
+        return m_armed;
+    }
+
+  private:
+    static size_t constexpr TIMER_WHEEL_LEVELS = 4U;
+    static size_t constexpr TIMER_WHEEL_SLOT_BITS = 6U;
+    static size_t constexpr TIMER_WHEEL_SLOTS = 1U << TIMER_WHEEL_SLOT_BITS;
+    static size_t constexpr TIMER_WHEEL_SLOT_MASK = TIMER_WHEEL_SLOTS - 1U;
+    // Largest delay in ticks the highest level can hold, timers further away are cascaded multiple times
+    static uint32_t constexpr TIMER_WHEEL_MAX_TICKS = (1UL << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1U;
+
+    /// @brief Links the timer into the slot of the lowest level whose range covers its expiry
+    void Insert(Timer & timer) {
+        uint32_t delta = timer.expiry_tick - m_current_tick;
+        // Timers further away than the highest level can hold are parked in its furthest slot and cascaded again once it is reached
+        if (delta > TIMER_WHEEL_MAX_TICKS) {
+            delta = TIMER_WHEEL_MAX_TICKS;
+        }
+        uint32_t const clamped_expiry = m_current_tick + delta;
+        size_t level = 0U;
+        while (level + 1U < TIMER_WHEEL_LEVELS && delta >= (1UL << (TIMER_WHEEL_SLOT_BITS * (level + 1U)))) {
+            level++;
+        }
+        size_t const slot = (clamped_expiry >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+        Timer * & head = m_wheels[level][slot];
+        timer.previous = nullptr;
+        timer.next = head;
+        if (head != nullptr) {
+            head->previous = &timer;
+        }
+        head = &timer;
+        timer.level = static_cast<uint8_t>(level);
+        timer.slot = static_cast<uint8_t>(slot);
+        timer.armed = true;
+    }
+
+    void Unlink(Timer & timer) {
+        if (timer.previous != nullptr) {
+            timer.previous->next = timer.next;
+        }
+        else {
+            m_wheels[timer.level][timer.slot] = timer.next;
+        }
+        if (timer.next != nullptr) {
+            timer.next->previous = timer.previous;
+        }
+        timer.previous = nullptr;
+        timer.next = nullptr;
+        timer.armed = false;
+    }
+
+    /// @brief Moves to the next tick, cascades the timers of the higher levels whose range has been reached and expires the due timers of the lowest level
+    void Process_Tick() {
+        m_current_tick++;
+        if ((m_current_tick & TIMER_WHEEL_SLOT_MASK) == 0U) {
+            for (size_t level = 1U; level < TIMER_WHEEL_LEVELS; level++) {
+                size_t const slot = (m_current_tick >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+                Cascade(level, slot);
+                // Higher levels only need to be cascaded once the current one wrapped around as well
+                if (slot != 0U) {
+                    break;
+                }
+            }
+        }
+
+        // Expire the due timers one at a time from the live slot, a callback is allowed to stop or restart any timer, including one due in the same tick.
+        // A restarted timer is at least one tick away and therefore never linked back into this slot
+        Timer * & head = m_wheels[0U][m_current_tick & TIMER_WHEEL_SLOT_MASK];
+        Timer * timer = nullptr;
+        while ((timer = head) != nullptr) {
+            Unlink(*timer);
+            m_armed--;
+            if (timer->callback != nullptr) {
+                timer->callback(timer->context);
+            }
+        }
+    }
+
+    /// @brief Reinserts all timers of the given slot, which moves them to a lower level now that their expiry is closer
+    void Cascade(size_t const & level, size_t const & slot) {
+        Timer * timer = m_wheels[level][slot];
+        m_wheels[level][slot] = nullptr;
+        while (timer != nullptr) {
+            Timer * const next = timer->next;
+            Insert(*timer);
+            timer = next;
+        }
+    }
+
+    uint32_t m_tick_milliseconds = 10U;                                 // Resolution of the wheel
+    uint32_t m_current_tick = 0U;                                       // Tick that was processed last
+    uint32_t m_last_tick_milliseconds = 0U;                             // Time the last processed tick started at
+    bool     m_synchronized = false;                                    // Whether m_last_tick_milliseconds was taken from the first advance
+    size_t   m_armed = 0U;                                              // Amount of armed timers
+    Timer *  m_wheels[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS] = {};      // First timer of every slot on every level
+};
+
+#endif // Timer_Wheel_h
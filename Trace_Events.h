@@ -0,0 +1,81 @@
+#ifndef Trace_Events_h
+#define Trace_Events_h
+
+// Library includes.
+#include <stdint.h>
+
+
+/// @brief Events the bioreactor firmware records into its Trace_Log, shared with the host decoder (see tools/trace_decode.cpp).
+/// Ids are sent in the binary records, existing ones may therefore never be renumbered, new events are only appended
+enum class Trace_Event : uint16_t {
+    LED_MODE_RPC = 1U,
+    BLINKING_INTERVAL_SET = 2U,
+    LED_STATE_SET = 3U,
+    LED_TOGGLED = 4U,
+    CONNECT_ATTEMPT = 5U,
+    CONNECT_FAILED = 6U,
+    CONNECTED = 7U,
+    ATTRIBUTE_REQUEST_FAILED = 8U,
+    ATTRIBUTE_REQUEST_TIMEOUT = 9U,
+    CONTROL_TICK = 10U,
+    TELEMETRY_SENT = 11U,
+    LINK_DEGRADED = 12U,
+    LINK_RECOVERED = 13U,
+    LINK_RECONNECT = 14U,
+    BROKER_SWITCH = 15U,
+    HEATER_CUTOFF = 16U
+};
+
+
+/// @brief Name of an event and of its arguments, unused arguments are nullptr
+struct Trace_Event_Info {
+    char const * name;
+    char const * first;
+    char const * second;
+};
+
+
+/// @brief Converts the given event id into its name and the names of its arguments
+/// @param event Id of the event
+/// @return Names of the event and its arguments, the name is nullptr for unknown events
+inline Trace_Event_Info Get_Trace_Event_Info(uint16_t const & event) {
+    switch (static_cast<Trace_Event>(event)) {
+        case Trace_Event::LED_MODE_RPC:
+            return { "led mode rpc", "mode", nullptr };
+        case Trace_Event::BLINKING_INTERVAL_SET:
+            return { "blinking interval set", "interval_ms", nullptr };
+        case Trace_Event::LED_STATE_SET:
+            return { "led state set", "state", nullptr };
+        case Trace_Event::LED_TOGGLED:
+            return { "led toggled", "state", nullptr };
+        case Trace_Event::CONNECT_ATTEMPT:
+            return { "connect attempt", "retry_delay_ms", nullptr };
+        case Trace_Event::CONNECT_FAILED:
+            return { "connect failed", "duration_us", nullptr };
+        case Trace_Event::CONNECTED:
+            return { "connected", "duration_us", nullptr };
+        case Trace_Event::ATTRIBUTE_REQUEST_FAILED:
+            return { "attribute request failed", "client", nullptr };
+        case Trace_Event::ATTRIBUTE_REQUEST_TIMEOUT:
+            return { "attribute request timeout", "timeout_ms", nullptr };
+        case Trace_Event::CONTROL_TICK:
+            return { "control tick", "heater_permille", "solve_us" };
+        case Trace_Event::TELEMETRY_SENT:
+            return { "telemetry sent", "bytes", "success" };
+        case Trace_Event::LINK_DEGRADED:
+            return { "link degraded", "score", "rtt_ms" };
+        case Trace_Event::LINK_RECOVERED:
+            return { "link recovered", "score", "rtt_ms" };
+        case Trace_Event::LINK_RECONNECT:
+            return { "link reconnect", "lost_probes", "rssi_dbm" };
+        case Trace_Event::BROKER_SWITCH:
+            return { "broker switch", "broker", "fallback" };
+        case Trace_Event::HEATER_CUTOFF:
+            return { "heater cutoff", "reason", "value" };
+        default:
+            break;
+    }
+    return { nullptr, nullptr, nullptr };
+}
+
+#endif // Trace_Events_h
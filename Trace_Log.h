@@ -0,0 +1,161 @@
+#ifndef Trace_Log_h
+#define Trace_Log_h
+
+// Library includes.
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// @brief Event recorded into the Trace_Log, the meaning of the event id and its arguments is defined by the application (see Trace_Events.h)
+struct Trace_Record {
+    uint32_t time_us = 0U;       // Time the event happened at in microseconds, wraps around after ~71 minutes
+    uint16_t event = 0U;         // Id of the event
+    uint16_t sequence = 0U;      // Incremented for every traced event, including dropped ones, gaps show the receiver how many records were lost
+    int32_t  arguments[2U] = {}; // Event specific arguments
+};
+
+
+/// @brief Lock free ring of binary trace records, replaces formatted logging on the hot path.
+/// Tracing an event only copies a few integers, formatting them into text and sending that over a slow serial port is left to the host (see tools/trace_decode.cpp),
+/// so the diagnostics no longer block loop() or disturb the timing of the control loop. One producer and one consumer may use the ring at the same time,
+/// for example events traced from an interrupt and drained from loop(). If the ring is full new events are dropped, the older ones are kept
+/// @tparam Capacity Amount of records the ring can hold, has to be a power of two, default = 128
+template<size_t Capacity = 128U>
+class Trace_Log {
+    static_assert(Capacity > 0U && (Capacity & (Capacity - 1U)) == 0U, "Capacity has to be a power of two");
+
+  public:
+    /// @brief Every drained record is framed with the sync bytes and followed by a checksum, allows the receiver to find records in a stream that contains other text as well
+    static uint8_t constexpr SYNC_FIRST = 0xA5U;
+    static uint8_t constexpr SYNC_SECOND = 0x5AU;
+    static size_t constexpr RECORD_SIZE = 16U;
+    static size_t constexpr FRAME_SIZE = 2U + RECORD_SIZE + 1U;
+
+    /// @brief Records an event, only the producer may call this
+    /// @param time_us Current time in microseconds
+    /// @param event Id of the event
+    /// @param first First event specific argument, default = 0
+    /// @param second Second event specific argument, default = 0
+    /// @return Whether the event was recorded, false if the ring was full
+    bool Trace(uint32_t const & time_us, uint16_t const & event, int32_t const & first = 0, int32_t const & second = 0) {
+        uint16_t const sequence = m_sequence++;
+        uint32_t const head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) >= Capacity) {
+            m_dropped.fetch_add(1U, std::memory_order_relaxed);
+            return false;
+        }
+        Trace_Record & record = m_records[head & (Capacity - 1U)];
+        record.time_us = time_us;
+        record.event = event;
+        record.sequence = sequence;
+        record.arguments[0U] = first;
+        record.arguments[1U] = second;
+        m_head.store(head + 1U, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief Removes the oldest record, only the consumer may call this
+    /// @param record Record the oldest one is copied into
+    /// @return Whether there was a record
+    bool Pop(Trace_Record & record) {
+        uint32_t const tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        record = m_records[tail & (Capacity - 1U)];
+        m_tail.store(tail + 1U, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief Writes the oldest records as binary frames, only the consumer may call this.
+    /// The amount of records should be limited to what the output can take without blocking, e.g. Serial.availableForWrite() / FRAME_SIZE
+    /// @tparam Output Anything with write(const uint8_t *, size_t), e.g. the Arduino Print class
+    /// @param output Output the frames are written to
+    /// @param max_records Maximum amount of records to write
+    /// @return Amount of written records
+    template<typename Output>
+    size_t Drain(Output & output, size_t const & max_records) {
+        size_t written = 0U;
+        Trace_Record record;
+        while (written < max_records && Pop(record)) {
+            uint8_t frame[FRAME_SIZE];
+            Serialize(record, frame);
+            output.write(frame, sizeof(frame));
+            written++;
+        }
+        return written;
+    }
+
+    /// @brief Serializes the record into a frame, all values are little endian
+    /// @param record Record to serialize
+    /// @param frame Frame of FRAME_SIZE bytes the record is written into
+    static void Serialize(Trace_Record const & record, uint8_t (&frame)[FRAME_SIZE]) {
+        frame[0U] = SYNC_FIRST;
+        frame[1U] = SYNC_SECOND;
+        uint8_t * data = frame + 2U;
+        Write_Little_Endian(data, record.time_us, 4U);
+        Write_Little_Endian(data + 4U, record.event, 2U);
+        Write_Little_Endian(data + 6U, record.sequence, 2U);
+        Write_Little_Endian(data + 8U, static_cast<uint32_t>(record.arguments[0U]), 4U);
+        Write_Little_Endian(data + 12U, static_cast<uint32_t>(record.arguments[1U]), 4U);
+        frame[FRAME_SIZE - 1U] = Checksum(data);
+    }
+
+    /// @brief Deserializes the record from the bytes following the sync bytes of a frame
+    /// @param data RECORD_SIZE bytes of the record followed by the checksum
+    /// @param record Record the frame is read into
+    /// @return Whether the checksum matched
+    static bool Deserialize(uint8_t const * data, Trace_Record & record) {
+        if (Checksum(data) != data[RECORD_SIZE]) {
+            return false;
+        }
+        record.time_us = Read_Little_Endian(data, 4U);
+        record.event = static_cast<uint16_t>(Read_Little_Endian(data + 4U, 2U));
+        record.sequence = static_cast<uint16_t>(Read_Little_Endian(data + 6U, 2U));
+        record.arguments[0U] = static_cast<int32_t>(Read_Little_Endian(data + 8U, 4U));
+        record.arguments[1U] = static_cast<int32_t>(Read_Little_Endian(data + 12U, 4U));
+        return true;
+    }
+
+    /// @brief Amount of events that were dropped, because the ring was full
+    /// @return Amount of dropped events
+    uint32_t Get_Dropped() const {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+  private:
+    static void Write_Little_Endian(uint8_t * data, uint32_t value, size_t const & size) {
+        for (size_t i = 0U; i < size; i++) {
+            data[i] = static_cast<uint8_t>(value);
+            value >>= 8U;
+        }
+    }
+
+    static uint32_t Read_Little_Endian(uint8_t const * data, size_t const & size) {
+        uint32_t value = 0U;
+        for (size_t i = size; i > 0U; i--) {
+            value = (value << 8U) | data[i - 1U];
+        }
+        return value;
+    }
+
+    // Fletcher-8 style checksum, detects swapped and corrupted bytes, unlike a plain sum
+    static uint8_t Checksum(uint8_t const * data) {
+        uint8_t sum = 0U;
+        uint8_t weighted = 0U;
+        for (size_t i = 0U; i < RECORD_SIZE; i++) {
+            sum += data[i];
+            weighted += sum;
+        }
+        return weighted;
+    }
+
+    Trace_Record          m_records[Capacity] = {}; // Ring of the recorded events
+    std::atomic<uint32_t> m_head = {0U};            // Amount of records ever written, only changed by the producer
+    std::atomic<uint32_t> m_tail = {0U};            // Amount of records ever read, only changed by the consumer
+    std::atomic<uint32_t> m_dropped = {0U};         // Events dropped because the ring was full
+    uint16_t              m_sequence = 0U;          // Sequence number of the next event
+};
+
+#endif // Trace_Log_h
@@ -0,0 +1,139 @@
+#ifndef Typed_RPC_Callback_h
+#define Typed_RPC_Callback_h
+
+// Local includes.
+#include "RPC_Callback.h"
+
+
+// Typed RPC response keys.
+char constexpr RPC_ERROR_KEY[] = "error";
+// Typed RPC error messages.
+char constexpr RPC_PARAMETER_INVALID_TYPE[] = "Invalid parameter type";
+char constexpr RPC_PARAMETER_OUT_OF_RANGE[] = "Parameter out of range";
+
+
+/// @brief Compile-time description of one integral or boolean RPC parameter, including the inclusive range of accepted values.
+/// Used as one of the Parameters of RPC_Binding, which generates the decoding and validation code for it
+/// @tparam T Type the parameter is decoded into and passed to the handler as
+/// @tparam Min Smallest accepted value
+/// @tparam Max Largest accepted value
+/// @tparam Key Key of the parameter in the received params object, nullptr if the params themselves are the single value, default = nullptr
+template<typename T, T Min, T Max, char const * Key = nullptr>
+struct RPC_Parameter {
+    static_assert(Min <= Max, "Minimum of the RPC parameter has to be smaller or equal to its maximum");
+    using value_type = T;
+
+    /// @brief Decodes and validates the parameter from the received params
+    /// @param params Params of the received RPC request
+    /// @param value Decoded value, only valid if the method returned nullptr
+    /// @return nullptr on success, otherwise the error message that should be sent back to the server
+    static char const * Decode(JsonVariantConst const & params, T & value) {
+        JsonVariantConst const variant = (Key == nullptr) ? params : params[Key];
+        if (!variant.is<T>()) {
+            return RPC_PARAMETER_INVALID_TYPE;
+        }
+        value = variant.as<T>();
+        if (value < Min || value > Max) {
+            return RPC_PARAMETER_OUT_OF_RANGE;
+        }
+        return nullptr;
+    }
+};
+
+/// @brief Compile-time description of one floating point RPC parameter, including the inclusive range of accepted values.
+/// Floating point values can not be used as non-type template arguments, therefore the range is given in thousandths instead
+/// @tparam Min_Milli Smallest accepted value multiplied by 1000
+/// @tparam Max_Milli Largest accepted value multiplied by 1000
+/// @tparam Key Key of the parameter in the received params object, nullptr if the params themselves are the single value, default = nullptr
+template<long Min_Milli, long Max_Milli, char const * Key = nullptr>
+struct RPC_Float_Parameter {
+    static_assert(Min_Milli <= Max_Milli, "Minimum of the RPC parameter has to be smaller or equal to its maximum");
+    using value_type = float;
+
+    /// @brief Decodes and validates the parameter from the received params, integer values are accepted as well
+    /// @param params Params of the received RPC request
+    /// @param value Decoded value, only valid if the method returned nullptr
+    /// @return nullptr on success, otherwise the error message that should be sent back to the server
+    static char const * Decode(JsonVariantConst const & params, float & value) {
+        JsonVariantConst const variant = (Key == nullptr) ? params : params[Key];
+        if (!variant.is<float>()) {
+            return RPC_PARAMETER_INVALID_TYPE;
+        }
+        value = variant.as<float>();
+        if (value < Min_Milli / 1000.0f || value > Max_Milli / 1000.0f) {
+            return RPC_PARAMETER_OUT_OF_RANGE;
+        }
+        return nullptr;
+    }
+};
+
+
+/// @brief Generates the glue between a plain typed handler function and the RPC_Callback interface used by Server_Side_RPC.
+/// Decoding, validation against the ranges declared at compile time and encoding of the result are all generated from the template arguments,
+/// which removes the hand-written conversion and error response code from every method and makes adding new methods a single line.
+/// If any parameter is invalid the handler is not called and {"error": "<reason>"} is sent back instead.
+/// Example usage: RPC_Callback{ "setLedMode", RPC_Binding<NEW_MODE_KEY, int, RPC_Parameter<int, 0, 1>>::Process<setLedMode> }
+/// @tparam Result_Key Key the value returned by the handler is sent back as
+/// @tparam Result Type returned by the handler, void if no response should be sent
+/// @tparam Parameters RPC_Parameter or RPC_Float_Parameter descriptions, in the same order as the arguments of the handler
+template<char const * Result_Key, typename Result, typename... Parameters>
+class RPC_Binding {
+  public:
+    using handler_type = Result (*)(typename Parameters::value_type...);
+
+    /// @brief Method that can be passed to RPC_Callback, decodes the parameters, calls the handler and encodes its result
+    /// @tparam Handler Typed handler function, that should be called with the decoded parameters
+    /// @param data Params of the received RPC request
+    /// @param response Document the result or the error message is written into
+    template<handler_type Handler>
+    static void Process(JsonVariantConst const & data, JsonDocument & response) {
+        Decoder<Handler, Parameters...>::Decode(data, response);
+    }
+
+  private:
+    /// @brief Decodes the first remaining parameter and appends it to the already decoded values,
+    /// recursion ends once all parameters have been decoded and the handler can be called
+    template<handler_type Handler, typename... Remaining>
+    struct Decoder;
+
+    template<handler_type Handler, typename First, typename... Rest>
+    struct Decoder<Handler, First, Rest...> {
+        template<typename... Values>
+        static void Decode(JsonVariantConst const & data, JsonDocument & response, Values const &... values) {
+            typename First::value_type value = {};
+            char const * const error = First::Decode(data, value);
+            if (error != nullptr) {
+                response[RPC_ERROR_KEY] = error;
+                return;
+            }
+            Decoder<Handler, Rest...>::Decode(data, response, values..., value);
+        }
+    };
+
+    template<handler_type Handler>
+    struct Decoder<Handler> {
+        template<typename... Values>
+        static void Decode(JsonVariantConst const &, JsonDocument & response, Values const &... values) {
+            Encoder<Result>::Encode(response, Handler, values...);
+        }
+    };
+
+    /// @brief Calls the handler and writes its result into the response, handlers returning void send no response
+    template<typename Return_Type, typename Dummy = void>
+    struct Encoder {
+        template<typename... Values>
+        static void Encode(JsonDocument & response, handler_type handler, Values const &... values) {
+            response[Result_Key] = handler(values...);
+        }
+    };
+
+    template<typename Dummy>
+    struct Encoder<void, Dummy> {
+        template<typename... Values>
+        static void Encode(JsonDocument &, handler_type handler, Values const &... values) {
+            handler(values...);
+        }
+    };
+};
+
+#endif // Typed_RPC_Callback_h
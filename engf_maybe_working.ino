@@ -9,11 +9,40 @@
 #define LED_BUILTIN 99
 #endif
 
+#if defined(ESP32)
+#include <Preferences.h>
+#else
+#include <EEPROM.h>
+#endif
+
 #include <ArduinoMqttClient.h>
 #include <Server_Side_RPC.h>
-#include <Attribute_Request.h>
 #include <Shared_Attribute_Update.h>
 #include <ThingsBoard.h>
+#include "Json_Writer.h"
+#include "Typed_RPC_Callback.h"
+#include "Client_Side_Request.h"
+#include "Timer_Wheel.h"
+#include "Network_Wait.h"
+#include "Device_Task.h"
+#include "Calibration.h"
+#include "Recipe.h"
+#include "PID_Controller.h"
+#include "Temperature_MPC.h"
+#include "Impaired_Client.h"
+#include "Telemetry_Backfill.h"
+#include "Base64.h"
+#include "Key_Dictionary.h"
+#include "Delta_OTA.h"
+#include "Sampling_Profiler.h"
+#include "Trace_Log.h"
+#include "Trace_Events.h"
+#include "Deferred_Logger.h"
+#include "Log_Level.h"
+#include "Metrics.h"
+#include "Link_Health.h"
+#include "Broker_Failover.h"
+#include "Standby_Client.h"
 
 constexpr char WIFI_SSID[] = "myhotspot";
 constexpr char WIFI_PASSWORD[] = "notmyactualpwd";
@@ -34,39 +63,302 @@ constexpr uint32_t MAX_MESSAGE_SIZE = 1024U;
 // Baud rate for the debugging serial connection.
 // If the Serial output is mangled, ensure to change the monitor speed accordingly to this variable
 constexpr uint32_t SERIAL_DEBUG_BAUD = 9600U;
+// Transmit FIFO of the UART, availableForWrite() never reports more, longer log messages are truncated to it so they can be printed at all
+constexpr size_t SERIAL_TX_FIFO_SIZE = 128U;
 
-// Maximum amount of attributs we can request or subscribe, has to be set both in the ThingsBoard template list and Attribute_Request_Callback template list
+// Maximum amount of attributs we can subscribe, has to be set both in the ThingsBoard template list and Shared_Attribute_Callback template list
 // and should be the same as the amount of variables in the passed array. If it is less not all variables will be requested or subscribed
 constexpr size_t MAX_ATTRIBUTES = 3U;
 
 constexpr uint64_t REQUEST_TIMEOUT_MICROSECONDS = 5000U * 1000U;
 
+// Bounds of the exponential backoff between failed connection attempts
+constexpr uint32_t CONNECT_RETRY_MIN_MS = 500U;
+constexpr uint32_t CONNECT_RETRY_MAX_MS = 30000U;
+
+// Maximum time loop() blocks waiting for incoming messages while idle,
+// ensures the MQTT keep alive is still sent in time even if no timer is due
+constexpr uint32_t MAX_IDLE_WAIT_MS = 1000U;
+
+// Maximum amount of attribute and rpc requests to the server that can wait for their response at the same time
+constexpr size_t MAX_OUTSTANDING_REQUESTS = 16U;
+
+// Analog inputs of the temperature and pH probes, the thermistor is on the low side of a voltage divider with THERMISTOR_SERIES_OHM
+#if defined(ESP32)
+constexpr uint8_t THERMISTOR_PIN = 34U;
+constexpr uint8_t PH_PIN = 35U;
+constexpr uint8_t ADC_BITS = 12U;
+#else
+// The ESP8266 only has the single analog input A0, the pH probe would read the thermistor
+#error "Reading the thermistor and the pH probe requires two analog inputs, use an ESP32"
+#endif
+constexpr float THERMISTOR_SERIES_OHM = 10000.0f;
+// Calibration tables have 2^CALIBRATION_TABLE_BITS segments
+constexpr uint8_t CALIBRATION_TABLE_BITS = 7U;
+
+// Maximum amount of phases a recipe can consist of and interval the setpoints are interpolated at
+constexpr size_t MAX_RECIPE_SEGMENTS = 8U;
+constexpr uint32_t RECIPE_TICK_MS = 1000U;
+// The whole recipe is received as one loadRecipe rpc, which the MQTT client drops without notice if it does not fit into MAX_MESSAGE_SIZE.
+// A phase with every key is at most ~90 characters, e.g. {"duration":4294967,"temperature":-100.125,"rpm":12000.5,"ph":14.25,"ramp":false},
+// the rest is the request topic and the method and params around the phases
+constexpr size_t RECIPE_SEGMENT_MAX_JSON_SIZE = 96U;
+constexpr size_t RECIPE_REQUEST_OVERHEAD = 128U;
+static_assert(MAX_RECIPE_SEGMENTS * RECIPE_SEGMENT_MAX_JSON_SIZE + RECIPE_REQUEST_OVERHEAD <= MAX_MESSAGE_SIZE, "A recipe with MAX_RECIPE_SEGMENTS phases has to fit into MAX_MESSAGE_SIZE");
+
+// Largest chunk of a firmware patch per otaChunk rpc, base64 encoded it has to fit into MAX_MESSAGE_SIZE with the rest of the request
+constexpr size_t OTA_MAX_CHUNK_SIZE = 512U;
+// Delay between activating a new firmware and restarting into it, gives the response of otaEnd time to be sent
+constexpr uint32_t OTA_RESTART_DELAY_MS = 1000U;
+
+// Events on the hot path are recorded as binary records instead of printing formatted text, and are only sent over serial as far as its buffer has room,
+// so diagnostics never block loop(). Capture the serial port and render the timeline with tools/trace_decode.cpp
+#define TRACE_LOG 1
+#if TRACE_LOG
+constexpr size_t TRACE_LOG_CAPACITY = 128U;
+#endif // TRACE_LOG
+
+// Samples where the firmware spends its time on the Xtensa ESP32 variants, controlled remotely with the startProfiler, stopProfiler and dumpProfile rpcs,
+// the dumped program counters are resolved against the firmware ELF on the host (see tools/sampling_profile.cpp)
+#define SAMPLING_PROFILER 1
+#if SAMPLING_PROFILER
+constexpr uint32_t PROFILER_DEFAULT_RATE_HZ = 1000U;
+// Histogram entries per dumpProfile response, one "pc:count," entry is at most 20 characters, which keeps the response below MAX_MESSAGE_SIZE
+constexpr size_t PROFILE_PAGE_ENTRIES = 32U;
+#endif // SAMPLING_PROFILER
+
+// Counters, gauges and histograms of the firmware itself are snapshotted together and published as one telemetry message (see Metrics.h),
+// instead of a message per value or diagnostics only visible on the serial port
+#define RUNTIME_METRICS 1
+#if RUNTIME_METRICS
+constexpr uint32_t METRICS_PUBLISH_INTERVAL_MS = 60000U;
+#endif // RUNTIME_METRICS
+
+// Output driving the heating jacket with a PWM duty cycle
+#if defined(ESP32)
+constexpr uint8_t HEATER_PIN = 25U;
+#else
+constexpr uint8_t HEATER_PIN = D5;
+#endif
+constexpr uint32_t HEATER_PWM_MAX = 255U;
+// The heater is switched off whatever the controller demands above this temperature, if the thermistor reading is stuck at either rail
+// (open or shorted probe) or if the control loop did not run for HEATER_STALE_MS, e.g. because loop() was blocked
+constexpr float HEATER_CUTOFF_TEMPERATURE = 60.0f;
+constexpr uint32_t THERMISTOR_FAULT_MARGIN = 16U;
+
+// Telemetry measured while disconnected is kept compressed and uploaded after reconnecting, one block per message.
+// Blocks of 2 KiB of records are compressed to at most 512 bytes, which fits into MAX_MESSAGE_SIZE as base64 (see tools/telemetry_decode.cpp)
+#define TELEMETRY_BACKFILL 1
+#if TELEMETRY_BACKFILL
+#if defined(ESP32)
+constexpr size_t BACKFILL_ARENA_SIZE = 32768U;
+#else
+constexpr size_t BACKFILL_ARENA_SIZE = 8192U;
+#endif
+constexpr size_t BACKFILL_BLOCK_SIZE = 2048U;
+constexpr size_t BACKFILL_COMPRESSED_BLOCK_SIZE = 512U;
+// Interval between two uploaded blocks, spreads the backfill to stay below the rate limits of the server
+constexpr uint32_t BACKFILL_UPLOAD_INTERVAL_MS = 200U;
+#endif // TELEMETRY_BACKFILL
+
+// Emulates a bad network between the MQTT client and the WiFi client, to test buffering, reconnects and timeouts
+// of the device logic under reproducible conditions, Impairment_Preset::HALF_OPEN tests the link health monitoring. Only for testing, has to be 0 in production
+#define NETWORK_IMPAIRMENT 0
+#if NETWORK_IMPAIRMENT
+constexpr Impairment_Preset NETWORK_IMPAIRMENT_PRESET = Impairment_Preset::FLAKY;
+constexpr uint64_t NETWORK_IMPAIRMENT_SEED = 1U;
+#endif // NETWORK_IMPAIRMENT
+
+// Judges the connection from the round trip time of small attribute requests, a weak signal only probes more often (see Link_Health.h). Telemetry is buffered while the probes
+// are slow or lost, and a connection whose probes are not answered anymore is reconnected, instead of losing everything published until the keepalive notices the half-open connection
+#define LINK_HEALTH 1
+#if LINK_HEALTH
+constexpr uint32_t LINK_CHECK_INTERVAL_MS = 250U;
+constexpr uint32_t LINK_PROBE_TIMEOUT_MS = 3000U;
+#endif // LINK_HEALTH
+
+// Switches to the next broker of THINGSBOARD_BROKERS as soon as the active one fails, e.g. while it is restarted for maintenance, over a second connection that is kept open
+// to the standby broker, and falls back to the preferred broker once it stayed reachable (see Broker_Failover.h). Telemetry is buffered in the backfill during the switch.
+// Every broker has to be a node of the same ThingsBoard cluster, so the device token is known to all of them, the standby server therefore has to be configured before enabling it
+#define BROKER_FAILOVER 0
+#if BROKER_FAILOVER
+constexpr char THINGSBOARD_STANDBY_SERVER[] = "standby.thingsboard.local";
+constexpr Broker_Endpoint THINGSBOARD_BROKERS[] = {
+  { THINGSBOARD_SERVER, THINGSBOARD_PORT },
+  { THINGSBOARD_STANDBY_SERVER, THINGSBOARD_PORT }
+};
+constexpr size_t THINGSBOARD_BROKER_COUNT = sizeof(THINGSBOARD_BROKERS) / sizeof(THINGSBOARD_BROKERS[0U]);
+// Interval the standby connection is checked and opened again, has to be shorter than the time the broker keeps a connection open without the MQTT handshake
+constexpr uint32_t STANDBY_REFRESH_MS = 10000U;
+// Time connecting the standby connection may block the timers, instead of the default connect timeout of the WiFiClient, which stalls the control loop and the keepalive
+// for seconds every STANDBY_REFRESH_MS while the standby broker is down. A broker of the same cluster answers well within it
+constexpr uint32_t STANDBY_CONNECT_TIMEOUT_MS = 300U;
+#endif // BROKER_FAILOVER
+
+// Interval of the temperature control loop, has to match the tick the model predictive controller has been configured with
+constexpr uint32_t CONTROL_TICK_MS = 1000U;
+constexpr uint32_t HEATER_STALE_MS = 3U * CONTROL_TICK_MS;
+// Prediction horizon and iteration limit of the model predictive controller, the worst case solve is ~1 ms on the ESP32 (see tools/mpc_benchmark.cpp)
+constexpr size_t MPC_HORIZON = 20U;
+constexpr size_t MPC_ITERATIONS = 60U;
+
 // Attribute names for attribute request and attribute updates functionality
 
 constexpr const char BLINKING_INTERVAL_ATTR[] = "blinkingInterval";
 constexpr const char LED_MODE_ATTR[] = "ledMode";
 constexpr const char LED_STATE_ATTR[] = "ledState";
 
+// Keys used in rpc params and responses
+constexpr const char NEW_MODE_KEY[] = "newMode";
+constexpr const char CALIBRATED_KEY[] = "calibrated";
+constexpr const char R1_KEY[] = "r1";
+constexpr const char T1_KEY[] = "t1";
+constexpr const char R2_KEY[] = "r2";
+constexpr const char T2_KEY[] = "t2";
+constexpr const char R3_KEY[] = "r3";
+constexpr const char T3_KEY[] = "t3";
+constexpr const char RAW1_KEY[] = "raw1";
+constexpr const char PH1_KEY[] = "ph1";
+constexpr const char RAW2_KEY[] = "raw2";
+constexpr const char PH2_KEY[] = "ph2";
+constexpr const char RAW3_KEY[] = "raw3";
+constexpr const char PH3_KEY[] = "ph3";
+constexpr const char TEMPERATURE_KEY[] = "temperature";
+constexpr const char RUNNING_KEY[] = "running";
+constexpr const char SEGMENTS_KEY[] = "segments";
+constexpr const char DURATION_KEY[] = "duration";
+constexpr const char RPM_KEY[] = "rpm";
+constexpr const char PH_KEY[] = "ph";
+constexpr const char RAMP_KEY[] = "ramp";
+constexpr const char CONTROLLER_KEY[] = "controller";
+constexpr const char OFFSET_KEY[] = "offset";
+constexpr const char DATA_KEY[] = "data";
+constexpr const char NEXT_KEY[] = "next";
+constexpr const char UPDATED_KEY[] = "updated";
+constexpr const char RATE_KEY[] = "rate";
+constexpr const char SAMPLES_KEY[] = "samples";
+constexpr const char DROPPED_KEY[] = "dropped";
+constexpr const char ENTRIES_KEY[] = "entries";
+constexpr const char PROFILE_KEY[] = "profile";
+
+// Keys of the high rate telemetry are sent as short numeric ids, the dictionary is published as the "telemetryKeys" attribute after connecting
+// and the ids are replaced with the names again on the receiving side (see tools/telemetry_decode.cpp).
+// A stock server would store the ids as time series of their own, the ids are therefore only sent once the receiving side acknowledged the dictionary,
+// by setting the shared attribute "telemetryKeysAck" to the amount of keys it knows. Until then, and after every reconnect until the acknowledgement
+// was received again, the keys are sent with their names.
+// The id of a key is its position in this list, new keys may therefore only be appended
+#define TELEMETRY_KEY_INTERNING 1
+constexpr const char TELEMETRY_KEYS_ATTR[] = "telemetryKeys";
+constexpr const char TELEMETRY_KEYS_ACK_ATTR[] = "telemetryKeysAck";
+constexpr const char *TELEMETRY_KEYS[] = {
+  "thermistorRaw",
+  "phRaw",
+  TEMPERATURE_KEY,
+  PH_KEY,
+  CONTROLLER_KEY,
+  "heaterOutput",
+  "controllerSolveUs",
+  LED_STATE_ATTR,
+  "recipeRunning",
+  "recipePhase",
+  "recipePhaseProgress",
+  "recipeProgress",
+  "temperatureSetpoint",
+  "stirrerSetpoint",
+  "phSetpoint"
+};
+Key_Dictionary<sizeof(TELEMETRY_KEYS) / sizeof(TELEMETRY_KEYS[0])> telemetryKeys(TELEMETRY_KEYS, false);
+
+#if TRACE_LOG
+Trace_Log<TRACE_LOG_CAPACITY> traceLog;
+#endif // TRACE_LOG
+
+/// @brief Records an event into the trace log, costs only a few stores and never blocks
+/// @param event Event that happened
+/// @param first First event specific argument (see Trace_Events.h)
+/// @param second Second event specific argument
+void traceEvent(const Trace_Event event, const int32_t first, const int32_t second) {
+#if TRACE_LOG
+  traceLog.Trace(micros(), static_cast<uint16_t>(event), first, second);
+#endif // TRACE_LOG
+}
+
+// Messages of the rpc and request implementations are only formatted and printed from the idle part of loop() (see Deferred_Logger.h),
+// so logging no longer slows down processing every rpc. Levels are chosen per category at compile time (see Log_Level.h), disabled messages are not even part of the image,
+// raise them to Log_Level::DEBUG while debugging
+using Api_Logger = Log_Policy<Deferred_Logger<16U, 48U>, Log_Level::ERROR, Log_Level::WARNING, Log_Level::WARNING>;
+
+/// @brief Prints the queued log messages and sends the recorded trace events over serial, only as much as fits into its transmit buffer without blocking
+void flushDiagnostics() {
+  Api_Logger::Flush(Serial, Serial.availableForWrite(), SERIAL_TX_FIFO_SIZE);
+#if TRACE_LOG
+  traceLog.Drain(Serial, Serial.availableForWrite() / decltype(traceLog)::FRAME_SIZE);
+#endif // TRACE_LOG
+}
+
 // Initialize underlying client, used to establish a connection
 WiFiClient wifiClient;
 
+#if BROKER_FAILOVER
+// Second underlying client, kept connected to the standby broker, the connection uses whichever of both clients is active
+WiFiClient standbyWifiClient;
+Standby_Client<WiFiClient> standbyClient(wifiClient, standbyWifiClient);
+Client &brokerClient = standbyClient;
+#else
+Client &brokerClient = wifiClient;
+#endif // BROKER_FAILOVER
+
+#if NETWORK_IMPAIRMENT
+// Delays, drops and disconnects the traffic of the underlying client
+Impaired_Client<> impairedClient(brokerClient, Get_Impairment_Profile(NETWORK_IMPAIRMENT_PRESET), NETWORK_IMPAIRMENT_SEED);
+
 // Initalize the Mqtt client instance
-Arduino_MQTT_Client mqttClient(wifiClient);
+Arduino_MQTT_Client mqttClient(impairedClient);
+#else
+// Initalize the Mqtt client instance
+Arduino_MQTT_Client mqttClient(brokerClient);
+#endif // NETWORK_IMPAIRMENT
+
+// Amount of rpc responses remembered to answer redelivered or retried requests without executing them again
+constexpr size_t MAX_CACHED_RPC_RESPONSES = 8U;
+constexpr size_t MAX_CACHED_RPC_RESPONSE_SIZE = 64U;
+
+// Shared timer wheel, every deadline (request timeouts, blinking, telemetry interval) is registered here
+// instead of being polled in every loop iteration
+Timer_Wheel timers;
 
 // Initialize used apis
-Server_Side_RPC<3U, 5U> rpc;
-Attribute_Request<2U, MAX_ATTRIBUTES> attr_request;
+Server_Side_RPC<14U, 5U, Api_Logger, MAX_CACHED_RPC_RESPONSES, MAX_CACHED_RPC_RESPONSE_SIZE> rpc;
+Client_Side_Request<MAX_OUTSTANDING_REQUESTS, Api_Logger> requests(timers);
 Shared_Attribute_Update<3U, MAX_ATTRIBUTES> shared_update;
 
 const std::array<IAPI_Implementation*, 3U> apis = {
     &rpc,
-    &attr_request,
+    &requests,
     &shared_update
 };
 
 // Initialize ThingsBoard instance with the maximum needed buffer size, stack size and the apis we want to use
 ThingsBoard tb(mqttClient, MAX_MESSAGE_SIZE, Default_Max_Stack_Size, apis);
 
+// Runtime metrics, incrementing them is a single atomic addition and never blocks
+Metric_Counter messagesPublished;
+Metric_Counter publishFailures;
+Metric_Counter mqttConnects;
+Metric_Counter wifiReconnects;
+Metric_Counter attributeUpdates;
+Metric_Counter loopIterations;
+Metric_Histogram controlSolveUs;
+Metric_Histogram loopBusyUs;
+
+/// @brief Counts the result of a publish
+/// @param sent Whether the message was published
+/// @return The given result, allows to wrap the send call directly
+bool countPublish(const bool sent) {
+  (sent ? messagesPublished : publishFailures).Increment();
+  return sent;
+}
+
 // handle led state and mode changes
 volatile bool attributesChanged = false;
 
@@ -81,16 +373,14 @@ constexpr uint16_t BLINKING_INTERVAL_MS_MIN = 10U;
 constexpr uint16_t BLINKING_INTERVAL_MS_MAX = 60000U;
 volatile uint16_t blinkingInterval = 1000U;
 
-uint32_t previousStateChange;
-
 // For telemetry
 constexpr int16_t telemetrySendInterval = 2000U;
-uint32_t previousDataSend;
 
 // List of shared attributes for subscribing to their updates
-constexpr std::array<const char *, 2U> SHARED_ATTRIBUTES_LIST = {
+constexpr std::array<const char *, 3U> SHARED_ATTRIBUTES_LIST = {
   LED_STATE_ATTR,
-  BLINKING_INTERVAL_ATTR
+  BLINKING_INTERVAL_ATTR,
+  TELEMETRY_KEYS_ACK_ATTR
 };
 
 // List of client attributes for requesting them (Using to initialize device states)
@@ -98,70 +388,565 @@ constexpr std::array<const char *, 1U> CLIENT_ATTRIBUTES_LIST = {
   LED_MODE_ATTR
 };
 
-/// @brief Initalizes WiFi connection,
-// will endlessly delay until a connection has been successfully established
+// Time a connection attempt to the AP is given before it is started again
+constexpr uint32_t WIFI_CONNECT_TIMEOUT_MS = 15000U;
+uint32_t wifiConnectStart = 0U;
+bool wifiConnecting = false;
+
+/// @brief Starts connecting to the AP, the connection is established in the background,
+/// loop() keeps running meanwhile and reconnect() reports once it has been established
 void InitWiFi() {
   Serial.println("Connecting to AP ...");
   // Attempting to establish a connection to the given WiFi network
   WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-  while (WiFi.status() != WL_CONNECTED) {
-    // Delay 500ms until a connection has been succesfully established
-    delay(500);
-    Serial.print(".");
-  }
-  Serial.println("Connected to AP");
+  wifiConnectStart = millis();
+  wifiConnecting = true;
 }
 
-/// @brief Reconnects the WiFi uses InitWiFi if the connection has been removed
-/// @return Returns true as soon as a connection has been established again
+/// @brief Reconnects the WiFi uses InitWiFi if the connection has been removed, never blocks,
+/// an attempt that did not succeed within WIFI_CONNECT_TIMEOUT_MS is started again
+/// @return Whether the WiFi is connected
 const bool reconnect() {
   // Check to ensure we aren't connected yet
   const wl_status_t status = WiFi.status();
   if (status == WL_CONNECTED) {
+    if (wifiConnecting) {
+      wifiConnecting = false;
+      Serial.println("Connected to AP");
+    }
     return true;
   }
 
   // If we aren't establish a new connection to the given WiFi network
-  InitWiFi();
-  return true;
+  if (!wifiConnecting || millis() - wifiConnectStart >= WIFI_CONNECT_TIMEOUT_MS) {
+    wifiReconnects.Increment();
+    InitWiFi();
+  }
+  return false;
 }
 
 
 /// @brief Processes function for RPC call "setLedMode"
-/// RPC_Data is a JSON variant, that can be queried using operator[]
-/// See https://arduinojson.org/v5/api/jsonvariant/subscript/ for more details
-/// @param data Data containing the rpc data that was called and its current value
-void processSetLedMode(const JsonVariantConst &data, JsonDocument &response) {
-  Serial.println("Received the set led state RPC method");
-
-  // Process data
-  int new_mode = data;
-
-  Serial.print("Mode to change: ");
-  Serial.println(new_mode);
-  StaticJsonDocument<1> response_doc;
-
-  if (new_mode != 0 && new_mode != 1) {
-    response_doc["error"] = "Unknown mode!";
-    response.set(response_doc);
-    return;
-  }
+/// Decoding and validating the mode (0 or 1) is generated by RPC_Binding,
+/// invalid requests are answered with an error and never reach this function
+/// @param new_mode Mode the led should be changed to
+/// @return Current mode, sent back to the server as "newMode"
+int processSetLedMode(const int new_mode) {
+  traceEvent(Trace_Event::LED_MODE_RPC, new_mode, 0);
 
   ledMode = new_mode;
 
   attributesChanged = true;
 
   // Returning current mode
-  response_doc["newMode"] = (int)ledMode;
-  response.set(response_doc);
+  return ledMode;
+}
+
+
+// Calibrations of the probes, the lookup tables are rebuilt from the stored points at boot
+Thermistor_Calibration<ADC_BITS, CALIBRATION_TABLE_BITS> thermistorCalibration(THERMISTOR_SERIES_OHM);
+PH_Calibration<ADC_BITS, CALIBRATION_TABLE_BITS> phCalibration;
+
+// Calibration points as persisted in flash, only the points are stored, the tables are cheap to rebuild
+struct StoredCalibration {
+  uint32_t magic;
+  Thermistor_Point thermistor[3U];
+  PH_Point ph[3U];
+  uint8_t phPointCount;
+  float phTemperature;
+};
+constexpr uint32_t CALIBRATION_MAGIC = 0xCA1B0001U;
+StoredCalibration storedCalibration = {};
+
+/// @brief Writes the current calibration points to flash
+void saveCalibration() {
+  storedCalibration.magic = CALIBRATION_MAGIC;
+#if defined(ESP32)
+  Preferences preferences;
+  preferences.begin("calibration", false);
+  preferences.putBytes("points", &storedCalibration, sizeof(storedCalibration));
+  preferences.end();
+#else
+  EEPROM.begin(sizeof(storedCalibration));
+  EEPROM.put(0, storedCalibration);
+  EEPROM.commit();
+  EEPROM.end();
+#endif
+}
+
+/// @brief Reads the calibration points from flash and rebuilds the lookup tables
+void loadCalibration() {
+#if defined(ESP32)
+  Preferences preferences;
+  preferences.begin("calibration", true);
+  const size_t length = preferences.getBytes("points", &storedCalibration, sizeof(storedCalibration));
+  preferences.end();
+  if (length != sizeof(storedCalibration)) {
+    return;
+  }
+#else
+  EEPROM.begin(sizeof(storedCalibration));
+  EEPROM.get(0, storedCalibration);
+  EEPROM.end();
+#endif
+  if (storedCalibration.magic != CALIBRATION_MAGIC) {
+    storedCalibration = {};
+    return;
+  }
+  if (storedCalibration.thermistor[0U].resistance_ohm > 0.0f) {
+    thermistorCalibration.Calibrate(storedCalibration.thermistor);
+  }
+  if (storedCalibration.phPointCount > 0U) {
+    phCalibration.Calibrate(storedCalibration.ph, storedCalibration.phPointCount, storedCalibration.phTemperature);
+  }
+}
+
+/// @brief Processes function for RPC call "setThermistorCalibration",
+/// fits the Steinhart-Hart model to three (resistance, temperature) points ordered by resistance
+/// @return Whether the calibration was valid and has been applied and persisted
+bool processSetThermistorCalibration(const float r1, const float t1, const float r2, const float t2, const float r3, const float t3) {
+  const Thermistor_Point points[3U] = { { r1, t1 }, { r2, t2 }, { r3, t3 } };
+  if (!thermistorCalibration.Calibrate(points)) {
+    return false;
+  }
+  memcpy(storedCalibration.thermistor, points, sizeof(points));
+  saveCalibration();
+  return true;
+}
+
+/// @brief Applies and persists a pH calibration from the given buffer points, ordered by raw reading
+bool applyPhCalibration(const PH_Point *points, const uint8_t count, const float temperature) {
+  if (!phCalibration.Calibrate(points, count, temperature)) {
+    return false;
+  }
+  memcpy(storedCalibration.ph, points, count * sizeof(PH_Point));
+  storedCalibration.phPointCount = count;
+  storedCalibration.phTemperature = temperature;
+  saveCalibration();
+  return true;
+}
+
+/// @brief Processes function for RPC call "setPhCalibration", two point calibration with the raw readings in two buffer solutions
+/// @return Whether the calibration was valid and has been applied and persisted
+bool processSetPhCalibration(const float raw1, const float ph1, const float raw2, const float ph2, const float temperature) {
+  const PH_Point points[2U] = { { raw1, ph1 }, { raw2, ph2 } };
+  return applyPhCalibration(points, 2U, temperature);
+}
+
+/// @brief Processes function for RPC call "setPhCalibration3", three point calibration with the raw readings in three buffer solutions
+/// @return Whether the calibration was valid and has been applied and persisted
+bool processSetPhCalibration3(const float raw1, const float ph1, const float raw2, const float ph2, const float raw3, const float ph3, const float temperature) {
+  const PH_Point points[3U] = { { raw1, ph1 }, { raw2, ph2 }, { raw3, ph3 } };
+  return applyPhCalibration(points, 3U, temperature);
+}
+
+// Accepted calibration ranges, in thousandths
+using Resistance_Param1 = RPC_Float_Parameter<1000L, 2000000000L, R1_KEY>;
+using Resistance_Param2 = RPC_Float_Parameter<1000L, 2000000000L, R2_KEY>;
+using Resistance_Param3 = RPC_Float_Parameter<1000L, 2000000000L, R3_KEY>;
+using Temperature_Param1 = RPC_Float_Parameter<-40000L, 150000L, T1_KEY>;
+using Temperature_Param2 = RPC_Float_Parameter<-40000L, 150000L, T2_KEY>;
+using Temperature_Param3 = RPC_Float_Parameter<-40000L, 150000L, T3_KEY>;
+using Raw_Param1 = RPC_Float_Parameter<0L, ((1L << ADC_BITS) - 1L) * 1000L, RAW1_KEY>;
+using Raw_Param2 = RPC_Float_Parameter<0L, ((1L << ADC_BITS) - 1L) * 1000L, RAW2_KEY>;
+using Raw_Param3 = RPC_Float_Parameter<0L, ((1L << ADC_BITS) - 1L) * 1000L, RAW3_KEY>;
+using PH_Param1 = RPC_Float_Parameter<0L, 14000L, PH1_KEY>;
+using PH_Param2 = RPC_Float_Parameter<0L, 14000L, PH2_KEY>;
+using PH_Param3 = RPC_Float_Parameter<0L, 14000L, PH3_KEY>;
+using Buffer_Temperature_Param = RPC_Float_Parameter<0L, 100000L, TEMPERATURE_KEY>;
+
+// Recipe executed on the device, interpolates the setpoints every control tick without any server round trip
+Recipe<MAX_RECIPE_SEGMENTS> recipe;
+// Current setpoints, indexed by Recipe_Channel, kept at their last value when no recipe is running
+Recipe<MAX_RECIPE_SEGMENTS>::Setpoints setpoints = { { 37.0f, 0.0f, 7.0f } };
+// Segment the last status was sent for, to report phase changes immediately
+size_t reportedRecipeSegment = SIZE_MAX;
+
+/// @brief Sends the recipe phase, its progress and the current setpoints
+void sendRecipeStatus() {
+  char payload[160];
+  Json_Writer writer(payload, sizeof(payload));
+  writer.Begin_Object();
+  writer.Add(telemetryKeys.Key("recipeRunning"), recipe.Is_Running());
+  writer.Add(telemetryKeys.Key("recipePhase"), recipe.Get_Segment_Index());
+  writer.Add(telemetryKeys.Key("recipePhaseProgress"), recipe.Get_Segment_Progress());
+  writer.Add(telemetryKeys.Key("recipeProgress"), recipe.Get_Progress());
+  writer.Add(telemetryKeys.Key("temperatureSetpoint"), setpoints.value[static_cast<size_t>(Recipe_Channel::TEMPERATURE)]);
+  writer.Add(telemetryKeys.Key("stirrerSetpoint"), setpoints.value[static_cast<size_t>(Recipe_Channel::STIRRER)]);
+  writer.Add(telemetryKeys.Key("phSetpoint"), setpoints.value[static_cast<size_t>(Recipe_Channel::PH)]);
+  writer.End_Object();
+  if (!writer.Overflowed()) {
+    countPublish(tb.sendTelemetryString(writer.Get_String()));
+  }
+}
+
+void recipeTick(void *context);
+Timer_Wheel::Timer recipeTimer(&recipeTick);
+
+/// @brief Timer callback of the control tick, interpolates the setpoints while a recipe is running and reports phase changes immediately
+void recipeTick(void *context) {
+  const bool running = recipe.Update(millis(), setpoints);
+  if (running) {
+    timers.Start(recipeTimer, RECIPE_TICK_MS);
+  }
+  if (recipe.Get_Segment_Index() != reportedRecipeSegment) {
+    reportedRecipeSegment = recipe.Get_Segment_Index();
+    sendRecipeStatus();
+  }
+}
+
+/// @brief Processes function for RPC call "loadRecipe", compiles the received phases and replaces the loaded recipe.
+/// Expects {"segments": [{"duration": <seconds>, "temperature": <celsius>, "rpm": <rpm>, "ph": <ph>, "ramp": <bool>}, ...]},
+/// setpoints that are left out keep the target of the previous phase, ramp defaults to false (step and hold).
+/// At most MAX_RECIPE_SEGMENTS phases, which always fit into MAX_MESSAGE_SIZE, longer recipes are answered with an error as long as the request still fits
+/// @param data Params of the received RPC request
+/// @param response Doc that will contain the amount of loaded segments or an error
+void processLoadRecipe(const JsonVariantConst &data, JsonDocument &response) {
+  const JsonArrayConst segments = data[SEGMENTS_KEY];
+  if (segments.isNull() || segments.size() == 0U || segments.size() > MAX_RECIPE_SEGMENTS) {
+    response[RPC_ERROR_KEY] = RPC_PARAMETER_OUT_OF_RANGE;
+    return;
+  }
+  Recipe_Segment compiled[MAX_RECIPE_SEGMENTS];
+  // Recipe starts from the current setpoints, so the first phase can ramp from them
+  const Recipe<MAX_RECIPE_SEGMENTS>::Setpoints initial = setpoints;
+  const float *previous = initial.value;
+  size_t count = 0U;
+  for (const JsonVariantConst segment : segments) {
+    Recipe_Segment &current = compiled[count];
+    if (!segment[DURATION_KEY].is<uint32_t>() || segment[DURATION_KEY].as<uint32_t>() > UINT32_MAX / 1000U) {
+      response[RPC_ERROR_KEY] = RPC_PARAMETER_INVALID_TYPE;
+      return;
+    }
+    current.duration_milliseconds = segment[DURATION_KEY].as<uint32_t>() * 1000U;
+    current.target[static_cast<size_t>(Recipe_Channel::TEMPERATURE)] = segment[TEMPERATURE_KEY] | previous[static_cast<size_t>(Recipe_Channel::TEMPERATURE)];
+    current.target[static_cast<size_t>(Recipe_Channel::STIRRER)] = segment[RPM_KEY] | previous[static_cast<size_t>(Recipe_Channel::STIRRER)];
+    current.target[static_cast<size_t>(Recipe_Channel::PH)] = segment[PH_KEY] | previous[static_cast<size_t>(Recipe_Channel::PH)];
+    current.ramp = segment[RAMP_KEY] | false;
+    previous = current.target;
+    count++;
+  }
+  if (!recipe.Load(compiled, count, initial)) {
+    response[RPC_ERROR_KEY] = RPC_PARAMETER_OUT_OF_RANGE;
+    return;
+  }
+  timers.Stop(recipeTimer);
+  reportedRecipeSegment = SIZE_MAX;
+  response[SEGMENTS_KEY] = count;
+}
+
+/// @brief Processes function for RPC call "startRecipe", restarts the loaded recipe from its first phase
+/// @return Whether a recipe is loaded and has been started, sent back to the server as "running"
+bool processStartRecipe() {
+  if (!recipe.Start(millis())) {
+    return false;
+  }
+  reportedRecipeSegment = SIZE_MAX;
+  recipeTick(nullptr);
+  return true;
+}
+
+/// @brief Processes function for RPC call "stopRecipe", the setpoints are held at their current values
+/// @return Whether the recipe is still running, sent back to the server as "running"
+bool processStopRecipe() {
+  recipe.Stop();
+  timers.Stop(recipeTimer);
+  sendRecipeStatus();
+  return recipe.Is_Running();
+}
+
+// Temperature control loop, the model predictive controller plans ahead over the thermal lag of the jacket
+// and overshoots less than the PID, which is kept as the baseline and fallback
+enum class TemperatureController : int {
+  OFF = 0,
+  PID = 1,
+  MPC = 2
+};
+volatile TemperatureController temperatureController = TemperatureController::OFF;
+PID_Controller pid;
+Temperature_MPC<MPC_HORIZON, MPC_ITERATIONS> mpc;
+// Heater duty cycle and duration of the last controller update, reported with the periodic telemetry
+float heaterOutput = 0.0f;
+uint32_t controllerSolveMicros = 0U;
+// Time of the last control loop update, checked by checkHeaterStale()
+uint32_t lastControlTick = 0U;
+
+// Cause of switching the heater off, reported as first argument of Trace_Event::HEATER_CUTOFF
+enum class HeaterCutoff : int32_t {
+  SENSOR_FAULT = 1,
+  OVER_TEMPERATURE = 2,
+  STALE_CONTROL = 3
+};
+
+/// @brief Switches the heater off and reports why, the controller keeps running and drives it again once the cause is gone
+/// @param reason Cause of the cutoff, see Trace_Event::HEATER_CUTOFF
+/// @param value Reading that caused the cutoff
+void heaterCutoff(const HeaterCutoff reason, const int32_t value) {
+  heaterOutput = 0.0f;
+  analogWrite(HEATER_PIN, 0);
+  traceEvent(Trace_Event::HEATER_CUTOFF, static_cast<int32_t>(reason), value);
+}
+
+/// @brief Switches the heater off if the control loop stopped updating it, called at the start of every loop() iteration,
+/// so the duty cycle is never latched for longer than HEATER_STALE_MS plus the longest blocking call
+void checkHeaterStale() {
+  if (heaterOutput == 0.0f || millis() - lastControlTick < HEATER_STALE_MS) {
+    return;
+  }
+  heaterCutoff(HeaterCutoff::STALE_CONTROL, millis() - lastControlTick);
+}
+
+void controlTick(void *context);
+Timer_Wheel::Timer controlTimer(&controlTick);
+
+/// @brief Timer callback of the temperature control loop, runs the selected controller against the current recipe setpoint
+void controlTick(void *context) {
+  if (temperatureController == TemperatureController::OFF) {
+    return;
+  }
+  timers.Start(controlTimer, CONTROL_TICK_MS);
+  lastControlTick = millis();
+  // Without a calibrated probe the measurement is meaningless, keep the heater off
+  if (!thermistorCalibration.Is_Calibrated()) {
+    heaterOutput = 0.0f;
+  } else {
+    const uint32_t raw = analogRead(THERMISTOR_PIN);
+    if (raw < THERMISTOR_FAULT_MARGIN || raw > (1U << ADC_BITS) - 1U - THERMISTOR_FAULT_MARGIN) {
+      heaterCutoff(HeaterCutoff::SENSOR_FAULT, raw);
+      return;
+    }
+    const float measured = thermistorCalibration.Temperature(raw);
+    if (!(measured < HEATER_CUTOFF_TEMPERATURE)) {
+      heaterCutoff(HeaterCutoff::OVER_TEMPERATURE, static_cast<int32_t>(measured));
+      return;
+    }
+    const float setpoint = setpoints.value[static_cast<size_t>(Recipe_Channel::TEMPERATURE)];
+    const uint32_t start = micros();
+    heaterOutput = (temperatureController == TemperatureController::MPC) ? mpc.Update(measured, setpoint) : pid.Update(measured, setpoint, CONTROL_TICK_MS / 1000.0f);
+    controllerSolveMicros = micros() - start;
+    controlSolveUs.Record(controllerSolveMicros);
+  }
+  analogWrite(HEATER_PIN, static_cast<int>(heaterOutput * HEATER_PWM_MAX));
+  traceEvent(Trace_Event::CONTROL_TICK, static_cast<int32_t>(heaterOutput * 1000.0f), controllerSolveMicros);
+}
+
+/// @brief Processes function for RPC call "setTemperatureController", 0 turns the heater off, 1 selects the PID and 2 the model predictive controller
+/// @param controller Controller that should be used
+/// @return Selected controller, sent back to the server as "controller"
+int processSetTemperatureController(const int controller) {
+  temperatureController = static_cast<TemperatureController>(controller);
+  // Both controllers start from scratch, stale integrals or state estimates would cause a bump
+  pid.Reset();
+  mpc.Reset();
+  if (temperatureController == TemperatureController::OFF) {
+    timers.Stop(controlTimer);
+    heaterOutput = 0.0f;
+    analogWrite(HEATER_PIN, 0);
+  } else {
+    controlTick(nullptr);
+  }
+  return controller;
+}
+
+
+// Firmware update with delta patches (see Delta_OTA.h and tools/delta_patch.cpp), the patch is streamed as base64 chunks with one rpc each:
+// otaBegin, then otaChunk {"offset":n,"data":"..."} until the whole patch was sent, then otaEnd. Every chunk is answered with the offset of the next one,
+// the server only sends the next chunk after that response (stop and wait), so the device is never flooded and a lost or repeated chunk is detected by its offset.
+// The patch is applied against the running image while it is received and written to the next OTA partition, which is only booted once its checksum was verified
+#if defined(ESP32)
+Esp_Partition_Source otaSource;
+Esp_Ota_Sink otaSink;
+Delta_Patch_Applier<Esp_Partition_Source, Esp_Ota_Sink> otaApplier(otaSource, otaSink);
+bool otaActive = false;
+
+void restartIntoUpdate(void *context) {
+  ESP.restart();
+}
+Timer_Wheel::Timer otaRestartTimer(&restartIntoUpdate);
+#endif // defined(ESP32)
+
+constexpr char OTA_NOT_SUPPORTED[] = "Firmware update not supported";
+constexpr char OTA_NOT_STARTED[] = "No firmware update started";
+constexpr char OTA_OUT_OF_ORDER[] = "Chunk out of order";
+
+/// @brief Processes function for RPC call "otaBegin", prepares the next OTA partition, discards an update that was in progress
+void processOtaBegin(const JsonVariantConst &data, JsonDocument &response) {
+#if defined(ESP32)
+  otaApplier.Reset();
+  otaActive = otaSink.Begin();
+  if (!otaActive) {
+    response[RPC_ERROR_KEY] = OTA_NOT_SUPPORTED;
+    return;
+  }
+  response[NEXT_KEY] = 0U;
+#else
+  response[RPC_ERROR_KEY] = OTA_NOT_SUPPORTED;
+#endif // defined(ESP32)
+}
+
+/// @brief Processes function for RPC call "otaChunk", applies the chunk if it is the next one, a repeated chunk is acknowledged again without applying it twice
+void processOtaChunk(const JsonVariantConst &data, JsonDocument &response) {
+#if defined(ESP32)
+  if (!otaActive) {
+    response[RPC_ERROR_KEY] = OTA_NOT_STARTED;
+    return;
+  }
+  const JsonVariantConst offset = data[OFFSET_KEY];
+  const char *encoded = data[DATA_KEY];
+  if (!offset.is<uint32_t>() || encoded == nullptr) {
+    response[RPC_ERROR_KEY] = RPC_PARAMETER_INVALID_TYPE;
+    return;
+  }
+  const size_t expected = otaApplier.Get_Consumed();
+  if (offset.as<uint32_t>() != expected) {
+    // Older chunks were already applied, their response got lost, newer ones mean a chunk is missing, either way the server continues at the next offset
+    if (offset.as<uint32_t>() > expected) {
+      response[RPC_ERROR_KEY] = OTA_OUT_OF_ORDER;
+    }
+    response[NEXT_KEY] = expected;
+    return;
+  }
+  uint8_t chunk[OTA_MAX_CHUNK_SIZE];
+  const size_t length = strlen(encoded);
+  const size_t size = Base64::Decode(encoded, length, chunk, sizeof(chunk));
+  if (size == 0U && length > 0U) {
+    response[RPC_ERROR_KEY] = RPC_PARAMETER_OUT_OF_RANGE;
+    response[NEXT_KEY] = expected;
+    return;
+  }
+  const Delta_Status status = otaApplier.Push(chunk, size);
+  if (status != Delta_Status::OK) {
+    otaSink.Abort();
+    otaActive = false;
+    response[RPC_ERROR_KEY] = Get_Delta_Status_Text(status);
+    return;
+  }
+  response[NEXT_KEY] = otaApplier.Get_Consumed();
+#else
+  response[RPC_ERROR_KEY] = OTA_NOT_SUPPORTED;
+#endif // defined(ESP32)
+}
+
+/// @brief Processes function for RPC call "otaEnd", verifies the new image, activates it and restarts into it
+void processOtaEnd(const JsonVariantConst &data, JsonDocument &response) {
+#if defined(ESP32)
+  if (!otaActive) {
+    response[RPC_ERROR_KEY] = OTA_NOT_STARTED;
+    return;
+  }
+  otaActive = false;
+  const Delta_Status status = otaApplier.Finish();
+  if (status != Delta_Status::OK) {
+    otaSink.Abort();
+    response[RPC_ERROR_KEY] = Get_Delta_Status_Text(status);
+    return;
+  }
+  if (!otaSink.End() || !otaSink.Activate()) {
+    response[RPC_ERROR_KEY] = Get_Delta_Status_Text(Delta_Status::TARGET_MISMATCH);
+    return;
+  }
+  response[UPDATED_KEY] = true;
+  timers.Start(otaRestartTimer, OTA_RESTART_DELAY_MS);
+#else
+  response[RPC_ERROR_KEY] = OTA_NOT_SUPPORTED;
+#endif // defined(ESP32)
+}
+
+
+// Sampling profiler, startProfiler {"rate":hz} clears the histogram and starts sampling the core running loop(), stopProfiler stops it,
+// dumpProfile {"offset":n} stops it as well and returns the entries from n on, ordered by descending count, as "pc:count,..." in hex and decimal.
+// The server requests pages until "next" reaches "entries"
+#if SAMPLING_PROFILER
+Sampling_Profiler<> profiler;
+// Whether the histogram was already ordered for dumping, ordering breaks the hash table, so sampling only continues after it was cleared again
+bool profileSorted = false;
+size_t profileEntries = 0U;
+char profilePage[PROFILE_PAGE_ENTRIES * 20U + 1U] = {};
+#endif // SAMPLING_PROFILER
+
+constexpr char PROFILER_NOT_SUPPORTED[] = "Profiler not supported";
+
+/// @brief Processes function for RPC call "startProfiler", starts sampling with a new histogram
+void processStartProfiler(const JsonVariantConst &data, JsonDocument &response) {
+#if SAMPLING_PROFILER
+  const uint32_t rate = data[RATE_KEY] | PROFILER_DEFAULT_RATE_HZ;
+  if (rate < Sampling_Profiler<>::MIN_RATE_HZ || rate > Sampling_Profiler<>::MAX_RATE_HZ) {
+    response[RPC_ERROR_KEY] = RPC_PARAMETER_OUT_OF_RANGE;
+    return;
+  }
+  profiler.Stop();
+  profiler.Get_Histogram().Clear();
+  profileSorted = false;
+  if (!profiler.Start(rate)) {
+    response[RPC_ERROR_KEY] = PROFILER_NOT_SUPPORTED;
+    return;
+  }
+  response[RUNNING_KEY] = true;
+#else
+  response[RPC_ERROR_KEY] = PROFILER_NOT_SUPPORTED;
+#endif // SAMPLING_PROFILER
+}
+
+/// @brief Processes function for RPC call "stopProfiler", stops sampling and keeps the histogram for dumping
+void processStopProfiler(const JsonVariantConst &data, JsonDocument &response) {
+#if SAMPLING_PROFILER
+  profiler.Stop();
+  response[RUNNING_KEY] = false;
+  response[SAMPLES_KEY] = profiler.Get_Histogram().Get_Samples();
+  response[DROPPED_KEY] = profiler.Get_Histogram().Get_Dropped();
+#else
+  response[RPC_ERROR_KEY] = PROFILER_NOT_SUPPORTED;
+#endif // SAMPLING_PROFILER
+}
+
+/// @brief Processes function for RPC call "dumpProfile", returns one page of the histogram
+void processDumpProfile(const JsonVariantConst &data, JsonDocument &response) {
+#if SAMPLING_PROFILER
+  profiler.Stop();
+  auto &histogram = profiler.Get_Histogram();
+  if (!profileSorted) {
+    profileEntries = histogram.Sort();
+    profileSorted = true;
+  }
+  const size_t offset = data[OFFSET_KEY] | 0U;
+  size_t next = offset;
+  size_t length = 0U;
+  profilePage[0] = '\0';
+  for (; next < profileEntries && next < offset + PROFILE_PAGE_ENTRIES; next++) {
+    const auto &entry = histogram.Get_Entry(next);
+    length += snprintf(profilePage + length, sizeof(profilePage) - length, "%s%lx:%lu", length > 0U ? "," : "",
+                       static_cast<unsigned long>(entry.pc), static_cast<unsigned long>(entry.count));
+  }
+  response[SAMPLES_KEY] = histogram.Get_Samples();
+  response[DROPPED_KEY] = histogram.Get_Dropped();
+  response[ENTRIES_KEY] = profileEntries;
+  // Stored as a pointer to the static page instead of being copied into the small response document
+  response[PROFILE_KEY] = static_cast<const char *>(profilePage);
+  response[NEXT_KEY] = next;
+#else
+  response[RPC_ERROR_KEY] = PROFILER_NOT_SUPPORTED;
+#endif // SAMPLING_PROFILER
 }
 
 
 // Optional, keep subscribed shared attributes empty instead,
 // and the callback will be called for every shared attribute changed on the device,
 // instead of only the one that were entered instead
-const std::array<RPC_Callback, 1U> callbacks = {
-  RPC_Callback{ "setLedMode", processSetLedMode }
+const std::array<RPC_Callback, 14U> callbacks = {
+  RPC_Callback{ "setLedMode", RPC_Binding<NEW_MODE_KEY, int, RPC_Parameter<int, 0, 1>>::Process<processSetLedMode> },
+  RPC_Callback{ "setThermistorCalibration", RPC_Binding<CALIBRATED_KEY, bool, Resistance_Param1, Temperature_Param1, Resistance_Param2, Temperature_Param2, Resistance_Param3, Temperature_Param3>::Process<processSetThermistorCalibration> },
+  RPC_Callback{ "setPhCalibration", RPC_Binding<CALIBRATED_KEY, bool, Raw_Param1, PH_Param1, Raw_Param2, PH_Param2, Buffer_Temperature_Param>::Process<processSetPhCalibration> },
+  RPC_Callback{ "setPhCalibration3", RPC_Binding<CALIBRATED_KEY, bool, Raw_Param1, PH_Param1, Raw_Param2, PH_Param2, Raw_Param3, PH_Param3, Buffer_Temperature_Param>::Process<processSetPhCalibration3> },
+  RPC_Callback{ "loadRecipe", processLoadRecipe },
+  RPC_Callback{ "startRecipe", RPC_Binding<RUNNING_KEY, bool>::Process<processStartRecipe> },
+  RPC_Callback{ "stopRecipe", RPC_Binding<RUNNING_KEY, bool>::Process<processStopRecipe> },
+  RPC_Callback{ "setTemperatureController", RPC_Binding<CONTROLLER_KEY, int, RPC_Parameter<int, 0, 2>>::Process<processSetTemperatureController> },
+  RPC_Callback{ "otaBegin", processOtaBegin },
+  RPC_Callback{ "otaChunk", processOtaChunk },
+  RPC_Callback{ "otaEnd", processOtaEnd },
+  RPC_Callback{ "startProfiler", processStartProfiler },
+  RPC_Callback{ "stopProfiler", processStopProfiler },
+  RPC_Callback{ "dumpProfile", processDumpProfile }
 };
 
 
@@ -174,23 +959,33 @@ void processSharedAttributes(const JsonObjectConst &data) {
       const uint16_t new_interval = it->value().as<uint16_t>();
       if (new_interval >= BLINKING_INTERVAL_MS_MIN && new_interval <= BLINKING_INTERVAL_MS_MAX) {
         blinkingInterval = new_interval;
-        Serial.print("Blinking interval is set to: ");
-        Serial.println(new_interval);
+        traceEvent(Trace_Event::BLINKING_INTERVAL_SET, new_interval, 0);
       }
     } else if (strcmp(it->key().c_str(), LED_STATE_ATTR) == 0) {
       ledState = it->value().as<bool>();
       if (LED_BUILTIN != 99) {
         digitalWrite(LED_BUILTIN, ledState);
       }
-      Serial.print("LED state is set to: ");
-      Serial.println(ledState);
+      traceEvent(Trace_Event::LED_STATE_SET, ledState, 0);
+    } else if (strcmp(it->key().c_str(), TELEMETRY_KEYS_ACK_ATTR) == 0) {
+#if TELEMETRY_KEY_INTERNING
+      telemetryKeys.Acknowledge(it->value().as<size_t>());
+#endif // TELEMETRY_KEY_INTERNING
     }
   }
+  attributeUpdates.Increment();
   attributesChanged = true;
 }
 
-void processClientAttributes(const JsonObjectConst &data) {
-  for (auto it = data.begin(); it != data.end(); ++it) {
+/// @brief Response callback of the shared attribute request, data contains the requested shared attributes
+void processSharedAttributesResponse(const JsonVariantConst &data) {
+  processSharedAttributes(data.as<JsonObjectConst>());
+}
+
+/// @brief Response callback of the client attribute request, data contains the requested client attributes
+void processClientAttributes(const JsonVariantConst &data) {
+  const JsonObjectConst attributes = data.as<JsonObjectConst>();
+  for (auto it = attributes.begin(); it != attributes.end(); ++it) {
     if (strcmp(it->key().c_str(), LED_MODE_ATTR) == 0) {
       const uint16_t new_mode = it->value().as<uint16_t>();
       ledMode = new_mode;
@@ -200,12 +995,435 @@ void processClientAttributes(const JsonObjectConst &data) {
 
 // Attribute request did not receive a response in the expected amount of microseconds 
 void requestTimedOut() {
-  Serial.printf("Attribute request timed out did not receive a response in (%llu) microseconds. Ensure client is connected to the MQTT broker and that the keys actually exist on the target device\n", REQUEST_TIMEOUT_MICROSECONDS);
+  // Ensure client is connected to the MQTT broker and that the keys actually exist on the target device
+  traceEvent(Trace_Event::ATTRIBUTE_REQUEST_TIMEOUT, REQUEST_TIMEOUT_MICROSECONDS / 1000U, 0);
 }
 
 const Shared_Attribute_Callback<MAX_ATTRIBUTES> attributes_callback(&processSharedAttributes, SHARED_ATTRIBUTES_LIST.cbegin(), SHARED_ATTRIBUTES_LIST.cend());
-const Attribute_Request_Callback<MAX_ATTRIBUTES> attribute_shared_request_callback(&processSharedAttributes, REQUEST_TIMEOUT_MICROSECONDS, &requestTimedOut, SHARED_ATTRIBUTES_LIST);
-const Attribute_Request_Callback<MAX_ATTRIBUTES> attribute_client_request_callback(&processClientAttributes, REQUEST_TIMEOUT_MICROSECONDS, &requestTimedOut, CLIENT_ATTRIBUTES_LIST);
+
+// Timers for the periodic device logic, registered with the shared timer wheel
+void blinkLed(void *context);
+void sendPeriodicTelemetry(void *context);
+Timer_Wheel::Timer blinkTimer(&blinkLed);
+Timer_Wheel::Timer telemetryTimer(&sendPeriodicTelemetry);
+
+#if LINK_HEALTH
+Link_Health linkHealth;
+Metric_Counter proactiveReconnects;
+#endif // LINK_HEALTH
+
+#if BROKER_FAILOVER
+Broker_Failover<> brokers(THINGSBOARD_BROKERS, THINGSBOARD_BROKER_COUNT);
+Metric_Counter brokerSwitches;
+// Whether the connection to the active broker was established and not noticed as lost yet
+bool brokerConnected = false;
+#endif // BROKER_FAILOVER
+
+/// @brief Broker the next connect has to use
+/// @return Active broker of the failover, or the only configured one
+Broker_Endpoint activeBroker() {
+#if BROKER_FAILOVER
+  return brokers.Get_Active();
+#else
+  return Broker_Endpoint{ THINGSBOARD_SERVER, THINGSBOARD_PORT };
+#endif // BROKER_FAILOVER
+}
+
+/// @brief Has to be called after every successful connect
+void brokerConnectSucceeded() {
+#if BROKER_FAILOVER
+  brokers.Connected(millis());
+  brokerConnected = true;
+#endif // BROKER_FAILOVER
+#if defined(ESP32)
+  // Reaching the server proves a freshly updated firmware works, otherwise the bootloader rolls it back with the next restart
+  if (Esp_Ota_Sink::Confirm_Running()) {
+    Serial.println("Firmware update confirmed");
+  }
+#endif // defined(ESP32)
+}
+
+/// @brief Has to be called after every failed connect and once a lost connection is noticed
+/// @return Whether the next connect goes to another broker and should be tried immediately instead of backing off
+bool brokerConnectFailed() {
+#if BROKER_FAILOVER
+  brokerConnected = false;
+  if (brokers.Failed(millis())) {
+    brokerSwitches.Increment();
+    traceEvent(Trace_Event::BROKER_SWITCH, brokers.Get_Active_Index(), 0);
+    return true;
+  }
+#endif // BROKER_FAILOVER
+  return false;
+}
+
+/// @brief Whether telemetry can be published directly, false while disconnected and while the probes judged the link degraded
+bool linkUsable() {
+#if LINK_HEALTH
+  return tb.connected() && linkHealth.Get_State() == Link_State::HEALTHY;
+#else
+  return tb.connected();
+#endif // LINK_HEALTH
+}
+
+/// @brief Whether the backfill can be uploaded, true as long as the probes are answered, even if they are too slow for the link to count as healthy,
+/// otherwise a slow but working link would keep recording the telemetry without ever uploading it, until the backfill wraps around
+bool backfillUsable() {
+#if LINK_HEALTH
+  return tb.connected() && linkHealth.Is_Answering();
+#else
+  return tb.connected();
+#endif // LINK_HEALTH
+}
+
+#if TELEMETRY_BACKFILL
+Telemetry_Backfill<BACKFILL_ARENA_SIZE, BACKFILL_BLOCK_SIZE, BACKFILL_COMPRESSED_BLOCK_SIZE> backfill;
+
+void uploadBackfill(void *context);
+Timer_Wheel::Timer backfillTimer(&uploadBackfill);
+
+/// @brief Timer callback uploading the oldest block of the telemetry recorded while disconnected, restarts itself until all blocks are uploaded.
+/// The block is sent as {"backfill":"<base64>","now":<millis>}, the receiver converts the recorded device times with now into timestamps
+void uploadBackfill(void *context) {
+  if (!backfillUsable()) {
+    return;
+  }
+  backfill.Seal();
+  const uint8_t *block = nullptr;
+  const size_t blockSize = backfill.Front(block);
+  if (blockSize == 0U) {
+    return;
+  }
+  // Static, both together are ~1.4 KiB, too much for the loop task stack
+  static char encoded[Base64::Get_Encoded_Length(BACKFILL_COMPRESSED_BLOCK_SIZE) + 1U];
+  Base64::Encode(block, blockSize, encoded, sizeof(encoded));
+  static char payload[sizeof(encoded) + 48U];
+  Json_Writer writer(payload, sizeof(payload));
+  writer.Begin_Object();
+  writer.Add("backfill", (const char *)encoded);
+  writer.Add("now", millis());
+  writer.End_Object();
+  // The block is only removed once it was sent, a failed upload is retried with the next attempt
+  if (!writer.Overflowed() && countPublish(tb.sendTelemetryString(writer.Get_String()))) {
+    backfill.Pop();
+  }
+  if (backfill.Has_Block()) {
+    timers.Start(backfillTimer, BACKFILL_UPLOAD_INTERVAL_MS);
+  }
+}
+#endif // TELEMETRY_BACKFILL
+
+#if LINK_HEALTH
+// Client attribute requested as probe, the content of the answer is not needed, only its arrival
+constexpr std::array<const char *, 1U> LINK_PROBE_ATTRIBUTES = {
+  "macAddress"
+};
+
+/// @brief Response callback of a link probe
+void linkProbeAnswered(const JsonVariantConst &data) {
+  linkHealth.Probe_Answered(millis());
+}
+
+void checkLink(void *context);
+Timer_Wheel::Timer linkTimer(&checkLink);
+
+/// @brief Timer callback sending the link probes and acting on the judged link quality, a dead connection is closed and connected again by loop().
+/// While the link is degraded sendPeriodicTelemetry buffers the measurements, they are uploaded as soon as the probes are answered again
+void checkLink(void *context) {
+  timers.Start(linkTimer, LINK_CHECK_INTERVAL_MS);
+  if (!tb.connected()) {
+    return;
+  }
+  const uint32_t now = millis();
+  if (linkHealth.Is_Probe_Due(now) && requests.Client_Attributes_Request(LINK_PROBE_ATTRIBUTES.cbegin(), LINK_PROBE_ATTRIBUTES.cend(), &linkProbeAnswered, LINK_PROBE_TIMEOUT_MS * 1000U, nullptr)) {
+    linkHealth.Probe_Sent(now);
+  }
+  const Link_State previous = linkHealth.Get_State();
+  const Link_State state = linkHealth.Update(now);
+  if (state == Link_State::DEAD) {
+    traceEvent(Trace_Event::LINK_RECONNECT, linkHealth.Get_Lost_Probes(), static_cast<int32_t>(linkHealth.Get_Rssi()));
+    proactiveReconnects.Increment();
+    tb.disconnect();
+    return;
+  }
+  if (state != previous) {
+    traceEvent(state == Link_State::HEALTHY ? Trace_Event::LINK_RECOVERED : Trace_Event::LINK_DEGRADED, linkHealth.Get_Score(), static_cast<int32_t>(linkHealth.Get_Rtt()));
+  }
+#if TELEMETRY_BACKFILL
+  if (backfillUsable() && backfill.Has_Pending() && !backfillTimer.Is_Armed()) {
+    timers.Start(backfillTimer, BACKFILL_UPLOAD_INTERVAL_MS);
+  }
+#endif // TELEMETRY_BACKFILL
+}
+#endif // LINK_HEALTH
+
+#if BROKER_FAILOVER
+void maintainStandby(void *context);
+Timer_Wheel::Timer standbyTimer(&maintainStandby);
+
+/// @brief Timer callback keeping the standby connection to the standby broker open, which doubles as its reachability check,
+/// and falling back to a more preferred broker once it stayed reachable for the holdoff. Opening the connection blocks for up to STANDBY_CONNECT_TIMEOUT_MS,
+/// it is therefore only done while connected, while disconnected loop() connects to the active broker instead
+void maintainStandby(void *context) {
+  timers.Start(standbyTimer, STANDBY_REFRESH_MS);
+  if (!tb.connected()) {
+    return;
+  }
+  const size_t standby = brokers.Get_Standby_Index(millis());
+  if (standby >= THINGSBOARD_BROKER_COUNT) {
+    return;
+  }
+  const bool reachable = standbyClient.Warm(THINGSBOARD_BROKERS[standby], STANDBY_CONNECT_TIMEOUT_MS);
+  const uint32_t now = millis();
+  brokers.Checked(standby, reachable, now);
+  if (!brokers.Is_Fallback_Due(now)) {
+    return;
+  }
+  // Planned switch, closing the connection does not count as failure and loop() connects over the standby connection right away
+  brokers.Switch_To(standby);
+  brokerConnected = false;
+  brokerSwitches.Increment();
+  traceEvent(Trace_Event::BROKER_SWITCH, standby, 1);
+  tb.disconnect();
+}
+#endif // BROKER_FAILOVER
+
+/// @brief Timer callback toggling the led while in blinking mode, restarts itself until the mode changes
+void blinkLed(void *context) {
+  if (ledMode != 1) {
+    return;
+  }
+  timers.Start(blinkTimer, blinkingInterval);
+  ledState = !ledState;
+  countPublish(tb.sendTelemetryData(telemetryKeys.Key(LED_STATE_ATTR), ledState));
+  countPublish(tb.sendAttributeData(LED_STATE_ATTR, ledState));
+  traceEvent(Trace_Event::LED_TOGGLED, ledState, 0);
+  if (LED_BUILTIN != 99) {
+    digitalWrite(LED_BUILTIN, ledState);
+  }
+}
+
+/// @brief Timer callback sending telemetry and device attributes every telemetrySendInterval.
+/// loop() advances the timers before it handles the connection, so the measurements are taken during WiFi and broker outages as well,
+/// while the link is not usable they are recorded into the backfill instead of being sent
+void sendPeriodicTelemetry(void *context) {
+  timers.Start(telemetryTimer, telemetrySendInterval);
+  // Probes are linearized with a table lookup, raw readings are sent as well, they are needed to calibrate the probes
+  const uint32_t thermistorRaw = analogRead(THERMISTOR_PIN);
+  const uint32_t phRaw = analogRead(PH_PIN);
+  char telemetry[128];
+  Json_Writer telemetryWriter(telemetry, sizeof(telemetry));
+  telemetryWriter.Begin_Object();
+  telemetryWriter.Add(telemetryKeys.Key("thermistorRaw"), thermistorRaw);
+  telemetryWriter.Add(telemetryKeys.Key("phRaw"), phRaw);
+  if (thermistorCalibration.Is_Calibrated()) {
+    const float temperature = thermistorCalibration.Temperature(thermistorRaw);
+    telemetryWriter.Add(telemetryKeys.Key(TEMPERATURE_KEY), temperature);
+    if (phCalibration.Is_Calibrated()) {
+      telemetryWriter.Add(telemetryKeys.Key(PH_KEY), phCalibration.PH(phRaw, temperature));
+    }
+  }
+  telemetryWriter.End_Object();
+  const int32_t rssi = WiFi.RSSI();
+#if LINK_HEALTH
+  linkHealth.Add_Rssi(millis(), rssi);
+#endif // LINK_HEALTH
+#if TELEMETRY_BACKFILL
+  // Nothing can be sent while disconnected, and what is sent over a degraded link would likely be lost, only the measurements are kept to be uploaded later
+  if (!linkUsable()) {
+    backfill.Record(millis(), telemetryWriter.Get_String(), telemetryWriter.Length());
+    return;
+  }
+  if (backfill.Has_Pending() && !backfillTimer.Is_Armed()) {
+    timers.Start(backfillTimer, BACKFILL_UPLOAD_INTERVAL_MS);
+  }
+#endif // TELEMETRY_BACKFILL
+  const bool telemetrySent = countPublish(tb.sendTelemetryString(telemetryWriter.Get_String()));
+  traceEvent(Trace_Event::TELEMETRY_SENT, telemetryWriter.Length(), telemetrySent);
+  // Serialize all attributes in a single pass into one message, instead of publishing every key on its own
+  char payload[192];
+  Json_Writer writer(payload, sizeof(payload));
+  writer.Begin_Object();
+  writer.Add("rssi", rssi);
+  writer.Add("channel", WiFi.channel());
+  writer.Add("bssid", WiFi.BSSIDstr().c_str());
+  writer.Add("localIp", WiFi.localIP().toString().c_str());
+  writer.Add("ssid", WiFi.SSID().c_str());
+  writer.End_Object();
+  if (!writer.Overflowed()) {
+    countPublish(tb.sendAttributeString(writer.Get_String()));
+  }
+  if (recipe.Is_Running()) {
+    sendRecipeStatus();
+  }
+  if (temperatureController != TemperatureController::OFF) {
+    char control[96];
+    Json_Writer controlWriter(control, sizeof(control));
+    controlWriter.Begin_Object();
+    controlWriter.Add(telemetryKeys.Key(CONTROLLER_KEY), static_cast<int>(temperatureController));
+    controlWriter.Add(telemetryKeys.Key("heaterOutput"), heaterOutput);
+    controlWriter.Add(telemetryKeys.Key("controllerSolveUs"), controllerSolveMicros);
+    controlWriter.End_Object();
+    if (controlWriter.Overflowed()) {
+      Serial.println("Control telemetry does not fit into its buffer, not sent");
+    }
+    else {
+      countPublish(tb.sendTelemetryString(controlWriter.Get_String()));
+    }
+  }
+#if NETWORK_IMPAIRMENT
+  // Compared with the telemetry and rpc timestamps on the server, gives the delivery ratio and latency under the emulated conditions
+  const Impairment_Statistics &impairment = impairedClient.Get_Statistics();
+  char network[256];
+  Json_Writer networkWriter(network, sizeof(network));
+  networkWriter.Begin_Object();
+  networkWriter.Add("impairedSegments", impairment.segments_written);
+  networkWriter.Add("impairedRetransmissions", impairment.retransmissions);
+  networkWriter.Add("impairedDisconnects", impairment.disconnects);
+  networkWriter.Add("impairedRefusedConnects", impairment.refused_connects);
+  networkWriter.Add("impairedBytesSent", impairment.bytes_sent);
+  // Windows in which the connection was half-open and published data was lost, shortened by the proactive reconnects of the link health monitoring
+  networkWriter.Add("impairedStalls", impairment.stalls);
+  networkWriter.Add("impairedStalledMs", impairment.stalled_ms);
+  networkWriter.Add("impairedBytesLost", impairment.bytes_lost);
+  networkWriter.End_Object();
+  if (!networkWriter.Overflowed()) {
+    countPublish(tb.sendTelemetryString(networkWriter.Get_String()));
+  }
+#endif // NETWORK_IMPAIRMENT
+}
+
+#if RUNTIME_METRICS
+Metrics_Registry<24U> metrics;
+
+void publishMetrics(void *context);
+Timer_Wheel::Timer metricsTimer(&publishMetrics);
+
+/// @brief Registers the runtime metrics, values already tracked by the apis and the platform are read when the snapshot is taken
+void registerMetrics() {
+  metrics.Add("messagesPublished", messagesPublished);
+  metrics.Add("publishFailures", publishFailures);
+  metrics.Add("mqttConnects", mqttConnects);
+  metrics.Add("wifiReconnects", wifiReconnects);
+  metrics.Add("attributeUpdates", attributeUpdates);
+  metrics.Add("loopIterations", loopIterations);
+  metrics.Add("rpcsHandled", []() -> uint32_t {
+    return rpc.Get_Handled();
+  });
+  metrics.Add("rssi", []() -> float {
+    return WiFi.RSSI();
+  });
+  metrics.Add("freeHeap", []() -> float {
+    return ESP.getFreeHeap();
+  });
+  metrics.Add("heaterOutput", []() -> float {
+    return heaterOutput;
+  });
+  metrics.Add("controlSolveUs", controlSolveUs);
+  metrics.Add("loopBusyUs", loopBusyUs);
+#if LINK_HEALTH
+  metrics.Add("proactiveReconnects", proactiveReconnects);
+  metrics.Add("linkScore", []() -> float {
+    return linkHealth.Get_Score();
+  });
+  metrics.Add("linkRttMs", []() -> float {
+    return linkHealth.Get_Rtt();
+  });
+#endif // LINK_HEALTH
+#if BROKER_FAILOVER
+  metrics.Add("brokerSwitches", brokerSwitches);
+  metrics.Add("activeBroker", []() -> uint32_t {
+    return brokers.Get_Active_Index();
+  });
+#endif // BROKER_FAILOVER
+}
+
+/// @brief Timer callback publishing a snapshot of every runtime metric as a single telemetry message every METRICS_PUBLISH_INTERVAL_MS
+void publishMetrics(void *context) {
+  timers.Start(metricsTimer, METRICS_PUBLISH_INTERVAL_MS);
+  if (!tb.connected()) {
+    return;
+  }
+  char payload[704];
+  Json_Writer writer(payload, sizeof(payload));
+  writer.Begin_Object();
+  metrics.Write(writer);
+  writer.End_Object();
+  if (!writer.Overflowed()) {
+    countPublish(tb.sendTelemetryString(writer.Get_String()));
+  }
+}
+#endif // RUNTIME_METRICS
+
+/// @brief Publishes the dictionary of the interned telemetry keys, has to be sent after every connect before any telemetry,
+/// so the receiver always knows the ids of the current firmware. Keys are sent with their names until the receiver acknowledged it
+void publishTelemetryKeys() {
+#if TELEMETRY_KEY_INTERNING
+  // The receiver might have changed while disconnected, the acknowledgement is requested with the shared attributes after every connect
+  telemetryKeys.Acknowledge(0U);
+  char payload[384];
+  Json_Writer writer(payload, sizeof(payload));
+  writer.Begin_Object();
+  writer.Key(TELEMETRY_KEYS_ATTR);
+  telemetryKeys.Write(writer);
+  writer.End_Object();
+  if (!writer.Overflowed()) {
+    countPublish(tb.sendAttributeString(writer.Get_String()));
+  }
+#endif // TELEMETRY_KEY_INTERNING
+}
+
+#if defined(__cpp_impl_coroutine)
+// Connect sequence, runs next to loop() instead of blocking it
+Device_Task connectTask;
+
+/// @brief Connects to ThingsBoard and requests the current attribute states.
+/// Failed connection attempts are retried with an exponential backoff, while waiting for the
+/// backoff or the attribute responses the task is suspended and loop() keeps running
+/// @return Whether the whole sequence was successful
+Device_Task connectToThingsBoard() {
+  uint32_t retryDelay = CONNECT_RETRY_MIN_MS;
+  while (true) {
+    traceEvent(Trace_Event::CONNECT_ATTEMPT, retryDelay, 0);
+    const uint32_t connectStart = micros();
+    const Broker_Endpoint broker = activeBroker();
+    if (tb.connect(broker.host, TOKEN, broker.port)) {
+      traceEvent(Trace_Event::CONNECTED, micros() - connectStart, 0);
+      mqttConnects.Increment();
+      brokerConnectSucceeded();
+#if LINK_HEALTH
+      linkHealth.Reset(millis());
+#endif // LINK_HEALTH
+      break;
+    }
+    traceEvent(Trace_Event::CONNECT_FAILED, micros() - connectStart, 0);
+    if (brokerConnectFailed()) {
+      // The standby broker is likely reachable, backing off would only lengthen the gap
+      retryDelay = CONNECT_RETRY_MIN_MS;
+      continue;
+    }
+    co_await Delay_Awaitable(timers, retryDelay);
+    retryDelay = retryDelay * 2U < CONNECT_RETRY_MAX_MS ? retryDelay * 2U : CONNECT_RETRY_MAX_MS;
+  }
+  // Sending a MAC address as an attribute
+  countPublish(tb.sendAttributeData("macAddress", WiFi.macAddress().c_str()));
+  publishTelemetryKeys();
+
+  // Both requests are sent before awaiting either of them, so they are in flight at the same time
+  auto sharedRequest = Await_Shared_Attributes(requests, SHARED_ATTRIBUTES_LIST.cbegin(), SHARED_ATTRIBUTES_LIST.cend(), REQUEST_TIMEOUT_MICROSECONDS, &processSharedAttributesResponse);
+  auto clientRequest = Await_Client_Attributes(requests, CLIENT_ATTRIBUTES_LIST.cbegin(), CLIENT_ATTRIBUTES_LIST.cend(), REQUEST_TIMEOUT_MICROSECONDS, &processClientAttributes);
+  const Request_Result sharedResult = co_await sharedRequest;
+  const Request_Result clientResult = co_await clientRequest;
+  if (sharedResult == Request_Result::TIMEOUT || clientResult == Request_Result::TIMEOUT) {
+    requestTimedOut();
+  }
+  if (sharedResult != Request_Result::RESPONSE || clientResult != Request_Result::RESPONSE) {
+    traceEvent(Trace_Event::ATTRIBUTE_REQUEST_FAILED, clientResult != Request_Result::RESPONSE, 0);
+    co_return false;
+  }
+  co_return true;
+}
+#endif // defined(__cpp_impl_coroutine)
 
 void setup() {
   // Initialize serial connection for debugging
@@ -214,92 +1432,161 @@ void setup() {
     pinMode(LED_BUILTIN, OUTPUT);
   }
   delay(1000);
+  pinMode(HEATER_PIN, OUTPUT);
+  analogWrite(HEATER_PIN, 0);
+  PID_Gains gains;
+  gains.kp = 0.4f;
+  gains.ki = 0.0004f;
+  gains.kd = 30.0f;
+  pid.Set_Gains(gains);
+  MPC_Settings settings;
+  settings.tick_seconds = CONTROL_TICK_MS / 1000.0f;
+  mpc.Configure(Thermal_Model(), settings);
+  loadCalibration();
   InitWiFi();
+
+  // Callbacks only have to be subscribed once, the library subscribes the topics again automatically after every reconnect.
+  // All consequent data processing will happen in the functions denoted by the callbacks array.
+  Serial.println("Subscribing for RPC...");
+  if (!rpc.RPC_Subscribe(callbacks.cbegin(), callbacks.cend())) {
+    Serial.println("Failed to subscribe for RPC");
+  }
+  if (!shared_update.Shared_Attributes_Subscribe(attributes_callback)) {
+    Serial.println("Failed to subscribe for shared attribute updates");
+  }
+  Serial.println("Subscribe done");
+
+  timers.Start(telemetryTimer, telemetrySendInterval);
+#if LINK_HEALTH
+  Link_Health_Settings linkSettings;
+  linkSettings.probe_timeout_ms = LINK_PROBE_TIMEOUT_MS;
+  linkHealth.Configure(linkSettings);
+  timers.Start(linkTimer, LINK_CHECK_INTERVAL_MS);
+#endif // LINK_HEALTH
+#if BROKER_FAILOVER
+  timers.Start(standbyTimer, STANDBY_REFRESH_MS);
+#endif // BROKER_FAILOVER
+#if RUNTIME_METRICS
+  registerMetrics();
+  timers.Start(metricsTimer, METRICS_PUBLISH_INTERVAL_MS);
+#endif // RUNTIME_METRICS
+}
+
+/// @brief Applies and reports changes of the led mode and state made by rpcs and shared attribute updates
+void applyAttributeChanges() {
+  if (!attributesChanged) {
+    return;
+  }
+  attributesChanged = false;
+  if (ledMode == 1) {
+    if (!blinkTimer.Is_Armed()) {
+      timers.Start(blinkTimer, blinkingInterval);
+    }
+  } else {
+    timers.Stop(blinkTimer);
+  }
+  // Both keys are sent in one message instead of one publish per key
+  char payload[64];
+  Json_Writer writer(payload, sizeof(payload));
+  writer.Begin_Object();
+  writer.Add(LED_MODE_ATTR, (int)ledMode);
+  writer.Add(LED_STATE_ATTR, (bool)ledState);
+  writer.End_Object();
+  countPublish(tb.sendTelemetryString(writer.Get_String()));
+  countPublish(tb.sendAttributeString(writer.Get_String()));
 }
 
 void loop() {
-  delay(10);
+  loopIterations.Increment();
+  checkHeaterStale();
+  flushDiagnostics();
+
+  // Instead of a fixed delay, block until a message arrives or the next timer is due,
+  // so idle iterations cost no CPU time and received rpcs are processed immediately
+  if (tb.connected()) {
+    uint32_t idleWait = timers.Milliseconds_Until_Next(millis());
+    if (idleWait > MAX_IDLE_WAIT_MS) {
+      idleWait = MAX_IDLE_WAIT_MS;
+    }
+    // A pending change is applied right away instead of after the wait
+    if (attributesChanged) {
+      idleWait = 0U;
+    }
+#if NETWORK_IMPAIRMENT
+    // Delayed bytes are released by the impaired client itself, the socket does not signal them
+    const uint32_t releaseWait = impairedClient.Milliseconds_Until_Next_Release();
+    if (idleWait > releaseWait) {
+      idleWait = releaseWait;
+    }
+#endif // NETWORK_IMPAIRMENT
+#if BROKER_FAILOVER
+    Network_Wait::Wait_For_Readable(standbyClient.Get_Active(), idleWait);
+#else
+    Network_Wait::Wait_For_Readable(wifiClient, idleWait);
+#endif // BROKER_FAILOVER
+  } else {
+    delay(10);
+  }
+
+  const uint32_t busyStart = micros();
+  // Calls the callbacks of all timers that expired since the last iteration, before and independent of the connection,
+  // the control loop and the measurements keep running while the WiFi or the broker are unreachable
+  timers.Advance(millis());
 
   if (!reconnect()) {
     return;
   }
 
   if (!tb.connected()) {
-    // Connect to the ThingsBoard
-    Serial.print("Connecting to: ");
-    Serial.print(THINGSBOARD_SERVER);
-    Serial.print(" with token ");
-    Serial.println(TOKEN);
-    if (!tb.connect(THINGSBOARD_SERVER, TOKEN, THINGSBOARD_PORT)) {
-      Serial.println("Failed to connect");
-      return;
+#if BROKER_FAILOVER
+    // A lost connection counts as failure of the broker, the next connect then goes to the standby broker
+    if (brokerConnected) {
+      brokerConnectFailed();
     }
-    // Sending a MAC address as an attribute
-    tb.sendAttributeData("macAddress", WiFi.macAddress().c_str());
-
-    Serial.println("Subscribing for RPC...");
-    // Perform a subscription. All consequent data processing will happen in
-    // processSetLedState() and processSetLedMode() functions,
-    // as denoted by callbacks array.
-    if (!rpc.RPC_Subscribe(callbacks.cbegin(), callbacks.cend())) {
-      Serial.println("Failed to subscribe for RPC");
-      return;
+#endif // BROKER_FAILOVER
+#if defined(__cpp_impl_coroutine)
+    // Only start a new sequence once the previous one finished, a running sequence
+    // is resumed by the timer wheel (backoff) and the request callbacks
+    if (connectTask.Done()) {
+      connectTask = connectToThingsBoard();
     }
-
-    if (!shared_update.Shared_Attributes_Subscribe(attributes_callback)) {
-      Serial.println("Failed to subscribe for shared attribute updates");
+    return;
+#else
+    // Connect to the ThingsBoard
+    traceEvent(Trace_Event::CONNECT_ATTEMPT, 0, 0);
+    const uint32_t connectStart = micros();
+    const Broker_Endpoint broker = activeBroker();
+    if (!tb.connect(broker.host, TOKEN, broker.port)) {
+      traceEvent(Trace_Event::CONNECT_FAILED, micros() - connectStart, 0);
+      brokerConnectFailed();
       return;
     }
+    traceEvent(Trace_Event::CONNECTED, micros() - connectStart, 0);
+    mqttConnects.Increment();
+    brokerConnectSucceeded();
+#if LINK_HEALTH
+    linkHealth.Reset(millis());
+#endif // LINK_HEALTH
+    // Sending a MAC address as an attribute
+    countPublish(tb.sendAttributeData("macAddress", WiFi.macAddress().c_str()));
+    publishTelemetryKeys();
 
-    Serial.println("Subscribe done");
-
-    // Request current states of shared attributes
-    if (!attr_request.Shared_Attributes_Request(attribute_shared_request_callback)) {
-      Serial.println("Failed to request for shared attributes");
+    // Request current states of shared and client attributes, both requests are sent
+    // without waiting for the response of the other, the responses are handled as they arrive
+    if (!requests.Shared_Attributes_Request(SHARED_ATTRIBUTES_LIST.cbegin(), SHARED_ATTRIBUTES_LIST.cend(), &processSharedAttributesResponse, REQUEST_TIMEOUT_MICROSECONDS, &requestTimedOut)) {
+      traceEvent(Trace_Event::ATTRIBUTE_REQUEST_FAILED, 0, 0);
       return;
     }
 
-    // Request current states of client attributes
-    if (!attr_request.Client_Attributes_Request(attribute_client_request_callback)) {
-      Serial.println("Failed to request for client attributes");
+    if (!requests.Client_Attributes_Request(CLIENT_ATTRIBUTES_LIST.cbegin(), CLIENT_ATTRIBUTES_LIST.cend(), &processClientAttributes, REQUEST_TIMEOUT_MICROSECONDS, &requestTimedOut)) {
+      traceEvent(Trace_Event::ATTRIBUTE_REQUEST_FAILED, 1, 0);
       return;
     }
-  }
-
-  if (attributesChanged) {
-    attributesChanged = false;
-    if (ledMode == 0) {
-      previousStateChange = millis();
-    }
-    tb.sendTelemetryData(LED_MODE_ATTR, ledMode);
-    tb.sendTelemetryData(LED_STATE_ATTR, ledState);
-    tb.sendAttributeData(LED_MODE_ATTR, ledMode);
-    tb.sendAttributeData(LED_STATE_ATTR, ledState);
-  }
-
-  if (ledMode == 1 && millis() - previousStateChange > blinkingInterval) {
-    previousStateChange = millis();
-    ledState = !ledState;
-    tb.sendTelemetryData(LED_STATE_ATTR, ledState);
-    tb.sendAttributeData(LED_STATE_ATTR, ledState);
-    if (LED_BUILTIN == 99) {
-      Serial.print("LED state changed to: ");
-      Serial.println(ledState);
-    } else {
-      digitalWrite(LED_BUILTIN, ledState);
-    }
-  }
-
-  // Sending telemetry every telemetrySendInterval time
-  if (millis() - previousDataSend > telemetrySendInterval) {
-    previousDataSend = millis();
-    tb.sendTelemetryData("temperature", random(10, 20));
-    tb.sendAttributeData("rssi", WiFi.RSSI());
-    tb.sendAttributeData("channel", WiFi.channel());
-    tb.sendAttributeData("bssid", WiFi.BSSIDstr().c_str());
-    tb.sendAttributeData("localIp", WiFi.localIP().toString().c_str());
-    tb.sendAttributeData("ssid", WiFi.SSID().c_str());
+#endif // defined(__cpp_impl_coroutine)
   }
 
   tb.loop();
+  // Changes made by the rpcs and attribute updates processed just now are applied before the next iteration blocks
+  applyAttributeChanges();
+  loopBusyUs.Record(micros() - busyStart);
 }
\ No newline at end of file
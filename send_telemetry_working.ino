@@ -1,5 +1,9 @@
 #include <WiFi.h> // WiFi control for ESP32
 #include <ThingsBoard.h> // ThingsBoard SDK
+#include <esp_sleep.h> // Deep sleep and wakeup sources
+#include <sys/time.h> // Wall clock, kept by the RTC timer across deep sleep
+#include "Json_Writer.h" // Single pass JSON serialization of the batches
+#include "Philox.h" // Counter based random numbers for the simulated readings
 
 // WiFi
 #define WIFI_AP_NAME "myhotspot"
@@ -9,45 +13,266 @@
 #define TOKEN "YXVimQYQcWeT1KkyRANw"
 #define THINGSBOARD_SERVER "demo.thingsboard.io"
 #define MQTT_PORT 1883
+
+// Seed of the simulated readings, every device draws its own sequence from it, keyed by its MAC address.
+// The value of a sample only depends on the seed, the device and the message counter, so a run is reproducible
+// and no generator state has to be kept in RTC memory across deep sleep
+#define SIMULATION_SEED 1ULL
+
+// Duty-cycled mode, for battery powered auxiliary sensors (e.g. ambient room probes).
+// Instead of keeping the radio on and waiting in delay() between samples, the chip deep sleeps,
+// appends every sample to RTC memory (which survives deep sleep) and only brings the radio up
+// every SAMPLES_PER_FLUSH samples to upload the whole batch at once.
+// Set to 0 to get the original always connected behaviour
+#define DUTY_CYCLED_MODE 1
+#define SAMPLE_PERIOD_MS 1000
+#define SAMPLES_PER_FLUSH 30
+// Maximum size of one batched telemetry message, batches that are bigger are split into multiple messages
+#define FLUSH_PAYLOAD_SIZE 256
+#define NTP_SERVER "pool.ntp.org"
+// Maximum time a flush waits for the access point, afterwards the device goes back to deep sleep with the samples still buffered
+#define WIFI_CONNECT_TIMEOUT_MS 15000
+// Failed flushes are retried with an exponential backoff, counted in sample wakeups, so a missing access point or server does not keep the radio on every wakeup
+#define FLUSH_RETRY_MAX_WAKEUPS 600
+
+// Energy model used to report the expected average current draw of the duty cycle.
+// Values are typical ESP32 figures, adjust them to the measured values of the actual board
+#define RADIO_ACTIVE_CURRENT_MA 120.0f // CPU at full speed with WiFi associated and transmitting
+#define CPU_ACTIVE_CURRENT_MA 30.0f // CPU awake with the radio powered down, while sampling
+#define DEEP_SLEEP_CURRENT_MA 0.01f // RTC timer and RTC memory only
+#define BATTERY_CAPACITY_MAH 2000.0f
+
 WiFiClient espClient; // Initialize ThingsBoard client
-ThingsBoard tb(espClient); // Initialize ThingsBoard instance
+ThingsBoardSized<FLUSH_PAYLOAD_SIZE> tb(espClient); // Initialize ThingsBoard instance
 int status = WL_IDLE_STATUS; // the Wifi radio's status
 
 //INITIALISE READING VARIABLES
-static uint16_t messageCounter = 0;
 static uint16_t temp = 25;
 static uint16_t rpm = 1600;
 float ph = 7;
 
-void InitWiFi()
+#if DUTY_CYCLED_MODE
+// One buffered reading, ts is the unix time in milliseconds or 0 if the clock was never synchronized
+struct Sample {
+  uint64_t ts;
+  uint16_t count;
+  float randomVal;
+};
+
+// Everything declared with RTC_DATA_ATTR survives deep sleep, but not a power cycle
+RTC_DATA_ATTR static uint16_t messageCounter = 0;
+RTC_DATA_ATTR static Sample samples[SAMPLES_PER_FLUSH];
+RTC_DATA_ATTR static uint8_t sampleCount = 0;
+// Accumulated awake time for the energy model, split into sample only wakeups and flushing wakeups
+RTC_DATA_ATTR static uint32_t sampleWakeups = 0;
+RTC_DATA_ATTR static uint32_t sampleAwakeMs = 0;
+RTC_DATA_ATTR static uint32_t flushWakeups = 0;
+RTC_DATA_ATTR static uint32_t flushAwakeMs = 0;
+// Failed flushes in a row and wakeups left until the next flush attempt
+RTC_DATA_ATTR static uint8_t flushFailures = 0;
+RTC_DATA_ATTR static uint16_t flushRetryWakeups = 0;
+#else
+static uint16_t messageCounter = 0;
+#endif // DUTY_CYCLED_MODE
+
+/// @brief Simulated reading in [0, 1) of the given message, replaces random(), whose hidden state restarts after every deep sleep
+float simulatedValue(uint32_t index) {
+  // The low word of the MAC is mostly the vendor prefix, the high bits are folded in so every device gets its own stream
+  static const uint64_t mac = ESP.getEfuseMac();
+  static const Random_Stream simulation(SIMULATION_SEED, (uint32_t)(mac ^ (mac >> 32)), 0);
+  return simulation.Uniform(index);
+}
+
+/// @brief Connects to the access point, gives up after WIFI_CONNECT_TIMEOUT_MS
+/// @return Whether the connection was established
+bool InitWiFi()
 {
   Serial.println("Connecting to AP ...");
   // attempt to connect to WiFi network
   WiFi.begin(WIFI_AP_NAME, WIFI_PASSWORD);
+  const uint32_t start = millis();
   while (WiFi.status() != WL_CONNECTED) {
+    if (millis() - start >= WIFI_CONNECT_TIMEOUT_MS) {
+      Serial.println("Failed to connect to AP");
+      return false;
+    }
     delay(500);
     Serial.print(".");
   }
   Serial.println("Connected to AP");
+  return true;
 }
 
 void reconnect() {
   // Loop until we're reconnected
   status = WiFi.status();
   if ( status != WL_CONNECTED) {
-    WiFi.begin(WIFI_AP_NAME, WIFI_PASSWORD);
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
+    // Bounded, loop() tries again on its next iteration
+    InitWiFi();
   }
-  Serial.println("Connected to AP");
+}
+
+#if DUTY_CYCLED_MODE
+/// @brief Current unix time in milliseconds, or 0 if the clock has never been synchronized with NTP.
+/// The RTC timer keeps the time running during deep sleep, so one synchronization per flush is enough
+uint64_t currentTimeMs() {
+  struct timeval now;
+  gettimeofday(&now, nullptr);
+  // Anything before 2020 means the clock still starts at the epoch and was never set
+  if (now.tv_sec < 1577836800) {
+    return 0;
   }
+  return (uint64_t)now.tv_sec * 1000ULL + now.tv_usec / 1000;
 }
 
+/// @brief Takes one reading and appends it to the RTC retained buffer
+void takeSample() {
+  Sample &sample = samples[sampleCount++];
+  sample.ts = currentTimeMs();
+  sample.count = ++messageCounter;
+  sample.randomVal = simulatedValue(sample.count);
+}
+
+/// @brief Serializes one sample as element of a batch, samples that have a timestamp are sent with it,
+/// so the server stores them at the time they were taken
+void writeSample(Json_Writer &writer, const Sample &sample) {
+  writer.Begin_Object();
+  if (sample.ts != 0) {
+    writer.Add("ts", sample.ts);
+    writer.Key("values");
+    writer.Begin_Object();
+  }
+  writer.Add("count", sample.count);
+  writer.Add("randomVal", sample.randomVal);
+  if (sample.ts != 0) {
+    writer.End_Object();
+  }
+  writer.End_Object();
+}
+
+/// @brief Uploads all buffered samples, split into as few messages as FLUSH_PAYLOAD_SIZE allows (see tools/telemetry_batch_benchmark.cpp).
+/// Sent samples are removed from the buffer, the remaining ones are retried on the next flush
+/// @return Whether all samples were sent
+bool sendBatch() {
+  char payload[FLUSH_PAYLOAD_SIZE];
+  char scratch[FLUSH_PAYLOAD_SIZE];
+  const size_t sent = Send_Json_Batches(samples, sampleCount, payload, scratch, sizeof(payload), &writeSample, [](const char *json, size_t) {
+    return tb.sendTelemetryJson(json);
+  });
+  memmove(samples, samples + sent, (sampleCount - sent) * sizeof(Sample));
+  sampleCount -= sent;
+  return sampleCount == 0;
+}
+
+/// @brief Prints and uploads the average current draw and battery life expected from the measured awake times,
+/// as well as the worst case latency between taking a sample and it arriving on the server
+void reportEnergyModel() {
+  if (sampleWakeups == 0 || flushWakeups == 0) {
+    return;
+  }
+  const float cycleMs = (float)SAMPLES_PER_FLUSH * SAMPLE_PERIOD_MS;
+  const float sampleMs = (float)sampleAwakeMs / sampleWakeups;
+  const float flushMs = (float)flushAwakeMs / flushWakeups;
+  // Charge used by one full cycle of SAMPLES_PER_FLUSH - 1 sample wakeups and one flush wakeup, in mA * ms
+  const float awakeCharge = (SAMPLES_PER_FLUSH - 1) * sampleMs * CPU_ACTIVE_CURRENT_MA + flushMs * RADIO_ACTIVE_CURRENT_MA;
+  const float sleepMs = cycleMs - (SAMPLES_PER_FLUSH - 1) * sampleMs - flushMs;
+  const float averageCurrentMa = (awakeCharge + (sleepMs > 0 ? sleepMs : 0) * DEEP_SLEEP_CURRENT_MA) / cycleMs;
+  const float batteryLifeH = BATTERY_CAPACITY_MAH / averageCurrentMa;
+  const float maxLatencyS = (cycleMs + flushMs) / 1000.0f;
+
+  Serial.print("Energy model: sample wakeup ");
+  Serial.print(sampleMs);
+  Serial.print(" ms, flush wakeup ");
+  Serial.print(flushMs);
+  Serial.print(" ms, average current ");
+  Serial.print(averageCurrentMa);
+  Serial.print(" mA, battery life ");
+  Serial.print(batteryLifeH);
+  Serial.print(" h, worst case latency ");
+  Serial.print(maxLatencyS);
+  Serial.println(" s");
+  tb.sendTelemetryFloat("avgCurrentMa", averageCurrentMa);
+  tb.sendTelemetryFloat("batteryLifeH", batteryLifeH);
+  tb.sendTelemetryFloat("maxLatencyS", maxLatencyS);
+}
+
+/// @brief Connects WiFi and ThingsBoard, uploads the buffered samples and shuts the radio down again
+/// @return Whether all buffered samples were uploaded
+bool flushSamples() {
+  if (!InitWiFi()) {
+    WiFi.disconnect(true);
+    WiFi.mode(WIFI_OFF);
+    return false;
+  }
+  bool flushed = false;
+  // Synchronizing once per flush is enough, the RTC timer keeps the clock running while sleeping
+  configTime(0, 0, NTP_SERVER);
+
+  Serial.print("Connecting to: ");
+  Serial.print(THINGSBOARD_SERVER);
+  Serial.print(" with token ");
+  Serial.println(TOKEN);
+  if (!tb.connect(THINGSBOARD_SERVER, TOKEN, MQTT_PORT)) {
+    // Samples stay buffered, once the buffer is full the oldest ones are dropped to keep sampling
+    Serial.println("Failed to connect");
+  }
+  else {
+    Serial.print("Sending batch of ");
+    Serial.print(sampleCount);
+    Serial.println(" samples");
+    flushed = sendBatch();
+    if (!flushed) {
+      Serial.println("Failed to send batch");
+    }
+    reportEnergyModel();
+    tb.loop();
+    tb.disconnect();
+  }
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+  return flushed;
+}
+#endif // DUTY_CYCLED_MODE
+
 void setup() {
   Serial.begin(9600);
+#if DUTY_CYCLED_MODE
+  // Never returns, every wakeup from deep sleep starts again at setup()
+  if (sampleCount == SAMPLES_PER_FLUSH) {
+    // Buffer is still full because the last flush failed, drop the oldest sample
+    memmove(samples, samples + 1, (SAMPLES_PER_FLUSH - 1) * sizeof(Sample));
+    sampleCount--;
+  }
+  takeSample();
+  if (flushRetryWakeups > 0) {
+    flushRetryWakeups--;
+  }
+  if (sampleCount < SAMPLES_PER_FLUSH || flushRetryWakeups > 0) {
+    sampleWakeups++;
+    sampleAwakeMs += millis();
+  }
+  else {
+    if (flushSamples()) {
+      flushFailures = 0;
+    }
+    else {
+      // Wait 2, 4, 8, ... wakeups before the next attempt, the buffer keeps the newest samples in the meantime
+      flushFailures = flushFailures < 15 ? flushFailures + 1 : flushFailures;
+      const uint32_t backoff = 1UL << flushFailures;
+      flushRetryWakeups = backoff < FLUSH_RETRY_MAX_WAKEUPS ? backoff : FLUSH_RETRY_MAX_WAKEUPS;
+    }
+    flushWakeups++;
+    flushAwakeMs += millis();
+  }
+  // Subtract the time we were awake, so samples stay evenly spaced
+  const uint32_t awakeMs = millis();
+  const uint32_t sleepMs = awakeMs < SAMPLE_PERIOD_MS ? SAMPLE_PERIOD_MS - awakeMs : 1;
+  esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000ULL);
+  esp_deep_sleep_start();
+#else
   WiFi.begin(WIFI_AP_NAME, WIFI_PASSWORD);
   InitWiFi();
+#endif // DUTY_CYCLED_MODE
 }
 void loop() {
   delay(1000);
@@ -69,8 +294,8 @@ void loop() {
     }
   }
 
-  float r = (float)random(1000)/1000.0;
   messageCounter++;
+  float r = simulatedValue(messageCounter);
   Serial.print("Sending data...[");
   Serial.print(messageCounter);
   Serial.print("]: ");
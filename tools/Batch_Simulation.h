@@ -0,0 +1,116 @@
+#ifndef Batch_Simulation_h
+#define Batch_Simulation_h
+
+// Local includes.
+#include "Noise_Model.h"
+#include "Thermal_Model.h"
+
+// Library includes.
+#include <chrono>
+#include <cmath>
+#include <stddef.h>
+
+
+/// @brief Setpoint the batch switches to at the given time
+struct Setpoint_Phase {
+    float start_seconds; // Time since the start of the batch
+    float setpoint_c;    // Medium temperature setpoint from then on
+};
+
+/// @brief Setpoint profile of one simulated batch, the first phase starts at 0
+struct Batch_Profile {
+    char const *           name;             // Name written into result tables
+    Setpoint_Phase const * phases;           // Phases ordered by start time
+    size_t                 phase_count;      // Amount of phases
+    float                  duration_seconds; // Length of the batch
+};
+
+/// @brief Plant the controllers are simulated against, differs from the model the controllers were designed with
+struct Batch_Disturbance {
+    char const *              name;                    // Name written into result tables
+    Thermal_Parameters        plant;                   // Actual parameters of the simulated vessel
+    float                     heat_load_w;             // Unknown heat flow into the medium, for example of an exothermic culture
+    float                     heat_load_start_seconds; // Time the heat load starts at
+    Sensor_Noise_Profile      sensor;                  // Noise, drift and dropouts of the temperature probe, ideal if left out
+    Pulse_Disturbance_Profile feed;                    // Random feed additions, as heat flow pulses into the medium, none if left out
+};
+
+/// @brief Tracking quality of one simulated batch
+struct Batch_Result {
+    double iae = 0.0;               // Integral of the absolute tracking error in kelvin seconds
+    float  overshoot_c = 0.0f;      // Largest temperature above the setpoint during the first phase
+    float  settle_seconds = 0.0f;   // Time until the temperature stays within the settle band during the first phase
+    double mean_microseconds = 0.0; // Mean wall time of one controller update, only measured if requested
+    double max_microseconds = 0.0;  // Worst wall time of one controller update, only measured if requested
+};
+
+/// @brief Band around the setpoint the temperature has to stay in, to be considered settled
+float constexpr BATCH_SETTLE_BAND_C = 0.2f;
+
+
+/// @brief Simulates one batch on a virtual clock, as fast as the host can compute it, the controller is called every tick with the measurement and the setpoint.
+/// Does not share any state, so any amount of batches can be simulated concurrently
+/// @tparam Controller Callable taking the measured temperature and the setpoint and returning the heater duty cycle
+/// @param controller Controller under test, already configured for tick_seconds
+/// @param profile Setpoint profile of the batch
+/// @param disturbance Plant and unknown heat load the controller is simulated against
+/// @param tick_seconds Interval of the control loop
+/// @param measure_time Whether the wall time of every controller update should be measured, adds a clock read per tick
+/// @param seed Seed of the noise of the run, default = 0
+/// @param device Identifier of the simulated device, every device gets independent noise from the same seed, default = 0
+/// @return Tracking quality of the batch
+template<typename Controller>
+Batch_Result Simulate_Batch(Controller const & controller, Batch_Profile const & profile, Batch_Disturbance const & disturbance, float const & tick_seconds, bool const & measure_time = false, uint64_t const & seed = 0U, uint32_t const & device = 0U) {
+    Thermal_Model plant(disturbance.plant);
+    // Counter based noise, the result only depends on the seed and the device, not on which thread simulates the batch or in which order
+    Noisy_Sensor probe(seed, device, 0U, disturbance.sensor);
+    Pulse_Disturbance feed(seed, device, disturbance.feed);
+    float measured = plant.Get_Vessel_Temperature();
+    float const first_phase_end = profile.phase_count > 1U ? profile.phases[1U].start_seconds : profile.duration_seconds;
+
+    Batch_Result result;
+    float last_outside_band = 0.0f;
+    double total_microseconds = 0.0;
+    size_t ticks = 0U;
+    size_t phase = 0U;
+    // Integer tick counter, accumulating the time as a float would drift over long batches
+    size_t const total_ticks = static_cast<size_t>(profile.duration_seconds / tick_seconds);
+    for (size_t tick = 0U; tick < total_ticks; tick++) {
+        float const time = static_cast<float>(tick) * tick_seconds;
+        while (phase + 1U < profile.phase_count && time >= profile.phases[phase + 1U].start_seconds) {
+            phase++;
+        }
+        float const setpoint = profile.phases[phase].setpoint_c;
+        // A dropped out sample keeps the previous measurement, like the device does
+        (void)probe.Sample(tick, plant.Get_Vessel_Temperature(), measured);
+
+        float heater = 0.0f;
+        if (measure_time) {
+            auto const start = std::chrono::steady_clock::now();
+            heater = controller(measured, setpoint);
+            double const microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            total_microseconds += microseconds;
+            result.max_microseconds = microseconds > result.max_microseconds ? microseconds : result.max_microseconds;
+        }
+        else {
+            heater = controller(measured, setpoint);
+        }
+        ticks++;
+
+        float const heat_load = (time >= disturbance.heat_load_start_seconds ? disturbance.heat_load_w : 0.0f) + feed.Value(tick);
+        plant.Step(heater, tick_seconds, heat_load);
+        float const error = plant.Get_Vessel_Temperature() - setpoint;
+        result.iae += std::fabs(error) * tick_seconds;
+        if (time < first_phase_end) {
+            result.overshoot_c = error > result.overshoot_c ? error : result.overshoot_c;
+            if (std::fabs(error) > BATCH_SETTLE_BAND_C) {
+                last_outside_band = time;
+            }
+        }
+    }
+    result.settle_seconds = last_outside_band;
+    result.mean_microseconds = ticks > 0U ? total_microseconds / static_cast<double>(ticks) : 0.0;
+    return result;
+}
+
+#endif // Batch_Simulation_h
@@ -0,0 +1,89 @@
+#ifndef Bioreactor_Model_h
+#define Bioreactor_Model_h
+
+// Library includes.
+#include <math.h>
+#include <stddef.h>
+
+
+/// @brief Kinetic and transfer parameters of the batch culture, time is in hours
+struct Bioreactor_Parameters {
+    double mu_max_per_h = 0.5;               // Maximum specific growth rate
+    double substrate_half_saturation = 0.1;  // Monod constant of the substrate in g/l
+    double oxygen_half_saturation = 0.2;     // Monod constant of the dissolved oxygen in mg/l
+    double biomass_yield = 0.5;              // Biomass formed per substrate consumed in g/g
+    double oxygen_yield = 1.0;               // Biomass formed per oxygen consumed in g/g
+    double co2_yield = 20.0;                 // CO2 released per biomass formed in mmol/g
+    double oxygen_kla_per_h = 200.0;         // Volumetric oxygen transfer coefficient of the sparger
+    double oxygen_saturation = 7.0;          // Dissolved oxygen in equilibrium with the gas phase in mg/l
+    double co2_kla_per_h = 180.0;            // Volumetric CO2 stripping coefficient
+    double co2_saturation = 0.5;             // Dissolved CO2 in equilibrium with the gas phase in mmol/l
+    double bicarbonate = 20.0;               // Bicarbonate buffer of the medium in mmol/l
+    double pka = 6.35;                       // First dissociation constant of carbonic acid
+    double ph_relaxation_per_h = 5000.0;     // Rate the pH follows the acid-base equilibrium at, nearly instantaneous
+};
+
+
+/// @brief Batch culture with Monod growth on a substrate and dissolved oxygen, oxygen transfer from the sparger, CO2 production and stripping
+/// and the pH of a bicarbonate buffer following the dissolved CO2. State y = [biomass g/l, substrate g/l, dissolved oxygen mg/l, dissolved CO2 mmol/l, pH].
+/// The gas transfer (~200 / h) and especially the acid-base equilibrium (~5000 / h) are orders of magnitude faster than the growth (~0.5 / h),
+/// which makes the system stiff: explicit integrators are limited by the fast modes long after they settled
+class Bioreactor_Model {
+  public:
+    /// @brief Amount of state variables
+    static size_t constexpr STATES = 5U;
+
+    enum State : size_t {
+        BIOMASS,
+        SUBSTRATE,
+        OXYGEN,
+        CO2,
+        PH
+    };
+
+    /// @brief Constructor
+    /// @param parameters Kinetic and transfer parameters
+    explicit Bioreactor_Model(Bioreactor_Parameters const & parameters = Bioreactor_Parameters())
+      : m_parameters(parameters)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Typical initial state, inoculated medium in equilibrium with the gas phase
+    /// @param y Receives the initial state
+    void Initial_State(double (&y)[STATES]) const {
+        y[BIOMASS] = 0.1;
+        y[SUBSTRATE] = 10.0;
+        y[OXYGEN] = m_parameters.oxygen_saturation;
+        y[CO2] = m_parameters.co2_saturation;
+        y[PH] = Equilibrium_PH(m_parameters.co2_saturation);
+    }
+
+    /// @brief Right hand side of the model
+    /// @param y Current state
+    /// @param dydt Receives the time derivative of the state per hour
+    void Derivative(double const & /* t */, double const (&y)[STATES], double (&dydt)[STATES]) const {
+        Bioreactor_Parameters const & p = m_parameters;
+        // Concentrations can become slightly negative within the integration error, the rates must not change sign because of that
+        double const substrate = y[SUBSTRATE] > 0.0 ? y[SUBSTRATE] : 0.0;
+        double const oxygen = y[OXYGEN] > 0.0 ? y[OXYGEN] : 0.0;
+        double const co2 = y[CO2] > 1e-6 ? y[CO2] : 1e-6;
+        double const growth = p.mu_max_per_h * substrate / (p.substrate_half_saturation + substrate) * oxygen / (p.oxygen_half_saturation + oxygen) * y[BIOMASS];
+        dydt[BIOMASS] = growth;
+        dydt[SUBSTRATE] = -growth / p.biomass_yield;
+        // Oxygen uptake in g/l/h converted to mg/l/h
+        dydt[OXYGEN] = p.oxygen_kla_per_h * (p.oxygen_saturation - y[OXYGEN]) - 1000.0 * growth / p.oxygen_yield;
+        dydt[CO2] = p.co2_yield * growth - p.co2_kla_per_h * (y[CO2] - p.co2_saturation);
+        dydt[PH] = p.ph_relaxation_per_h * (Equilibrium_PH(co2) - y[PH]);
+    }
+
+  private:
+    /// @brief Henderson-Hasselbalch equation of the bicarbonate buffer
+    double Equilibrium_PH(double const & co2) const {
+        return m_parameters.pka + log10(m_parameters.bicarbonate / co2);
+    }
+
+    Bioreactor_Parameters m_parameters = {}; // Kinetic and transfer parameters
+};
+
+#endif // Bioreactor_Model_h
@@ -0,0 +1,246 @@
+#ifndef Rosenbrock_Integrator_h
+#define Rosenbrock_Integrator_h
+
+// Library includes.
+#include <math.h>
+#include <stddef.h>
+
+
+/// @brief Counters of one integration, used to compare the cost of integrators
+struct Integrator_Statistics {
+    size_t accepted_steps = 0U;       // Steps whose error estimate was within the tolerance
+    size_t rejected_steps = 0U;       // Steps that were repeated with a smaller step size
+    size_t function_evaluations = 0U; // Calls of the right hand side, including the ones for the Jacobian
+    size_t jacobian_evaluations = 0U; // Finite difference Jacobians
+    size_t decompositions = 0U;       // LU decompositions of the iteration matrix
+};
+
+
+/// @brief Linearly implicit Rosenbrock integrator of order 2 with an embedded order 3 error estimate (the method of MATLAB's ode23s, Shampine and Reichelt 1997),
+/// with adaptive step size control. Stable for stiff systems (L-stable), so the step size is only limited by the accuracy of the slow dynamics.
+/// Every step costs one LU decomposition of W = I - h * d * J and three forward and backward substitutions, no Newton iteration.
+/// The Jacobian is computed by finite differences and reused when a step is rejected.
+/// All workspaces are members sized at compile time, integrating never allocates memory
+/// @tparam System Class providing STATES and Derivative(t, y, dydt)
+template<typename System>
+class Rosenbrock_Integrator {
+  public:
+    static size_t constexpr N = System::STATES;
+
+    /// @brief Constructor
+    /// @param relative_tolerance Accepted local error relative to the magnitude of every state
+    /// @param absolute_tolerance Accepted local error of states close to zero
+    Rosenbrock_Integrator(double const & relative_tolerance = 1e-6, double const & absolute_tolerance = 1e-9)
+      : m_relative_tolerance(relative_tolerance)
+      , m_absolute_tolerance(absolute_tolerance)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Integrates the system from t0 to t1
+    /// @param system System that should be integrated
+    /// @param t0 Start time
+    /// @param t1 End time, has to be after t0
+    /// @param y State at t0, receives the state at t1
+    /// @param initial_step First step size that is tried, adapted afterwards, Get_Next_Step() continues a previous integration without restarting the step size control
+    /// @return Whether t1 was reached, false if the step size dropped below the resolution of the time
+    bool Integrate(System const & system, double t0, double const & t1, double (&y)[N], double initial_step) {
+        double h = initial_step > 0.0 ? initial_step : (t1 - t0) * 1e-3;
+        system.Derivative(t0, y, m_f0);
+        m_statistics.function_evaluations++;
+        Jacobian(system, t0, y);
+
+        while (t0 < t1) {
+            double const proposed = h;
+            if (t0 + h > t1) {
+                h = t1 - t0;
+            }
+            if (h <= fabs(t0) * 1e-14) {
+                return false;
+            }
+
+            // W = I - h * d * J
+            for (size_t row = 0U; row < N; row++) {
+                for (size_t column = 0U; column < N; column++) {
+                    m_lu[row][column] = (row == column ? 1.0 : 0.0) - h * D * m_jacobian[row][column];
+                }
+            }
+            if (!Decompose()) {
+                h *= 0.5;
+                continue;
+            }
+
+            // k1 = W^-1 * f0
+            for (size_t i = 0U; i < N; i++) {
+                m_k1[i] = m_f0[i];
+            }
+            Solve(m_k1);
+            // k2 = W^-1 * (f1 - k1) + k1
+            for (size_t i = 0U; i < N; i++) {
+                m_y_stage[i] = y[i] + 0.5 * h * m_k1[i];
+            }
+            system.Derivative(t0 + 0.5 * h, m_y_stage, m_f1);
+            for (size_t i = 0U; i < N; i++) {
+                m_k2[i] = m_f1[i] - m_k1[i];
+            }
+            Solve(m_k2);
+            for (size_t i = 0U; i < N; i++) {
+                m_k2[i] += m_k1[i];
+                m_y_new[i] = y[i] + h * m_k2[i];
+            }
+            // k3 = W^-1 * (f2 - e32 * (k2 - f1) - 2 * (k1 - f0)), only needed for the error estimate
+            system.Derivative(t0 + h, m_y_new, m_f2);
+            m_statistics.function_evaluations += 2U;
+            for (size_t i = 0U; i < N; i++) {
+                m_k3[i] = m_f2[i] - E32 * (m_k2[i] - m_f1[i]) - 2.0 * (m_k1[i] - m_f0[i]);
+            }
+            Solve(m_k3);
+
+            double error = 0.0;
+            for (size_t i = 0U; i < N; i++) {
+                double const local = h / 6.0 * (m_k1[i] - 2.0 * m_k2[i] + m_k3[i]);
+                double const scale = m_absolute_tolerance + m_relative_tolerance * (fabs(y[i]) > fabs(m_y_new[i]) ? fabs(y[i]) : fabs(m_y_new[i]));
+                double const ratio = fabs(local) / scale;
+                error = ratio > error ? ratio : error;
+            }
+
+            // Order 2 method, step size scales with the error to the power of 1 / 3
+            double factor = error > 0.0 ? SAFETY * pow(error, -1.0 / 3.0) : MAX_GROWTH;
+            factor = factor < MIN_SHRINK ? MIN_SHRINK : (factor > MAX_GROWTH ? MAX_GROWTH : factor);
+            if (error > 1.0) {
+                m_statistics.rejected_steps++;
+                h *= factor;
+                continue;
+            }
+
+            m_statistics.accepted_steps++;
+            t0 += h;
+            for (size_t i = 0U; i < N; i++) {
+                y[i] = m_y_new[i];
+                // First same as last, f2 is the derivative at the start of the next step
+                m_f0[i] = m_f2[i];
+            }
+            h *= factor;
+            m_next_step = (t0 >= t1 && h < proposed) ? proposed : h;
+            if (t0 < t1) {
+                Jacobian(system, t0, y);
+            }
+        }
+        return true;
+    }
+
+    /// @brief Step size proposed by the error control after the last accepted step, the shortened final step to reach t1 does not reduce it
+    /// @return Step size
+    double const & Get_Next_Step() const {
+        return m_next_step;
+    }
+
+    /// @brief Counters accumulated over all integrations since construction or the last Reset_Statistics()
+    /// @return Statistics
+    Integrator_Statistics const & Get_Statistics() const {
+        return m_statistics;
+    }
+
+    /// @brief Clears the counters
+    void Reset_Statistics() {
+        m_statistics = Integrator_Statistics();
+    }
+
+  private:
+    static constexpr double D = 1.0 / (2.0 + 1.4142135623730951);
+    static constexpr double E32 = 6.0 + 1.4142135623730951;
+    static constexpr double SAFETY = 0.8;
+    static constexpr double MIN_SHRINK = 0.2;
+    static constexpr double MAX_GROWTH = 5.0;
+
+    /// @brief Forward difference Jacobian around y, f0 has to contain the derivative at y
+    void Jacobian(System const & system, double const & t, double const (&y)[N]) {
+        for (size_t i = 0U; i < N; i++) {
+            m_y_stage[i] = y[i];
+        }
+        for (size_t column = 0U; column < N; column++) {
+            double const delta = 1.4901161193847656e-08 * (fabs(y[column]) > 1e-5 ? fabs(y[column]) : 1e-5);
+            m_y_stage[column] = y[column] + delta;
+            system.Derivative(t, m_y_stage, m_f1);
+            m_y_stage[column] = y[column];
+            for (size_t row = 0U; row < N; row++) {
+                m_jacobian[row][column] = (m_f1[row] - m_f0[row]) / delta;
+            }
+        }
+        m_statistics.function_evaluations += N;
+        m_statistics.jacobian_evaluations++;
+    }
+
+    /// @brief LU decomposition of m_lu in place with partial pivoting
+    /// @return Whether the matrix is regular
+    bool Decompose() {
+        m_statistics.decompositions++;
+        for (size_t k = 0U; k < N; k++) {
+            size_t pivot = k;
+            for (size_t row = k + 1U; row < N; row++) {
+                if (fabs(m_lu[row][k]) > fabs(m_lu[pivot][k])) {
+                    pivot = row;
+                }
+            }
+            if (m_lu[pivot][k] == 0.0) {
+                return false;
+            }
+            m_pivot[k] = pivot;
+            if (pivot != k) {
+                for (size_t column = 0U; column < N; column++) {
+                    double const swap = m_lu[k][column];
+                    m_lu[k][column] = m_lu[pivot][column];
+                    m_lu[pivot][column] = swap;
+                }
+            }
+            for (size_t row = k + 1U; row < N; row++) {
+                double const factor = m_lu[row][k] / m_lu[k][k];
+                m_lu[row][k] = factor;
+                for (size_t column = k + 1U; column < N; column++) {
+                    m_lu[row][column] -= factor * m_lu[k][column];
+                }
+            }
+        }
+        return true;
+    }
+
+    /// @brief Solves W * x = b in place with the decomposition of the current step
+    void Solve(double (&b)[N]) const {
+        for (size_t k = 0U; k < N; k++) {
+            if (m_pivot[k] != k) {
+                double const swap = b[k];
+                b[k] = b[m_pivot[k]];
+                b[m_pivot[k]] = swap;
+            }
+        }
+        for (size_t row = 1U; row < N; row++) {
+            for (size_t column = 0U; column < row; column++) {
+                b[row] -= m_lu[row][column] * b[column];
+            }
+        }
+        for (size_t row = N; row-- > 0U;) {
+            for (size_t column = row + 1U; column < N; column++) {
+                b[row] -= m_lu[row][column] * b[column];
+            }
+            b[row] /= m_lu[row][row];
+        }
+    }
+
+    double                m_relative_tolerance = 1e-6; // Accepted relative local error
+    double                m_absolute_tolerance = 1e-9; // Accepted absolute local error
+    double                m_next_step = 0.0;           // Step size proposed for the next step
+    double                m_jacobian[N][N] = {};       // Jacobian at the start of the current step
+    double                m_lu[N][N] = {};             // LU decomposition of the iteration matrix
+    size_t                m_pivot[N] = {};             // Row swapped with every row during the decomposition
+    double                m_f0[N] = {};                // Derivative at the start of the step
+    double                m_f1[N] = {};                // Derivative at the stage, also the Jacobian scratch
+    double                m_f2[N] = {};                // Derivative at the end of the step
+    double                m_k1[N] = {};                // Stage slopes
+    double                m_k2[N] = {};
+    double                m_k3[N] = {};
+    double                m_y_stage[N] = {};           // Stage state
+    double                m_y_new[N] = {};             // Candidate state at the end of the step
+    Integrator_Statistics m_statistics = {};           // Work counters
+};
+
+#endif // Rosenbrock_Integrator_h
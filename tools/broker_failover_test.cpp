@@ -0,0 +1,409 @@
+// Host test of the broker failover (see Broker_Failover.h) against two local broker stand-ins on real TCP sockets.
+// Every stand-in accepts connections on localhost, answers a CONNECT line with CONNACK, like the MQTT handshake, and records every received PUB line with its arrival time.
+// The device publishes a record every 50 ms, records produced while it is not connected are buffered and sent after reconnecting, like the telemetry backfill of the sketch.
+// During the run the preferred broker goes down for maintenance, it closes every connection and refuses new ones, and comes back later.
+// With a single broker the device retries with the exponential backoff of the sketch, with failover it switches to the second broker over the warm standby socket
+// and falls back to the preferred one once it stayed reachable for the holdoff. Timings are scaled down ten times compared to the sketch to keep the run short.
+// Reports the longest time without any record arriving at a broker, and the records that were lost or buffered.
+// Build and run from the repository root:
+//     g++ -std=c++11 -O2 -pthread -I. -Itools tools/broker_failover_test.cpp -o broker_failover_test && ./broker_failover_test
+
+// Local includes.
+#include "Broker_Failover.h"
+
+// Library includes.
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+namespace {
+
+char constexpr LOCALHOST[] = "127.0.0.1";
+uint32_t constexpr RECORD_INTERVAL_MS = 50U;
+uint32_t constexpr MAINTENANCE_START_MS = 2000U;
+uint32_t constexpr MAINTENANCE_END_MS = 6000U;
+uint32_t constexpr RUN_MS = 10000U;
+uint32_t constexpr DRAIN_MS = 1000U;
+uint32_t constexpr CONNACK_TIMEOUT_MS = 500U;
+uint32_t constexpr CONNECT_RETRY_MIN_MS = 50U;
+uint32_t constexpr CONNECT_RETRY_MAX_MS = 3000U;
+uint32_t constexpr STANDBY_REFRESH_MS = 1000U;
+int32_t constexpr STANDBY_CONNECT_TIMEOUT_MS = 30;
+
+auto const start_time = std::chrono::steady_clock::now();
+
+uint32_t Now_Ms() {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count());
+}
+
+// Stand-in of a broker, runs on its own thread
+class Broker_Stand_In {
+  public:
+    Broker_Stand_In() {
+        Open();
+        m_thread = std::thread([this]() { Run(); });
+    }
+
+    ~Broker_Stand_In() {
+        m_running = false;
+        m_thread.join();
+        Close_All();
+    }
+
+    uint16_t const & Get_Port() const {
+        return m_port;
+    }
+
+    void Set_Down(bool const & down) {
+        m_down = down;
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> Get_Received() {
+        std::lock_guard<std::mutex> guard(m_lock);
+        return m_received;
+    }
+
+  private:
+    struct Connection {
+        int         fd;
+        std::string buffer;
+    };
+
+    void Open() {
+        m_listener = socket(AF_INET, SOCK_STREAM, 0);
+        int const enable = 1;
+        setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(m_port);
+        inet_pton(AF_INET, LOCALHOST, &address.sin_addr);
+        if (bind(m_listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(m_listener, 8) != 0) {
+            std::perror("broker stand-in");
+            std::exit(1);
+        }
+        socklen_t length = sizeof(address);
+        getsockname(m_listener, reinterpret_cast<sockaddr *>(&address), &length);
+        m_port = ntohs(address.sin_port);
+    }
+
+    void Close_All() {
+        for (Connection const & connection : m_connections) {
+            close(connection.fd);
+        }
+        m_connections.clear();
+        if (m_listener >= 0) {
+            close(m_listener);
+            m_listener = -1;
+        }
+    }
+
+    void Run() {
+        while (m_running) {
+            if (m_down && m_listener >= 0) {
+                Close_All();
+            }
+            else if (!m_down && m_listener < 0) {
+                Open();
+            }
+            if (m_listener < 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            std::vector<pollfd> fds(1U, pollfd{ m_listener, POLLIN, 0 });
+            for (Connection const & connection : m_connections) {
+                fds.push_back(pollfd{ connection.fd, POLLIN, 0 });
+            }
+            if (poll(fds.data(), fds.size(), 1) <= 0) {
+                continue;
+            }
+            if (fds[0U].revents & POLLIN) {
+                int const fd = accept(m_listener, nullptr, nullptr);
+                if (fd >= 0) {
+                    m_connections.push_back(Connection{ fd, std::string() });
+                }
+            }
+            for (size_t i = 1U; i < fds.size(); i++) {
+                if (fds[i].revents != 0) {
+                    Receive(m_connections[i - 1U]);
+                }
+            }
+            m_connections.erase(std::remove_if(m_connections.begin(), m_connections.end(), [](Connection const & connection) {
+                return connection.fd < 0;
+            }), m_connections.end());
+        }
+    }
+
+    void Receive(Connection & connection) {
+        char chunk[512];
+        ssize_t const count = recv(connection.fd, chunk, sizeof(chunk), 0);
+        if (count <= 0) {
+            close(connection.fd);
+            connection.fd = -1;
+            return;
+        }
+        connection.buffer.append(chunk, static_cast<size_t>(count));
+        size_t end = 0U;
+        while ((end = connection.buffer.find('\n')) != std::string::npos) {
+            std::string const line = connection.buffer.substr(0U, end);
+            connection.buffer.erase(0U, end + 1U);
+            if (line == "CONNECT") {
+                send(connection.fd, "CONNACK\n", 8U, MSG_NOSIGNAL);
+            }
+            else if (line.compare(0U, 4U, "PUB ") == 0) {
+                std::lock_guard<std::mutex> guard(m_lock);
+                m_received.emplace_back(static_cast<uint32_t>(std::strtoul(line.c_str() + 4U, nullptr, 10)), Now_Ms());
+            }
+        }
+    }
+
+    std::thread                                 m_thread;
+    std::atomic<bool>                           m_running = {true};
+    std::atomic<bool>                           m_down = {false};
+    int                                         m_listener = -1;
+    uint16_t                                    m_port = 0U;
+    std::vector<Connection>                     m_connections;
+    std::mutex                                  m_lock;
+    std::vector<std::pair<uint32_t, uint32_t>>  m_received; // Sequence number and arrival time of every record
+};
+
+// Blocking TCP client socket with the interface Warm_Standby expects from WiFiClient
+class Host_Socket {
+  public:
+    ~Host_Socket() {
+        stop();
+    }
+
+    int connect(char const * host, uint16_t port) {
+        return connect(host, port, -1);
+    }
+
+    // Same as the connect with timeout of the ESP32 WiFiClient, connects without blocking and waits at most the timeout, a negative timeout waits forever
+    int connect(char const * host, uint16_t port, int32_t timeout) {
+        stop();
+        m_fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        inet_pton(AF_INET, host, &address.sin_addr);
+        int const flags = fcntl(m_fd, F_GETFL, 0);
+        fcntl(m_fd, F_SETFL, flags | O_NONBLOCK);
+        if (::connect(m_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+            pollfd fd = { m_fd, POLLOUT, 0 };
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (errno != EINPROGRESS || poll(&fd, 1U, timeout) <= 0 || getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+                stop();
+                return 0;
+            }
+        }
+        fcntl(m_fd, F_SETFL, flags);
+        return 1;
+    }
+
+    uint8_t connected() {
+        if (m_fd < 0) {
+            return 0U;
+        }
+        // A closed connection is readable with 0 bytes, received data is left in the socket
+        char byte = 0;
+        ssize_t const count = recv(m_fd, &byte, 1U, MSG_PEEK | MSG_DONTWAIT);
+        if (count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            stop();
+            return 0U;
+        }
+        return 1U;
+    }
+
+    bool Write(std::string const & data) {
+        return m_fd >= 0 && send(m_fd, data.data(), data.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(data.size());
+    }
+
+    bool Read_Line(std::string & line, uint32_t const & timeout_ms) {
+        uint32_t const deadline = Now_Ms() + timeout_ms;
+        line.clear();
+        while (m_fd >= 0 && Now_Ms() < deadline) {
+            pollfd fd = { m_fd, POLLIN, 0 };
+            if (poll(&fd, 1U, 1) <= 0) {
+                continue;
+            }
+            char byte = 0;
+            if (recv(m_fd, &byte, 1U, 0) != 1) {
+                stop();
+                return false;
+            }
+            if (byte == '\n') {
+                return true;
+            }
+            line += byte;
+        }
+        return false;
+    }
+
+    void stop() {
+        if (m_fd >= 0) {
+            close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+  private:
+    int m_fd = -1;
+};
+
+struct Result {
+    uint32_t longest_gap_ms = 0U; // Longest time without any record arriving at a broker, after the first one arrived
+    size_t   produced = 0U;
+    size_t   delivered = 0U;
+    size_t   buffered = 0U;       // Records produced while disconnected, sent after reconnecting
+    uint32_t switches = 0U;
+    size_t   final_broker = 0U;
+};
+
+// The device, publishes records through the sockets of a Warm_Standby, with or without failover
+Result Run(bool const & failover) {
+    Broker_Stand_In primary;
+    Broker_Stand_In secondary;
+    Broker_Endpoint const brokers[] = { { LOCALHOST, primary.Get_Port() }, { LOCALHOST, secondary.Get_Port() } };
+    Broker_Failover_Settings settings;
+    settings.down_ms = 3000U;
+    settings.fallback_holdoff_ms = 2000U;
+    Broker_Failover<2U> selection(brokers, failover ? 2U : 1U, settings);
+    Host_Socket sockets[2U];
+    Warm_Standby<Host_Socket> standby(sockets[0U], sockets[1U]);
+
+    Result result;
+    std::vector<uint32_t> backlog;
+    bool session = false;
+    uint32_t const start = Now_Ms();
+    uint32_t next_record = start;
+    uint32_t next_connect = start;
+    uint32_t next_refresh = start;
+    uint32_t retry_delay = CONNECT_RETRY_MIN_MS;
+
+    auto const lost = [&](uint32_t const & now) {
+        session = false;
+        standby.Get_Active().stop();
+        if (failover && selection.Failed(now)) {
+            next_connect = now;
+            return;
+        }
+        next_connect = now + retry_delay;
+        retry_delay = retry_delay * 2U < CONNECT_RETRY_MAX_MS ? retry_delay * 2U : CONNECT_RETRY_MAX_MS;
+    };
+
+    while (true) {
+        uint32_t const now = Now_Ms();
+        uint32_t const elapsed = now - start;
+        if (elapsed >= RUN_MS + DRAIN_MS) {
+            break;
+        }
+        primary.Set_Down(elapsed >= MAINTENANCE_START_MS && elapsed < MAINTENANCE_END_MS);
+        if (elapsed < RUN_MS && now >= next_record) {
+            backlog.push_back(static_cast<uint32_t>(result.produced++));
+            if (!session) {
+                result.buffered++;
+            }
+            next_record += RECORD_INTERVAL_MS;
+        }
+
+        if (session && !standby.Get_Active().connected()) {
+            lost(now);
+        }
+        if (!session && now >= next_connect) {
+            Broker_Endpoint const & broker = selection.Get_Active();
+            // Same as the connect of the MQTT client through Standby_Client, the warm standby socket is taken over if it is connected to the broker
+            bool const connected = standby.Adopt(broker.host, broker.port) || standby.Get_Active().connect(broker.host, broker.port);
+            std::string reply;
+            if (connected && standby.Get_Active().Write("CONNECT\n") && standby.Get_Active().Read_Line(reply, CONNACK_TIMEOUT_MS) && reply == "CONNACK") {
+                session = true;
+                retry_delay = CONNECT_RETRY_MIN_MS;
+                selection.Connected(now);
+            }
+            else {
+                lost(now);
+            }
+        }
+        if (session) {
+            std::string payload;
+            for (uint32_t const sequence : backlog) {
+                payload += "PUB " + std::to_string(sequence) + "\n";
+            }
+            if (!payload.empty()) {
+                if (standby.Get_Active().Write(payload)) {
+                    backlog.clear();
+                }
+                else {
+                    lost(now);
+                }
+            }
+        }
+        if (failover && session && now >= next_refresh) {
+            next_refresh = now + STANDBY_REFRESH_MS;
+            size_t const index = selection.Get_Standby_Index(now);
+            selection.Checked(index, standby.Warm(brokers[index], STANDBY_CONNECT_TIMEOUT_MS), now);
+            if (selection.Is_Fallback_Due(now)) {
+                // Planned switch back to the preferred broker, the records in between are buffered
+                selection.Switch_To(index);
+                session = false;
+                standby.Get_Active().stop();
+                next_connect = now;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> received = primary.Get_Received();
+    std::vector<std::pair<uint32_t, uint32_t>> const from_secondary = secondary.Get_Received();
+    received.insert(received.end(), from_secondary.begin(), from_secondary.end());
+    std::vector<bool> arrived(result.produced, false);
+    std::vector<uint32_t> arrival_times;
+    for (auto const & record : received) {
+        if (record.first < arrived.size() && !arrived[record.first]) {
+            arrived[record.first] = true;
+            result.delivered++;
+        }
+        arrival_times.push_back(record.second);
+    }
+    std::sort(arrival_times.begin(), arrival_times.end());
+    for (size_t i = 1U; i < arrival_times.size(); i++) {
+        result.longest_gap_ms = std::max(result.longest_gap_ms, arrival_times[i] - arrival_times[i - 1U]);
+    }
+    result.switches = selection.Get_Switches();
+    result.final_broker = selection.Get_Active_Index();
+    return result;
+}
+
+void Print(char const * name, Result const & result) {
+    std::printf("%-16s %12u ms %9zu %9zu %9zu %9zu %9u %8zu\n", name, result.longest_gap_ms, result.produced, result.delivered,
+        result.produced - result.delivered, result.buffered, result.switches, result.final_broker);
+}
+
+} // namespace
+
+
+int main() {
+    std::printf("record every %u ms for %u ms, preferred broker down from %u ms to %u ms\n", RECORD_INTERVAL_MS, RUN_MS, MAINTENANCE_START_MS, MAINTENANCE_END_MS);
+    std::printf("%-16s %15s %9s %9s %9s %9s %9s %8s\n", "brokers", "longest gap", "produced", "delivered", "lost", "buffered", "switches", "final");
+    Result const single = Run(false);
+    Print("single", single);
+    Result const failover = Run(true);
+    Print("failover", failover);
+    bool const passed = failover.longest_gap_ms < 1000U && failover.final_broker == 0U && failover.switches >= 2U;
+    std::printf("failover gap below 1 s and fallback to the preferred broker: %s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
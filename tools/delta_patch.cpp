@@ -0,0 +1,327 @@
+// Creates and applies the binary delta patches of the firmware update (see Delta_OTA.h) on file-backed images.
+// A patch copies unchanged ranges of the running image and only contains the bytes that are actually new, a firmware that changed in a few functions
+// therefore needs a patch of a fraction of the full image, which is what has to be transferred over the slow Wi-Fi of the device.
+// The demo moves two thirds of the code and changes every address literal pointing into it, a pessimistic case, and still needs only ~13 % of the image.
+// The patch is applied with the same streaming applier the device uses, fed in chunks of the size of one RPC, to test the path without a device.
+// Build and run from the repository root:
+//     g++ -std=c++11 -O2 -I. -Itools tools/delta_patch.cpp -o delta_patch
+//     ./delta_patch diff old.bin new.bin patch.bin        creates a patch converting old.bin into new.bin
+//     ./delta_patch full new.bin patch.bin                creates a patch containing the complete image, for devices without a known source
+//     ./delta_patch apply old.bin patch.bin out.bin       applies a patch in chunks of CHUNK_SIZE bytes and verifies the result
+//     ./delta_patch demo                                  diffs and applies synthetic firmware images with typical changes
+
+// Local includes.
+#include "Delta_OTA.h"
+#include "Philox.h"
+
+// Library includes.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace {
+
+// Bytes of the patch transferred with one otaChunk RPC, the base64 encoded chunk has to fit into the MQTT buffer of the device
+size_t constexpr CHUNK_SIZE = 512U;
+// Length of the blocks that are indexed to find matches, shorter copies from anywhere in the source do not pay off against their instruction
+size_t constexpr BLOCK_SIZE = 16U;
+// Shortest copy continuing where the previous copy ended, the offset is known, so it pays off earlier, keeps the unchanged code between changed addresses
+size_t constexpr MIN_CONTINUED_COPY = 8U;
+
+using Image = std::vector<uint8_t>;
+
+bool Read_File(char const * path, Image & data) {
+    FILE * file = fopen(path, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "Can not open %s\n", path);
+        return false;
+    }
+    data.clear();
+    uint8_t buffer[4096];
+    size_t count = 0U;
+    while ((count = fread(buffer, 1U, sizeof(buffer), file)) > 0U) {
+        data.insert(data.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return true;
+}
+
+bool Write_File(char const * path, Image const & data) {
+    FILE * file = fopen(path, "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "Can not create %s\n", path);
+        return false;
+    }
+    bool const written = fwrite(data.data(), 1U, data.size(), file) == data.size();
+    fclose(file);
+    return written;
+}
+
+void Append_Uint32(Image & patch, uint32_t const & value) {
+    for (uint8_t i = 0U; i < 4U; i++) {
+        patch.push_back(static_cast<uint8_t>(value >> (8U * i)));
+    }
+}
+
+void Append_Varint(Image & patch, uint32_t value) {
+    while (value >= 0x80U) {
+        patch.push_back(static_cast<uint8_t>(value | 0x80U));
+        value >>= 7U;
+    }
+    patch.push_back(static_cast<uint8_t>(value));
+}
+
+Image Header(Image const & source, Image const & target) {
+    Image patch = { 'B', 'D', 'P', '1' };
+    Append_Uint32(patch, static_cast<uint32_t>(source.size()));
+    Append_Uint32(patch, Crc32::Calculate(source.data(), source.size()));
+    Append_Uint32(patch, static_cast<uint32_t>(target.size()));
+    Append_Uint32(patch, Crc32::Calculate(target.data(), target.size()));
+    return patch;
+}
+
+void Append_Add(Image & patch, Image const & target, size_t const & begin, size_t const & end) {
+    if (end <= begin) {
+        return;
+    }
+    patch.push_back(static_cast<uint8_t>(Delta_Opcode::ADD));
+    Append_Varint(patch, static_cast<uint32_t>(end - begin));
+    patch.insert(patch.end(), target.begin() + begin, target.begin() + end);
+}
+
+uint64_t Block_Hash(uint8_t const * data) {
+    // FNV-1a, only used to find candidates, every candidate is compared byte by byte
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0U; i < BLOCK_SIZE; i++) {
+        hash = (hash ^ data[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+size_t Match_Length(Image const & source, size_t const & source_offset, Image const & target, size_t const & target_offset) {
+    size_t length = 0U;
+    while (source_offset + length < source.size() && target_offset + length < target.size() && source[source_offset + length] == target[target_offset + length]) {
+        length++;
+    }
+    return length;
+}
+
+/// @brief Greedy delta: every aligned block of the source is indexed, the target is scanned for the longest match, either continuing where the previous copy
+/// ended in the source (code that only moved, with a few changed addresses in between) or at an indexed block, bytes without a match become ADD instructions
+Image Diff(Image const & source, Image const & target) {
+    Image patch = Header(source, target);
+    std::unordered_map<uint64_t, uint32_t> index;
+    for (size_t offset = 0U; offset + BLOCK_SIZE <= source.size(); offset += BLOCK_SIZE / 4U) {
+        index.emplace(Block_Hash(source.data() + offset), static_cast<uint32_t>(offset));
+    }
+
+    size_t pending = 0U;
+    size_t position = 0U;
+    size_t expected_source = 0U;
+    while (position < target.size()) {
+        size_t best_length = 0U;
+        size_t best_offset = 0U;
+        if (expected_source < source.size()) {
+            best_length = Match_Length(source, expected_source, target, position);
+            best_offset = expected_source;
+        }
+        if (position + BLOCK_SIZE <= target.size()) {
+            auto const candidate = index.find(Block_Hash(target.data() + position));
+            if (candidate != index.end()) {
+                size_t const length = Match_Length(source, candidate->second, target, position);
+                if (length > best_length) {
+                    best_length = length;
+                    best_offset = candidate->second;
+                }
+            }
+        }
+        if (best_length < (best_offset == expected_source ? MIN_CONTINUED_COPY : BLOCK_SIZE)) {
+            position++;
+            expected_source++;
+            continue;
+        }
+        // Extend the match backwards into the bytes that would otherwise be added
+        while (position > pending && best_offset > 0U && source[best_offset - 1U] == target[position - 1U]) {
+            position--;
+            best_offset--;
+            best_length++;
+        }
+        Append_Add(patch, target, pending, position);
+        patch.push_back(static_cast<uint8_t>(Delta_Opcode::COPY));
+        Append_Varint(patch, static_cast<uint32_t>(best_offset));
+        Append_Varint(patch, static_cast<uint32_t>(best_length));
+        position += best_length;
+        pending = position;
+        expected_source = best_offset + best_length;
+    }
+    Append_Add(patch, target, pending, target.size());
+    return patch;
+}
+
+Image Full(Image const & target) {
+    Image patch = Header(Image(), target);
+    Append_Add(patch, target, 0U, target.size());
+    return patch;
+}
+
+/// @brief Running image read from a file
+class File_Source {
+  public:
+    explicit File_Source(Image const & image)
+      : m_image(image)
+    {
+        // Nothing to do
+    }
+
+    bool Read(uint32_t const & offset, uint8_t * buffer, size_t const & size) {
+        if (offset > m_image.size() || size > m_image.size() - offset) {
+            return false;
+        }
+        memcpy(buffer, m_image.data() + offset, size);
+        return true;
+    }
+
+  private:
+    Image const & m_image;
+};
+
+/// @brief New image, collected in memory and written to the file once it was verified
+class Memory_Sink {
+  public:
+    bool Write(uint8_t const * data, size_t const & size) {
+        m_image.insert(m_image.end(), data, data + size);
+        return true;
+    }
+
+    Image const & Get_Image() const {
+        return m_image;
+    }
+
+  private:
+    Image m_image;
+};
+
+/// @brief Streams the patch through the applier in chunks, like the otaChunk RPCs, each chunk only being pushed once the previous one was acknowledged.
+/// Every chunk starts at the offset the applier acknowledged, while it verifies the source the same instructions are sent again
+Delta_Status Apply(Image const & source, Image const & patch, Image & target, size_t & chunks) {
+    File_Source file_source(source);
+    Memory_Sink sink;
+    Delta_Patch_Applier<File_Source, Memory_Sink> applier(file_source, sink);
+    chunks = 0U;
+    for (size_t offset = 0U; offset < patch.size(); offset = applier.Get_Consumed()) {
+        size_t const size = (patch.size() - offset) < CHUNK_SIZE ? (patch.size() - offset) : CHUNK_SIZE;
+        chunks++;
+        if (applier.Push(patch.data() + offset, size) != Delta_Status::OK) {
+            return applier.Get_Status();
+        }
+    }
+    Delta_Status const status = applier.Finish();
+    target = sink.Get_Image();
+    return status;
+}
+
+/// @brief Synthetic firmware image, instructions and pointers into the image itself, so a shift of the code changes the addresses referring past it
+Image Synthetic_Image(Random_Stream const & random, size_t const & size) {
+    Image image(size);
+    for (size_t i = 0U; i < size; i += 4U) {
+        uint32_t const word = random.Block(i / 4U).word[0U];
+        // Every fourth word is an absolute address literal
+        uint32_t const value = (i / 4U) % 4U == 3U ? 0x400D0000U + (word % size) : word;
+        memcpy(image.data() + i, &value, 4U < size - i ? 4U : size - i);
+    }
+    return image;
+}
+
+/// @brief Applies typical changes of a new firmware version: a function grows, a constant changes and the code behind the change moves
+Image Modify(Image const & source, Random_Stream const & random) {
+    Image target = source;
+    // Changed instructions in a few functions
+    for (uint32_t i = 0U; i < 40U; i++) {
+        size_t const offset = random.Block(1000000U + i).word[0U] % (target.size() - 8U);
+        target[offset] ^= 0x5AU;
+        target[offset + 3U] ^= 0xA5U;
+    }
+    // A function grew by 300 bytes, which moves everything behind it
+    size_t const insert = target.size() / 3U;
+    Image const inserted = Synthetic_Image(Random_Stream(2U, 0U, 0U), 300U);
+    target.insert(target.begin() + insert, inserted.begin(), inserted.end());
+    // Absolute addresses past the insertion move with the code
+    for (size_t i = 12U; i + 4U <= target.size(); i += 16U) {
+        uint32_t value = 0U;
+        memcpy(&value, target.data() + i, 4U);
+        if (value >= 0x400D0000U + insert && value < 0x400D0000U + source.size()) {
+            value += 300U;
+            memcpy(target.data() + i, &value, 4U);
+        }
+    }
+    return target;
+}
+
+int Demo() {
+    Random_Stream const random(1U, 0U, 0U);
+    Image const source = Synthetic_Image(random, 1024U * 1024U);
+    Image const target = Modify(source, random);
+    Image const patch = Diff(source, target);
+    Image result;
+    size_t chunks = 0U;
+    Delta_Status const status = Apply(source, patch, result, chunks);
+    printf("image %zu bytes, patch %zu bytes (%.1f %%), %zu chunks of %zu bytes instead of %zu, applied: %s\n", target.size(), patch.size(),
+      100.0 * static_cast<double>(patch.size()) / static_cast<double>(target.size()), chunks, CHUNK_SIZE, (target.size() + CHUNK_SIZE - 1U) / CHUNK_SIZE, Get_Delta_Status_Text(status));
+
+    // A patch applied against a different image has to be rejected before anything is written
+    Image other = source;
+    other[100U] ^= 1U;
+    Delta_Status const mismatch = Apply(other, patch, result, chunks);
+    printf("against a different source: %s\n", Get_Delta_Status_Text(mismatch));
+    // A corrupted chunk has to be detected at the latest by the target checksum
+    Image corrupted = patch;
+    corrupted[corrupted.size() / 2U] ^= 0x10U;
+    Delta_Status const corruption = Apply(source, corrupted, result, chunks);
+    printf("corrupted patch: %s\n", Get_Delta_Status_Text(corruption));
+    return status == Delta_Status::OK && result.size() == target.size() && mismatch == Delta_Status::SOURCE_MISMATCH && corruption != Delta_Status::OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+} // namespace
+
+
+int main(int argc, char * argv[]) {
+    std::string const command = argc > 1 ? argv[1] : "";
+    if (command == "demo") {
+        return Demo();
+    }
+    if (command == "diff" && argc == 5) {
+        Image source;
+        Image target;
+        if (!Read_File(argv[2], source) || !Read_File(argv[3], target)) {
+            return EXIT_FAILURE;
+        }
+        Image const patch = Diff(source, target);
+        printf("patch %zu bytes, %.1f %% of the image\n", patch.size(), 100.0 * static_cast<double>(patch.size()) / static_cast<double>(target.size()));
+        return Write_File(argv[4], patch) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (command == "full" && argc == 4) {
+        Image target;
+        if (!Read_File(argv[2], target)) {
+            return EXIT_FAILURE;
+        }
+        return Write_File(argv[3], Full(target)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (command == "apply" && argc == 5) {
+        Image source;
+        Image patch;
+        if (!Read_File(argv[2], source) || !Read_File(argv[3], patch)) {
+            return EXIT_FAILURE;
+        }
+        Image target;
+        size_t chunks = 0U;
+        Delta_Status const status = Apply(source, patch, target, chunks);
+        printf("%zu chunks, %s\n", chunks, Get_Delta_Status_Text(status));
+        return status == Delta_Status::OK && Write_File(argv[4], target) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    fprintf(stderr, "Usage: %s diff old new patch | full new patch | apply old patch out | demo\n", argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,38 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+// Host stand-in of the Arduino core for the tools, only provides what the headers driven by them use.
+// Time is virtual, the tool sets it with Host_Clock::Set() and everything reading millis() sees the simulated time
+
+// Library includes.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/// @brief Virtual time of the host tools
+class Host_Clock {
+  public:
+    /// @brief Current virtual time
+    /// @return Milliseconds since the start of the simulation
+    static uint32_t & Now() {
+        static uint32_t now = 0U;
+        return now;
+    }
+
+    /// @brief Moves the virtual time
+    /// @param now_ms New time in milliseconds, is allowed to wrap around
+    static void Set(uint32_t const & now_ms) {
+        Now() = now_ms;
+    }
+};
+
+inline uint32_t millis() {
+    return Host_Clock::Now();
+}
+
+inline uint32_t micros() {
+    return Host_Clock::Now() * 1000U;
+}
+
+#endif // Arduino_h
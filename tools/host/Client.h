@@ -0,0 +1,47 @@
+#ifndef Client_h
+#define Client_h
+
+// Host stand-in of the Arduino Client interface for the tools, see Arduino.h in the same directory
+
+// Library includes.
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// @brief IPv4 address, only passed through by the clients under test
+class IPAddress {
+  public:
+    IPAddress(uint32_t const & address = 0U)
+      : m_address(address)
+    {
+        // Nothing to do
+    }
+
+    operator uint32_t() const {
+        return m_address;
+    }
+
+  private:
+    uint32_t m_address = 0U;
+};
+
+
+/// @brief Byte stream connection, same virtual methods as the Arduino core
+class Client {
+  public:
+    virtual ~Client() = default;
+    virtual int connect(IPAddress ip, uint16_t port) = 0;
+    virtual int connect(char const * host, uint16_t port) = 0;
+    virtual size_t write(uint8_t byte) = 0;
+    virtual size_t write(uint8_t const * buffer, size_t size) = 0;
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int read(uint8_t * buffer, size_t size) = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;
+    virtual void stop() = 0;
+    virtual uint8_t connected() = 0;
+    virtual operator bool() = 0;
+};
+
+#endif // Client_h
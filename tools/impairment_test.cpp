@@ -0,0 +1,284 @@
+// Host test of the device traffic under every preset of Impaired_Client (see Impaired_Client.h), on a virtual clock without any real network.
+// The device publishes a telemetry record every 2 seconds and answers every RPC of the server right away, all over Impaired_Client,
+// which sits in front of an in-memory stand-in of the broker connection, like it sits in front of the WiFiClient in the sketch.
+// The server sends an RPC every 5 seconds while the connection is open, a lost connection is opened again every second.
+// Records produced while disconnected, refused by a full socket buffer or written into a half-open connection are not delivered.
+// Reports per preset the ratio of delivered telemetry, the answered RPCs and their round trip latency, and the emulated impairments.
+// Fails if the unimpaired link or the good WiFi do not deliver (almost) everything.
+// Build and run from the repository root:
+//     g++ -std=c++11 -O2 -I. -Itools -Itools/host tools/impairment_test.cpp -o impairment_test && ./impairment_test [devices] [hours] [seed]
+
+// Local includes.
+#include "Impaired_Client.h"
+
+// Library includes.
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+uint32_t constexpr STEP_MS = 5U;
+uint32_t constexpr TELEMETRY_INTERVAL_MS = 2000U;
+uint32_t constexpr RPC_INTERVAL_MS = 5000U;
+uint32_t constexpr RECONNECT_INTERVAL_MS = 1000U;
+// Padding of a telemetry record, about the size of the periodic telemetry of the sketch
+size_t constexpr TELEMETRY_PADDING = 120U;
+
+struct Preset {
+    char const *      name;
+    Impairment_Preset preset;
+    double            minimum_delivered; // Delivered ratio the test requires, 0 for no requirement
+};
+
+Preset constexpr PRESETS[] = {
+    { "none", Impairment_Preset::NONE, 1.0 },
+    { "good-wifi", Impairment_Preset::GOOD_WIFI, 0.99 },
+    { "congested", Impairment_Preset::CONGESTED, 0.0 },
+    { "lossy", Impairment_Preset::LOSSY, 0.0 },
+    { "flaky", Impairment_Preset::FLAKY, 0.0 },
+    { "half-open", Impairment_Preset::HALF_OPEN, 0.0 }
+};
+
+/// @brief In-memory stand-in of the broker connection, records what arrives at the server and queues what the server sends
+class Server_Client : public Client {
+  public:
+    int connect(IPAddress, uint16_t) override {
+        return Open();
+    }
+
+    int connect(char const *, uint16_t) override {
+        return Open();
+    }
+
+    size_t write(uint8_t byte) override {
+        return write(&byte, 1U);
+    }
+
+    size_t write(uint8_t const * buffer, size_t size) override {
+        if (!m_connected) {
+            return 0U;
+        }
+        for (size_t i = 0U; i < size; i++) {
+            if (buffer[i] != '\n') {
+                m_line.push_back(static_cast<char>(buffer[i]));
+                continue;
+            }
+            Receive_Line();
+            m_line.clear();
+        }
+        return size;
+    }
+
+    int available() override {
+        return static_cast<int>(m_outbound.size());
+    }
+
+    int read() override {
+        uint8_t byte = 0U;
+        return read(&byte, 1U) == 1 ? byte : -1;
+    }
+
+    int read(uint8_t * buffer, size_t size) override {
+        size_t const count = std::min(size, m_outbound.size());
+        std::copy(m_outbound.begin(), m_outbound.begin() + count, buffer);
+        m_outbound.erase(0U, count);
+        return count > 0U ? static_cast<int>(count) : -1;
+    }
+
+    int peek() override {
+        return m_outbound.empty() ? -1 : static_cast<uint8_t>(m_outbound[0U]);
+    }
+
+    void flush() override {
+        // Nothing to do
+    }
+
+    void stop() override {
+        m_connected = false;
+        m_outbound.clear();
+        m_line.clear();
+    }
+
+    uint8_t connected() override {
+        return m_connected;
+    }
+
+    operator bool() override {
+        return m_connected;
+    }
+
+    /// @brief Sends an RPC request to the device, only possible while the server side of the connection is open
+    void Send_Rpc(uint32_t const & id) {
+        char line[32];
+        int const length = std::snprintf(line, sizeof(line), "Q%u\n", id);
+        m_outbound.append(line, static_cast<size_t>(length));
+        m_rpc_sent_ms.push_back(millis());
+    }
+
+    std::vector<uint32_t> m_telemetry_received; // Sequence numbers of the telemetry records that arrived
+    std::vector<uint32_t> m_rpc_sent_ms;        // Time every RPC was sent, indexed by its id
+    std::vector<uint32_t> m_rpc_latency_ms;     // Round trip of every answered RPC
+    uint32_t              m_malformed = 0U;     // Lines that could not be parsed
+
+  private:
+    int Open() {
+        stop();
+        m_connected = true;
+        return 1;
+    }
+
+    void Receive_Line() {
+        unsigned value = 0U;
+        if (m_line.size() > 1U && m_line[0U] == 'T' && std::sscanf(m_line.c_str() + 1U, "%u", &value) == 1) {
+            m_telemetry_received.push_back(value);
+            return;
+        }
+        if (m_line.size() > 1U && m_line[0U] == 'A' && std::sscanf(m_line.c_str() + 1U, "%u", &value) == 1 && value < m_rpc_sent_ms.size()) {
+            m_rpc_latency_ms.push_back(millis() - m_rpc_sent_ms[value]);
+            return;
+        }
+        m_malformed++;
+    }
+
+    bool        m_connected = false;
+    std::string m_outbound; // Bytes sent by the server, not yet read by the device
+    std::string m_line;     // Received bytes of the current line
+};
+
+struct Result {
+    uint64_t telemetry_produced = 0U;
+    uint64_t telemetry_delivered = 0U;
+    uint64_t rpcs_sent = 0U;
+    std::vector<uint32_t> rpc_latency_ms;
+    uint64_t malformed = 0U;
+    Impairment_Statistics statistics = {};
+};
+
+/// @brief Writes a complete line, a partially accepted line is completed, like the MQTT client finishing a packet
+bool Write_Line(Client & client, std::string const & line) {
+    size_t written = 0U;
+    while (written < line.size()) {
+        size_t const accepted = client.write(reinterpret_cast<uint8_t const *>(line.data()) + written, line.size() - written);
+        if (accepted == 0U) {
+            return false;
+        }
+        written += accepted;
+    }
+    return true;
+}
+
+Result Simulate(Impairment_Preset const & preset, uint64_t const & seed, uint32_t const & device, uint64_t const & duration_ms) {
+    Server_Client server;
+    Impaired_Client<> impaired(server, Get_Impairment_Profile(preset), seed, device);
+    Result result;
+    std::string const padding(TELEMETRY_PADDING, 'x');
+    std::string received;
+    uint32_t telemetry_sequence = 0U;
+    uint32_t rpc_id = 0U;
+    uint64_t next_connect_ms = 0U;
+
+    for (uint64_t now_ms = 0U; now_ms < duration_ms; now_ms += STEP_MS) {
+        Host_Clock::Set(static_cast<uint32_t>(now_ms));
+        if (!impaired.connected()) {
+            received.clear();
+            if (now_ms >= next_connect_ms) {
+                next_connect_ms = now_ms + RECONNECT_INTERVAL_MS;
+                (void)impaired.connect("broker", 1883U);
+            }
+        }
+        // Server side, sends its requests whenever its end of the connection is open
+        if (now_ms % RPC_INTERVAL_MS == 0U && server.connected()) {
+            server.Send_Rpc(rpc_id++);
+            result.rpcs_sent++;
+        }
+        // Device side
+        if (now_ms % TELEMETRY_INTERVAL_MS == 0U) {
+            result.telemetry_produced++;
+            if (impaired.connected()) {
+                (void)Write_Line(impaired, "T" + std::to_string(telemetry_sequence) + " " + padding + "\n");
+            }
+            telemetry_sequence++;
+        }
+        uint8_t chunk[64U];
+        while (impaired.available() > 0) {
+            int const count = impaired.read(chunk, sizeof(chunk));
+            if (count <= 0) {
+                break;
+            }
+            for (int i = 0; i < count; i++) {
+                if (chunk[i] != '\n') {
+                    received.push_back(static_cast<char>(chunk[i]));
+                    continue;
+                }
+                if (received.size() > 1U && received[0U] == 'Q') {
+                    (void)Write_Line(impaired, "A" + received.substr(1U) + "\n");
+                }
+                received.clear();
+            }
+        }
+    }
+    // Bytes still on the way when the run ends are not counted against the link
+    result.telemetry_delivered = server.m_telemetry_received.size();
+    result.rpc_latency_ms = server.m_rpc_latency_ms;
+    result.malformed = server.m_malformed;
+    result.statistics = impaired.Get_Statistics();
+    return result;
+}
+
+void Accumulate(Result & total, Result const & result) {
+    total.telemetry_produced += result.telemetry_produced;
+    total.telemetry_delivered += result.telemetry_delivered;
+    total.rpcs_sent += result.rpcs_sent;
+    total.rpc_latency_ms.insert(total.rpc_latency_ms.end(), result.rpc_latency_ms.begin(), result.rpc_latency_ms.end());
+    total.malformed += result.malformed;
+    total.statistics.retransmissions += result.statistics.retransmissions;
+    total.statistics.disconnects += result.statistics.disconnects;
+    total.statistics.refused_connects += result.statistics.refused_connects;
+    total.statistics.stalls += result.statistics.stalls;
+    total.statistics.bytes_lost += result.statistics.bytes_lost;
+}
+
+uint32_t Percentile(std::vector<uint32_t> const & sorted, double const & percentile) {
+    if (sorted.empty()) {
+        return 0U;
+    }
+    return sorted[static_cast<size_t>(percentile * (sorted.size() - 1U))];
+}
+
+} // namespace
+
+
+int main(int argc, char * argv[]) {
+    uint32_t const devices = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 4U;
+    double const hours = argc > 2 ? std::strtod(argv[2], nullptr) : 1.0;
+    uint64_t const seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1U;
+    uint64_t const duration_ms = static_cast<uint64_t>(hours * 3600e3);
+
+    std::printf("%u devices, %.1f h, telemetry every %u ms, an rpc every %u ms\n", devices, hours, TELEMETRY_INTERVAL_MS, RPC_INTERVAL_MS);
+    std::printf("%-10s %10s %10s %9s %8s %8s %8s %8s %11s %8s %9s\n", "preset", "delivered", "rpcs", "answered", "p50 ms", "p95 ms", "max ms",
+        "retrans", "disconnects", "stalls", "malformed");
+    bool passed = true;
+    for (Preset const & preset : PRESETS) {
+        Result total;
+        for (uint32_t device = 0U; device < devices; device++) {
+            Accumulate(total, Simulate(preset.preset, seed, device, duration_ms));
+        }
+        std::sort(total.rpc_latency_ms.begin(), total.rpc_latency_ms.end());
+        double const delivered = total.telemetry_produced > 0U ? static_cast<double>(total.telemetry_delivered) / total.telemetry_produced : 0.0;
+        double const answered = total.rpcs_sent > 0U ? static_cast<double>(total.rpc_latency_ms.size()) / total.rpcs_sent : 0.0;
+        std::printf("%-10s %9.2f%% %10llu %8.2f%% %8u %8u %8u %8u %11u %8u %9llu\n", preset.name, 100.0 * delivered,
+            static_cast<unsigned long long>(total.rpcs_sent), 100.0 * answered, Percentile(total.rpc_latency_ms, 0.5),
+            Percentile(total.rpc_latency_ms, 0.95), Percentile(total.rpc_latency_ms, 1.0), total.statistics.retransmissions,
+            total.statistics.disconnects, total.statistics.stalls, static_cast<unsigned long long>(total.malformed));
+        if (delivered + 1e-9 < preset.minimum_delivered || total.malformed > 0U) {
+            std::printf("FAILED: %s delivered %.2f %%, required %.2f %%, %llu malformed lines\n", preset.name, 100.0 * delivered,
+                100.0 * preset.minimum_delivered, static_cast<unsigned long long>(total.malformed));
+            passed = false;
+        }
+    }
+    return passed ? 0 : 1;
+}
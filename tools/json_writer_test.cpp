@@ -0,0 +1,89 @@
+// Host test of the JSON writer (see Json_Writer.h), compares the written payloads with the expected JSON and checks that a too small buffer
+// or a value that does not fit its formatting buffer marks the writer as overflowed instead of writing past a buffer. Best built with the address sanitizer.
+// Build and run from the repository root:
+//     g++ -std=c++11 -O2 -fsanitize=address,undefined -I. -Itools tools/json_writer_test.cpp -o json_writer_test && ./json_writer_test
+
+// Local includes.
+#include "Json_Writer.h"
+
+// Library includes.
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+
+namespace {
+
+bool Check(char const * name, bool const & condition) {
+    std::printf("%-52s %s\n", name, condition ? "PASS" : "FAIL");
+    return condition;
+}
+
+bool Members() {
+    char buffer[128];
+    Json_Writer writer(buffer, sizeof(buffer));
+    writer.Begin_Object();
+    writer.Add("count", 3U);
+    writer.Add("temperature", 37.25f);
+    writer.Key("ph");
+    writer.Value(7.0, 2U);
+    writer.Add("name", "a\"b");
+    writer.Key("values");
+    writer.Begin_Array();
+    writer.Value(-1);
+    writer.Value(true);
+    writer.Value(static_cast<char const *>(nullptr));
+    writer.End_Array();
+    writer.End_Object();
+    return Check("members, arrays and escaping", !writer.Overflowed()
+        && std::strcmp(writer.Get_String(), "{\"count\":3,\"temperature\":37.250,\"ph\":7.00,\"name\":\"a\\\"b\",\"values\":[-1,true,null]}") == 0);
+}
+
+bool Non_Finite() {
+    char buffer[64];
+    Json_Writer writer(buffer, sizeof(buffer));
+    writer.Begin_Array();
+    writer.Value(NAN);
+    writer.Value(INFINITY);
+    writer.End_Array();
+    return Check("non finite values are written as null", !writer.Overflowed() && std::strcmp(writer.Get_String(), "[null,null]") == 0);
+}
+
+bool Large_Values() {
+    char buffer[256];
+    Json_Writer writer(buffer, sizeof(buffer));
+    writer.Begin_Object();
+    writer.Add("large", 1e30f);
+    bool const float_overflowed = writer.Overflowed();
+    writer.Clear();
+    writer.Begin_Array();
+    writer.Value(-1.5e300, 6U);
+    bool const double_overflowed = writer.Overflowed();
+    writer.Clear();
+    writer.Begin_Array();
+    writer.Value(1e20, 3U);
+    writer.End_Array();
+    return Check("values too long to format overflow the writer", float_overflowed && double_overflowed && !writer.Overflowed()
+        && std::strcmp(writer.Get_String(), "[100000000000000000000.000]") == 0);
+}
+
+bool Small_Buffer() {
+    char buffer[16];
+    Json_Writer writer(buffer, sizeof(buffer));
+    writer.Begin_Object();
+    writer.Add("temperature", 37.25f);
+    writer.End_Object();
+    return Check("too small buffer overflows and stays terminated", writer.Overflowed() && std::strlen(writer.Get_String()) < sizeof(buffer));
+}
+
+} // namespace
+
+
+int main() {
+    bool passed = true;
+    passed &= Members();
+    passed &= Non_Finite();
+    passed &= Large_Values();
+    passed &= Small_Buffer();
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,436 @@
+// Host simulation of the link health monitoring of the sketch (see Link_Health.h) on a virtual clock, with and without the monitoring.
+// The device logic of engf_maybe_working.ino runs on the real classes: checkLink(), sendPeriodicTelemetry() and uploadBackfill() are repeated below on a Timer_Wheel
+// with the same intervals and the same gates, over Impaired_Client, which sits in front of an in-memory stand-in of the broker connection.
+// The device publishes a record every 2 seconds, probes the connection with a request the server answers and records the telemetry into the Telemetry_Backfill
+// while the link is not usable, the backfill is uploaded as compressed blocks, which the server decodes. Without monitoring only the keepalive ends a half-open connection.
+// Every link is run with a good and with a weak signal strength, a weak signal alone must not keep the telemetry from being sent.
+// Reports per link the delivered records, the records recorded into the backfill and dropped by it, the reconnects and the emulated stalls.
+// Fails if the monitoring delivers less than the keepalive alone, or if a weak but working signal does not deliver (almost) everything.
+// Build and run from the repository root:
+//     g++ -std=c++11 -O2 -I. -Itools -Itools/host tools/link_health_simulation.cpp -o link_health_simulation && ./link_health_simulation [devices] [hours] [seed]
+
+// Local includes.
+#include "Base64.h"
+#include "Impaired_Client.h"
+#include "Json_Writer.h"
+#include "Link_Health.h"
+#include "Lzss.h"
+#include "Telemetry_Backfill.h"
+#include "Timer_Wheel.h"
+
+// Library includes.
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+uint32_t constexpr STEP_MS = 5U;
+uint32_t constexpr RECONNECT_INTERVAL_MS = 1000U;
+// Time after the end of the run in which nothing is measured anymore, but the backfill is still uploaded
+uint32_t constexpr DRAIN_MS = 120000U;
+// Same as engf_maybe_working.ino
+uint32_t constexpr TELEMETRY_INTERVAL_MS = 2000U;
+uint32_t constexpr LINK_CHECK_INTERVAL_MS = 250U;
+uint32_t constexpr LINK_PROBE_TIMEOUT_MS = 3000U;
+uint32_t constexpr BACKFILL_UPLOAD_INTERVAL_MS = 200U;
+size_t constexpr BACKFILL_ARENA_SIZE = 8192U;
+size_t constexpr BACKFILL_BLOCK_SIZE = 2048U;
+size_t constexpr BACKFILL_COMPRESSED_BLOCK_SIZE = 512U;
+float constexpr RSSI_NOISE_DBM = 2.0f;
+
+using Backfill = Telemetry_Backfill<BACKFILL_ARENA_SIZE, BACKFILL_BLOCK_SIZE, BACKFILL_COMPRESSED_BLOCK_SIZE>;
+
+struct Link {
+    char const *      name;
+    Impairment_Preset preset;
+    float             rssi_dbm;           // Mean signal strength reported by the WiFi
+    double            minimum_delivered;  // Delivered ratio the monitoring has to reach, 0 for no requirement
+};
+
+Link constexpr LINKS[] = {
+    { "good-wifi", Impairment_Preset::GOOD_WIFI, -62.0f, 0.99 },
+    { "weak-wifi", Impairment_Preset::GOOD_WIFI, -88.0f, 0.99 },
+    { "congested", Impairment_Preset::CONGESTED, -70.0f, 0.0 },
+    { "weak-congested", Impairment_Preset::CONGESTED, -88.0f, 0.0 },
+    { "half-open", Impairment_Preset::HALF_OPEN, -62.0f, 0.0 },
+    { "weak-half-open", Impairment_Preset::HALF_OPEN, -88.0f, 0.0 }
+};
+
+/// @brief In-memory stand-in of the broker connection, answers the probes and records which telemetry records arrived, directly or in a backfill block
+class Server_Client : public Client {
+  public:
+    int connect(IPAddress, uint16_t) override {
+        return Open();
+    }
+
+    int connect(char const *, uint16_t) override {
+        return Open();
+    }
+
+    size_t write(uint8_t byte) override {
+        return write(&byte, 1U);
+    }
+
+    size_t write(uint8_t const * buffer, size_t size) override {
+        if (!m_connected) {
+            return 0U;
+        }
+        for (size_t i = 0U; i < size; i++) {
+            if (buffer[i] != '\n') {
+                m_line.push_back(static_cast<char>(buffer[i]));
+                continue;
+            }
+            Receive_Line();
+            m_line.clear();
+        }
+        return size;
+    }
+
+    int available() override {
+        return static_cast<int>(m_outbound.size());
+    }
+
+    int read() override {
+        uint8_t byte = 0U;
+        return read(&byte, 1U) == 1 ? byte : -1;
+    }
+
+    int read(uint8_t * buffer, size_t size) override {
+        size_t const count = std::min(size, m_outbound.size());
+        std::copy(m_outbound.begin(), m_outbound.begin() + count, buffer);
+        m_outbound.erase(0U, count);
+        return count > 0U ? static_cast<int>(count) : -1;
+    }
+
+    int peek() override {
+        return m_outbound.empty() ? -1 : static_cast<uint8_t>(m_outbound[0U]);
+    }
+
+    void flush() override {
+        // Nothing to do
+    }
+
+    void stop() override {
+        m_connected = false;
+        m_outbound.clear();
+        m_line.clear();
+    }
+
+    uint8_t connected() override {
+        return m_connected;
+    }
+
+    operator bool() override {
+        return m_connected;
+    }
+
+    std::vector<bool> m_delivered;     // Whether the record with the sequence number arrived
+    uint32_t          m_malformed = 0U; // Lines that could not be parsed
+
+  private:
+    int Open() {
+        stop();
+        m_connected = true;
+        return 1;
+    }
+
+    void Receive_Line() {
+        if (m_line.size() > 1U && m_line[0U] == 'P') {
+            // Probe, answered right away like an attribute request
+            m_outbound += "R" + m_line.substr(1U) + "\n";
+            return;
+        }
+        if (m_line.size() > 1U && m_line[0U] == 'T' && Deliver(m_line.c_str() + 1U) == 1U) {
+            return;
+        }
+        if (m_line.size() > 1U && m_line[0U] == 'B' && Receive_Block(m_line.substr(1U))) {
+            return;
+        }
+        m_malformed++;
+    }
+
+    /// @brief Decodes a backfill block like tools/telemetry_decode.cpp and delivers every record in it
+    bool Receive_Block(std::string const & encoded) {
+        std::vector<uint8_t> compressed(encoded.size());
+        size_t const size = Base64::Decode(encoded.c_str(), encoded.size(), compressed.data(), compressed.size());
+        size_t const expected = Lzss::Get_Decompressed_Size(compressed.data(), size);
+        std::string records(expected, '\0');
+        if (expected == 0U || Lzss::Decompress(compressed.data(), size, reinterpret_cast<uint8_t *>(&records[0U]), expected) != expected) {
+            return false;
+        }
+        return Deliver(records.c_str()) > 0U;
+    }
+
+    /// @brief Marks every record in the text as delivered
+    size_t Deliver(char const * text) {
+        size_t count = 0U;
+        for (char const * key = std::strstr(text, "\"seq\":"); key != nullptr; key = std::strstr(key + 1U, "\"seq\":")) {
+            unsigned long const sequence = std::strtoul(key + 6U, nullptr, 10);
+            if (sequence >= m_delivered.size()) {
+                m_delivered.resize(sequence + 1U, false);
+            }
+            m_delivered[sequence] = true;
+            count++;
+        }
+        return count;
+    }
+
+    bool        m_connected = false;
+    std::string m_outbound; // Bytes sent by the server, not yet read by the device
+    std::string m_line;     // Received bytes of the current line
+};
+
+/// @brief Writes a complete line, a partially accepted line is completed, like the MQTT client finishing a packet
+bool Write_Line(Client & client, std::string const & line) {
+    size_t written = 0U;
+    while (written < line.size()) {
+        size_t const accepted = client.write(reinterpret_cast<uint8_t const *>(line.data()) + written, line.size() - written);
+        if (accepted == 0U) {
+            return false;
+        }
+        written += accepted;
+    }
+    return true;
+}
+
+struct Result {
+    uint64_t produced = 0U;   // Records measured
+    uint64_t delivered = 0U;  // Records that arrived at the server, directly or with the backfill
+    uint64_t recorded = 0U;   // Records kept in the backfill instead of being sent directly
+    uint64_t dropped = 0U;    // Records the full backfill discarded
+    uint64_t reconnects = 0U; // Reconnects of the monitoring
+    uint64_t stalls = 0U;     // Connections that went half-open
+    uint64_t malformed = 0U;
+};
+
+/// @brief Device logic of the sketch, with the link health monitoring enabled or disabled like LINK_HEALTH
+class Device {
+  public:
+    Device(Link const & link, uint64_t const & seed, uint32_t const & device, bool const & monitored)
+      : m_link(link)
+      , m_impaired(m_server, Get_Impairment_Profile(link.preset), seed, device)
+      , m_rssi_noise(seed, device, static_cast<uint32_t>(Noise_Stream::NETWORK) + 0x10U)
+      , m_monitored(monitored)
+      , m_telemetry_timer(&Send_Periodic_Telemetry, this)
+      , m_link_timer(&Check_Link, this)
+      , m_backfill_timer(&Upload_Backfill, this)
+    {
+        Link_Health_Settings settings;
+        settings.probe_timeout_ms = LINK_PROBE_TIMEOUT_MS;
+        m_health.Configure(settings);
+        m_timers.Start(m_telemetry_timer, TELEMETRY_INTERVAL_MS);
+        if (m_monitored) {
+            m_timers.Start(m_link_timer, LINK_CHECK_INTERVAL_MS);
+        }
+    }
+
+    /// @brief Runs the loop of the sketch until the given time, measures until end_ms and afterwards only uploads what is left in the backfill
+    Result Run(uint64_t const & end_ms) {
+        for (uint64_t now_ms = 0U; now_ms < end_ms + DRAIN_MS; now_ms += STEP_MS) {
+            Host_Clock::Set(static_cast<uint32_t>(now_ms));
+            m_measuring = now_ms < end_ms;
+            m_timers.Advance(millis());
+            if (!m_impaired.connected()) {
+                m_received.clear();
+                if (now_ms >= m_next_connect_ms) {
+                    m_next_connect_ms = now_ms + RECONNECT_INTERVAL_MS;
+                    if (m_impaired.connect("broker", 1883U)) {
+                        m_health.Reset(millis());
+                        m_probe_pending = false;
+                    }
+                }
+            }
+            Receive();
+        }
+        m_result.delivered = static_cast<uint64_t>(std::count(m_server.m_delivered.begin(), m_server.m_delivered.end(), true));
+        m_result.recorded = m_backfill.Get_Statistics().records;
+        m_result.dropped = m_backfill.Get_Statistics().dropped_records;
+        m_result.stalls = m_impaired.Get_Statistics().stalls;
+        m_result.malformed = m_server.m_malformed;
+        return m_result;
+    }
+
+  private:
+    /// @brief Same as linkUsable() of the sketch
+    bool Link_Usable() {
+        return m_impaired.connected() && (!m_monitored || m_health.Get_State() == Link_State::HEALTHY);
+    }
+
+    /// @brief Same as backfillUsable() of the sketch
+    bool Backfill_Usable() {
+        return m_impaired.connected() && (!m_monitored || m_health.Is_Answering());
+    }
+
+    /// @brief Reads the answers of the probes, answers after the request timeout are ignored like Client_Side_Request does
+    void Receive() {
+        uint8_t chunk[64U];
+        while (m_impaired.available() > 0) {
+            int const count = m_impaired.read(chunk, sizeof(chunk));
+            if (count <= 0) {
+                break;
+            }
+            for (int i = 0; i < count; i++) {
+                if (chunk[i] != '\n') {
+                    m_received.push_back(static_cast<char>(chunk[i]));
+                    continue;
+                }
+                if (m_received.size() > 1U && m_received[0U] == 'R' && m_probe_pending && std::strtoul(m_received.c_str() + 1U, nullptr, 10) == m_probe_id) {
+                    m_probe_pending = false;
+                    m_health.Probe_Answered(millis());
+                }
+                m_received.clear();
+            }
+        }
+    }
+
+    /// @brief Same as sendPeriodicTelemetry() of the sketch, with a record of about the same size
+    static void Send_Periodic_Telemetry(void * context) {
+        Device & device = *static_cast<Device *>(context);
+        device.m_timers.Start(device.m_telemetry_timer, TELEMETRY_INTERVAL_MS);
+        if (!device.m_measuring) {
+            return;
+        }
+        char telemetry[128];
+        Json_Writer writer(telemetry, sizeof(telemetry));
+        writer.Begin_Object();
+        writer.Add("seq", device.m_result.produced++);
+        writer.Add("thermistorRaw", 2048U + device.m_result.produced % 7U);
+        writer.Add("phRaw", 1800U + device.m_result.produced % 5U);
+        writer.Add("temperature", 37.0f + static_cast<float>(device.m_result.produced % 10U) * 0.01f);
+        writer.Add("ph", 7.0f + static_cast<float>(device.m_result.produced % 3U) * 0.01f);
+        writer.End_Object();
+        float const rssi = device.m_link.rssi_dbm + device.m_rssi_noise.Normal(device.m_result.produced) * RSSI_NOISE_DBM;
+        device.m_health.Add_Rssi(millis(), rssi);
+        if (!device.Link_Usable()) {
+            device.m_backfill.Record(millis(), writer.Get_String(), writer.Length());
+            return;
+        }
+        if (device.m_backfill.Has_Pending() && !device.m_backfill_timer.Is_Armed()) {
+            device.m_timers.Start(device.m_backfill_timer, BACKFILL_UPLOAD_INTERVAL_MS);
+        }
+        (void)Write_Line(device.m_impaired, "T" + std::string(writer.Get_String()) + "\n");
+    }
+
+    /// @brief Same as uploadBackfill() of the sketch
+    static void Upload_Backfill(void * context) {
+        Device & device = *static_cast<Device *>(context);
+        if (!device.Backfill_Usable()) {
+            return;
+        }
+        device.m_backfill.Seal();
+        uint8_t const * block = nullptr;
+        size_t const block_size = device.m_backfill.Front(block);
+        if (block_size == 0U) {
+            return;
+        }
+        char encoded[Base64::Get_Encoded_Length(BACKFILL_COMPRESSED_BLOCK_SIZE) + 1U];
+        size_t const length = Base64::Encode(block, block_size, encoded, sizeof(encoded));
+        if (Write_Line(device.m_impaired, "B" + std::string(encoded, length) + "\n")) {
+            device.m_backfill.Pop();
+        }
+        if (device.m_backfill.Has_Block()) {
+            device.m_timers.Start(device.m_backfill_timer, BACKFILL_UPLOAD_INTERVAL_MS);
+        }
+    }
+
+    /// @brief Same as checkLink() of the sketch, the probe is a line the server answers instead of an attribute request
+    static void Check_Link(void * context) {
+        Device & device = *static_cast<Device *>(context);
+        device.m_timers.Start(device.m_link_timer, LINK_CHECK_INTERVAL_MS);
+        if (!device.m_impaired.connected()) {
+            return;
+        }
+        uint32_t const now = millis();
+        if (device.m_probe_pending && now - device.m_probe_sent_ms >= LINK_PROBE_TIMEOUT_MS) {
+            device.m_probe_pending = false;
+        }
+        if (device.m_health.Is_Probe_Due(now) && !device.m_probe_pending && Write_Line(device.m_impaired, "P" + std::to_string(++device.m_probe_id) + "\n")) {
+            device.m_probe_pending = true;
+            device.m_probe_sent_ms = now;
+            device.m_health.Probe_Sent(now);
+        }
+        if (device.m_health.Update(now) == Link_State::DEAD) {
+            device.m_result.reconnects++;
+            device.m_impaired.stop();
+            return;
+        }
+        if (device.Backfill_Usable() && device.m_backfill.Has_Pending() && !device.m_backfill_timer.Is_Armed()) {
+            device.m_timers.Start(device.m_backfill_timer, BACKFILL_UPLOAD_INTERVAL_MS);
+        }
+    }
+
+    Link const &                     m_link;
+    Server_Client                    m_server;
+    Impaired_Client<>                m_impaired;
+    Random_Stream                    m_rssi_noise;
+    bool                             m_monitored = false;
+    Timer_Wheel                      m_timers;
+    Timer_Wheel::Timer               m_telemetry_timer;
+    Timer_Wheel::Timer               m_link_timer;
+    Timer_Wheel::Timer               m_backfill_timer;
+    Link_Health                      m_health;
+    Backfill                         m_backfill;
+    Result                           m_result;
+    std::string                      m_received;           // Received bytes of the current line
+    bool                             m_measuring = true;   // Whether telemetry is still measured
+    uint64_t                         m_next_connect_ms = 0U;
+    bool                             m_probe_pending = false;
+    uint32_t                         m_probe_sent_ms = 0U;
+    uint32_t                         m_probe_id = 0U;
+};
+
+void Accumulate(Result & total, Result const & result) {
+    total.produced += result.produced;
+    total.delivered += result.delivered;
+    total.recorded += result.recorded;
+    total.dropped += result.dropped;
+    total.reconnects += result.reconnects;
+    total.stalls += result.stalls;
+    total.malformed += result.malformed;
+}
+
+double Delivered(Result const & result) {
+    return result.produced > 0U ? static_cast<double>(result.delivered) / result.produced : 0.0;
+}
+
+void Print(char const * link, char const * detection, Result const & result) {
+    std::printf("%-15s %-12s %9.3f%% %10llu %10llu %9llu %11llu %7llu\n", link, detection, 100.0 * Delivered(result),
+        static_cast<unsigned long long>(result.produced - result.delivered), static_cast<unsigned long long>(result.recorded),
+        static_cast<unsigned long long>(result.dropped), static_cast<unsigned long long>(result.reconnects), static_cast<unsigned long long>(result.stalls));
+}
+
+} // namespace
+
+
+int main(int argc, char * argv[]) {
+    uint32_t const devices = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 4U;
+    double const hours = argc > 2 ? std::strtod(argv[2], nullptr) : 2.0;
+    uint64_t const seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1U;
+    uint64_t const duration_ms = static_cast<uint64_t>(hours * 3600e3);
+
+    std::printf("%u devices, %.1f h, telemetry every %u ms, the backfill is uploaded for %u s after the run\n", devices, hours, TELEMETRY_INTERVAL_MS, DRAIN_MS / 1000U);
+    std::printf("%-15s %-12s %10s %10s %10s %9s %11s %7s\n", "link", "detection", "delivered", "lost", "backfilled", "dropped", "reconnects", "stalls");
+    bool passed = true;
+    for (Link const & link : LINKS) {
+        Result keepalive;
+        Result monitored;
+        for (uint32_t device = 0U; device < devices; device++) {
+            Accumulate(keepalive, Device(link, seed, device, false).Run(duration_ms));
+            Accumulate(monitored, Device(link, seed, device, true).Run(duration_ms));
+        }
+        Print(link.name, "keepalive", keepalive);
+        Print(link.name, "link health", monitored);
+        if (Delivered(monitored) + 1e-9 < link.minimum_delivered || Delivered(monitored) + 1e-9 < Delivered(keepalive) || monitored.malformed + keepalive.malformed > 0U) {
+            std::printf("FAILED: %s delivered %.3f %% with link health, %.3f %% without, required %.2f %%, %llu malformed lines\n", link.name,
+                100.0 * Delivered(monitored), 100.0 * Delivered(keepalive), 100.0 * link.minimum_delivered,
+                static_cast<unsigned long long>(monitored.malformed + keepalive.malformed));
+            passed = false;
+        }
+    }
+    return passed ? 0 : 1;
+}
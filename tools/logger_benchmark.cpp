@@ -0,0 +1,199 @@
+// Host benchmark of the deferred logger (see Deferred_Logger.h) against a logger that formats and prints synchronously like DefaultLogger.
+// A burst of server side rpcs is processed with the debug messages Server_Side_RPC logs for every request, printed to a model of the 9600 baud debugging serial port
+// of the device, whose writes block once its transmit buffer is full. The deferred logger only flushes from the idle time between requests,
+// and only as much as fits into the transmit buffer. The burst logs slightly more than the serial port can send, so the synchronous logger blocks every request
+// a bit longer than the one before, while the deferred one keeps the excess in its ring and prints it after the burst, or drops it once the ring is full.
+// Reports the time the logging added to every request, the host CPU time plus the time blocked on the serial port.
+// Build and run from the repository root:
+//     g++ -std=c++11 -O2 -I. -Itools tools/logger_benchmark.cpp -o logger_benchmark && ./logger_benchmark
+
+// Local includes.
+#include "Deferred_Logger.h"
+
+// Library includes.
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+
+namespace {
+
+// Serial port of the device, 10 bits are sent per byte
+double constexpr SERIAL_BAUD = 9600.0;
+size_t constexpr SERIAL_TX_BUFFER = 128U;
+// Burst of rpcs, e.g. a dashboard sending a setpoint change to the device repeatedly
+size_t constexpr RPC_COUNT = 40U;
+double constexpr RPC_INTERVAL_MS = 100.0;
+size_t constexpr REPETITIONS = 2000U;
+
+// Debug messages of Server_Side_RPC, logged for every received request
+char constexpr NO_RPC_PARAMS_PASSED[] = "No parameters passed with RPC, passing null JSON";
+char constexpr CALLING_RPC_CB[] = "Calling subscribed callback for rpc with methodname (%s)";
+char constexpr RPC_RESPONSE_CACHED[] = "Server-side RPC request with id (%u) was already handled, sending cached response";
+// Warning of Server_Side_RPC, longer than the transmit buffer once formatted
+char constexpr RPC_RESPONSE_NOT_CACHED[] = "Server-side RPC request with id (%u) was already handled, but its response did not fit into the cache, increase MaxCachedResponseSize (%u)";
+
+// Transmit buffer drained at the baud rate, writing more than fits blocks until enough was sent
+class Serial_Model {
+  public:
+    void Reset() {
+        m_now_ms = 0.0;
+        m_queued = 0.0;
+        m_blocked_ms = 0.0;
+    }
+
+    void Advance_To(double const & now_ms) {
+        if (now_ms <= m_now_ms) {
+            return;
+        }
+        double const sent = (now_ms - m_now_ms) * SERIAL_BAUD / 10e3;
+        m_queued = sent >= m_queued ? 0.0 : m_queued - sent;
+        m_now_ms = now_ms;
+    }
+
+    size_t availableForWrite() const {
+        return SERIAL_TX_BUFFER - static_cast<size_t>(m_queued + 0.999);
+    }
+
+    size_t println(char const * message) {
+        double const size = static_cast<double>(std::strlen(message) + 2U);
+        double const free = SERIAL_TX_BUFFER - m_queued;
+        if (size > free) {
+            double const wait_ms = (size - free) * 10e3 / SERIAL_BAUD;
+            m_blocked_ms += wait_ms;
+            Advance_To(m_now_ms + wait_ms);
+        }
+        m_queued += size;
+        return static_cast<size_t>(size);
+    }
+
+    double Get_Now() const {
+        return m_now_ms;
+    }
+
+    double Get_Blocked() const {
+        return m_blocked_ms;
+    }
+
+  private:
+    double m_now_ms = 0.0;     // Simulated time
+    double m_queued = 0.0;     // Bytes in the transmit buffer
+    double m_blocked_ms = 0.0; // Time spent waiting for room in the transmit buffer
+};
+
+Serial_Model serial;
+
+// Formats into a buffer on the stack and prints it immediately, like DefaultLogger
+class Synchronous_Logger {
+  public:
+    template<typename ...Args>
+    static int printfln(char const * const format, Args const &... args) {
+        char message[160];
+        int const length = std::snprintf(message, sizeof(message), format, args...);
+        serial.println(message);
+        return length;
+    }
+
+    static int println(char const * const message) {
+        return static_cast<int>(serial.println(message));
+    }
+};
+
+using Deferred = Deferred_Logger<16U, 48U>;
+
+// The debug logging Server_Side_RPC does while processing one request
+template<typename Logger>
+void Process_Rpc(char const * method_name, unsigned int const & request_id) {
+    if (request_id % 4U == 3U) {
+        Logger::printfln(RPC_RESPONSE_CACHED, request_id);
+        return;
+    }
+    Logger::println(NO_RPC_PARAMS_PASSED);
+    Logger::printfln(CALLING_RPC_CB, method_name);
+}
+
+struct Result {
+    double cpu_ns = 0.0;      // Host CPU time of the logging per request
+    double blocked_ms = 0.0;  // Mean time blocked on the serial port per request
+    double worst_ms = 0.0;    // Longest time one request was blocked
+};
+
+template<typename Logger, bool Deferred_Flush>
+Result Run() {
+    Result result;
+    double cpu_ns = 0.0;
+    for (size_t repetition = 0U; repetition < REPETITIONS; repetition++) {
+        serial.Reset();
+        for (size_t i = 0U; i < RPC_COUNT; i++) {
+            serial.Advance_To(i * RPC_INTERVAL_MS);
+            double const blocked_before = serial.Get_Blocked();
+            // The received message is overwritten by the next one, string arguments may not be kept as a pointer
+            char method_name[32];
+            std::snprintf(method_name, sizeof(method_name), "setTemperature%u", static_cast<unsigned int>(i % 3U));
+            auto const start = std::chrono::steady_clock::now();
+            Process_Rpc<Logger>(method_name, static_cast<unsigned int>(i));
+            cpu_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            double const blocked = serial.Get_Blocked() - blocked_before;
+            result.worst_ms = blocked > result.worst_ms ? blocked : result.worst_ms;
+            if (Deferred_Flush) {
+                // Idle time of loop() until the next request, flushed in small steps as the transmit buffer empties
+                for (double now = serial.Get_Now(); now < (i + 1U) * RPC_INTERVAL_MS; now += 1.0) {
+                    serial.Advance_To(now);
+                    Deferred::Flush(serial, serial.availableForWrite());
+                }
+            }
+        }
+        result.blocked_ms += serial.Get_Blocked();
+        // Messages still queued at the end of the burst are printed during the following idle time
+        while (Deferred_Flush && Deferred::Has_Pending()) {
+            serial.Advance_To(serial.Get_Now() + 1.0);
+            Deferred::Flush(serial, serial.availableForWrite());
+        }
+    }
+    result.cpu_ns = cpu_ns / (REPETITIONS * RPC_COUNT);
+    result.blocked_ms /= REPETITIONS * RPC_COUNT;
+    return result;
+}
+
+void Print(char const * name, Result const & result) {
+    std::printf("%-12s %10.1f ns %14.3f ms %14.3f ms\n", name, result.cpu_ns, result.blocked_ms, result.worst_ms);
+}
+
+} // namespace
+
+
+int main() {
+    std::printf("%zu rpcs every %.0f ms, debug messages printed at %.0f baud with a %zu byte transmit buffer\n",
+        RPC_COUNT, RPC_INTERVAL_MS, SERIAL_BAUD, SERIAL_TX_BUFFER);
+    std::printf("%-12s %13s %17s %17s\n", "logger", "cpu per rpc", "blocked per rpc", "worst rpc");
+    Print("synchronous", Run<Synchronous_Logger, false>());
+    Print("deferred", Run<Deferred, true>());
+    std::printf("deferred logger dropped %u messages, %.1f per burst\n", Deferred::Get_Dropped(), static_cast<double>(Deferred::Get_Dropped()) / REPETITIONS);
+
+    // Flushed messages have to be identical to the synchronously formatted ones
+    struct Capture {
+        char text[160] = {};
+        size_t println(char const * message) {
+            std::snprintf(text, sizeof(text), "%s", message);
+            return std::strlen(message) + 2U;
+        }
+    } capture;
+    char method_name[32] = "setLedMode";
+    Deferred::printfln(CALLING_RPC_CB, method_name);
+    std::strcpy(method_name, "overwritten");
+    Deferred::Flush(capture, sizeof(capture.text));
+    char expected[160];
+    std::snprintf(expected, sizeof(expected), CALLING_RPC_CB, "setLedMode");
+    bool const identical = std::strcmp(expected, capture.text) == 0;
+    std::printf("formatted message \"%s\": %s\n", capture.text, identical ? "PASS" : "FAIL");
+
+    // A message longer than the whole transmit buffer is truncated to it, instead of blocking every message queued after it
+    Deferred::printfln(RPC_RESPONSE_NOT_CACHED, 17U, 64U);
+    Deferred::println(NO_RPC_PARAMS_PASSED);
+    size_t const printed = Deferred::Flush(capture, SERIAL_TX_BUFFER, SERIAL_TX_BUFFER);
+    size_t const truncated = std::strlen(capture.text);
+    size_t const remaining = Deferred::Flush(capture, SERIAL_TX_BUFFER, SERIAL_TX_BUFFER);
+    bool const unblocked = printed == 1U && truncated + 2U == SERIAL_TX_BUFFER && remaining == 1U && std::strcmp(capture.text, NO_RPC_PARAMS_PASSED) == 0 && !Deferred::Has_Pending();
+    std::printf("message longer than the %zu byte transmit buffer is truncated: %s\n", SERIAL_TX_BUFFER, unblocked ? "PASS" : "FAIL");
+    return identical && unblocked ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+// Host benchmark of the model predictive temperature controller against the PID baseline.
+// Simulates a batch temperature profile on a plant whose parameters deliberately differ from the controller model,
+// compares the tracking error of both controllers, and checks the worst case solve time against the control tick budget of the device.
+// Build and run from the repository root:
+//     g++ -std=c++11 -O2 -I. -Itools tools/mpc_benchmark.cpp -o mpc_benchmark && ./mpc_benchmark
+// Exits with 1 if the estimated solve time on the device exceeds the budget.
+
+// Local includes.
+#include "Batch_Simulation.h"
+#include "PID_Controller.h"
+#include "Temperature_MPC.h"
+
+// Library includes.
+#include <cstdio>
+
+
+namespace {
+
+// Controller configuration, identical to the one used on the device
+size_t constexpr MPC_HORIZON = 20U;
+size_t constexpr MPC_ITERATIONS = 60U;
+float constexpr TICK_SECONDS = 1.0f;
+
+// Budget of one control tick on the device and the conservative cost model of the ESP32 single precision FPU,
+// a multiply-add including both operand loads is counted as 8 cycles at 240 MHz
+double constexpr BUDGET_MILLISECONDS = 100.0;
+double constexpr DEVICE_CYCLES_PER_OPERATION = 8.0;
+double constexpr DEVICE_CLOCK_HZ = 240e6;
+
+// Setpoint profile, heat up, hold, cool down, heat up again
+Setpoint_Phase constexpr PHASES[] = {
+    { 0.0f, 37.0f },
+    { 7200.0f, 30.0f },
+    { 10800.0f, 37.0f }
+};
+Batch_Profile constexpr PROFILE = { "heat-cool-heat", PHASES, sizeof(PHASES) / sizeof(PHASES[0U]), 14400.0f };
+
+void Print(char const * name, Batch_Result const & result) {
+    std::printf("%-5s IAE %9.1f K*s  overshoot %5.2f K  settle %6.0f s  solve mean %7.2f us  max %7.2f us\n",
+        name, result.iae, result.overshoot_c, result.settle_seconds, result.mean_microseconds, result.max_microseconds);
+}
+
+} // namespace
+
+
+int main() {
+    // Plant differs from the model the controller was designed with
+    Batch_Disturbance disturbance = { "mismatch", Thermal_Parameters(), 0.0f, 0.0f, Sensor_Noise_Profile(), Pulse_Disturbance_Profile() };
+    disturbance.plant.vessel_capacity_j_per_k *= 1.15f;
+    disturbance.plant.jacket_vessel_conductance_w_per_k *= 0.9f;
+    disturbance.plant.ambient_c = 20.0f;
+
+    PID_Gains gains;
+    gains.kp = 0.4f;
+    gains.ki = 0.0004f;
+    gains.kd = 30.0f;
+    PID_Controller pid(gains);
+    Batch_Result const pid_result = Simulate_Batch([&pid](float const & measured, float const & setpoint) {
+        return pid.Update(measured, setpoint, TICK_SECONDS);
+    }, PROFILE, disturbance, TICK_SECONDS, true);
+
+    MPC_Settings settings;
+    settings.tick_seconds = TICK_SECONDS;
+    Temperature_MPC<MPC_HORIZON, MPC_ITERATIONS> mpc(Thermal_Model(), settings);
+    Batch_Result const mpc_result = Simulate_Batch([&mpc](float const & measured, float const & setpoint) {
+        return mpc.Update(measured, setpoint);
+    }, PROFILE, disturbance, TICK_SECONDS, true);
+
+    Print("PID", pid_result);
+    Print("MPC", mpc_result);
+
+    size_t const operations = Temperature_MPC<MPC_HORIZON, MPC_ITERATIONS>::OPERATIONS_PER_SOLVE;
+    double const device_milliseconds = static_cast<double>(operations) * DEVICE_CYCLES_PER_OPERATION / DEVICE_CLOCK_HZ * 1000.0;
+    bool const within_budget = device_milliseconds <= BUDGET_MILLISECONDS;
+    std::printf("MPC worst case %zu multiply-adds, estimated %.2f ms on the device, budget %.0f ms: %s\n",
+        operations, device_milliseconds, BUDGET_MILLISECONDS, within_budget ? "PASS" : "FAIL");
+    return within_budget ? 0 : 1;
+}
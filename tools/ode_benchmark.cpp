@@ -0,0 +1,189 @@
+// Host benchmark of the Rosenbrock integrator against explicit fixed step integrators on the stiff bioreactor model.
+// Every integrator is tuned to the cheapest setting (largest step or loosest tolerance) that still reaches the same accuracy at every hour of the batch,
+// compared to a reference solution, then its throughput is measured in simulated hours per CPU second.
+// Build and run from the repository root:
+//     g++ -std=c++11 -O2 -Itools tools/ode_benchmark.cpp -o ode_benchmark && ./ode_benchmark
+
+// Local includes.
+#include "Bioreactor_Model.h"
+#include "Rosenbrock_Integrator.h"
+
+// Library includes.
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+
+
+namespace {
+
+size_t constexpr N = Bioreactor_Model::STATES;
+// Simulated batch, long enough to deplete the substrate
+double constexpr BATCH_HOURS = 24.0;
+// Largest accepted error of any state at the end of the batch, relative to the reference
+double constexpr TARGET_ERROR = 1e-4;
+// The trajectory is compared at every full hour
+size_t constexpr CHECKPOINTS = 24U;
+// Step of the reference solution (2^-17 h), far below the stability limit of the fastest mode, fixed steps are powers of two to hit every checkpoint exactly
+double constexpr REFERENCE_STEP_HOURS = 1.0 / 131072.0;
+// Every measurement is repeated until it took at least this long, to get a stable timing
+double constexpr MINIMUM_MEASUREMENT_SECONDS = 0.2;
+
+char constexpr const * STATE_NAMES[N] = { "biomass", "substrate", "oxygen", "co2", "ph" };
+
+void Euler_Step(Bioreactor_Model const & model, double const & t, double (&y)[N], double const & h) {
+    double dydt[N] = {};
+    model.Derivative(t, y, dydt);
+    for (size_t i = 0U; i < N; i++) {
+        y[i] += h * dydt[i];
+    }
+}
+
+void RK4_Step(Bioreactor_Model const & model, double const & t, double (&y)[N], double const & h) {
+    double k1[N] = {};
+    double k2[N] = {};
+    double k3[N] = {};
+    double k4[N] = {};
+    double stage[N] = {};
+    model.Derivative(t, y, k1);
+    for (size_t i = 0U; i < N; i++) {
+        stage[i] = y[i] + 0.5 * h * k1[i];
+    }
+    model.Derivative(t + 0.5 * h, stage, k2);
+    for (size_t i = 0U; i < N; i++) {
+        stage[i] = y[i] + 0.5 * h * k2[i];
+    }
+    model.Derivative(t + 0.5 * h, stage, k3);
+    for (size_t i = 0U; i < N; i++) {
+        stage[i] = y[i] + h * k3[i];
+    }
+    model.Derivative(t + h, stage, k4);
+    for (size_t i = 0U; i < N; i++) {
+        y[i] += h / 6.0 * (k1[i] + 2.0 * k2[i] + 2.0 * k3[i] + k4[i]);
+    }
+}
+
+using Trajectory = double[CHECKPOINTS][N];
+
+template<typename Step_Function>
+void Integrate_Fixed(Bioreactor_Model const & model, Step_Function const & step, double const & h, Trajectory & trajectory) {
+    double y[N] = {};
+    model.Initial_State(y);
+    size_t const steps_per_checkpoint = static_cast<size_t>(BATCH_HOURS / CHECKPOINTS / h);
+    size_t tick = 0U;
+    for (size_t checkpoint = 0U; checkpoint < CHECKPOINTS; checkpoint++) {
+        for (size_t i = 0U; i < steps_per_checkpoint; i++, tick++) {
+            step(model, static_cast<double>(tick) * h, y, h);
+        }
+        for (size_t i = 0U; i < N; i++) {
+            trajectory[checkpoint][i] = y[i];
+        }
+    }
+}
+
+void Integrate_Rosenbrock(Bioreactor_Model const & model, Rosenbrock_Integrator<Bioreactor_Model> & integrator, Trajectory & trajectory) {
+    double y[N] = {};
+    model.Initial_State(y);
+    double step = 1e-4;
+    for (size_t checkpoint = 0U; checkpoint < CHECKPOINTS; checkpoint++) {
+        double const start = BATCH_HOURS * checkpoint / CHECKPOINTS;
+        integrator.Integrate(model, start, start + BATCH_HOURS / CHECKPOINTS, y, step);
+        step = integrator.Get_Next_Step();
+        for (size_t i = 0U; i < N; i++) {
+            trajectory[checkpoint][i] = y[i];
+        }
+    }
+}
+
+/// @brief Largest error of any state at any checkpoint, relative to the magnitude of the reference
+double Error(Trajectory const & trajectory, Trajectory const & reference) {
+    double error = 0.0;
+    for (size_t checkpoint = 0U; checkpoint < CHECKPOINTS; checkpoint++) {
+        for (size_t i = 0U; i < N; i++) {
+            double const expected = reference[checkpoint][i];
+            double const actual = trajectory[checkpoint][i];
+            double const scale = std::fabs(expected) > 1e-3 ? std::fabs(expected) : 1e-3;
+            double const relative = std::isfinite(actual) ? std::fabs(actual - expected) / scale : HUGE_VAL;
+            error = relative > error ? relative : error;
+        }
+    }
+    return error;
+}
+
+/// @brief Measures the CPU time of the given integration, repeated until the measurement is long enough
+template<typename Function>
+double CPU_Seconds(Function const & function) {
+    size_t repetitions = 0U;
+    std::clock_t const start = std::clock();
+    double seconds = 0.0;
+    do {
+        function();
+        repetitions++;
+        seconds = static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+    } while (seconds < MINIMUM_MEASUREMENT_SECONDS);
+    return seconds / static_cast<double>(repetitions);
+}
+
+void Print(char const * name, char const * setting, double const & value, size_t const & steps, size_t const & evaluations, double const & error, double const & seconds) {
+    std::printf("%-11s %-9s %10.3g %10zu steps %10zu f-evals  error %8.2e  %12.1f sim-h/cpu-s\n",
+        name, setting, value, steps, evaluations, error, BATCH_HOURS / seconds);
+}
+
+template<typename Step_Function>
+void Benchmark_Fixed(char const * name, Bioreactor_Model const & model, Step_Function const & step, size_t const & evaluations_per_step, Trajectory const & reference) {
+    double h = 0.125;
+    Trajectory trajectory = {};
+    for (; h > REFERENCE_STEP_HOURS; h *= 0.5) {
+        Integrate_Fixed(model, step, h, trajectory);
+        if (Error(trajectory, reference) <= TARGET_ERROR) {
+            break;
+        }
+    }
+    double const error = Error(trajectory, reference);
+    double const seconds = CPU_Seconds([&]() {
+        Integrate_Fixed(model, step, h, trajectory);
+    });
+    size_t const steps = static_cast<size_t>(BATCH_HOURS / h);
+    Print(name, "step h", h, steps, steps * evaluations_per_step, error, seconds);
+}
+
+void Benchmark_Rosenbrock(Bioreactor_Model const & model, Trajectory const & reference) {
+    double tolerance = 1e-2;
+    Trajectory trajectory = {};
+    Integrator_Statistics statistics;
+    for (; tolerance > 1e-12; tolerance *= 0.5) {
+        Rosenbrock_Integrator<Bioreactor_Model> integrator(tolerance, tolerance * 1e-3);
+        Integrate_Rosenbrock(model, integrator, trajectory);
+        statistics = integrator.Get_Statistics();
+        if (Error(trajectory, reference) <= TARGET_ERROR) {
+            break;
+        }
+    }
+    double const error = Error(trajectory, reference);
+    Rosenbrock_Integrator<Bioreactor_Model> integrator(tolerance, tolerance * 1e-3);
+    double const seconds = CPU_Seconds([&]() {
+        Integrate_Rosenbrock(model, integrator, trajectory);
+    });
+    Print("Rosenbrock", "rtol", tolerance, statistics.accepted_steps + statistics.rejected_steps, statistics.function_evaluations, error, seconds);
+    std::printf("            %zu rejected steps, %zu jacobians, %zu decompositions\n", statistics.rejected_steps, statistics.jacobian_evaluations, statistics.decompositions);
+}
+
+} // namespace
+
+
+int main() {
+    Bioreactor_Model const model;
+    static Trajectory reference = {};
+    Integrate_Fixed(model, RK4_Step, REFERENCE_STEP_HOURS, reference);
+    // Middle of the exponential growth phase
+    size_t constexpr SHOWN_CHECKPOINT = 7U;
+    std::printf("Reference after %zu h:", SHOWN_CHECKPOINT + 1U);
+    for (size_t i = 0U; i < N; i++) {
+        std::printf(" %s %.6g", STATE_NAMES[i], reference[SHOWN_CHECKPOINT][i]);
+    }
+    std::printf("\nTarget error %.0e relative, cheapest setting reaching it:\n", TARGET_ERROR);
+
+    Benchmark_Fixed("Euler", model, Euler_Step, 1U, reference);
+    Benchmark_Fixed("RK4", model, RK4_Step, 4U, reference);
+    Benchmark_Rosenbrock(model, reference);
+    return 0;
+}
@@ -0,0 +1,314 @@
+// Parallel parameter sweep of the temperature controllers, used to tune their gains offline.
+// Every combination of controller gains, setpoint profile and plant disturbance is one job, that simulates a complete batch on its own virtual clock.
+// Jobs are sharded across a work-stealing thread pool, a thread pops jobs from the back of its own queue and steals from the front of the other queues once it ran empty,
+// batches of very different cost (MPC against PID) are therefore balanced without any central lock, and the sweep scales with the amount of cores.
+// Build and run from the repository root:
+//     g++ -std=c++11 -O2 -pthread -I. -Itools tools/parameter_sweep.cpp -o parameter_sweep && ./parameter_sweep [threads] [results.csv] [seed] [metrics.prom]
+// The results table (CSV) is written to the given file or stdout, the throughput to stderr.
+// Runtime metrics of the sweep (see Metrics.h), updated lock-free from the worker threads, are dumped in the Prometheus text format to the given file, "-" writes them to stderr.
+// Sensor noise and feed disturbances are drawn from a counter based generator keyed by the seed, the scenario (profile and disturbance) and the replicate,
+// every controller of the same scenario and replicate sees the same noise, and the table is identical for any amount of threads.
+
+// Local includes.
+#include "Batch_Simulation.h"
+#include "Metrics.h"
+#include "PID_Controller.h"
+#include "Temperature_MPC.h"
+
+// Library includes.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+size_t constexpr MPC_HORIZON = 20U;
+size_t constexpr MPC_ITERATIONS = 60U;
+float constexpr TICK_SECONDS = 1.0f;
+// Independent noise realizations every parameter set is simulated with
+size_t constexpr REPLICATES = 2U;
+
+// Parameter grid
+float constexpr PID_KP[] = { 0.1f, 0.2f, 0.4f, 0.8f, 1.6f };
+float constexpr PID_KI[] = { 0.0001f, 0.0002f, 0.0004f, 0.0008f, 0.0016f };
+float constexpr PID_KD[] = { 0.0f, 15.0f, 30.0f, 60.0f };
+float constexpr MPC_MOVE_WEIGHT[] = { 0.01f, 0.05f, 0.2f, 1.0f };
+float constexpr MPC_PREDICTION_STEP[] = { 15.0f, 30.0f, 60.0f };
+
+Setpoint_Phase constexpr HEAT_COOL_HEAT[] = {
+    { 0.0f, 37.0f },
+    { 7200.0f, 30.0f },
+    { 10800.0f, 37.0f }
+};
+Setpoint_Phase constexpr STEP_HOLD[] = {
+    { 0.0f, 32.0f },
+    { 5400.0f, 37.0f }
+};
+Batch_Profile constexpr PROFILES[] = {
+    { "heat-cool-heat", HEAT_COOL_HEAT, sizeof(HEAT_COOL_HEAT) / sizeof(HEAT_COOL_HEAT[0U]), 14400.0f },
+    { "step-hold", STEP_HOLD, sizeof(STEP_HOLD) / sizeof(STEP_HOLD[0U]), 10800.0f }
+};
+
+std::vector<Batch_Disturbance> Disturbances() {
+    std::vector<Batch_Disturbance> disturbances;
+    disturbances.push_back(Batch_Disturbance{ "nominal", Thermal_Parameters(), 0.0f, 0.0f, Sensor_Noise_Profile(), Pulse_Disturbance_Profile() });
+    Batch_Disturbance mismatch = { "mismatch", Thermal_Parameters(), 0.0f, 0.0f, Sensor_Noise_Profile(), Pulse_Disturbance_Profile() };
+    mismatch.plant.vessel_capacity_j_per_k *= 1.15f;
+    mismatch.plant.jacket_vessel_conductance_w_per_k *= 0.9f;
+    mismatch.plant.ambient_c = 20.0f;
+    disturbances.push_back(mismatch);
+    // Exothermic culture adding heat once the batch is running
+    Batch_Disturbance exothermic = mismatch;
+    exothermic.name = "mismatch+exotherm";
+    exothermic.heat_load_w = 40.0f;
+    exothermic.heat_load_start_seconds = 3600.0f;
+    disturbances.push_back(exothermic);
+    // Realistic probe and process, noisy drifting probe with dropouts and cold feed additions
+    Batch_Disturbance noisy = mismatch;
+    noisy.name = "mismatch+noise+feed";
+    noisy.sensor.noise_sigma = 0.05f;
+    noisy.sensor.drift_sigma = 0.0005f;
+    noisy.sensor.dropout_probability = 0.01f;
+    noisy.sensor.quantization = 0.01f;
+    noisy.feed.probability = 1.0f / 1800.0f;
+    noisy.feed.amplitude_min = -150.0f;
+    noisy.feed.amplitude_max = -50.0f;
+    noisy.feed.duration = 120U;
+    disturbances.push_back(noisy);
+    return disturbances;
+}
+
+enum class Controller_Type : uint8_t {
+    PID,
+    MPC
+};
+
+struct Sweep_Job {
+    Controller_Type type;
+    float           parameters[3U]; // kp, ki, kd or move weight, prediction step
+    size_t          profile;
+    size_t          disturbance;
+    size_t          replicate;
+    uint32_t        noise_key;      // Identifies the scenario and replicate, used as the simulated device of the noise generator
+};
+
+std::vector<Sweep_Job> Build_Grid(size_t const & disturbance_count) {
+    std::vector<Sweep_Job> jobs;
+    size_t constexpr profile_count = sizeof(PROFILES) / sizeof(PROFILES[0U]);
+    for (size_t profile = 0U; profile < profile_count; profile++) {
+        for (size_t disturbance = 0U; disturbance < disturbance_count; disturbance++) {
+            for (size_t replicate = 0U; replicate < REPLICATES; replicate++) {
+                uint32_t const noise_key = static_cast<uint32_t>((profile * disturbance_count + disturbance) * REPLICATES + replicate);
+                for (float const kp : PID_KP) {
+                    for (float const ki : PID_KI) {
+                        for (float const kd : PID_KD) {
+                            jobs.push_back(Sweep_Job{ Controller_Type::PID, { kp, ki, kd }, profile, disturbance, replicate, noise_key });
+                        }
+                    }
+                }
+                for (float const move_weight : MPC_MOVE_WEIGHT) {
+                    for (float const prediction_step : MPC_PREDICTION_STEP) {
+                        jobs.push_back(Sweep_Job{ Controller_Type::MPC, { move_weight, prediction_step, 0.0f }, profile, disturbance, replicate, noise_key });
+                    }
+                }
+            }
+        }
+    }
+    return jobs;
+}
+
+// Metrics of the sweep, incremented concurrently by every worker thread
+Metric_Counter pid_batches;
+Metric_Counter mpc_batches;
+Metric_Histogram batch_duration_us;
+Metric_Gauge worker_threads;
+
+Batch_Result Run_Job(Sweep_Job const & job, std::vector<Batch_Disturbance> const & disturbances, uint64_t const & seed) {
+    Batch_Profile const & profile = PROFILES[job.profile];
+    Batch_Disturbance const & disturbance = disturbances[job.disturbance];
+    if (job.type == Controller_Type::PID) {
+        PID_Gains gains;
+        gains.kp = job.parameters[0U];
+        gains.ki = job.parameters[1U];
+        gains.kd = job.parameters[2U];
+        PID_Controller pid(gains);
+        return Simulate_Batch([&pid](float const & measured, float const & setpoint) {
+            return pid.Update(measured, setpoint, TICK_SECONDS);
+        }, profile, disturbance, TICK_SECONDS, false, seed, job.noise_key);
+    }
+    MPC_Settings settings;
+    settings.tick_seconds = TICK_SECONDS;
+    settings.move_weight = job.parameters[0U];
+    settings.prediction_step_seconds = job.parameters[1U];
+    Temperature_MPC<MPC_HORIZON, MPC_ITERATIONS> mpc(Thermal_Model(), settings);
+    return Simulate_Batch([&mpc](float const & measured, float const & setpoint) {
+        return mpc.Update(measured, setpoint);
+    }, profile, disturbance, TICK_SECONDS, false, seed, job.noise_key);
+}
+
+
+/// @brief Thread pool with one job queue per thread, idle threads steal from the other queues.
+/// All jobs are known up front and jobs never spawn new ones, a thread therefore exits once its own queue and all queues it tried to steal from are empty
+class Work_Stealing_Pool {
+  public:
+    explicit Work_Stealing_Pool(size_t const & thread_count)
+      : m_queues(thread_count)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Runs function(index) for every index in [0, count) and blocks until all of them finished
+    template<typename Function>
+    void Run(size_t const & count, Function const & function) {
+        size_t const thread_count = m_queues.size();
+        // Contiguous shards, neighbouring jobs have similar cost, stealing from the front takes the work furthest away from the owner
+        for (size_t thread = 0U; thread < thread_count; thread++) {
+            size_t const begin = count * thread / thread_count;
+            size_t const end = count * (thread + 1U) / thread_count;
+            for (size_t index = begin; index < end; index++) {
+                m_queues[thread].jobs.push_back(index);
+            }
+        }
+        std::vector<std::thread> threads;
+        for (size_t thread = 0U; thread < thread_count; thread++) {
+            threads.emplace_back([this, thread, &function]() {
+                size_t index = 0U;
+                while (Pop(thread, index) || Steal(thread, index)) {
+                    function(index);
+                }
+            });
+        }
+        for (std::thread & thread : threads) {
+            thread.join();
+        }
+    }
+
+    /// @brief Amount of jobs that were executed by another thread than the one they were sharded to
+    /// @return Counter of the stolen jobs
+    Metric_Counter const & Get_Stolen() const {
+        return m_stolen;
+    }
+
+  private:
+    struct Queue {
+        std::mutex         lock;
+        std::deque<size_t> jobs;
+    };
+
+    bool Pop(size_t const & thread, size_t & index) {
+        Queue & queue = m_queues[thread];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.jobs.empty()) {
+            return false;
+        }
+        index = queue.jobs.back();
+        queue.jobs.pop_back();
+        return true;
+    }
+
+    bool Steal(size_t const & thread, size_t & index) {
+        size_t const thread_count = m_queues.size();
+        for (size_t offset = 1U; offset < thread_count; offset++) {
+            Queue & victim = m_queues[(thread + offset) % thread_count];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.jobs.empty()) {
+                index = victim.jobs.front();
+                victim.jobs.pop_front();
+                m_stolen.Increment();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Queue> m_queues; // One queue per thread
+    Metric_Counter     m_stolen; // Jobs taken from the queue of another thread
+};
+
+// Adapts a file to the output interface of Metrics_Registry::Write_Prometheus
+struct File_Output {
+    FILE * file;
+
+    size_t write(uint8_t const * buffer, size_t const & size) {
+        return std::fwrite(buffer, 1U, size, file);
+    }
+};
+
+} // namespace
+
+
+int main(int argc, char * argv[]) {
+    size_t thread_count = std::thread::hardware_concurrency();
+    if (argc > 1) {
+        thread_count = static_cast<size_t>(std::strtoul(argv[1], nullptr, 10));
+    }
+    if (thread_count == 0U) {
+        thread_count = 1U;
+    }
+    uint64_t seed = 1U;
+    if (argc > 3) {
+        seed = std::strtoull(argv[3], nullptr, 10);
+    }
+    FILE * output = stdout;
+    if (argc > 2) {
+        output = std::fopen(argv[2], "w");
+        if (output == nullptr) {
+            std::fprintf(stderr, "Failed to open %s\n", argv[2]);
+            return 1;
+        }
+    }
+
+    std::vector<Batch_Disturbance> const disturbances = Disturbances();
+    std::vector<Sweep_Job> const jobs = Build_Grid(disturbances.size());
+    // Every job writes only its own slot, no synchronization needed
+    std::vector<Batch_Result> results(jobs.size());
+
+    auto const start = std::chrono::steady_clock::now();
+    Work_Stealing_Pool pool(thread_count);
+    Metrics_Registry<8U> metrics;
+    metrics.Add("pid_batches_total", pid_batches);
+    metrics.Add("mpc_batches_total", mpc_batches);
+    metrics.Add("stolen_jobs_total", pool.Get_Stolen());
+    metrics.Add("batch_duration_us", batch_duration_us);
+    metrics.Add("worker_threads", worker_threads);
+    worker_threads.Set(static_cast<float>(thread_count));
+    pool.Run(jobs.size(), [&](size_t const & index) {
+        auto const batch_start = std::chrono::steady_clock::now();
+        results[index] = Run_Job(jobs[index], disturbances, seed);
+        batch_duration_us.Record(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - batch_start).count()));
+        (jobs[index].type == Controller_Type::PID ? pid_batches : mpc_batches).Increment();
+    });
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::fprintf(output, "controller,p1,p2,p3,profile,disturbance,replicate,iae_ks,overshoot_c,settle_s\n");
+    for (size_t index = 0U; index < jobs.size(); index++) {
+        Sweep_Job const & job = jobs[index];
+        Batch_Result const & result = results[index];
+        std::fprintf(output, "%s,%g,%g,%g,%s,%s,%zu,%.1f,%.3f,%.0f\n",
+            job.type == Controller_Type::PID ? "pid" : "mpc", job.parameters[0U], job.parameters[1U], job.parameters[2U],
+            PROFILES[job.profile].name, disturbances[job.disturbance].name, job.replicate, result.iae, result.overshoot_c, result.settle_seconds);
+    }
+    if (output != stdout) {
+        std::fclose(output);
+    }
+    std::fprintf(stderr, "%zu batches on %zu threads in %.2f s (%.1f batches/s)\n", jobs.size(), thread_count, seconds, static_cast<double>(jobs.size()) / seconds);
+    if (argc > 4) {
+        bool const to_stderr = std::strcmp(argv[4], "-") == 0;
+        File_Output metrics_output = { to_stderr ? stderr : std::fopen(argv[4], "w") };
+        if (metrics_output.file == nullptr) {
+            std::fprintf(stderr, "Failed to open %s\n", argv[4]);
+            return 1;
+        }
+        metrics.Write_Prometheus(metrics_output, "sweep_");
+        if (!to_stderr) {
+            std::fclose(metrics_output.file);
+        }
+    }
+    return 0;
+}
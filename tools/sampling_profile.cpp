@@ -0,0 +1,192 @@
+// Host side of the sampling profiler (see Sampling_Profiler.h), resolves sampled program counters to the functions they belong to.
+// Without arguments the host simulation of a batch with the model predictive controller is profiled with the same histogram the device uses,
+// sampled with SIGPROF instead of a timer interrupt, and resolved against this executable, which shows the profiler and the resolution working end to end.
+// With resolve the dumpProfile responses of a device are read from stdin, every "profile":"<pc>:<count>,..." page is collected
+// and resolved against the firmware ELF with addr2line, the toolchain one (e.g. xtensa-esp32-elf-addr2line) has to be given for device dumps.
+// Build and run from the repository root:
+//     g++ -std=c++11 -O2 -g -I. -Itools tools/sampling_profile.cpp -o sampling_profile && ./sampling_profile
+//     ./sampling_profile resolve firmware.elf xtensa-esp32-elf-addr2line < responses.txt
+
+// Local includes.
+#include "Batch_Simulation.h"
+#include "Sampling_Profiler.h"
+#include "Temperature_MPC.h"
+
+// Library includes.
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <link.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+
+namespace {
+
+// Same configuration as the device
+size_t constexpr MPC_HORIZON = 20U;
+size_t constexpr MPC_ITERATIONS = 60U;
+float constexpr TICK_SECONDS = 1.0f;
+uint32_t constexpr SAMPLE_RATE_HZ = 1000U;
+size_t constexpr SIMULATED_BATCHES = 20U;
+size_t constexpr PRINTED_FUNCTIONS = 15U;
+char constexpr PROFILE_KEY[] = "\"profile\":\"";
+
+Setpoint_Phase constexpr PHASES[] = {
+    { 0.0f, 37.0f },
+    { 7200.0f, 30.0f },
+    { 10800.0f, 37.0f }
+};
+Batch_Profile constexpr PROFILE = { "heat-cool-heat", PHASES, sizeof(PHASES) / sizeof(PHASES[0U]), 14400.0f };
+
+using Sample = std::pair<uintptr_t, uint32_t>;
+
+// Resolves the addresses to function names with one addr2line call, unknown addresses are resolved to "??"
+std::vector<std::string> Resolve(std::string const & addr2line, std::string const & elf, std::vector<Sample> const & samples) {
+    std::vector<std::string> functions;
+    if (samples.empty()) {
+        return functions;
+    }
+    std::string command = addr2line + " -f -C -e '" + elf + "'";
+    char address[24] = {};
+    for (Sample const & sample : samples) {
+        std::snprintf(address, sizeof(address), " 0x%" PRIxPTR, sample.first);
+        command += address;
+    }
+    std::unique_ptr<FILE, int(*)(FILE *)> output(popen(command.c_str(), "r"), &pclose);
+    if (output == nullptr) {
+        return functions;
+    }
+    // Two lines per address, the function and the source location
+    char line[1024] = {};
+    bool function_line = true;
+    while (std::fgets(line, sizeof(line), output.get()) != nullptr) {
+        if (function_line) {
+            line[std::strcspn(line, "\r\n")] = '\0';
+            functions.emplace_back(line);
+        }
+        function_line = !function_line;
+    }
+    return functions;
+}
+
+// Sums the samples of every function and prints the hottest ones
+int Print_Report(std::string const & addr2line, std::string const & elf, std::vector<Sample> const & samples, uint32_t const & total, uint32_t const & dropped) {
+    std::vector<std::string> const functions = Resolve(addr2line, elf, samples);
+    if (functions.size() != samples.size()) {
+        std::fprintf(stderr, "Resolving %zu addresses with %s failed\n", samples.size(), addr2line.c_str());
+        return 1;
+    }
+    std::map<std::string, uint32_t> per_function;
+    uint32_t counted = 0U;
+    for (size_t i = 0U; i < samples.size(); i++) {
+        per_function[functions[i]] += samples[i].second;
+        counted += samples[i].second;
+    }
+    std::vector<std::pair<std::string, uint32_t>> ranked(per_function.begin(), per_function.end());
+    std::sort(ranked.begin(), ranked.end(), [](std::pair<std::string, uint32_t> const & lhs, std::pair<std::string, uint32_t> const & rhs) {
+        return lhs.second > rhs.second;
+    });
+
+    std::printf("%" PRIu32 " samples, %" PRIu32 " dropped, %zu granules in %zu functions\n", total, dropped, samples.size(), ranked.size());
+    std::printf("%8s %7s  %s\n", "samples", "share", "function");
+    for (size_t i = 0U; i < ranked.size() && i < PRINTED_FUNCTIONS; i++) {
+        std::printf("%8" PRIu32 " %6.1f%%  %s\n", ranked[i].second, counted > 0U ? 100.0 * ranked[i].second / counted : 0.0, ranked[i].first.c_str());
+    }
+    return 0;
+}
+
+int Load_Bias_Callback(dl_phdr_info * info, size_t, void * data) {
+    // First object is the executable itself, its bias is 0 unless it is position independent
+    *static_cast<uintptr_t *>(data) = static_cast<uintptr_t>(info->dlpi_addr);
+    return 1;
+}
+
+int Profile_Self() {
+    Sampling_Profiler<> profiler;
+    if (!profiler.Start(SAMPLE_RATE_HZ)) {
+        std::fprintf(stderr, "Starting the profiler failed\n");
+        return 1;
+    }
+    Batch_Disturbance disturbance = { "mismatch", Thermal_Parameters(), 0.0f, 0.0f, Sensor_Noise_Profile(), Pulse_Disturbance_Profile() };
+    disturbance.plant.vessel_capacity_j_per_k *= 1.15f;
+    float iae = 0.0f;
+    for (size_t batch = 0U; batch < SIMULATED_BATCHES; batch++) {
+        MPC_Settings settings;
+        settings.tick_seconds = TICK_SECONDS;
+        Temperature_MPC<MPC_HORIZON, MPC_ITERATIONS> mpc(Thermal_Model(), settings);
+        iae += Simulate_Batch([&mpc](float const & measured, float const & setpoint) {
+            return mpc.Update(measured, setpoint);
+        }, PROFILE, disturbance, TICK_SECONDS, false, batch).iae;
+    }
+    profiler.Stop();
+    std::printf("Simulated %zu batches, mean IAE %.1f K*s\n", SIMULATED_BATCHES, iae / SIMULATED_BATCHES);
+
+    // Addresses of a position independent executable have to be made relative to its load address before addr2line can resolve them
+    uintptr_t bias = 0U;
+    dl_iterate_phdr(&Load_Bias_Callback, &bias);
+    auto & histogram = profiler.Get_Histogram();
+    size_t const used = histogram.Sort();
+    std::vector<Sample> samples;
+    for (size_t i = 0U; i < used; i++) {
+        samples.emplace_back(histogram.Get_Entry(i).pc - bias, histogram.Get_Entry(i).count);
+    }
+    // addr2line would see itself behind /proc/self/exe, it needs the real path
+    char executable[4096] = {};
+    ssize_t const length = readlink("/proc/self/exe", executable, sizeof(executable) - 1U);
+    if (length <= 0) {
+        std::fprintf(stderr, "Finding the executable failed\n");
+        return 1;
+    }
+    return Print_Report("addr2line", executable, samples, histogram.Get_Samples(), histogram.Get_Dropped());
+}
+
+int Resolve_Dump(std::string const & elf, std::string const & addr2line) {
+    // Pages may overlap if a request was repeated, the entries are therefore merged by address instead of summed
+    std::map<uintptr_t, uint32_t> merged;
+    char line[4096] = {};
+    while (std::fgets(line, sizeof(line), stdin) != nullptr) {
+        char const * page = std::strstr(line, PROFILE_KEY);
+        if (page == nullptr) {
+            continue;
+        }
+        page += sizeof(PROFILE_KEY) - 1U;
+        while (*page != '"' && *page != '\0') {
+            char * end = nullptr;
+            uintptr_t const pc = static_cast<uintptr_t>(std::strtoull(page, &end, 16));
+            if (end == page || *end != ':') {
+                break;
+            }
+            page = end + 1U;
+            uint32_t const count = static_cast<uint32_t>(std::strtoul(page, &end, 10));
+            merged[pc] = count;
+            page = *end == ',' ? end + 1U : end;
+        }
+    }
+    std::vector<Sample> const samples(merged.begin(), merged.end());
+    uint32_t total = 0U;
+    for (Sample const & sample : samples) {
+        total += sample.second;
+    }
+    return Print_Report(addr2line, elf, samples, total, 0U);
+}
+
+} // namespace
+
+
+int main(int argc, char * argv[]) {
+    if (argc >= 3 && std::strcmp(argv[1], "resolve") == 0) {
+        return Resolve_Dump(argv[2], argc >= 4 ? argv[3] : "addr2line");
+    }
+    else if (argc != 1) {
+        std::fprintf(stderr, "Usage: %s [resolve <firmware.elf> [addr2line]]\n", argv[0]);
+        return 1;
+    }
+    return Profile_Self();
+}
@@ -0,0 +1,181 @@
+// Host benchmark of the batched telemetry upload of send_telemetry_working.ino against sending every sample as its own message,
+// and of serializing with Json_Writer against filling a JsonDocument and calling serializeJson, as the library does for its own messages and the rpc responses.
+// A flush uploads the SAMPLES_PER_FLUSH buffered samples, batched with Send_Json_Batches (see Json_Writer.h) into as few messages as FLUSH_PAYLOAD_SIZE allows,
+// or one message per sample. The JsonDocument cases send the same samples with the same split, the batches are filled until measureJson exceeds the payload buffer.
+// Every message costs the MQTT publish header with the telemetry topic and the TCP/IP headers of the segment and of its acknowledgement,
+// which is most of the data of a single small sample. Reports the messages, payload and transmitted bytes per flush, and the host CPU time to serialize one flush.
+// Needs ArduinoJson 6, the version the library is built with, build and run from the repository root:
+//     g++ -std=c++11 -O2 -I. -Itools -I<ArduinoJson>/src tools/telemetry_batch_benchmark.cpp -o telemetry_batch_benchmark && ./telemetry_batch_benchmark [samples per flush]
+
+// Local includes.
+#include "Json_Writer.h"
+
+// Library includes.
+#include <ArduinoJson.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+namespace {
+
+size_t constexpr FLUSH_PAYLOAD_SIZE = 256U;
+size_t constexpr REPETITIONS = 20000U;
+// Topic of the ThingsBoard telemetry upload
+char constexpr TELEMETRY_TOPIC[] = "v1/devices/me/telemetry";
+// IPv4 and TCP header without options, sent for the segment and for its acknowledgement
+size_t constexpr TCP_IP_HEADER_SIZE = 40U;
+
+// Same as the buffered reading of send_telemetry_working.ino
+struct Sample {
+    uint64_t ts;
+    uint16_t count;
+    float    randomVal;
+};
+
+// Same serialization as writeSample() of send_telemetry_working.ino
+void Write_Sample(Json_Writer & writer, Sample const & sample) {
+    writer.Begin_Object();
+    if (sample.ts != 0U) {
+        writer.Add("ts", sample.ts);
+        writer.Key("values");
+        writer.Begin_Object();
+    }
+    writer.Add("count", sample.count);
+    writer.Add("randomVal", sample.randomVal);
+    if (sample.ts != 0U) {
+        writer.End_Object();
+    }
+    writer.End_Object();
+}
+
+void Add_Values(JsonObject values, Sample const & sample) {
+    values["count"] = sample.count;
+    values["randomVal"] = sample.randomVal;
+}
+
+// Same content as Write_Sample(), added to a JsonDocument like the library serializes its messages
+void Add_Sample(JsonObject object, Sample const & sample) {
+    if (sample.ts == 0U) {
+        Add_Values(object, sample);
+        return;
+    }
+    object["ts"] = sample.ts;
+    Add_Values(object.createNestedObject("values"), sample);
+}
+
+// Bytes of one QoS 0 publish of the given payload, including the headers of the segment and of its acknowledgement
+size_t Wire_Size(size_t const & payload_size) {
+    size_t const remaining = 2U + std::strlen(TELEMETRY_TOPIC) + payload_size;
+    size_t const fixed_header = 1U + (remaining < 128U ? 1U : 2U);
+    return fixed_header + remaining + 2U * TCP_IP_HEADER_SIZE;
+}
+
+struct Result {
+    size_t messages = 0U;
+    size_t payload_bytes = 0U;
+    size_t wire_bytes = 0U;
+    double serialize_us = 0.0; // Host CPU time to serialize one flush
+};
+
+enum class Serializer : uint8_t {
+    WRITER,
+    DOCUMENT
+};
+
+// Memory of a document holding the whole flush, ts and values need an object each
+size_t Document_Capacity(size_t const & samples) {
+    return JSON_ARRAY_SIZE(samples) + samples * 2U * JSON_OBJECT_SIZE(2U);
+}
+
+Result Run(std::vector<Sample> const & samples, bool const & batched, Serializer const & serializer) {
+    char payload[FLUSH_PAYLOAD_SIZE];
+    char scratch[FLUSH_PAYLOAD_SIZE];
+    DynamicJsonDocument document(Document_Capacity(samples.size()));
+    Result result;
+    auto const send = [&result](char const *, size_t const & length) {
+        result.messages++;
+        result.payload_bytes += length;
+        result.wire_bytes += Wire_Size(length);
+        return true;
+    };
+    auto const start = std::chrono::steady_clock::now();
+    for (size_t repetition = 0U; repetition < REPETITIONS; repetition++) {
+        result = Result();
+        if (serializer == Serializer::DOCUMENT && batched) {
+            // Adds samples until the serialized array does not fit anymore, then sends it without the last one, which starts the next batch
+            size_t next = 0U;
+            while (next < samples.size()) {
+                document.clear();
+                JsonArray array = document.to<JsonArray>();
+                for (; next < samples.size(); next++) {
+                    Add_Sample(array.createNestedObject(), samples[next]);
+                    if (measureJson(document) >= sizeof(payload) && array.size() > 1U) {
+                        array.remove(array.size() - 1U);
+                        break;
+                    }
+                }
+                send(payload, serializeJson(document, payload, sizeof(payload)));
+            }
+            continue;
+        }
+        if (serializer == Serializer::DOCUMENT) {
+            for (Sample const & sample : samples) {
+                document.clear();
+                Add_Sample(document.to<JsonObject>(), sample);
+                send(payload, serializeJson(document, payload, sizeof(payload)));
+            }
+            continue;
+        }
+        if (batched) {
+            (void)Send_Json_Batches(samples.data(), samples.size(), payload, scratch, sizeof(payload), &Write_Sample, send);
+            continue;
+        }
+        Json_Writer writer(payload, sizeof(payload));
+        for (Sample const & sample : samples) {
+            writer.Clear();
+            Write_Sample(writer, sample);
+            send(writer.Get_String(), writer.Length());
+        }
+    }
+    double const elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    result.serialize_us = elapsed_us / REPETITIONS;
+    return result;
+}
+
+void Print(char const * name, Result const & result, size_t const & samples) {
+    std::printf("%-14s %9zu %14zu %11zu %16.1f %18.2f\n", name, result.messages, result.payload_bytes, result.wire_bytes,
+        static_cast<double>(result.wire_bytes) / samples, result.serialize_us);
+}
+
+} // namespace
+
+
+int main(int argc, char * argv[]) {
+    size_t const count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 30U;
+    std::vector<Sample> samples;
+    for (size_t i = 0U; i < count; i++) {
+        // Timestamped samples one second apart, like a flush after the clock was synchronized once
+        samples.push_back(Sample{ 1760000000000ULL + i * 1000U, static_cast<uint16_t>(i + 1U), static_cast<float>((i * 7919U) % 1000U) / 1000.0f });
+    }
+    Result const single = Run(samples, false, Serializer::WRITER);
+    Result const batch = Run(samples, true, Serializer::WRITER);
+    Result const document_single = Run(samples, false, Serializer::DOCUMENT);
+    Result const document_batch = Run(samples, true, Serializer::DOCUMENT);
+    std::printf("%zu samples per flush, payload buffer %zu bytes\n", count, FLUSH_PAYLOAD_SIZE);
+    std::printf("%-14s %9s %14s %11s %16s %18s\n", "sends", "messages", "payload bytes", "wire bytes", "wire per sample", "serialize us/flush");
+    Print("document", document_single, count);
+    Print("document batch", document_batch, count);
+    Print("single", single, count);
+    Print("batch", batch, count);
+    std::printf("batching saves %.1f %% of the transmitted bytes and %zu of %zu messages\n",
+        100.0 * (1.0 - static_cast<double>(batch.wire_bytes) / single.wire_bytes), single.messages - batch.messages, single.messages);
+    // Json_Writer always writes 3 decimals, serializeJson the shortest representation, so the payloads differ slightly in size
+    std::printf("batched Json_Writer against the batched JsonDocument: %+.1f %% payload bytes, %.2fx serialize time\n",
+        100.0 * (static_cast<double>(batch.payload_bytes) / document_batch.payload_bytes - 1.0), batch.serialize_us / document_batch.serialize_us);
+    std::printf("batched Json_Writer against a JsonDocument per sample: %+.1f %% transmitted bytes, %.2fx serialize time\n",
+        100.0 * (static_cast<double>(batch.wire_bytes) / document_single.wire_bytes - 1.0), batch.serialize_us / document_single.serialize_us);
+    return 0;
+}
@@ -0,0 +1,313 @@
+// Host decoder of the compressed telemetry backfill (see Telemetry_Backfill.h), stands in for the ingestion side that has to unpack the batches before they are stored.
+// Reads one telemetry message per line from stdin, messages of the form {"backfill":"<base64>","now":<device millis>} are decompressed and converted into
+// the ThingsBoard timestamped telemetry array [{"ts":<epoch ms>,"values":{...}},...], the device time of every record is shifted by the time the message was received at.
+// Telemetry keys interned by the device (see Key_Dictionary.h) are replaced with their names, the dictionary is taken from the last "telemetryKeys" attribute message in the input.
+// Any other message is passed through unchanged.
+// With --bench an hour of synthetic 1 Hz reactor telemetry is compressed with encoder settings that fit an ESP-class device,
+// reporting the compression ratio and the compression and decompression time per block measured on this host.
+// Build and run from the repository root:
+//     g++ -std=c++11 -O2 -I. -Itools tools/telemetry_decode.cpp -o telemetry_decode && ./telemetry_decode [received epoch ms] < messages.txt
+//     ./telemetry_decode --bench
+
+// Local includes.
+#include "Base64.h"
+#include "Json_Writer.h"
+#include "Key_Dictionary.h"
+#include "Lzss.h"
+#include "Philox.h"
+#include "Telemetry_Backfill.h"
+
+// Library includes.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+// Telemetry interval and length of the outage of the benchmark
+uint32_t constexpr SAMPLE_INTERVAL_MS = 1000U;
+uint32_t constexpr OUTAGE_SAMPLES = 3600U;
+// Every measurement is repeated until it took at least this long, to get a stable timing
+double constexpr MINIMUM_MEASUREMENT_SECONDS = 0.2;
+
+/// @brief Finds the string value of the given key in a flat JSON message, enough for the messages the device sends
+bool Find_String(std::string const & message, char const * key, std::string & value) {
+    std::string const pattern = std::string("\"") + key + "\":\"";
+    size_t const start = message.find(pattern);
+    if (start == std::string::npos) {
+        return false;
+    }
+    size_t const begin = start + pattern.size();
+    size_t const end = message.find('"', begin);
+    if (end == std::string::npos) {
+        return false;
+    }
+    value = message.substr(begin, end - begin);
+    return true;
+}
+
+/// @brief Finds the unsigned number value of the given key in a flat JSON message
+bool Find_Number(std::string const & message, char const * key, uint64_t & value) {
+    std::string const pattern = std::string("\"") + key + "\":";
+    size_t const start = message.find(pattern);
+    if (start == std::string::npos) {
+        return false;
+    }
+    char * end = nullptr;
+    value = strtoull(message.c_str() + start + pattern.size(), &end, 10);
+    return end != message.c_str() + start + pattern.size();
+}
+
+/// @brief Reads the key dictionary from a "telemetryKeys" attribute message, the names contain no escaped characters
+bool Find_Dictionary(std::string const & message, std::vector<std::string> & dictionary) {
+    std::string const pattern = "\"telemetryKeys\":[";
+    size_t position = message.find(pattern);
+    if (position == std::string::npos) {
+        return false;
+    }
+    dictionary.clear();
+    position += pattern.size();
+    while (position < message.size() && message[position] != ']') {
+        size_t const begin = message.find('"', position);
+        size_t const end = begin == std::string::npos ? std::string::npos : message.find('"', begin + 1U);
+        if (end == std::string::npos) {
+            return false;
+        }
+        dictionary.push_back(message.substr(begin + 1U, end - begin - 1U));
+        position = end + 1U;
+        while (position < message.size() && (message[position] == ',' || message[position] == ' ')) {
+            position++;
+        }
+    }
+    return true;
+}
+
+/// @brief Replaces every object key that is an id of the dictionary with its name, string values and unknown keys are copied unchanged
+std::string Expand_Keys(std::string const & json, std::vector<std::string> const & dictionary) {
+    std::string output;
+    output.reserve(json.size() * 2U);
+    size_t position = 0U;
+    while (position < json.size()) {
+        if (json[position] != '"') {
+            output += json[position++];
+            continue;
+        }
+        size_t end = position + 1U;
+        while (end < json.size() && json[end] != '"') {
+            end += json[end] == '\\' ? 2U : 1U;
+        }
+        std::string const text = json.substr(position + 1U, end - position - 1U);
+        position = end + 1U;
+        size_t next = position;
+        while (next < json.size() && json[next] == ' ') {
+            next++;
+        }
+        bool const is_key = next < json.size() && json[next] == ':';
+        bool const is_id = !text.empty() && text.size() <= 3U && text.find_first_not_of("0123456789") == std::string::npos;
+        size_t const id = is_id ? static_cast<size_t>(strtoul(text.c_str(), nullptr, 10)) : 0U;
+        output += '"';
+        output += (is_key && is_id && id < dictionary.size()) ? dictionary[id] : text;
+        output += '"';
+    }
+    return output;
+}
+
+/// @brief Decompresses one backfill block into its newline separated records
+bool Decompress_Block(std::string const & encoded, std::string & records) {
+    std::vector<uint8_t> compressed(encoded.size() / 4U * 3U + 3U);
+    size_t const size = Base64::Decode(encoded.c_str(), encoded.size(), compressed.data(), compressed.size());
+    size_t const expected = Lzss::Get_Decompressed_Size(compressed.data(), size);
+    if (size == 0U || expected == 0U) {
+        return false;
+    }
+    records.resize(expected);
+    return Lzss::Decompress(compressed.data(), size, reinterpret_cast<uint8_t *>(&records[0U]), expected) == expected;
+}
+
+/// @brief Converts the records of a block into the timestamped telemetry array, the record time is relative to the device time at the upload
+bool Convert_Records(std::string const & records, uint32_t const & now, uint64_t const & received_ms, std::string & output) {
+    output = "[";
+    size_t begin = 0U;
+    while (begin < records.size()) {
+        size_t const end = records.find('\n', begin);
+        std::string const record = records.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+        begin = end == std::string::npos ? records.size() : end + 1U;
+        uint64_t time = 0U;
+        size_t const values = record.find(",\"values\":");
+        if (!Find_Number(record, "t", time) || values == std::string::npos) {
+            return false;
+        }
+        // Device time is 32 bit milliseconds, the difference is correct across a wrap around
+        uint32_t const age = now - static_cast<uint32_t>(time);
+        if (output.size() > 1U) {
+            output += ',';
+        }
+        output += "{\"ts\":" + std::to_string(received_ms - age) + record.substr(values);
+    }
+    output += ']';
+    return true;
+}
+
+int Decode(uint64_t const & received_override) {
+    std::string line;
+    char chunk[4096];
+    size_t failures = 0U;
+    std::vector<std::string> dictionary;
+    while (fgets(chunk, sizeof(chunk), stdin) != nullptr) {
+        line += chunk;
+        if (line.empty() || line.back() != '\n') {
+            if (!feof(stdin)) {
+                continue;
+            }
+        }
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+            line.pop_back();
+        }
+        std::string encoded;
+        uint64_t now = 0U;
+        if (Find_Dictionary(line, dictionary)) {
+            fprintf(stderr, "Key dictionary with %zu keys\n", dictionary.size());
+        }
+        if (!Find_String(line, "backfill", encoded) || !Find_Number(line, "now", now)) {
+            if (!line.empty()) {
+                printf("%s\n", Expand_Keys(line, dictionary).c_str());
+            }
+            line.clear();
+            continue;
+        }
+        uint64_t const received_ms = received_override != 0U ? received_override
+          : static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+        std::string records;
+        std::string output;
+        if (!Decompress_Block(encoded, records) || !Convert_Records(records, static_cast<uint32_t>(now), received_ms, output)) {
+            fprintf(stderr, "Invalid backfill block: %s\n", line.c_str());
+            failures++;
+        }
+        else {
+            printf("%s\n", Expand_Keys(output, dictionary).c_str());
+        }
+        line.clear();
+    }
+    return failures == 0U ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Keys of the synthetic samples, in the order of the dictionary of the sketch
+char constexpr const * BENCH_KEYS[] = { "thermistorRaw", "phRaw", "temperature", "ph", "controller", "heaterOutput" };
+
+/// @brief Serialized values of one synthetic sample, the keys of the periodic telemetry of the sketch with slowly drifting, noisy values
+size_t Synthetic_Values(Random_Stream const & random, Key_Dictionary<6U> const & keys, uint32_t const & index, char * buffer, size_t const & capacity) {
+    float const temperature = 37.0f + 0.05f * random.Normal(index) + 0.3f * sinf(index * 0.001f);
+    float const ph = 7.0f - 0.0002f * index + 0.01f * random.Normal(index + OUTAGE_SAMPLES);
+    Json_Writer writer(buffer, capacity);
+    writer.Begin_Object();
+    writer.Add(keys.Key("thermistorRaw"), static_cast<uint32_t>(2100.0f - 30.0f * (temperature - 37.0f)));
+    writer.Add(keys.Key("phRaw"), static_cast<uint32_t>(1500.0f + 120.0f * (ph - 7.0f)));
+    writer.Add(keys.Key("temperature"), temperature);
+    writer.Add(keys.Key("ph"), ph);
+    writer.Add(keys.Key("heaterOutput"), 0.4f + 0.02f * random.Normal(index + 2U * OUTAGE_SAMPLES));
+    writer.End_Object();
+    return writer.Length();
+}
+
+template<typename Encoder>
+void Bench(char const * name, std::vector<std::string> const & samples) {
+    // Arena large enough for the whole outage, to measure the ratio without discarding blocks
+    using Backfill = Telemetry_Backfill<262144U, 2048U, 512U, Encoder>;
+    std::unique_ptr<Backfill> const backfill(new Backfill());
+    for (uint32_t i = 0U; i < samples.size(); i++) {
+        backfill->Record(i * SAMPLE_INTERVAL_MS, samples[i].c_str(), samples[i].size());
+    }
+    backfill->Seal();
+    Backfill_Statistics const statistics = backfill->Get_Statistics();
+
+    // Time compressing and decompressing the sealed blocks again, the blocks are popped to iterate them
+    std::vector<std::vector<uint8_t>> blocks;
+    uint8_t const * data = nullptr;
+    size_t size = 0U;
+    while ((size = backfill->Front(data)) > 0U) {
+        blocks.emplace_back(data, data + size);
+        backfill->Pop();
+    }
+    std::vector<std::vector<uint8_t>> raw(blocks.size());
+    for (size_t i = 0U; i < blocks.size(); i++) {
+        raw[i].resize(Lzss::Get_Decompressed_Size(blocks[i].data(), blocks[i].size()));
+        if (Lzss::Decompress(blocks[i].data(), blocks[i].size(), raw[i].data(), raw[i].size()) != raw[i].size()) {
+            fprintf(stderr, "%s: round trip failed\n", name);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    static Encoder encoder;
+    uint8_t output[512U];
+    using Clock = std::chrono::steady_clock;
+    size_t repetitions = 0U;
+    Clock::time_point const compress_start = Clock::now();
+    double compress_seconds = 0.0;
+    do {
+        for (std::vector<uint8_t> const & block : raw) {
+            encoder.Compress(block.data(), block.size(), output, sizeof(output));
+        }
+        repetitions++;
+        compress_seconds = std::chrono::duration<double>(Clock::now() - compress_start).count();
+    } while (compress_seconds < MINIMUM_MEASUREMENT_SECONDS);
+    double const compress_us = compress_seconds * 1e6 / static_cast<double>(repetitions * raw.size());
+
+    std::vector<uint8_t> scratch(4096U);
+    repetitions = 0U;
+    Clock::time_point const decompress_start = Clock::now();
+    double decompress_seconds = 0.0;
+    do {
+        for (std::vector<uint8_t> const & block : blocks) {
+            Lzss::Decompress(block.data(), block.size(), scratch.data(), scratch.size());
+        }
+        repetitions++;
+        decompress_seconds = std::chrono::duration<double>(Clock::now() - decompress_start).count();
+    } while (decompress_seconds < MINIMUM_MEASUREMENT_SECONDS);
+    double const decompress_us = decompress_seconds * 1e6 / static_cast<double>(repetitions * blocks.size());
+
+    printf("%-22s %8zu %8u %8u %7.2f %10zu %12.1f %14.1f\n", name, sizeof(Encoder), statistics.raw_bytes, statistics.compressed_bytes,
+      static_cast<double>(statistics.raw_bytes) / statistics.compressed_bytes, blocks.size(), compress_us, decompress_us);
+}
+
+int Bench() {
+    Random_Stream const random(1U, 0U, 0U);
+    Key_Dictionary<6U> const names(BENCH_KEYS, false);
+    Key_Dictionary<6U> const ids(BENCH_KEYS, true);
+    std::vector<std::string> samples;
+    std::vector<std::string> interned;
+    char buffer[256];
+    for (uint32_t i = 0U; i < OUTAGE_SAMPLES; i++) {
+        size_t length = Synthetic_Values(random, names, i, buffer, sizeof(buffer));
+        samples.emplace_back(buffer, length);
+        length = Synthetic_Values(random, ids, i, buffer, sizeof(buffer));
+        interned.emplace_back(buffer, length);
+    }
+    printf("%u records of %zu bytes (%zu bytes with interned keys), blocks of up to 2048 bytes compressed into at most 512 bytes\n",
+      OUTAGE_SAMPLES, samples[0U].size(), interned[0U].size());
+    printf("%-22s %8s %8s %8s %7s %10s %12s %14s\n", "encoder", "ram", "raw", "packed", "ratio", "blocks", "compress us", "decompress us");
+    Bench<Lzss_Encoder<8U, 4U, 8U, 4U>>("window 256, chain 4", samples);
+    Bench<Lzss_Encoder<8U, 5U, 8U, 16U>>("window 256, length 5", samples);
+    Bench<Lzss_Encoder<10U, 4U, 9U, 4U>>("window 1k, chain 4", samples);
+    Bench<Lzss_Encoder<10U, 4U, 9U, 16U>>("window 1k, chain 16", samples);
+    Bench<Lzss_Encoder<10U, 5U, 9U, 16U>>("window 1k, length 5", samples);
+    Bench<Lzss_Encoder<11U, 4U, 10U, 16U>>("window 2k, chain 16", samples);
+    Bench<Lzss_Encoder<10U, 6U, 9U, 16U>>("window 1k, length 6", samples);
+    Bench<Lzss_Encoder<>>("default, interned keys", interned);
+    return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+int main(int argc, char * argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return Bench();
+    }
+    uint64_t const received_ms = argc > 1 ? strtoull(argv[1], nullptr, 10) : 0U;
+    return Decode(received_ms);
+}
@@ -0,0 +1,126 @@
+// Host test of the timer wheel (see Timer_Wheel.h) against callbacks that change other timers while the wheel expires them.
+// In the sketch an expiring timer often stops timers due in the same tick, e.g. checkLink() disconnects, which releases every outstanding request
+// and stops its timeout timer, or it restarts them. Every case arms the timers, advances the wheel past their deadline and checks which callbacks ran
+// and that the amount of armed timers stays consistent, which Advance() and Milliseconds_Until_Next() rely on.
+// Build and run from the repository root:
+//     g++ -std=c++11 -O2 -I. -Itools tools/timer_wheel_test.cpp -o timer_wheel_test && ./timer_wheel_test
+
+// Local includes.
+#include "Timer_Wheel.h"
+
+// Library includes.
+#include <cstdio>
+
+
+namespace {
+
+struct Test_Timer {
+    Timer_Wheel *      wheel = nullptr;
+    Timer_Wheel::Timer timer;
+    Test_Timer *       stops = nullptr;    // Timer the callback stops
+    Test_Timer *       restarts = nullptr; // Timer the callback restarts
+    uint32_t           calls = 0U;
+};
+
+void Expired(void * context) {
+    Test_Timer & test = *static_cast<Test_Timer *>(context);
+    test.calls++;
+    if (test.stops != nullptr) {
+        test.wheel->Stop(test.stops->timer);
+    }
+    if (test.restarts != nullptr) {
+        test.wheel->Start(test.restarts->timer, 100U);
+    }
+}
+
+void Bind(Timer_Wheel & wheel, Test_Timer & test) {
+    test.wheel = &wheel;
+    test.timer = Timer_Wheel::Timer(&Expired, &test);
+}
+
+bool Check(char const * name, bool const & condition) {
+    std::printf("%-58s %s\n", name, condition ? "PASS" : "FAIL");
+    return condition;
+}
+
+// Timers started in the same tick are linked into the same slot, the one started last is expired first
+bool Stop_Sibling() {
+    Timer_Wheel wheel;
+    Test_Timer timers[3U];
+    for (Test_Timer & timer : timers) {
+        Bind(wheel, timer);
+    }
+    timers[2U].stops = &timers[1U];
+    wheel.Advance(0U);
+    for (Test_Timer & timer : timers) {
+        wheel.Start(timer.timer, 50U);
+    }
+    wheel.Advance(60U);
+    return Check("callback stops a sibling due in the same tick", timers[2U].calls == 1U && timers[1U].calls == 0U && timers[0U].calls == 1U
+        && wheel.Get_Armed() == 0U && wheel.Milliseconds_Until_Next(60U) == UINT32_MAX);
+}
+
+bool Restart_Sibling() {
+    Timer_Wheel wheel;
+    Test_Timer timers[3U];
+    for (Test_Timer & timer : timers) {
+        Bind(wheel, timer);
+    }
+    timers[2U].restarts = &timers[1U];
+    wheel.Advance(0U);
+    for (Test_Timer & timer : timers) {
+        wheel.Start(timer.timer, 50U);
+    }
+    wheel.Advance(60U);
+    bool const deferred = timers[1U].calls == 0U && wheel.Get_Armed() == 1U && timers[1U].timer.Is_Armed();
+    wheel.Advance(170U);
+    return Check("callback restarts a sibling due in the same tick", deferred && timers[1U].calls == 1U && timers[0U].calls == 1U
+        && wheel.Get_Armed() == 0U);
+}
+
+bool Stop_Chain() {
+    Timer_Wheel wheel;
+    Test_Timer timers[8U];
+    for (Test_Timer & timer : timers) {
+        Bind(wheel, timer);
+    }
+    // Every expired timer stops the one expired after it, only every second timer may run
+    for (size_t i = 0U; i + 1U < 8U; i++) {
+        timers[i + 1U].stops = &timers[i];
+    }
+    wheel.Advance(0U);
+    for (Test_Timer & timer : timers) {
+        wheel.Start(timer.timer, 50U);
+    }
+    wheel.Advance(60U);
+    uint32_t calls = 0U;
+    for (Test_Timer const & timer : timers) {
+        calls += timer.calls;
+    }
+    return Check("chain of callbacks stopping the next timer of the tick", calls == 4U && wheel.Get_Armed() == 0U);
+}
+
+bool Stop_Self_Restart() {
+    Timer_Wheel wheel;
+    Test_Timer timer;
+    Bind(wheel, timer);
+    timer.restarts = &timer;
+    wheel.Advance(0U);
+    wheel.Start(timer.timer, 50U);
+    wheel.Advance(60U);
+    wheel.Advance(170U);
+    wheel.Stop(timer.timer);
+    return Check("periodic timer restarting itself, then stopped", timer.calls == 2U && wheel.Get_Armed() == 0U);
+}
+
+} // namespace
+
+
+int main() {
+    bool passed = true;
+    passed &= Stop_Sibling();
+    passed &= Restart_Sibling();
+    passed &= Stop_Chain();
+    passed &= Stop_Self_Restart();
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+// Host decoder of the binary trace log (see Trace_Log.h and Trace_Events.h), renders the records captured from the serial port of the device as a timeline.
+// Reads the raw serial stream from stdin, text printed by the firmware outside the hot path is passed through, records with a wrong checksum are skipped,
+// gaps in the sequence numbers are reported as dropped events. The summary lists every event with the interval between its occurrences,
+// which shows the jitter of periodic events like the control tick.
+// With --demo a synthetic trace is written through the same Trace_Log and decoded, and the cost of tracing an event is compared with formatting the equivalent text line.
+// Build and run from the repository root:
+//     g++ -std=c++11 -O2 -I. -Itools tools/trace_decode.cpp -o trace_decode && ./trace_decode < capture.bin
+//     ./trace_decode --demo
+
+// Local includes.
+#include "Trace_Events.h"
+#include "Trace_Log.h"
+
+// Library includes.
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+
+
+namespace {
+
+using Log = Trace_Log<128U>;
+
+// Baud rate of the debugging serial connection of the device, 10 bits are sent per byte
+uint32_t constexpr SERIAL_BAUD = 9600U;
+size_t constexpr BENCH_EVENTS = 1000000U;
+
+// Interval statistics of one event
+struct Event_Summary {
+    size_t   count = 0U;
+    uint64_t last_us = 0U;
+    uint64_t min_interval_us = UINT64_MAX;
+    uint64_t max_interval_us = 0U;
+    uint64_t total_interval_us = 0U;
+};
+
+class Timeline {
+  public:
+    void Text(std::string const & line) {
+        if (!line.empty()) {
+            std::printf("%29s| %s\n", "", line.c_str());
+        }
+    }
+
+    void Record(Trace_Record const & record) {
+        if (m_records > 0U) {
+            uint16_t const lost = static_cast<uint16_t>(record.sequence - m_sequence - 1U);
+            if (lost > 0U) {
+                std::printf("%29s-- %u events dropped --\n", "", static_cast<unsigned int>(lost));
+                m_dropped += lost;
+            }
+            // The device clock wraps around after ~71 minutes
+            if (record.time_us < m_last_time) {
+                m_epoch += UINT64_C(1) << 32U;
+            }
+        }
+        m_records++;
+        m_sequence = record.sequence;
+        m_last_time = record.time_us;
+        uint64_t const time_us = m_epoch + record.time_us;
+        if (m_records == 1U) {
+            m_start_us = time_us;
+        }
+
+        Trace_Event_Info const info = Get_Trace_Event_Info(record.event);
+        std::printf("%12.6f s %+11.3f ms  ", (time_us - m_start_us) / 1e6, m_records > 1U ? (time_us - m_previous_us) / 1e3 : 0.0);
+        if (info.name == nullptr) {
+            std::printf("event %u", static_cast<unsigned int>(record.event));
+        }
+        else {
+            std::printf("%s", info.name);
+        }
+        char const * const names[2U] = { info.first, info.second };
+        for (size_t i = 0U; i < 2U; i++) {
+            if (names[i] != nullptr) {
+                std::printf(" %s=%" PRId32, names[i], record.arguments[i]);
+            }
+            else if (info.name == nullptr) {
+                std::printf(" %" PRId32, record.arguments[i]);
+            }
+        }
+        std::printf("\n");
+        m_previous_us = time_us;
+
+        Event_Summary & summary = m_summaries[record.event];
+        if (summary.count > 0U) {
+            uint64_t const interval = time_us - summary.last_us;
+            summary.min_interval_us = interval < summary.min_interval_us ? interval : summary.min_interval_us;
+            summary.max_interval_us = interval > summary.max_interval_us ? interval : summary.max_interval_us;
+            summary.total_interval_us += interval;
+        }
+        summary.count++;
+        summary.last_us = time_us;
+    }
+
+    void Print_Summary(size_t const & corrupted) const {
+        std::printf("\n%zu records, %zu dropped, %zu corrupted\n", m_records, m_dropped, corrupted);
+        std::printf("%-28s %8s %12s %12s %12s\n", "event", "count", "min ms", "mean ms", "max ms");
+        for (auto const & entry : m_summaries) {
+            Event_Summary const & summary = entry.second;
+            Trace_Event_Info const info = Get_Trace_Event_Info(entry.first);
+            std::string const name = info.name != nullptr ? info.name : "event " + std::to_string(entry.first);
+            if (summary.count < 2U) {
+                std::printf("%-28s %8zu\n", name.c_str(), summary.count);
+                continue;
+            }
+            std::printf("%-28s %8zu %12.3f %12.3f %12.3f\n", name.c_str(), summary.count, summary.min_interval_us / 1e3,
+                summary.total_interval_us / 1e3 / (summary.count - 1U), summary.max_interval_us / 1e3);
+        }
+    }
+
+  private:
+    size_t                            m_records = 0U;
+    size_t                            m_dropped = 0U;
+    uint16_t                          m_sequence = 0U;
+    uint32_t                          m_last_time = 0U;
+    uint64_t                          m_epoch = 0U;
+    uint64_t                          m_start_us = 0U;
+    uint64_t                          m_previous_us = 0U;
+    std::map<uint16_t, Event_Summary> m_summaries;
+};
+
+// Splits the stream into records and the text between them
+void Decode(std::string const & stream) {
+    Timeline timeline;
+    std::string line;
+    size_t corrupted = 0U;
+    size_t position = 0U;
+    while (position < stream.size()) {
+        uint8_t const byte = static_cast<uint8_t>(stream[position]);
+        if (byte == Log::SYNC_FIRST && position + Log::FRAME_SIZE <= stream.size() && static_cast<uint8_t>(stream[position + 1U]) == Log::SYNC_SECOND) {
+            Trace_Record record;
+            if (Log::Deserialize(reinterpret_cast<uint8_t const *>(stream.data()) + position + 2U, record)) {
+                timeline.Record(record);
+                position += Log::FRAME_SIZE;
+                continue;
+            }
+            corrupted++;
+        }
+        if (byte == '\n') {
+            timeline.Text(line);
+            line.clear();
+        }
+        else if (byte != '\r') {
+            line += static_cast<char>(byte);
+        }
+        position++;
+    }
+    timeline.Text(line);
+    timeline.Print_Summary(corrupted);
+}
+
+// Collects the frames like the serial port of the device would send them
+struct String_Output {
+    std::string data;
+
+    size_t write(uint8_t const * buffer, size_t const & size) {
+        data.append(reinterpret_cast<char const *>(buffer), size);
+        return size;
+    }
+};
+
+void Trace(Log & log, String_Output & output, uint32_t const & time_us, Trace_Event const & event, int32_t const & first = 0, int32_t const & second = 0) {
+    log.Trace(time_us, static_cast<uint16_t>(event), first, second);
+    log.Drain(output, 1U);
+}
+
+int Demo() {
+    // A connect with one failed attempt, then a few seconds of control ticks with jitter, a setLedMode rpc and blinking
+    Log log;
+    String_Output output;
+    output.data += "Connecting to AP ...\r\nConnected to AP\r\n";
+    Trace(log, output, 1200000U, Trace_Event::CONNECT_ATTEMPT, 500);
+    Trace(log, output, 1450000U, Trace_Event::CONNECT_FAILED, 250000);
+    Trace(log, output, 1950000U, Trace_Event::CONNECT_ATTEMPT, 1000);
+    Trace(log, output, 2130000U, Trace_Event::CONNECTED, 180000);
+    uint32_t time_us = 2200000U;
+    for (int32_t tick = 0; tick < 8; tick++) {
+        time_us += 1000000U + static_cast<uint32_t>((tick * 7919) % 3000);
+        Trace(log, output, time_us, Trace_Event::CONTROL_TICK, 400 + tick * 20, 950 + tick);
+        if (tick == 2) {
+            Trace(log, output, time_us + 3000U, Trace_Event::LED_MODE_RPC, 1);
+        }
+        if (tick >= 3) {
+            Trace(log, output, time_us + 5000U, Trace_Event::LED_TOGGLED, tick & 1);
+        }
+        if (tick % 2 == 1) {
+            Trace(log, output, time_us + 8000U, Trace_Event::TELEMETRY_SENT, 71, 1);
+        }
+    }
+    // Events traced while the serial buffer was full are counted as dropped by the next record
+    for (size_t i = 0U; i < Log::FRAME_SIZE * 3U; i++) {
+        log.Trace(time_us, static_cast<uint16_t>(Trace_Event::LED_TOGGLED));
+        Trace_Record record;
+        log.Pop(record);
+    }
+    Trace(log, output, time_us + 20000U, Trace_Event::ATTRIBUTE_REQUEST_TIMEOUT, 5000);
+    Decode(output.data);
+
+    // Cost on this host of recording an event compared with formatting the text line the firmware printed before
+    Log bench;
+    Trace_Record record;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0U; i < BENCH_EVENTS; i++) {
+        bench.Trace(static_cast<uint32_t>(i), static_cast<uint16_t>(Trace_Event::BLINKING_INTERVAL_SET), static_cast<int32_t>(i));
+        bench.Pop(record);
+    }
+    double const trace_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCH_EVENTS;
+    char text[64];
+    int length = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0U; i < BENCH_EVENTS; i++) {
+        length = std::snprintf(text, sizeof(text), "Blinking interval is set to: %u\r\n", static_cast<unsigned int>(i % 60000U));
+    }
+    double const format_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCH_EVENTS;
+    std::printf("\nTrace %.1f ns per event, formatting %.1f ns per line (%u)\n", trace_ns, format_ns, static_cast<unsigned int>(record.sequence));
+    std::printf("At %u baud a %zu byte record takes %.1f ms on the wire, the %d byte text line %.1f ms, "
+        "either blocks loop() once the serial buffer is full, records are only drained as far as the buffer has room\n",
+        SERIAL_BAUD, Log::FRAME_SIZE, Log::FRAME_SIZE * 10e3 / SERIAL_BAUD, length, length * 10e3 / SERIAL_BAUD);
+    return 0;
+}
+
+} // namespace
+
+
+int main(int argc, char * argv[]) {
+    if (argc == 2 && std::strcmp(argv[1], "--demo") == 0) {
+        return Demo();
+    }
+    else if (argc != 1) {
+        std::fprintf(stderr, "Usage: %s [--demo] < capture.bin\n", argv[0]);
+        return 1;
+    }
+    std::string stream;
+    char buffer[4096];
+    size_t read = 0U;
+    while ((read = std::fread(buffer, 1U, sizeof(buffer), stdin)) > 0U) {
+        stream.append(buffer, read);
+    }
+    Decode(stream);
+    return 0;
+}